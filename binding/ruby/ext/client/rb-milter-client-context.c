@@ -21,6 +21,8 @@
 
 #define SELF(self) (MILTER_CLIENT_CONTEXT(RVAL2GOBJ(self)))
 
+static ID id_read;
+
 static VALUE
 initialize (int argc, VALUE *argv, VALUE self)
 {
@@ -200,6 +202,21 @@ replace_body (VALUE self, VALUE rb_chunk)
                                                 &error)) {
             RAISE_GERROR(error);
         }
+    } else if (rb_respond_to(rb_chunk, id_read)) {
+        VALUE rb_read_size = UINT2NUM(MILTER_CHUNK_SIZE);
+        VALUE rb_read_chunk;
+
+        /* Read and send by chunk not to keep the whole new body. */
+        while (!NIL_P(rb_read_chunk = rb_funcall(rb_chunk, id_read, 1,
+                                                 rb_read_size))) {
+            if (!milter_client_context_replace_body_stream(
+                    SELF(self),
+                    RSTRING_PTR(rb_read_chunk),
+                    RSTRING_LEN(rb_read_chunk),
+                    &error)) {
+                RAISE_GERROR(error);
+            }
+        }
     } else {
         GBytes *chunk = RVAL2BOXED(rb_chunk, G_TYPE_BYTES);;
         if (!milter_client_context_replace_body_bytes(SELF(self),
@@ -313,6 +330,8 @@ Init_milter_client_context (void)
 {
     VALUE rb_cMilterClientContext;
 
+    id_read = rb_intern("read");
+
     rb_cMilterClientContext = G_DEF_CLASS(MILTER_TYPE_CLIENT_CONTEXT,
                                           "ClientContext", rb_mMilter);
     G_DEF_ERROR2(MILTER_CLIENT_CONTEXT_ERROR,
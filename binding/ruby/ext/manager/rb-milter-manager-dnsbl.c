@@ -0,0 +1,158 @@
+/* -*- c-file-style: "ruby" -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <rb-milter-core-private.h>
+#include "rb-milter-manager-private.h"
+
+static VALUE
+add_service (VALUE self, VALUE domain)
+{
+    milter_manager_dnsbl_add_service(RVAL2CSTR(domain));
+    return Qnil;
+}
+
+static VALUE
+clear_services (VALUE self)
+{
+    milter_manager_dnsbl_clear_services();
+    return Qnil;
+}
+
+static VALUE
+add_name_server (int argc, VALUE *argv, VALUE self)
+{
+    VALUE address, port;
+    GError *error = NULL;
+
+    rb_scan_args(argc, argv, "11", &address, &port);
+
+    if (!milter_manager_dnsbl_add_name_server(RVAL2CSTR(address),
+					      NIL_P(port) ? 53 : NUM2UINT(port),
+					      &error))
+	RAISE_GERROR(error);
+
+    return Qnil;
+}
+
+static VALUE
+clear_name_servers (VALUE self)
+{
+    milter_manager_dnsbl_clear_name_servers();
+    return Qnil;
+}
+
+static VALUE
+get_timeout (VALUE self)
+{
+    return rb_float_new(milter_manager_dnsbl_get_timeout());
+}
+
+static VALUE
+set_timeout (VALUE self, VALUE timeout)
+{
+    milter_manager_dnsbl_set_timeout(NUM2DBL(timeout));
+    return Qnil;
+}
+
+static VALUE
+get_negative_cache_ttl (VALUE self)
+{
+    return UINT2NUM(milter_manager_dnsbl_get_negative_cache_ttl());
+}
+
+static VALUE
+set_negative_cache_ttl (VALUE self, VALUE ttl)
+{
+    milter_manager_dnsbl_set_negative_cache_ttl(NUM2UINT(ttl));
+    return Qnil;
+}
+
+static VALUE
+request_lookup (VALUE self, VALUE context)
+{
+    milter_manager_dnsbl_request_lookup(MILTER_CLIENT_CONTEXT(RVAL2GOBJ(context)));
+    return Qnil;
+}
+
+static VALUE
+lookup_requested_p (VALUE self, VALUE context)
+{
+    MilterClientContext *client_context;
+
+    client_context = MILTER_CLIENT_CONTEXT(RVAL2GOBJ(context));
+    return CBOOL2RVAL(milter_manager_dnsbl_is_lookup_requested(client_context));
+}
+
+/* Returns cached answers such as ["127.0.0.2"] or nil. An
+ * empty array means NXDOMAIN. */
+static VALUE
+cached_answers (VALUE self, VALUE query_domain)
+{
+    GList *answers = NULL;
+    VALUE rb_answers;
+
+    if (!milter_manager_dnsbl_get_cached_answers(RVAL2CSTR(query_domain),
+						 &answers))
+	return Qnil;
+
+    rb_answers = GLIST2ARY_STR(answers);
+    g_list_free_full(answers, g_free);
+    return rb_answers;
+}
+
+static VALUE
+clear_cache (VALUE self)
+{
+    milter_manager_dnsbl_clear_cache();
+    return Qnil;
+}
+
+void
+Init_milter_manager_dnsbl (void)
+{
+    VALUE rb_mMilterManagerDNSBL;
+
+    rb_mMilterManagerDNSBL =
+	rb_define_module_under(rb_mMilterManager, "DNSBL");
+
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "add_service", add_service, 1);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "clear_services", clear_services, 0);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "add_name_server", add_name_server, -1);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "clear_name_servers", clear_name_servers, 0);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "timeout", get_timeout, 0);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "timeout=", set_timeout, 1);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "negative_cache_ttl", get_negative_cache_ttl, 0);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "negative_cache_ttl=", set_negative_cache_ttl, 1);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "request_lookup", request_lookup, 1);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "lookup_requested?", lookup_requested_p, 1);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "cached_answers", cached_answers, 1);
+    rb_define_module_function(rb_mMilterManagerDNSBL,
+			      "clear_cache", clear_cache, 0);
+}
@@ -36,6 +36,8 @@ extern void Init_milter_manager_children (void);
 extern void Init_milter_manager_control_command_encoder (void);
 extern void Init_milter_manager_control_reply_encoder (void);
 extern void Init_milter_manager_control_decoder (void);
+extern void Init_milter_manager_tcp_connection_table (void);
+extern void Init_milter_manager_dnsbl (void);
 
 extern VALUE rb_milter_manager_gstring_handle_to_xml_signal (guint num, const GValue *values);
 
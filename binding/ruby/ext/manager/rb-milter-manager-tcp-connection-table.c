@@ -0,0 +1,125 @@
+/* -*- c-file-style: "ruby" -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <rb-milter-core-private.h>
+#include "rb-milter-manager-private.h"
+
+static ID id_pack;
+
+static VALUE
+available_p (VALUE self)
+{
+    return CBOOL2RVAL(milter_manager_tcp_connection_table_is_available());
+}
+
+static VALUE
+get_lifetime (VALUE self)
+{
+    return rb_float_new(milter_manager_tcp_connection_table_get_lifetime());
+}
+
+static VALUE
+set_lifetime (VALUE self, VALUE lifetime)
+{
+    milter_manager_tcp_connection_table_set_lifetime(NUM2DBL(lifetime));
+    return Qnil;
+}
+
+static VALUE
+update (VALUE self)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_tcp_connection_table_update(&error))
+	RAISE_GERROR(error);
+
+    return Qnil;
+}
+
+/* Returns [STATE, LOCAL_ADDRESS] such as ["ESTABLISHED",
+ * Milter::SocketAddress::IPv4] or nil. STATE uses the same
+ * format as netstat. */
+static VALUE
+lookup (int argc, VALUE *argv, VALUE self)
+{
+    VALUE rb_address, rb_update_on_miss, packed_address;
+    MilterManagerTCPState state;
+    MilterGenericSocketAddress local_address;
+    socklen_t local_address_length;
+    gchar *state_name, *position;
+    VALUE rb_state;
+
+    rb_scan_args(argc, argv, "11", &rb_address, &rb_update_on_miss);
+
+    if (RVAL2CBOOL(rb_obj_is_kind_of(rb_address, rb_cString)))
+	packed_address = rb_address;
+    else
+	packed_address = rb_funcall(rb_address, id_pack, 0);
+
+    if (!milter_manager_tcp_connection_table_lookup(
+	    (const struct sockaddr *)RSTRING_PTR(packed_address),
+	    RSTRING_LEN(packed_address),
+	    RVAL2CBOOL(rb_update_on_miss),
+	    &state,
+	    &local_address))
+	return Qnil;
+
+    state_name = milter_utils_get_enum_nick_name(MILTER_TYPE_MANAGER_TCP_STATE,
+						 state);
+    for (position = state_name; *position; position++) {
+	if (*position == '-')
+	    *position = '_';
+	else
+	    *position = g_ascii_toupper(*position);
+    }
+    rb_state = CSTR2RVAL(state_name);
+    g_free(state_name);
+
+    if (local_address.address.base.sa_family == AF_INET)
+	local_address_length = sizeof(struct sockaddr_in);
+    else
+	local_address_length = sizeof(struct sockaddr_in6);
+
+    return rb_ary_new3(2,
+		       rb_state,
+		       ADDRESS2RVAL(&(local_address.address.base),
+				    local_address_length));
+}
+
+void
+Init_milter_manager_tcp_connection_table (void)
+{
+    VALUE rb_mMilterManagerTCPConnectionTable;
+
+    id_pack = rb_intern("pack");
+
+    rb_mMilterManagerTCPConnectionTable =
+	rb_define_module_under(rb_mMilterManager, "TCPConnectionTable");
+
+    rb_define_module_function(rb_mMilterManagerTCPConnectionTable,
+			      "available?", available_p, 0);
+    rb_define_module_function(rb_mMilterManagerTCPConnectionTable,
+			      "lifetime", get_lifetime, 0);
+    rb_define_module_function(rb_mMilterManagerTCPConnectionTable,
+			      "lifetime=", set_lifetime, 1);
+    rb_define_module_function(rb_mMilterManagerTCPConnectionTable,
+			      "update", update, 0);
+    rb_define_module_function(rb_mMilterManagerTCPConnectionTable,
+			      "lookup", lookup, -1);
+}
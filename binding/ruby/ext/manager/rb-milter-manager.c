@@ -34,4 +34,6 @@ Init_milter_manager (void)
     Init_milter_manager_control_command_encoder();
     Init_milter_manager_control_reply_encoder();
     Init_milter_manager_control_decoder();
+    Init_milter_manager_tcp_connection_table();
+    Init_milter_manager_dnsbl();
 }
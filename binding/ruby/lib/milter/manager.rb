@@ -232,9 +232,16 @@ module Milter
         dump_item("manager.packet_buffer_size", c.default_packet_buffer_size)
         dump_item("manager.connection_check_interval",
                   c.connection_check_interval.inspect)
+        dump_item("manager.connection_check_batch_size",
+                  c.connection_check_batch_size)
         dump_item("manager.chunk_size", c.chunk_size)
         dump_item("manager.max_pending_finished_sessions",
                   c.max_pending_finished_sessions)
+        dump_item("manager.parallel_message_processing",
+                  c.parallel_message_processing?)
+        dump_item("manager.max_on_memory_body_size",
+                  c.max_on_memory_body_size)
+        dump_item("manager.reuse_port", c.reuse_port?)
         @result << "\n"
       end
 
@@ -347,6 +354,7 @@ module Milter
         dump_egg_item(name, "enabled", egg.enabled?)
         dump_egg_item(name, "fallback_status", egg.fallback_status.nick.inspect)
         dump_egg_item(name, "evaluation_mode", egg.evaluation_mode?)
+        dump_egg_item(name, "reuse_connection", egg.reuse_connection?)
         dump_egg_applicable_conditions(egg)
         dump_egg_item(name, "command", egg.command.inspect)
         dump_egg_item(name, "command_options", egg.command_options.inspect)
@@ -973,6 +981,30 @@ module Milter
             @configuration.max_pending_finished_sessions = n_sessions
           end
 
+          def parallel_message_processing?
+            @configuration.parallel_message_processing?
+          end
+
+          def parallel_message_processing=(boolean)
+            @configuration.parallel_message_processing = boolean
+          end
+
+          def max_on_memory_body_size
+            @configuration.max_on_memory_body_size
+          end
+
+          def max_on_memory_body_size=(size)
+            @configuration.max_on_memory_body_size = size
+          end
+
+          def reuse_port?
+            @configuration.reuse_port?
+          end
+
+          def reuse_port=(boolean)
+            @configuration.reuse_port = boolean
+          end
+
           def maintained_hooks
             @configuration.maintained_hooks
           end
@@ -1030,6 +1062,16 @@ module Milter
           @raw_configuration.connection_check_interval = interval
         end
 
+        def connection_check_batch_size
+          @raw_configuration.connection_check_batch_size
+        end
+
+        def connection_check_batch_size=(size)
+          update_location("connection_check_batch_size", size.nil?)
+          size ||= 30
+          @raw_configuration.connection_check_batch_size = size
+        end
+
         def netstat_connection_checker
           @raw_configuration.netstat_connection_checker
         end
@@ -1051,8 +1093,13 @@ module Milter
           self.connection_check_interval = interval
           checker = netstat_connection_checker
           checker.database_lifetime = interval
-          define_connection_checker("netstat") do |context|
-            checker.connected?(context)
+          if checker.use_tcp_connection_table?
+            # Leaders are checked in C without running netstat.
+            @raw_configuration.use_tcp_connection_table = true
+          else
+            define_connection_checker("netstat") do |context|
+              checker.connected?(context)
+            end
           end
         end
 
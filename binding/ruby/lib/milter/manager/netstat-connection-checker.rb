@@ -32,7 +32,12 @@ module Milter::Manager
       @options = (options || {}).dup
       @database = nil
       @last_update = nil
-      detect_netstat_command_line
+      detect_tcp_connection_table
+      detect_netstat_command_line if @tcp_connection_table.nil?
+    end
+
+    def use_tcp_connection_table?
+      not @tcp_connection_table.nil?
     end
 
     def connected?(context)
@@ -64,6 +69,7 @@ module Milter::Manager
 
     def database_lifetime=(lifetime)
       @options[:database_lifetime] = lifetime
+      @tcp_connection_table.lifetime = lifetime if @tcp_connection_table
     end
 
     private
@@ -82,7 +88,7 @@ module Milter::Manager
     end
 
     def connection_info(address, options={})
-      return nil if @netstat_command_line.nil?
+      return nil if @tcp_connection_table.nil? and @netstat_command_line.nil?
       type = nil
       case address
       when Milter::SocketAddress::IPv4
@@ -101,6 +107,10 @@ module Milter::Manager
         return nil
       end
 
+      if @tcp_connection_table
+        return tcp_connection_table_connection_info(type, address, options)
+      end
+
       tcp_address = "#{address.address}:#{address.port}"
       update_database
       info = @database[type][tcp_address]
@@ -112,6 +122,16 @@ module Milter::Manager
       info
     end
 
+    def tcp_connection_table_connection_info(type, address, options)
+      state, local_address =
+        @tcp_connection_table.lookup(address, !!options[:retry])
+      return nil if state.nil?
+      ConnectionInfo.new(type.to_s,
+                         local_address.address, local_address.port.to_s,
+                         address.address, address.port.to_s,
+                         state)
+    end
+
     def purge_cache
       @database = nil
       @last_update = nil
@@ -161,6 +181,16 @@ module Milter::Manager
       [ip_address, port]
     end
 
+    def detect_tcp_connection_table
+      @tcp_connection_table = nil
+      return unless Milter::Manager.const_defined?(:TCPConnectionTable)
+      table = Milter::Manager::TCPConnectionTable
+      return unless table.available?
+      table.lifetime = database_lifetime
+      @tcp_connection_table = table
+      Milter::Logger.info("[netstat][detect] <TCP connection table>")
+    end
+
     def detect_netstat_command_line
       @netstat_command_line = nil
       @netstat_command_env = ENV.to_h
@@ -24,9 +24,11 @@ module Milter::Manager
 
     def initialize
       @table = []
+      @index = build_index(@table)
     end
 
     def parse(io)
+      table = @table.dup
       each_line(io) do |line, line_no|
         case line
         when /\A\s*([\d\.]+|[\da-fA-F:]+)(?:\/(\d+))?\s+(.+)\s*$/
@@ -41,19 +43,121 @@ module Milter::Manager
             raise InvalidValueError.new(address, $!.message, line,
                                         io.path, line_no)
           end
-          @table << [ip_address, action]
+          table << [ip_address, action]
         else
           raise InvalidFormatError.new(line, io.path, line_no)
         end
       end
+      index = build_index(table)
+      @table, @index = table, index
     end
 
+    # Returns the action of the first entry in the table that
+    # includes address like Postfix's cidr_table(5). Entries are
+    # indexed by a path compressed binary trie (Patricia trie) per
+    # address family. So a lookup only visits nodes for prefixes in
+    # the table on the address's path instead of all entries or
+    # all address bits.
     def find(address)
       address = address.to_ip_address if address.respond_to?(:to_ip_address)
-      @table.each do |match_address, action|
-        return action if match_address === address
+      unless address.is_a?(IPAddr)
+        begin
+          address = IPAddr.new(address.to_s)
+        rescue ArgumentError
+          return nil
+        end
+      end
+      root, n_bits = @index[address.family]
+      return nil if root.nil?
+
+      value = address.to_i
+      node = root
+      found = nil
+      while node
+        break unless prefix_match?(value, node.prefix, node.length, n_bits)
+        entry = node.entry
+        found = entry if entry and (found.nil? or entry[0] < found[0])
+        break if node.length == n_bits
+        node = node.children[bit_at(value, node.length, n_bits)]
       end
-      nil
+      return nil if found.nil?
+      found[1]
+    end
+
+    private
+    # A node has the prefix of length bits and the earliest table
+    # entry, [table_index, action], for the prefix if exists.
+    # Nodes without entry exist only as branches.
+    class Node < Struct.new(:prefix, :length, :children, :entry)
+      def initialize(prefix, length, entry=nil)
+        super(prefix, length, [nil, nil], entry)
+      end
+    end
+
+    def build_index(table)
+      index = {
+        Socket::AF_INET => [Node.new(0, 0), 32],
+        Socket::AF_INET6 => [Node.new(0, 0), 128],
+      }
+      table.each_with_index do |(ip_address, action), i|
+        root, n_bits = index[ip_address.family]
+        next if root.nil?
+        insert(root, ip_address.to_i, ip_address.prefix, n_bits, [i, action])
+      end
+      index
+    end
+
+    def insert(node, value, length, n_bits, entry)
+      value = mask(value, length, n_bits)
+      loop do
+        if node.length == length
+          node.entry ||= entry
+          return
+        end
+        bit = bit_at(value, node.length, n_bits)
+        child = node.children[bit]
+        if child.nil?
+          node.children[bit] = Node.new(value, length, entry)
+          return
+        end
+        common_length = common_prefix_length(value, child.prefix,
+                                             [length, child.length].min,
+                                             n_bits)
+        if common_length == child.length
+          node = child
+          next
+        end
+        if common_length == length
+          branch = Node.new(value, length, entry)
+        else
+          branch = Node.new(mask(value, common_length, n_bits),
+                            common_length)
+          branch.children[bit_at(value, common_length, n_bits)] =
+            Node.new(value, length, entry)
+        end
+        branch.children[bit_at(child.prefix, common_length, n_bits)] = child
+        node.children[bit] = branch
+        return
+      end
+    end
+
+    def mask(value, length, n_bits)
+      return 0 if length.zero?
+      value & (((1 << length) - 1) << (n_bits - length))
+    end
+
+    def bit_at(value, position, n_bits)
+      (value >> (n_bits - position - 1)) & 1
+    end
+
+    def prefix_match?(value, prefix, length, n_bits)
+      mask(value, length, n_bits) == prefix
+    end
+
+    def common_prefix_length(value1, value2, max_length, n_bits)
+      diff = mask(value1 ^ value2, max_length, n_bits)
+      return max_length if diff.zero?
+      n_bits - diff.bit_length
     end
   end
 end
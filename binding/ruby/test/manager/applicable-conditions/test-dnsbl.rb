@@ -0,0 +1,248 @@
+# Copyright (C) 2026  Kouhei Sutou <kou@clear-code.com>
+#
+# This library is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+class TestApplicableConditionsDNSBL < Test::Unit::TestCase
+  class StubResolver
+    attr_reader :queries
+    def initialize(answers, not_found_class)
+      @answers = answers
+      @not_found_class = not_found_class
+      @queries = []
+    end
+
+    def getresources(name, type)
+      name = name.chomp(".")
+      @queries << name
+      answers = @answers[name]
+      raise @not_found_class, name if answers.nil?
+      raise answers if answers.is_a?(Exception)
+      answers.collect do |address, ttl|
+        resource = type.new(address)
+        resource.instance_variable_set(:@ttl, ttl)
+        resource
+      end
+    end
+  end
+
+  def setup
+    @configuration = Milter::Manager::Configuration.new
+    @configuration.clear_load_paths
+    @configuration.append_load_path("#{ENV['TOP_SRCDIR']}/data")
+    @loader = Milter::Manager::ConfigurationLoader.new(@configuration)
+    @loader.load("applicable-conditions/dnsbl.conf")
+    @dnsbl = @loader.dnsbl
+    @dnsbl.prefetch = false
+    @dnsbl.clear_services
+    @dnsbl.clear_cache
+    @dnsbl.add_service("bl.example.com", "127.0.0.2")
+    @server = nil
+  end
+
+  def teardown
+    @server.close if @server
+  end
+
+  def test_listed
+    resolver = stub_resolver("2.0.0.192.bl.example.com" =>
+                              [["127.0.0.2", 300]])
+    @dnsbl.resolver = resolver
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+  end
+
+  def test_not_listed
+    resolver = stub_resolver({})
+    @dnsbl.resolver = resolver
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+  end
+
+  def test_unexpected_answer
+    resolver = stub_resolver("2.0.0.192.bl.example.com" =>
+                              [["127.0.0.4", 300]])
+    @dnsbl.resolver = resolver
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.2")))
+  end
+
+  def test_cache_positive
+    resolver = stub_resolver("2.0.0.192.bl.example.com" =>
+                              [["127.0.0.2", 300]])
+    @dnsbl.resolver = resolver
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+    assert_equal(["2.0.0.192.bl.example.com"], resolver.queries)
+  end
+
+  def test_cache_negative
+    resolver = stub_resolver({})
+    @dnsbl.resolver = resolver
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_equal(["3.0.0.192.bl.example.com"], resolver.queries)
+  end
+
+  def test_cache_negative_disabled
+    resolver = stub_resolver({})
+    @dnsbl.resolver = resolver
+    @dnsbl.negative_cache_ttl = 0
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_equal(["3.0.0.192.bl.example.com",
+                  "3.0.0.192.bl.example.com"],
+                 resolver.queries)
+  end
+
+  def test_cache_expired
+    resolver = stub_resolver("2.0.0.192.bl.example.com" =>
+                              [["127.0.0.2", 0]])
+    @dnsbl.resolver = resolver
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+    assert_equal(["2.0.0.192.bl.example.com",
+                  "2.0.0.192.bl.example.com"],
+                 resolver.queries)
+  end
+
+  def test_lookup_error
+    @dnsbl.add_service("bl2.example.com", "127.0.0.2")
+    resolver = stub_resolver("2.0.0.192.bl.example.com" =>
+                              Resolv::ResolvError.new("timeout"),
+                             "2.0.0.192.bl2.example.com" =>
+                              [["127.0.0.2", 300]])
+    @dnsbl.resolver = resolver
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+  end
+
+  def test_lookup_error_not_cached
+    resolver = stub_resolver("3.0.0.192.bl.example.com" =>
+                              Resolv::ResolvError.new("timeout"))
+    @dnsbl.resolver = resolver
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_equal(["3.0.0.192.bl.example.com",
+                  "3.0.0.192.bl.example.com"],
+                 resolver.queries)
+  end
+
+  def test_no_data_not_cached
+    resolver = stub_resolver("3.0.0.192.bl.example.com" => [])
+    @dnsbl.resolver = resolver
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_equal(["3.0.0.192.bl.example.com",
+                  "3.0.0.192.bl.example.com"],
+                 resolver.queries)
+  end
+
+  def test_name_server_listed
+    start_name_server("2.0.0.192.bl.example.com" => ["127.0.0.2", 300])
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+    assert_true(@dnsbl.listed?(ipv4("192.0.0.2")))
+    assert_equal(["2.0.0.192.bl.example.com"], @queries)
+  end
+
+  def test_name_server_nxdomain
+    start_name_server("3.0.0.192.bl.example.com" => :nxdomain)
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_equal(["3.0.0.192.bl.example.com"], @queries)
+  end
+
+  def test_name_server_servfail
+    start_name_server("3.0.0.192.bl.example.com" => :servfail)
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_equal(["3.0.0.192.bl.example.com",
+                  "3.0.0.192.bl.example.com"],
+                 @queries)
+  end
+
+  def test_name_server_timeout
+    start_name_server("3.0.0.192.bl.example.com" => :timeout)
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.3")))
+    assert_equal(["3.0.0.192.bl.example.com",
+                  "3.0.0.192.bl.example.com"],
+                 @queries)
+  end
+
+  def test_prefetch_request_lookup
+    context = Milter::ClientContext.new
+    @dnsbl.prefetch = true
+    assert_false(Milter::Manager::DNSBL.lookup_requested?(context))
+    @dnsbl.request_lookup(context)
+    assert_true(Milter::Manager::DNSBL.lookup_requested?(context))
+  end
+
+  def test_prefetch_not_cached
+    resolver = stub_resolver("2.0.0.192.bl.example.com" =>
+                              [["127.0.0.2", 300]])
+    @dnsbl.resolver = resolver
+    @dnsbl.prefetch = true
+    assert_false(@dnsbl.listed?(ipv4("192.0.0.2")))
+    assert_equal([], resolver.queries)
+  end
+
+  private
+  def ipv4(address)
+    Milter::SocketAddress::IPv4.new(address, 2929)
+  end
+
+  def stub_resolver(answers)
+    StubResolver.new(answers, @dnsbl.singleton_class::NotFound)
+  end
+
+  # Starts a name server on localhost that answers the given
+  # responses: [address, ttl], :nxdomain, :servfail or :timeout
+  # (no response).
+  def start_name_server(responses)
+    @server = UDPSocket.new
+    @server.bind("127.0.0.1", 0)
+    @queries = []
+    Thread.new do
+      begin
+        loop do
+          data, (_, port, host, _) = @server.recvfrom(512)
+          request = Resolv::DNS::Message.decode(data)
+          question_name, = request.question.first
+          name = question_name.to_s
+          @queries << name
+          response = responses[name] || :nxdomain
+          next if response == :timeout
+          reply = Resolv::DNS::Message.new(request.id)
+          reply.qr = 1
+          reply.rd = request.rd
+          reply.ra = 1
+          request.question.each do |request_name, type|
+            reply.add_question(request_name, type)
+          end
+          case response
+          when :nxdomain
+            reply.rcode = Resolv::DNS::RCode::NXDomain
+          when :servfail
+            reply.rcode = Resolv::DNS::RCode::ServFail
+          else
+            address, ttl = response
+            reply.add_answer(question_name, ttl,
+                             Resolv::DNS::Resource::IN::A.new(address))
+          end
+          @server.send(reply.encode, 0, host, port)
+        end
+      rescue IOError
+        # Closed by teardown.
+      end
+    end
+    @dnsbl.name_server = ["127.0.0.1", @server.addr[1]]
+    @dnsbl.timeout = 0.2
+  end
+end
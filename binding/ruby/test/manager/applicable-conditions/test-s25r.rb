@@ -0,0 +1,76 @@
+# Copyright (C) 2026  Kouhei Sutou <kou@clear-code.com>
+#
+# This library is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+class TestApplicableConditionsS25R < Test::Unit::TestCase
+  def setup
+    @configuration = Milter::Manager::Configuration.new
+    @configuration.clear_load_paths
+    @configuration.append_load_path("#{ENV['TOP_SRCDIR']}/data")
+    @loader = Milter::Manager::ConfigurationLoader.new(@configuration)
+    @loader.load("applicable-conditions/s25r.conf")
+    @s25r = @loader.s25r
+    @address = Milter::SocketAddress::IPv4.new("192.0.2.1", 2929)
+  end
+
+  def test_white_regexp
+    assert_true(@s25r.white?("mail-xxx.google.com", @address))
+    assert_false(@s25r.white?("google.com.example.net", @address))
+  end
+
+  def test_black_string
+    assert_true(@s25r.black?("unknown", @address))
+    assert_false(@s25r.black?("unknown.example.com", @address))
+  end
+
+  def test_black_regexp
+    assert_true(@s25r.black?("dhcp1.example.com", @address))
+    assert_true(@s25r.black?("DSL1.example.com", @address))
+    assert_true(@s25r.black?("[192.0.2.1]", @address))
+    assert_false(@s25r.black?("mail.example.com", @address))
+  end
+
+  def test_add_after_match
+    assert_false(@s25r.white?("mail.example.com", @address))
+    @s25r.add_whitelist(/\Amail\.example\.com\z/)
+    assert_true(@s25r.white?("mail.example.com", @address))
+  end
+
+  def test_backreference
+    @s25r.add_blacklist(/\A(\w)\1\./)
+    assert_true(@s25r.black?("aa.example.com", @address))
+    assert_false(@s25r.black?("ab.example.com", @address))
+  end
+
+  def test_named_group
+    @s25r.add_blacklist(/\A(?<label>[a-z]+)-\k<label>\./)
+    assert_true(@s25r.black?("mx-mx.example.com", @address))
+    assert_false(@s25r.black?("mx-my.example.com", @address))
+    assert_true(@s25r.black?("dhcp1.example.com", @address))
+  end
+
+  def test_add_proc
+    @s25r.add_whitelist do |host|
+      host.end_with?(".example.org")
+    end
+    assert_true(@s25r.white?("mail.example.org", @address))
+    assert_false(@s25r.white?("mail.example.net", @address))
+  end
+
+  def test_only_check_ipv4
+    address = Milter::SocketAddress::IPv6.new("::1", 2929)
+    assert_true(@s25r.white?("unknown", address))
+    assert_false(@s25r.black?("unknown", address))
+  end
+end
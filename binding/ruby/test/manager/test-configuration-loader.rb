@@ -257,6 +257,28 @@ class TestConfigurationLoader < Test::Unit::TestCase
     assert_equal(0, @configuration.max_pending_finished_sessions)
   end
 
+  def test_manager_parallel_message_processing
+    assert_false(@configuration.parallel_message_processing?)
+    @loader.manager.parallel_message_processing = true
+    assert_true(@configuration.parallel_message_processing?)
+    assert_equal(@configuration.parallel_message_processing?,
+                 @loader.manager.parallel_message_processing?)
+  end
+
+  def test_manager_max_on_memory_body_size
+    assert_equal(5242880, @configuration.max_on_memory_body_size)
+    @loader.manager.max_on_memory_body_size = 1024
+    assert_equal(1024, @configuration.max_on_memory_body_size)
+  end
+
+  def test_manager_reuse_port
+    assert_false(@configuration.reuse_port?)
+    @loader.manager.reuse_port = true
+    assert_true(@configuration.reuse_port?)
+    assert_equal(@configuration.reuse_port?,
+                 @loader.manager.reuse_port?)
+  end
+
   def test_database_type
     assert_equal(nil, @configuration.database.type)
     @loader.database.type = "mysql"
@@ -66,6 +66,12 @@ class TestConfiguration < Test::Unit::TestCase
     assert_equal(10, @configuration.connection_check_interval)
   end
 
+  def test_connection_check_batch_size
+    assert_equal(30, @configuration.connection_check_batch_size)
+    @configuration.connection_check_batch_size = 0
+    assert_equal(0, @configuration.connection_check_batch_size)
+  end
+
   def test_event_loop_backend
     assert_equal("glib", @configuration.event_loop_backend.nick)
     @configuration.event_loop_backend = "libev"
@@ -300,9 +306,17 @@ manager.packet_buffer_size = 0
 # default
 manager.connection_check_interval = 0
 # default
+manager.connection_check_batch_size = 30
+# default
 manager.chunk_size = 65535
 # default
 manager.max_pending_finished_sessions = 0
+# default
+manager.parallel_message_processing = false
+# default
+manager.max_on_memory_body_size = 5242880
+# default
+manager.reuse_port = false
 
 # default
 controller.connection_spec = nil
@@ -445,9 +459,17 @@ manager.packet_buffer_size = 0
 # default
 manager.connection_check_interval = 0
 # default
+manager.connection_check_batch_size = 30
+# default
 manager.chunk_size = 65535
 # default
 manager.max_pending_finished_sessions = 0
+# default
+manager.parallel_message_processing = false
+# default
+manager.max_on_memory_body_size = 5242880
+# default
+manager.reuse_port = false
 
 # #{__FILE__}:#{controller_connection_spec}
 controller.connection_spec = "inet:10025"
@@ -493,6 +515,8 @@ define_milter("milter1") do |milter|
   milter.fallback_status = "accept"
   # default
   milter.evaluation_mode = false
+  # default
+  milter.reuse_connection = false
   milter.applicable_conditions = [
     # #{__FILE__}:#{milter1_lines[:applicable_condition_s25r]}
     "S25R",
@@ -526,6 +550,8 @@ define_milter("milter2") do |milter|
   # #{__FILE__}:#{milter2_lines[:evaluation_mode]}
   milter.evaluation_mode = true
   # default
+  milter.reuse_connection = false
+  # default
   milter.applicable_conditions = []
   # default
   milter.command = nil
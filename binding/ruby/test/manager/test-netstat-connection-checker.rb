@@ -161,6 +161,33 @@ EON
                  @checker.instance_variable_get(:@database))
   end
 
+  def test_tcp_connection_table
+    unless Milter::Manager.const_defined?(:TCPConnectionTable)
+      omit("TCP connection table isn't bound")
+    end
+    table = Milter::Manager::TCPConnectionTable
+    omit("TCP connection table isn't available") unless table.available?
+
+    lifetime = table.lifetime
+    server = TCPServer.new("127.0.0.1", 0)
+    client = TCPSocket.new("127.0.0.1", server.addr[1])
+    accepted = server.accept
+    begin
+      checker = Milter::Manager::NetstatConnectionChecker.new
+      assert_true(checker.use_tcp_connection_table?)
+      client_address = Milter::SocketAddress::IPv4.new("127.0.0.1",
+                                                       client.addr[1])
+      assert_equal(["127.0.0.1", server.addr[1].to_s],
+                   [checker.smtp_server_interface_ip_address(client_address),
+                    checker.smtp_server_interface_port(client_address)])
+    ensure
+      accepted.close
+      client.close
+      server.close
+      table.lifetime = lifetime
+    end
+  end
+
   private
   def info(protocol,
            local_ip_address, local_port,
@@ -87,6 +87,53 @@ EOC
     assert_equal("OK", @table.find(ipv6("2001:2f8:c2:201::fff0")))
   end
 
+  def test_first_match_over_longest_match
+    @table.parse(create_input(<<-EOC))
+192.168.0.0/16          OK
+192.168.1.0/24          REJECT
+192.168.1.1             DISCARD
+EOC
+    assert_equal("OK", @table.find(ipv4("192.168.1.1")))
+  end
+
+  def test_split_compressed_path
+    @table.parse(create_input(<<-EOC))
+192.168.1.0/24          OK
+192.168.0.0/16          REJECT
+10.0.0.0/8              DISCARD
+192.168.128.0/17        OK
+EOC
+    assert_equal(["OK", "REJECT", "REJECT", "DISCARD", nil],
+                 [@table.find(ipv4("192.168.1.5")),
+                  @table.find(ipv4("192.168.2.1")),
+                  @table.find(ipv4("192.168.200.1")),
+                  @table.find(ipv4("10.1.1.1")),
+                  @table.find(ipv4("11.0.0.1"))])
+  end
+
+  def test_no_match_ipv4
+    @table.parse(create_input(<<-EOC))
+192.168.1.0/24          OK
+2001:2f8:c2:201::0/64   REJECT
+EOC
+    assert_nil(@table.find(ipv4("192.168.2.1")))
+  end
+
+  def test_parse_error_keeps_loaded_entries
+    @table.parse(create_input(<<-EOC))
+192.168.1.1             OK
+EOC
+    assert_raise(Milter::Manager::ConditionTable::InvalidFormatError) do
+      @table.parse(create_input(<<-EOC))
+192.168.1.0/24          REJECT
+x:: OK
+EOC
+    end
+    assert_equal([nil, "OK"],
+                 [@table.find(ipv4("192.168.1.2")),
+                  @table.find(ipv4("192.168.1.1"))])
+  end
+
   def test_logical_line
     @table.parse(create_input(<<-EOC))
 192.168.1.1
@@ -470,6 +470,15 @@ cb_abort (MilterClientContext *context, MilterClientContextState state,
     return libmilter_compatible_convert_status_to(status);
 }
 
+static void
+cb_quit_new_connection (MilterClientContext *context, gpointer user_data)
+{
+    SmfiContext *smfi_context = user_data;
+
+    if (filter_description->xxfi_close)
+        filter_description->xxfi_close(smfi_context);
+}
+
 static void
 cb_finished (MilterFinishedEmittable *emittable, gpointer user_data)
 {
@@ -511,6 +520,8 @@ smfi_context_attach_to_client_context (SmfiContext *context)
 
 #undef CONNECT
 
+    g_signal_connect(client_context, "quit-new-connection",
+                     G_CALLBACK(cb_quit_new_connection), context);
     g_signal_connect(client_context, "finished",
                      G_CALLBACK(cb_finished), context);
 }
@@ -542,6 +553,7 @@ smfi_context_detach_from_client_context (SmfiContext *context)
     DISCONNECT(end_of_message);
     DISCONNECT(abort);
 
+    DISCONNECT(quit_new_connection);
     DISCONNECT(finished);
 
 #undef DISCONNECT
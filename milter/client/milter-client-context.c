@@ -23,12 +23,17 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include <milter/core.h>
 #include "../client.h"
 #include "milter-client-context.h"
 #include "milter-client-enum-types.h"
 
+#define REPLACE_BODY_MAX_PENDING_SIZE (MILTER_CHUNK_SIZE * 16)
+#define REPLACE_BODY_DRAIN_TIMEOUT 5.0
+
 enum
 {
     NEGOTIATE,
@@ -63,6 +68,8 @@ enum
 
     MESSAGE_PROCESSED,
 
+    QUIT_NEW_CONNECTION,
+
     LAST_SIGNAL
 };
 
@@ -105,7 +112,7 @@ struct _MilterClientContextPrivate
     gchar *extended_reply_code;
     gchar *reply_message;
     guint timeout;
-    guint timeout_id;
+    MilterEventLoopDeadline timeout_deadline;
     gchar *quarantine_reason;
     MilterGenericSocketAddress address;
     MilterMessageResult *message_result;
@@ -2132,6 +2139,37 @@ milter_client_context_class_init (MilterClientContextClass *klass)
                      NULL,
                      G_TYPE_NONE, 1, MILTER_TYPE_MESSAGE_RESULT);
 
+    /**
+     * MilterClientContext::quit-new-connection:
+     * @context: the context that received the signal.
+     *
+     * This signal is emitted when MTA finishes the current
+     * connection but keeps the socket for the next
+     * connection (SMFIC_QUIT_NC). Connection related data
+     * such as macros are cleared after this signal. The
+     * next connection starts with
+     * #MilterClientContext::connect without negotiation
+     * because the negotiated option is kept.
+     *
+     * #MilterFinishedEmittable::finished isn't emitted
+     * until the socket is closed. Connect this signal if
+     * you release per connection resources on
+     * #MilterFinishedEmittable::finished.
+     *
+     * See also <ulink
+     * url="https://www.milter.org/developers/api/xxfi_close">
+     * xxfi_close</ulink> on milter.org.
+     */
+    signals[QUIT_NEW_CONNECTION] =
+        g_signal_new("quit-new-connection",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     G_STRUCT_OFFSET(MilterClientContextClass,
+                                     quit_new_connection),
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE, 0);
+
     g_type_class_add_private(gobject_class, sizeof(MilterClientContextPrivate));
 }
 
@@ -2151,7 +2189,7 @@ milter_client_context_init (MilterClientContext *context)
     priv->extended_reply_code = NULL;
     priv->reply_message = NULL;
     priv->timeout = 7210;
-    priv->timeout_id = 0;
+    milter_event_loop_deadline_init(&(priv->timeout_deadline));
     priv->quarantine_reason = NULL;
     memset(&(priv->address), '\0', sizeof(priv->address));
 
@@ -2172,12 +2210,7 @@ disable_timeout (MilterClientContext *context)
 
     priv = MILTER_CLIENT_CONTEXT_GET_PRIVATE(context);
 
-    if (priv->timeout_id > 0) {
-        MilterEventLoop *loop;
-        loop = milter_agent_get_event_loop(MILTER_AGENT(context));
-        milter_event_loop_remove(loop, priv->timeout_id);
-        priv->timeout_id = 0;
-    }
+    milter_event_loop_deadline_cancel(&(priv->timeout_deadline));
 }
 
 static void
@@ -2651,10 +2684,11 @@ write_packet_without_error_handling (MilterClientContext *context,
 
     disable_timeout(context);
     loop = milter_agent_get_event_loop(MILTER_AGENT(context));
-    priv->timeout_id = milter_event_loop_add_timeout(loop,
-                                                     priv->timeout,
-                                                     cb_timeout,
-                                                     context);
+    milter_event_loop_deadline_set(loop,
+                                   &(priv->timeout_deadline),
+                                   priv->timeout,
+                                   cb_timeout,
+                                   context);
     success = milter_agent_write_packet(MILTER_AGENT(context),
                                         packet, packet_size,
                                         &agent_error);
@@ -3137,29 +3171,9 @@ milter_client_context_delete_recipient (MilterClientContext *context,
     return write_packet_on_end_of_message(context, packet, packet_size);
 }
 
-/**
- * milter_client_context_replace_body: (skip)
- * @context: A #MilterClientContext.
- * @body: (array length=body_size) (element-type guint8): the new body.
- * @body_size: The size of @body.
- * @error: Return location for an error, or %NULL.
- *
- * This is a `const gchar *` version of
- * milter_client_context_replace_body_bytes().
- *
- * Returns: %TRUE on success.
- */
-gboolean
-milter_client_context_replace_body (MilterClientContext *context,
-                                    const gchar *body, gsize body_size,
-                                    GError **error)
+static gboolean
+validate_replace_body (MilterClientContextPrivate *priv, GError **error)
 {
-    MilterClientContextPrivate *priv;
-    gsize rest_size, packed_size = 0;
-    MilterEncoder *encoder;
-    MilterReplyEncoder *reply_encoder;
-
-    priv = MILTER_CLIENT_CONTEXT_GET_PRIVATE(context);
     if (!validate_state("replace-body",
                         MILTER_CLIENT_CONTEXT_STATE_END_OF_MESSAGE,
                         priv->state,
@@ -3172,9 +3186,58 @@ milter_client_context_replace_body (MilterClientContext *context,
                          error))
         return FALSE;
 
-    milter_debug("[%u] [client][send][replace-body] <%" G_GSIZE_FORMAT ">",
+    return TRUE;
+}
+
+/*
+ * Streamed body is written on the end-of-message callback
+ * that doesn't return to the event loop until it finishes.
+ * Unwritten packets are written here so that a large new
+ * body isn't accumulated in the writer.
+ *
+ * The drain blocks the thread that runs the event loop. So
+ * it's used only by streaming entry points that opt into
+ * backpressure. In-memory bodies are written by the event
+ * loop asynchronously.
+ */
+static gboolean
+drain_replaced_body (MilterClientContext *context, GError **error)
+{
+    GError *agent_error = NULL;
+    GError *drain_error = NULL;
+
+    if (milter_agent_get_pending_write_size(MILTER_AGENT(context)) <=
+        REPLACE_BODY_MAX_PENDING_SIZE)
+        return TRUE;
+
+    if (milter_agent_drain(MILTER_AGENT(context),
+                           REPLACE_BODY_MAX_PENDING_SIZE,
+                           REPLACE_BODY_DRAIN_TIMEOUT,
+                           &agent_error))
+        return TRUE;
+
+    milter_utils_set_error_with_sub_error(
+        &drain_error,
+        MILTER_CLIENT_CONTEXT_ERROR,
+        MILTER_CLIENT_CONTEXT_ERROR_IO_ERROR,
+        agent_error,
+        "Failed to write replaced body");
+    milter_error("[%u] [client][error][replace-body][drain] %s",
                  milter_agent_get_tag(MILTER_AGENT(context)),
-                 body_size);
+                 drain_error->message);
+    g_propagate_error(error, drain_error);
+    return FALSE;
+}
+
+static gboolean
+write_replace_body (MilterClientContext *context,
+                    const gchar *body, gsize body_size,
+                    gboolean drain,
+                    GError **error)
+{
+    gsize rest_size, packed_size = 0;
+    MilterEncoder *encoder;
+    MilterReplyEncoder *reply_encoder;
 
     encoder = milter_agent_get_encoder(MILTER_AGENT(context));
     reply_encoder = MILTER_REPLY_ENCODER(encoder);
@@ -3194,11 +3257,44 @@ milter_client_context_replace_body (MilterClientContext *context,
 
         if (!write_packet_on_end_of_message(context, packet, packet_size))
             return FALSE;
+
+        if (drain && !drain_replaced_body(context, error))
+            return FALSE;
     }
 
     return TRUE;
 }
 
+/**
+ * milter_client_context_replace_body: (skip)
+ * @context: A #MilterClientContext.
+ * @body: (array length=body_size) (element-type guint8): the new body.
+ * @body_size: The size of @body.
+ * @error: Return location for an error, or %NULL.
+ *
+ * This is a `const gchar *` version of
+ * milter_client_context_replace_body_bytes().
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+milter_client_context_replace_body (MilterClientContext *context,
+                                    const gchar *body, gsize body_size,
+                                    GError **error)
+{
+    MilterClientContextPrivate *priv;
+
+    priv = MILTER_CLIENT_CONTEXT_GET_PRIVATE(context);
+    if (!validate_replace_body(priv, error))
+        return FALSE;
+
+    milter_debug("[%u] [client][send][replace-body] <%" G_GSIZE_FORMAT ">",
+                 milter_agent_get_tag(MILTER_AGENT(context)),
+                 body_size);
+
+    return write_replace_body(context, body, body_size, FALSE, error);
+}
+
 /**
  * milter_client_context_replace_body_bytes: (rename-to milter_client_context_replace_body)
  * @context: A #MilterClientContext.
@@ -3234,6 +3330,115 @@ milter_client_context_replace_body_bytes (MilterClientContext *context,
                                               error);
 }
 
+/**
+ * milter_client_context_replace_body_fd:
+ * @context: A #MilterClientContext.
+ * @fd: The file descriptor to read the new body from.
+ * @error: Return location for an error, or %NULL.
+ *
+ * Replaces the body of the current message with data read
+ * from @fd until EOF. Data are read and sent by
+ * %MILTER_CHUNK_SIZE bytes. If the MTA doesn't read them
+ * fast enough, this waits for it. So the whole new body
+ * isn't kept in memory even when it's large. The event loop
+ * isn't run while waiting. This fails when the MTA doesn't
+ * read anything for 5 seconds.
+ *
+ * @fd should be blocking. It isn't closed.
+ *
+ * This function can be called in
+ * #MilterClientContext::end-of-message signal like
+ * milter_client_context_replace_body_bytes().
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean
+milter_client_context_replace_body_fd (MilterClientContext *context,
+                                       gint fd,
+                                       GError **error)
+{
+    MilterClientContextPrivate *priv;
+    gchar *chunk;
+    gsize total_size = 0;
+    gboolean success = TRUE;
+
+    priv = MILTER_CLIENT_CONTEXT_GET_PRIVATE(context);
+    if (!validate_replace_body(priv, error))
+        return FALSE;
+
+    chunk = g_new(gchar, MILTER_CHUNK_SIZE);
+    while (success) {
+        gssize read_size;
+
+        read_size = read(fd, chunk, MILTER_CHUNK_SIZE);
+        if (read_size == -1) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(error,
+                        MILTER_CLIENT_CONTEXT_ERROR,
+                        MILTER_CLIENT_CONTEXT_ERROR_IO_ERROR,
+                        "failed to read new body: <%d>: %s",
+                        fd, g_strerror(errno));
+            success = FALSE;
+            break;
+        }
+        if (read_size == 0)
+            break;
+
+        success = write_replace_body(context, chunk, read_size, TRUE, error);
+        total_size += read_size;
+    }
+    g_free(chunk);
+
+    milter_debug("[%u] [client][send][replace-body][fd] <%d>:<%" G_GSIZE_FORMAT ">",
+                 milter_agent_get_tag(MILTER_AGENT(context)),
+                 fd,
+                 total_size);
+
+    return success;
+}
+
+/**
+ * milter_client_context_replace_body_stream:
+ * @context: A #MilterClientContext.
+ * @chunk: (array length=chunk_size) (element-type guint8):
+ *   A part of the new body.
+ * @chunk_size: The size of @chunk.
+ * @error: Return location for an error, or %NULL.
+ *
+ * Appends @chunk to the new body of the current message
+ * like milter_client_context_replace_body(). But this waits
+ * for the MTA when it doesn't read written chunks fast
+ * enough. It's for a caller that reads a large new body
+ * chunk by chunk. The event loop isn't run while waiting.
+ * This fails when the MTA doesn't read anything for 5
+ * seconds.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean
+milter_client_context_replace_body_stream (MilterClientContext *context,
+                                           const gchar *chunk,
+                                           gsize chunk_size,
+                                           GError **error)
+{
+    MilterClientContextPrivate *priv;
+
+    priv = MILTER_CLIENT_CONTEXT_GET_PRIVATE(context);
+    if (!validate_replace_body(priv, error))
+        return FALSE;
+
+    milter_debug("[%u] [client][send][replace-body][stream] <%" G_GSIZE_FORMAT ">",
+                 milter_agent_get_tag(MILTER_AGENT(context)),
+                 chunk_size);
+
+    return write_replace_body(context, chunk, chunk_size, TRUE, error);
+}
+
 gboolean
 milter_client_context_progress (MilterClientContext *context)
 {
@@ -3973,8 +4178,8 @@ cb_decoder_define_macro (MilterDecoder *decoder, MilterCommand macro_context,
     MilterClientContext *context = user_data;
 
     disable_timeout(context);
-    milter_protocol_agent_set_macros_hash_table(MILTER_PROTOCOL_AGENT(context),
-                                                macro_context, macros);
+    milter_protocol_agent_share_macros_hash_table(MILTER_PROTOCOL_AGENT(context),
+                                                  macro_context, macros);
     g_signal_emit(context, signals[DEFINE_MACRO], 0, macro_context, macros);
 }
 
@@ -4239,6 +4444,41 @@ cb_decoder_quit (MilterDecoder *decoder, gpointer user_data)
     milter_agent_shutdown(MILTER_AGENT(context));
 }
 
+static void
+cb_decoder_quit_new_connection (MilterDecoder *decoder, gpointer user_data)
+{
+    MilterClientContext *context;
+    MilterClientContextPrivate *priv;
+    MilterProtocolAgent *agent;
+
+    context = MILTER_CLIENT_CONTEXT(user_data);
+    priv = MILTER_CLIENT_CONTEXT_GET_PRIVATE(context);
+    agent = MILTER_PROTOCOL_AGENT(context);
+
+    /* FIXME: should check the previous state */
+    milter_client_context_set_state(
+        context, MILTER_CLIENT_CONTEXT_STATE_QUIT);
+
+    disable_timeout(context);
+    milter_debug("[%u] [client][quit-new-connection]",
+                 milter_agent_get_tag(MILTER_AGENT(context)));
+    g_signal_emit(context, signals[QUIT_NEW_CONNECTION], 0);
+
+    milter_client_context_reset_message_related_data(context);
+    milter_protocol_agent_clear_macros(agent, MILTER_COMMAND_CONNECT);
+    milter_protocol_agent_clear_macros(agent, MILTER_COMMAND_HELO);
+    if (priv->quarantine_reason) {
+        g_free(priv->quarantine_reason);
+        priv->quarantine_reason = NULL;
+    }
+    priv->status = MILTER_STATUS_NOT_CHANGE;
+
+    /* The negotiated option is still valid. The next
+     * connection starts with CONNECT. */
+    milter_client_context_set_state(
+        context, MILTER_CLIENT_CONTEXT_STATE_NEGOTIATE_REPLIED);
+}
+
 static void
 cb_decoder_abort (MilterDecoder *decoder, gpointer user_data)
 {
@@ -4286,6 +4526,7 @@ decoder_new (MilterAgent *agent)
     CONNECT(body);
     CONNECT(end_of_message);
     CONNECT(quit);
+    CONNECT(quit_new_connection);
     CONNECT(abort);
 
 #undef CONNECT
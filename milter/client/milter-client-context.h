@@ -492,6 +492,7 @@ struct _MilterClientContextClass
 
     void         (*message_processed)  (MilterClientContext *context,
                                         MilterMessageResult *result);
+    void         (*quit_new_connection)(MilterClientContext *context);
 };
 
 /**
@@ -772,6 +773,18 @@ milter_client_context_replace_body_bytes (MilterClientContext *context,
                                           GBytes *body,
                                           GError **error);
 
+gboolean
+milter_client_context_replace_body_fd    (MilterClientContext *context,
+                                          gint fd,
+                                          GError **error);
+
+gboolean
+milter_client_context_replace_body_stream
+                                         (MilterClientContext *context,
+                                          const gchar *chunk,
+                                          gsize chunk_size,
+                                          GError **error);
+
 /**
  * milter_client_context_progress:
  * @context: a %MilterClientContext.
@@ -596,6 +596,53 @@ parse_max_pending_finished_sessions (const gchar *option_name,
     return TRUE;
 }
 
+static gboolean
+parse_multi_thread (const gchar *option_name,
+                    const gchar *value,
+                    gpointer data,
+                    GError **error)
+{
+    MilterClient *client = data;
+
+    milter_client_set_multi_thread_mode(client, TRUE);
+    return TRUE;
+}
+
+static gboolean
+parse_max_threads (const gchar *option_name,
+                   const gchar *value,
+                   gpointer data,
+                   GError **error)
+{
+    MilterClient *client = data;
+    gchar *end;
+    glong n_threads;
+
+    errno = 0;
+    n_threads = strtol(value, &end, 0);
+
+    if (end[0] != '\0') {
+        set_invalid_integer_value_error(error, option_name, value, end);
+        return FALSE;
+    }
+
+    if (n_threads > G_MAXUINT || errno == ERANGE) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_BAD_VALUE,
+                    _("%s: too big: <%s>: parsed=<%ld>, max=<%d>"),
+                    option_name,
+                    value,
+                    n_threads,
+                    G_MAXUINT);
+      return FALSE;
+    }
+
+    milter_client_set_max_threads(client, n_threads);
+
+    return TRUE;
+}
+
 static const GOptionEntry option_entries[] =
 {
     {"connection-spec", 's', 0, G_OPTION_ARG_CALLBACK, parse_connection_spec,
@@ -657,6 +704,13 @@ static const GOptionEntry option_entries[] =
      parse_max_pending_finished_sessions,
      N_("Don't hold over N_SESSIONS pending finished sessions (default: 0)"),
      "N_SESSIONS"},
+    {"multi-thread", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+     parse_multi_thread,
+     N_("Process sessions in session threads"), NULL},
+    {"max-threads", 0, 0, G_OPTION_ARG_CALLBACK, parse_max_threads,
+     N_("Run up to N_THREADS session threads with --multi-thread "
+        "(default: 10)"),
+     "N_THREADS"},
     {NULL}
 };
 
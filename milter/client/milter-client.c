@@ -52,7 +52,10 @@ enum
     PROP_SYSLOG_FACILITIY,
     PROP_START_SYSLOG,
     PROP_RUN_AS_DAEMON,
-    PROP_MAX_PENDING_FINISHED_SESSIONS
+    PROP_MAX_PENDING_FINISHED_SESSIONS,
+    PROP_MULTI_THREAD_MODE,
+    PROP_MAX_THREADS,
+    PROP_REUSE_PORT
 };
 
 enum
@@ -69,6 +72,8 @@ enum
 
 static gint signals[LAST_SIGNAL] = {0};
 
+#define LOG_FLUSH_INTERVAL 1.0 /* seconds */
+
 #define MILTER_CLIENT_GET_PRIVATE(obj)                  \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                 \
                                  MILTER_TYPE_CLIENT,    \
@@ -82,6 +87,7 @@ struct _MilterClientPrivate
     MilterEventLoop *event_loop;
     guint accept_watch_id;
     guint accept_error_watch_id;
+    guint log_flush_timeout_id;
     gchar *connection_spec;
     GList *processing_data;
     guint n_processing_sessions;
@@ -101,12 +107,15 @@ struct _MilterClientPrivate
     guint suspend_time_on_unacceptable;
     guint max_connections;
     gboolean multi_thread_mode;
-    GThreadPool *worker_threads;
+    guint max_threads;
+    GPtrArray *session_threads;
+    GMutex threads_mutex;
     struct {
         GIOChannel *control;
         guint n_process;
         guint id;
         GArray *pids;
+        GPtrArray *listen_channels;
     } workers;
     struct sockaddr *address;
     socklen_t address_size;
@@ -131,6 +140,7 @@ struct _MilterClientPrivate
     gboolean daemonized;
 
     guint max_pending_finished_sessions;
+    gboolean reuse_port;
 };
 
 typedef struct _MilterClientProcessData
@@ -143,6 +153,9 @@ typedef struct _MilterClientProcessData
 
 typedef gboolean (*AcceptConnectionFunction) (MilterClient *client, gint fd);
 
+static void multi_thread_stop_threads (MilterClientPrivate *priv);
+static void dispose_workers_listen_channels (MilterClientPrivate *priv);
+
 #define _milter_client_get_type milter_client_get_type
 MILTER_DEFINE_ERROR_EMITTABLE_TYPE(MilterClient, _milter_client, G_TYPE_OBJECT)
 #undef _milter_client_get_type
@@ -223,6 +236,11 @@ static void         set_max_pending_finished_sessions
                             guint            n_sessions);
 static GArray      *get_worker_pids
                            (MilterClient    *client);
+static gboolean     is_reuse_port
+                           (MilterClient    *client);
+static void         set_reuse_port
+                           (MilterClient    *client,
+                            gboolean         reuse_port);
 
 static void
 _milter_client_class_init (MilterClientClass *klass)
@@ -264,6 +282,8 @@ _milter_client_class_init (MilterClientClass *klass)
     client_class->set_max_pending_finished_sessions
                                          = set_max_pending_finished_sessions;
     client_class->get_worker_pids        = get_worker_pids;
+    client_class->is_reuse_port          = is_reuse_port;
+    client_class->set_reuse_port         = set_reuse_port;
 
     spec = g_param_spec_string("connection-spec",
                                "Connection Spec",
@@ -380,6 +400,31 @@ _milter_client_class_init (MilterClientClass *klass)
     g_object_class_install_property(gobject_class,
                                     PROP_MAX_PENDING_FINISHED_SESSIONS, spec);
 
+    spec = g_param_spec_boolean("multi-thread-mode",
+                                "Multi thread mode",
+                                "Whether processing sessions in "
+                                "multi-thread mode or not",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_MULTI_THREAD_MODE,
+                                    spec);
+
+    spec = g_param_spec_uint("max-threads",
+                             "Maximum number of session threads",
+                             "The maximum number of session threads "
+                             "in multi-thread mode",
+                             0, G_MAXUINT, MILTER_CLIENT_DEFAULT_MAX_THREADS,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_MAX_THREADS, spec);
+
+    spec = g_param_spec_boolean("reuse-port",
+                                "Reuse port",
+                                "Whether each worker listens on its own "
+                                "SO_REUSEPORT socket or not",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_REUSE_PORT, spec);
+
     signals[CONNECTION_ESTABLISHED] =
         g_signal_new("connection-established",
                      MILTER_TYPE_CLIENT,
@@ -491,6 +536,7 @@ _milter_client_init (MilterClient *client)
 
     priv->accept_watch_id = 0;
     priv->accept_error_watch_id = 0;
+    priv->log_flush_timeout_id = 0;
     priv->connection_spec = NULL;
     priv->processing_data = NULL;
     priv->n_processing_sessions = 0;
@@ -511,11 +557,14 @@ _milter_client_init (MilterClient *client)
         MILTER_CLIENT_DEFAULT_SUSPEND_TIME_ON_UNACCEPTABLE;
     priv->max_connections = MILTER_CLIENT_DEFAULT_MAX_CONNECTIONS;
     priv->multi_thread_mode = FALSE;
-    priv->worker_threads = NULL;
+    priv->max_threads = MILTER_CLIENT_DEFAULT_MAX_THREADS;
+    priv->session_threads = NULL;
+    g_mutex_init(&(priv->threads_mutex));
     priv->workers.n_process = 0;
     priv->workers.id = 0;
     priv->workers.control = NULL;
     priv->workers.pids = NULL;
+    priv->workers.listen_channels = NULL;
     priv->address = NULL;
     priv->address_size = 0;
     priv->effective_user = NULL;
@@ -540,6 +589,7 @@ _milter_client_init (MilterClient *client)
     priv->daemonized = FALSE;
 
     priv->max_pending_finished_sessions = 0;
+    priv->reuse_port = FALSE;
 }
 
 static void
@@ -596,7 +646,8 @@ finish_processing (MilterClientProcessData *data)
     milter_client_session_finished(data->client);
 
     if (data->priv->quitting && data->priv->event_loop) {
-        n_processing_sessions = data->priv->n_processing_sessions;
+        n_processing_sessions =
+            g_atomic_int_get(&(data->priv->n_processing_sessions));
         g_mutex_lock(&(data->priv->quit_mutex));
         if (data->priv->quitting && n_processing_sessions == 0) {
             milter_debug("[%u] [client][loop][quit]", tag);
@@ -636,7 +687,7 @@ milter_client_set_n_processing_sessions (MilterClient *client,
     MilterClientPrivate *priv;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    priv->n_processing_sessions = n_processing_sessions;
+    g_atomic_int_set(&(priv->n_processing_sessions), n_processing_sessions);
 }
 
 void
@@ -646,7 +697,7 @@ milter_client_set_n_processed_sessions (MilterClient *client,
     MilterClientPrivate *priv;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    priv->n_processed_sessions = n_processed_sessions;
+    g_atomic_int_set(&(priv->n_processed_sessions), n_processed_sessions);
 }
 
 gboolean
@@ -656,7 +707,8 @@ milter_client_need_maintain (MilterClient *client, guint n_finished_sessions)
     guint maintenance_interval, n_finished_sessions_in_interval;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    if (priv->n_processing_sessions == 0 && n_finished_sessions > 0)
+    if (g_atomic_int_get(&(priv->n_processing_sessions)) == 0 &&
+        n_finished_sessions > 0)
         return TRUE;
 
     maintenance_interval = milter_client_get_maintenance_interval(client);
@@ -664,7 +716,8 @@ milter_client_need_maintain (MilterClient *client, guint n_finished_sessions)
         return FALSE;
 
     n_finished_sessions_in_interval =
-        priv->n_processed_sessions % maintenance_interval;
+        g_atomic_int_get(&(priv->n_processed_sessions)) %
+        maintenance_interval;
     return n_finished_sessions_in_interval < n_finished_sessions;
 }
 
@@ -678,18 +731,20 @@ dispose_finished_data (MilterClient *client)
     if (!priv->finished_data)
         return;
 
-    n_processed_sessions_before = priv->n_processed_sessions;
+    n_processed_sessions_before =
+        g_atomic_int_get(&(priv->n_processed_sessions));
     g_ptr_array_foreach(priv->finished_data, (GFunc)finish_processing, NULL);
     g_ptr_array_free(priv->finished_data, TRUE);
     priv->finished_data = NULL;
     n_finished_sessions =
-        priv->n_processed_sessions - n_processed_sessions_before;
+        g_atomic_int_get(&(priv->n_processed_sessions)) -
+        n_processed_sessions_before;
     g_signal_emit(client, signals[SESSIONS_FINISHED], 0, n_finished_sessions);
 
     milter_statistics("[sessions][finished] %u(+%u) %u",
-                      priv->n_processed_sessions,
+                      g_atomic_int_get(&(priv->n_processed_sessions)),
                       n_finished_sessions,
-                      priv->n_processing_sessions);
+                      g_atomic_int_get(&(priv->n_processing_sessions)));
     if (milter_client_need_maintain(client, n_finished_sessions)) {
         g_signal_emit(client, signals[MAINTAIN], 0);
     }
@@ -724,6 +779,39 @@ dispose_accept_watchers (MilterClientPrivate *priv)
         }
         priv->accept_error_watch_id = 0;
     }
+
+    if (priv->log_flush_timeout_id > 0) {
+        if (priv->accept_loop) {
+            milter_event_loop_remove(priv->accept_loop,
+                                     priv->log_flush_timeout_id);
+        } else {
+            milter_event_loop_remove(priv->event_loop,
+                                     priv->log_flush_timeout_id);
+        }
+        priv->log_flush_timeout_id = 0;
+    }
+}
+
+static gboolean
+cb_flush_log (gpointer user_data)
+{
+    milter_logger_flush(milter_logger());
+    return TRUE;
+}
+
+static void
+watch_log_flush (MilterClientPrivate *priv, MilterEventLoop *loop)
+{
+    if (priv->log_flush_timeout_id > 0)
+        return;
+
+    /* Buffered low level logs are flushed only by the next log
+     * without this. */
+    priv->log_flush_timeout_id =
+        milter_event_loop_add_timeout(loop,
+                                      LOG_FLUSH_INTERVAL,
+                                      cb_flush_log,
+                                      NULL);
 }
 
 static void
@@ -743,6 +831,7 @@ finalize (GObject *object)
     priv = MILTER_CLIENT_GET_PRIVATE(object);
 
     g_mutex_clear(&(priv->quit_mutex));
+    g_mutex_clear(&(priv->threads_mutex));
 
     G_OBJECT_CLASS(_milter_client_parent_class)->finalize(object);
 }
@@ -764,6 +853,8 @@ dispose (GObject *object)
         priv->workers.pids = NULL;
     }
 
+    dispose_workers_listen_channels(priv);
+
     if (priv->listening_channel) {
         g_io_channel_unref(priv->listening_channel);
         priv->listening_channel = NULL;
@@ -786,6 +877,8 @@ dispose (GObject *object)
         priv->connection_spec = NULL;
     }
 
+    multi_thread_stop_threads(priv);
+
     if (priv->processing_data) {
         g_list_foreach(priv->processing_data, (GFunc)process_data_free, NULL);
         g_list_free(priv->processing_data);
@@ -807,11 +900,6 @@ dispose (GObject *object)
         priv->default_unix_socket_group = NULL;
     }
 
-    if (priv->worker_threads) {
-        g_thread_pool_free(priv->worker_threads, TRUE, FALSE);
-        priv->worker_threads = NULL;
-    }
-
     dispose_address(priv);
 
     if (priv->effective_user) {
@@ -905,6 +993,16 @@ set_property (GObject      *object,
         milter_client_set_max_pending_finished_sessions(client,
                                                         g_value_get_uint(value));
         break;
+    case PROP_MULTI_THREAD_MODE:
+        milter_client_set_multi_thread_mode(client,
+                                            g_value_get_boolean(value));
+        break;
+    case PROP_MAX_THREADS:
+        milter_client_set_max_threads(client, g_value_get_uint(value));
+        break;
+    case PROP_REUSE_PORT:
+        milter_client_set_reuse_port(client, g_value_get_boolean(value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -969,6 +1067,15 @@ get_property (GObject    *object,
         g_value_set_uint(value,
                          milter_client_get_max_pending_finished_sessions(client));
         break;
+    case PROP_MULTI_THREAD_MODE:
+        g_value_set_boolean(value, milter_client_is_multi_thread_mode(client));
+        break;
+    case PROP_MAX_THREADS:
+        g_value_set_uint(value, milter_client_get_max_threads(client));
+        break;
+    case PROP_REUSE_PORT:
+        g_value_set_boolean(value, milter_client_is_reuse_port(client));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -1226,22 +1333,20 @@ milter_client_create_context (MilterClient *client)
     return context;
 }
 
-static gboolean
-milter_client_start_context (MilterClient *client,
+static void
+milter_client_setup_context (MilterClient *client,
                              MilterClientContext *context,
+                             MilterEventLoop *event_loop,
                              GIOChannel *channel,
-                             MilterGenericSocketAddress *address,
-                             GError **error)
+                             MilterGenericSocketAddress *address)
 {
-    MilterClientPrivate *priv;
     MilterAgent *agent;
     MilterWriter *writer;
     MilterReader *reader;
 
     agent = MILTER_AGENT(context);
-    priv = MILTER_CLIENT_GET_PRIVATE(client);
 
-    milter_agent_set_event_loop(agent, priv->event_loop);
+    milter_agent_set_event_loop(agent, event_loop);
 
     writer = milter_writer_io_channel_new(channel);
     milter_agent_set_writer(agent, writer);
@@ -1252,8 +1357,22 @@ milter_client_start_context (MilterClient *client,
     g_object_unref(reader);
 
     milter_client_context_set_socket_address(context, address);
+}
+
+static gboolean
+milter_client_start_context (MilterClient *client,
+                             MilterClientContext *context,
+                             GIOChannel *channel,
+                             MilterGenericSocketAddress *address,
+                             GError **error)
+{
+    MilterClientPrivate *priv;
 
-    return milter_agent_start(agent, error);
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    milter_client_setup_context(client, context, priv->event_loop,
+                                channel, address);
+
+    return milter_agent_start(MILTER_AGENT(context), error);
 }
 
 
@@ -1350,24 +1469,28 @@ accept_connection_fd (MilterClient *client, gint server_fd,
     MilterClientPrivate *priv;
     gint client_fd;
     guint n_suspend, suspend_time, max_connections;
+    guint n_processing_sessions;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
 
     suspend_time = milter_client_get_suspend_time_on_unacceptable(client);
     max_connections = milter_client_get_max_connections(client);
+    n_processing_sessions = g_atomic_int_get(&(priv->n_processing_sessions));
     for (n_suspend = 0;
-         0 < max_connections && max_connections <= priv->n_processing_sessions;
+         0 < max_connections && max_connections <= n_processing_sessions;
          n_suspend++) {
         milter_warning("[client][accept][suspend] "
                        "too many processing connection: %u, max: %u; "
                        "suspend accepting connection in %d seconds: #%u",
-                       priv->n_processing_sessions,
+                       n_processing_sessions,
                        max_connections,
                        suspend_time,
                        n_suspend);
         g_usleep(suspend_time * G_USEC_PER_SEC);
         milter_warning("[client][accept][resume] "
                        "resume accepting connection: #%u", n_suspend);
+        n_processing_sessions =
+            g_atomic_int_get(&(priv->n_processing_sessions));
     }
 
     *address_size = sizeof(*address);
@@ -1553,6 +1676,268 @@ single_thread_start_accept (MilterClient *client, GError **error)
     return TRUE;
 }
 
+typedef struct _MilterClientThread
+{
+    MilterClient *client;
+    GThread *thread;
+    MilterEventLoop *loop;
+    GAsyncQueue *queue;
+    gint wakeup_fds[2];
+    guint wakeup_watch_id;
+    gint n_sessions;
+    gint quitting;
+} MilterClientThread;
+
+static void
+multi_thread_quit_if_idle (MilterClientThread *thread)
+{
+    if (g_atomic_int_get(&(thread->quitting)) &&
+        g_atomic_int_get(&(thread->n_sessions)) == 0) {
+        milter_event_loop_quit(thread->loop);
+    }
+}
+
+static void
+multi_thread_cb_finished (MilterClientContext *context, gpointer _data)
+{
+    MilterClientProcessData *data = _data;
+    MilterClientThread *thread;
+
+    thread = g_object_get_data(G_OBJECT(context), "milter-client-thread");
+    g_mutex_lock(&(data->priv->threads_mutex));
+    finish_processing(data);
+    g_mutex_unlock(&(data->priv->threads_mutex));
+
+    g_atomic_int_add(&(thread->n_sessions), -1);
+    multi_thread_quit_if_idle(thread);
+}
+
+static void
+multi_thread_start_session (MilterClientThread *thread,
+                            MilterClientProcessData *data)
+{
+    MilterAgent *agent;
+    MilterClientContext *context;
+    GError *error = NULL;
+
+    context = MILTER_CLIENT_CONTEXT(data->context);
+    agent = MILTER_AGENT(context);
+    milter_debug("[%u] [client][multi-thread][start]",
+                 milter_agent_get_tag(agent));
+
+    g_object_set_data(G_OBJECT(context), "milter-client-thread", thread);
+    data->finished_handler_id =
+        g_signal_connect(data->context, "finished",
+                         G_CALLBACK(multi_thread_cb_finished), data);
+
+    milter_agent_set_event_loop(agent, thread->loop);
+    if (milter_agent_start(agent, &error)) {
+        g_signal_emit(thread->client, signals[CONNECTION_ESTABLISHED], 0,
+                      context);
+    } else {
+        milter_error("[%u] [client][multi-thread][start][error] %s",
+                     milter_agent_get_tag(agent), error->message);
+        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(thread->client),
+                                    error);
+        g_error_free(error);
+        milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(context));
+    }
+}
+
+static void
+multi_thread_start_queued_sessions (MilterClientThread *thread)
+{
+    MilterClientProcessData *data;
+
+    while ((data = g_async_queue_try_pop(thread->queue))) {
+        multi_thread_start_session(thread, data);
+    }
+    multi_thread_quit_if_idle(thread);
+}
+
+static gboolean
+multi_thread_cb_wakeup (GIOChannel *channel, GIOCondition condition,
+                        gpointer user_data)
+{
+    MilterClientThread *thread = user_data;
+    gchar buffer[64];
+
+    while (read(thread->wakeup_fds[0], buffer, sizeof(buffer)) > 0) {
+    }
+    multi_thread_start_queued_sessions(thread);
+
+    return TRUE;
+}
+
+static void
+multi_thread_wakeup (MilterClientThread *thread)
+{
+    ssize_t written;
+
+    do {
+        written = write(thread->wakeup_fds[1], "", 1);
+    } while (written == -1 && errno == EINTR);
+}
+
+static gpointer
+multi_thread_session_thread (gpointer user_data)
+{
+    MilterClientThread *thread = user_data;
+    GIOChannel *wakeup_channel;
+
+    thread->loop = milter_client_create_event_loop(thread->client, FALSE);
+
+    wakeup_channel = g_io_channel_unix_new(thread->wakeup_fds[0]);
+    thread->wakeup_watch_id =
+        milter_event_loop_watch_io(thread->loop,
+                                   wakeup_channel,
+                                   G_IO_IN | G_IO_PRI,
+                                   multi_thread_cb_wakeup,
+                                   thread);
+    g_io_channel_unref(wakeup_channel);
+
+    multi_thread_start_queued_sessions(thread);
+    if (!g_atomic_int_get(&(thread->quitting)) ||
+        g_atomic_int_get(&(thread->n_sessions)) > 0) {
+        milter_event_loop_run(thread->loop);
+    }
+
+    milter_event_loop_remove(thread->loop, thread->wakeup_watch_id);
+    thread->wakeup_watch_id = 0;
+    g_object_unref(thread->loop);
+    thread->loop = NULL;
+
+    return NULL;
+}
+
+static void
+multi_thread_thread_free (MilterClientThread *thread)
+{
+    g_async_queue_unref(thread->queue);
+    close(thread->wakeup_fds[0]);
+    close(thread->wakeup_fds[1]);
+    g_free(thread);
+}
+
+static MilterClientThread *
+multi_thread_thread_new (MilterClient *client, guint id, GError **error)
+{
+    MilterClientThread *thread;
+    gchar *name;
+    GError *local_error = NULL;
+
+    thread = g_new0(MilterClientThread, 1);
+    thread->client = client;
+    thread->queue = g_async_queue_new();
+    if (pipe(thread->wakeup_fds) == -1) {
+        g_set_error(error,
+                    MILTER_CLIENT_ERROR,
+                    MILTER_CLIENT_ERROR_THREAD,
+                    "failed to create a pipe for waking up a session thread: "
+                    "%s",
+                    g_strerror(errno));
+        g_async_queue_unref(thread->queue);
+        g_free(thread);
+        return NULL;
+    }
+    fcntl(thread->wakeup_fds[0], F_SETFL,
+          fcntl(thread->wakeup_fds[0], F_GETFL) | O_NONBLOCK);
+
+    name = g_strdup_printf("milter-client-session-thread-%u", id);
+    thread->thread = g_thread_try_new(name,
+                                      multi_thread_session_thread,
+                                      thread,
+                                      &local_error);
+    g_free(name);
+    if (!thread->thread) {
+        g_set_error(error,
+                    MILTER_CLIENT_ERROR,
+                    MILTER_CLIENT_ERROR_THREAD,
+                    "failed to create a session thread: %s",
+                    local_error->message);
+        g_error_free(local_error);
+        multi_thread_thread_free(thread);
+        return NULL;
+    }
+
+    milter_debug("[client][multi-thread][thread][new] <%u>", id);
+
+    return thread;
+}
+
+static MilterClientThread *
+multi_thread_choose_thread (MilterClient *client, GError **error)
+{
+    MilterClientPrivate *priv;
+    MilterClientThread *thread = NULL;
+    guint i, max_threads;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    for (i = 0; i < priv->session_threads->len; i++) {
+        MilterClientThread *candidate;
+
+        candidate = g_ptr_array_index(priv->session_threads, i);
+        if (!thread ||
+            g_atomic_int_get(&(candidate->n_sessions)) <
+            g_atomic_int_get(&(thread->n_sessions))) {
+            thread = candidate;
+        }
+    }
+
+    max_threads = milter_client_get_max_threads(client);
+    if (thread && g_atomic_int_get(&(thread->n_sessions)) == 0)
+        return thread;
+    if (priv->session_threads->len >= max_threads)
+        return thread;
+
+    {
+        MilterClientThread *new_thread;
+        GError *local_error = NULL;
+
+        new_thread = multi_thread_thread_new(client,
+                                             priv->session_threads->len,
+                                             &local_error);
+        if (!new_thread) {
+            if (thread) {
+                milter_warning("[client][multi-thread][thread][new][error] %s",
+                               local_error->message);
+                g_error_free(local_error);
+                return thread;
+            }
+            g_propagate_error(error, local_error);
+            return NULL;
+        }
+        g_ptr_array_add(priv->session_threads, new_thread);
+        return new_thread;
+    }
+}
+
+static void
+multi_thread_stop_threads (MilterClientPrivate *priv)
+{
+    guint i;
+
+    if (!priv->session_threads)
+        return;
+
+    for (i = 0; i < priv->session_threads->len; i++) {
+        MilterClientThread *thread;
+
+        thread = g_ptr_array_index(priv->session_threads, i);
+        g_atomic_int_set(&(thread->quitting), TRUE);
+        multi_thread_wakeup(thread);
+    }
+    for (i = 0; i < priv->session_threads->len; i++) {
+        MilterClientThread *thread;
+
+        thread = g_ptr_array_index(priv->session_threads, i);
+        g_thread_join(thread->thread);
+        multi_thread_thread_free(thread);
+    }
+    g_ptr_array_free(priv->session_threads, TRUE);
+    priv->session_threads = NULL;
+}
+
 static void
 multi_thread_process_client_channel (MilterClient *client, GIOChannel *channel,
                                      MilterGenericSocketAddress *address,
@@ -1561,11 +1946,13 @@ multi_thread_process_client_channel (MilterClient *client, GIOChannel *channel,
     MilterClientPrivate *priv;
     MilterClientContext *context;
     MilterClientProcessData *data;
+    MilterClientThread *thread;
     GError *error = NULL;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
 
     context = milter_client_create_context(client);
+    milter_client_setup_context(client, context, NULL, channel, address);
 
     data = g_new(MilterClientProcessData, 1);
     data->priv = priv;
@@ -1573,35 +1960,34 @@ multi_thread_process_client_channel (MilterClient *client, GIOChannel *channel,
     data->context = context;
     data->finished_handler_id = 0;
 
+    g_mutex_lock(&(priv->threads_mutex));
     priv->processing_data = g_list_prepend(priv->processing_data, data);
-    if (milter_client_start_context(client, context, channel, address, &error)) {
-        g_thread_pool_push(priv->worker_threads, data, &error);
-        if (error) {
-            GError *client_error;
-
-            client_error = g_error_new(MILTER_CLIENT_ERROR,
-                                       MILTER_CLIENT_ERROR_THREAD,
-                                       "failed to push a data to thread pool: %s",
-                                       error->message);
-            g_error_free(error);
-            milter_error("[%u] [client][multi-thread][error] %s",
-                         milter_agent_get_tag(MILTER_AGENT(context)),
-                         client_error->message);
-            milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(client),
-                                        client_error);
-            g_error_free(client_error);
-            milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(context));
-        }
+    g_mutex_unlock(&(priv->threads_mutex));
+
+    thread = multi_thread_choose_thread(client, &error);
+    if (thread) {
+        g_atomic_int_inc(&(thread->n_sessions));
+        g_async_queue_push(thread->queue, data);
+        multi_thread_wakeup(thread);
     } else {
-        milter_error("[%u] [client][multi-thread][start][error] %s",
-                     milter_agent_get_tag(MILTER_AGENT(context)),
-                     error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(context), error);
+        GError *client_error;
+
+        client_error = g_error_new(MILTER_CLIENT_ERROR,
+                                   MILTER_CLIENT_ERROR_THREAD,
+                                   "failed to dispatch a session "
+                                   "to session thread: %s",
+                                   error->message);
         g_error_free(error);
-        milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(context));
+        milter_error("[%u] [client][multi-thread][error] %s",
+                     milter_agent_get_tag(MILTER_AGENT(context)),
+                     client_error->message);
+        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(client),
+                                    client_error);
+        g_error_free(client_error);
+        g_mutex_lock(&(priv->threads_mutex));
+        finish_processing(data);
+        g_mutex_unlock(&(priv->threads_mutex));
     }
-
-    g_io_channel_unref(channel);
 }
 
 static gboolean
@@ -1638,83 +2024,17 @@ multi_thread_accept_watch_func (GIOChannel *channel, GIOCondition condition,
     return keep_callback;
 }
 
-static void
-multi_thread_cb_finished (MilterClientContext *context, gpointer _data)
-{
-    MilterClientProcessData *data = _data;
-
-    finish_processing(data);
-}
-
-static void
-multi_thread_process_client_channel_thread (gpointer data_, gpointer user_data)
-{
-    MilterAgent *agent;
-    MilterClientContext *context;
-    MilterClient *client = data_;
-    MilterClientProcessData *data = user_data;
-    MilterEventLoop *event_loop;
-    GError *error = NULL;
-
-    event_loop = milter_client_create_event_loop(client, FALSE);
-
-    context = MILTER_CLIENT_CONTEXT(data->context);
-    agent = MILTER_AGENT(context);
-    milter_debug("[%u] [client][multi-thread][start]",
-                 milter_agent_get_tag(agent));
-
-    data->finished_handler_id =
-        g_signal_connect(data->context, "finished",
-                         G_CALLBACK(multi_thread_cb_finished), data);
-
-    milter_agent_set_event_loop(agent, event_loop);
-    if (milter_agent_start(agent, &error)) {
-        g_signal_emit(client, signals[CONNECTION_ESTABLISHED], 0, context);
-        milter_event_loop_run(event_loop);
-    } else {
-        milter_error("[%u] [client][multi-thread][start][error] %s",
-                     milter_agent_get_tag(agent), error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(client),
-                                    error);
-        g_error_free(error);
-        milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(context));
-    }
-
-    g_object_unref(event_loop);
-}
-
 static gboolean
 multi_thread_start_accept (MilterClient *client, GError **error)
 {
     MilterClientPrivate *priv;
-    gint max_threads = 10;
-    GError *local_error = NULL;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    priv->worker_threads =
-        g_thread_pool_new(multi_thread_process_client_channel_thread,
-                          client,
-                          max_threads,
-                          FALSE,
-                          &local_error);
-    if (!priv->worker_threads) {
-        GError *client_error;
-        client_error = g_error_new(MILTER_CLIENT_ERROR,
-                                   MILTER_CLIENT_ERROR_THREAD,
-                                   "failed to create a thread pool "
-                                   "for processing accepted connection: %s",
-                                   local_error->message);
-        g_error_free(local_error);
-        milter_error("[client][multi-thread][accept][error] %s",
-                     client_error->message);
-        g_propagate_error(error, client_error);
-        return FALSE;
-    }
+    priv->session_threads = g_ptr_array_new();
 
     milter_event_loop_run(priv->accept_loop);
 
-    g_thread_pool_free(priv->worker_threads, TRUE, TRUE);
-    priv->worker_threads = NULL;
+    multi_thread_stop_threads(priv);
 
     return TRUE;
 }
@@ -1732,12 +2052,14 @@ milter_client_listen_channel (MilterClient  *client, GError **error)
     dispose_address(priv);
 
     connection_spec = milter_client_get_connection_spec(client);
-    channel = milter_connection_listen(connection_spec,
-                                       priv->listen_backlog,
-                                       &(priv->address),
-                                       &(priv->address_size),
-                                       priv->remove_unix_socket_on_create,
-                                       error);
+    channel = milter_connection_listen_full(connection_spec,
+                                            priv->listen_backlog,
+                                            &(priv->address),
+                                            &(priv->address_size),
+                                            priv->remove_unix_socket_on_create,
+                                            milter_client_is_reuse_port(client) &&
+                                            milter_client_get_n_workers(client) > 0,
+                                            error);
     if (priv->address_size > 0) {
         g_signal_emit(client, signals[LISTEN_STARTED], 0,
                       priv->address, priv->address_size);
@@ -1746,6 +2068,61 @@ milter_client_listen_channel (MilterClient  *client, GError **error)
     return channel;
 }
 
+static void
+dispose_workers_listen_channels (MilterClientPrivate *priv)
+{
+    if (priv->workers.listen_channels) {
+        g_ptr_array_free(priv->workers.listen_channels, TRUE);
+        priv->workers.listen_channels = NULL;
+    }
+}
+
+static gboolean
+milter_client_listen_workers_channels (MilterClient *client, GError **error)
+{
+    MilterClientPrivate *priv;
+    guint i, n_workers;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+
+    dispose_workers_listen_channels(priv);
+    n_workers = milter_client_get_n_workers(client);
+    if (n_workers < 2)
+        return TRUE;
+    if (!milter_connection_is_reuse_port(priv->listen_channel))
+        return TRUE;
+
+    /* The first worker uses the listen channel. Sockets for the
+     * other workers are also bound here because binding a privileged
+     * port fails after milter_client_drop_privilege(). */
+    priv->workers.listen_channels =
+        g_ptr_array_new_with_free_func((GDestroyNotify)g_io_channel_unref);
+    for (i = 1; i < n_workers; i++) {
+        GIOChannel *channel;
+        GError *local_error = NULL;
+
+        channel = milter_connection_listen_full(
+            milter_client_get_connection_spec(client),
+            priv->listen_backlog,
+            NULL,
+            NULL,
+            FALSE,
+            TRUE,
+            &local_error);
+        if (!channel) {
+            milter_error("[client][listen][reuse-port][error] <%u> %s",
+                         i + 1, local_error->message);
+            g_propagate_error(error, local_error);
+            dispose_workers_listen_channels(priv);
+            return FALSE;
+        }
+        g_ptr_array_add(priv->workers.listen_channels, channel);
+    }
+    milter_debug("[client][listen][reuse-port] <%u>", n_workers);
+
+    return TRUE;
+}
+
 gboolean
 milter_client_listen (MilterClient  *client, GError **error)
 {
@@ -1757,7 +2134,8 @@ milter_client_listen (MilterClient  *client, GError **error)
 
     milter_client_set_listen_channel(client, channel);
     g_io_channel_unref(channel);
-    return TRUE;
+
+    return milter_client_listen_workers_channels(client, error);
 }
 
 static struct passwd *
@@ -2010,7 +2388,8 @@ milter_client_prepare (MilterClient *client, MilterEventLoop *loop,
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
 
-    if (priv->listening_channel || priv->n_processing_sessions > 0) {
+    if (priv->listening_channel ||
+        g_atomic_int_get(&(priv->n_processing_sessions)) > 0) {
         local_error = g_error_new(MILTER_CLIENT_ERROR,
                                   MILTER_CLIENT_ERROR_RUNNING,
                                   "The milter client is already running: <%p>",
@@ -2048,6 +2427,7 @@ milter_client_prepare (MilterClient *client, MilterEventLoop *loop,
                                    G_IO_ERR | G_IO_HUP | G_IO_NVAL,
                                    accept_error_watch_func,
                                    client);
+    watch_log_flush(priv, loop);
 
     return TRUE;
 }
@@ -2137,11 +2517,34 @@ worker_watch_master (GIOChannel   *source,
     return TRUE;
 }
 
+static void
+worker_use_listen_channel (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (!priv->workers.listen_channels)
+        return;
+
+    if (priv->workers.id > 1) {
+        GIOChannel *channel;
+
+        channel = g_ptr_array_index(priv->workers.listen_channels,
+                                    priv->workers.id - 2);
+        milter_debug("[client][worker][listen][reuse-port] <%u>",
+                     priv->workers.id);
+        milter_client_set_listen_channel(client, channel);
+    }
+    /* Closes sockets for the other workers. */
+    dispose_workers_listen_channels(priv);
+}
+
 static gboolean
 client_run_workers (MilterClient *client, guint n_workers, GError **error)
 {
     guint i;
     int pipe_fds[2];
+    gboolean reuse_port;
     MilterClientPrivate *priv;
     MilterEventLoop *loop;
 
@@ -2173,6 +2576,13 @@ client_run_workers (MilterClient *client, guint n_workers, GError **error)
 
     priv->workers.pids = g_array_new(TRUE, TRUE, sizeof(GPid));
 
+    reuse_port = milter_connection_is_reuse_port(priv->listen_channel);
+    if (milter_client_is_reuse_port(client) && !reuse_port) {
+        milter_warning("[client][workers][run][reuse-port][unavailable] "
+                       "workers share one listen socket: <%s>",
+                       milter_client_get_connection_spec(client));
+    }
+
     for (i = 0; i < n_workers; ++i) {
         GPid pid = milter_client_fork(client);
         switch (pid) {
@@ -2180,12 +2590,14 @@ client_run_workers (MilterClient *client, guint n_workers, GError **error)
             close(pipe_fds[MILTER_UTILS_WRITE_PIPE]);
             priv->workers.control = setup_client_channel(pipe_fds[MILTER_UTILS_READ_PIPE]);
             priv->workers.id = i + 1;
+            worker_use_listen_channel(client);
             milter_event_loop_watch_io(loop, priv->workers.control,
                                        G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
                                        worker_watch_master, client);
             g_signal_emit(client, signals[WORKER_CREATED], 0);
             run_worker(client, error);
             milter_client_shutdown(client);
+            milter_logger_flush(milter_logger());
             _exit(EXIT_SUCCESS);
         default:
             g_array_append_val(priv->workers.pids, pid);
@@ -2205,6 +2617,16 @@ client_run_workers (MilterClient *client, guint n_workers, GError **error)
     close(pipe_fds[MILTER_UTILS_READ_PIPE]);
     priv->workers.control = setup_client_channel(pipe_fds[MILTER_UTILS_WRITE_PIPE]);
 
+    if (reuse_port) {
+        /* All SO_REUSEPORT sockets are bound by milter_client_listen()
+         * before privileges are dropped and each worker inherits its
+         * own socket by fork(). The master must not keep them
+         * because the kernel also distributes connections to them
+         * but the master never accepts. */
+        milter_client_set_listen_channel(client, NULL);
+        dispose_workers_listen_channels(priv);
+    }
+
     milter_info("[client][workers][run] <%d>", n_workers);
     return TRUE;
 }
@@ -2427,6 +2849,7 @@ run_master (MilterClient *client, GError **error)
     }
 
     priv->quitting = FALSE;
+    watch_log_flush(priv, milter_client_get_event_loop(client));
     milter_event_loop_run(milter_client_get_event_loop(client));
 
     return TRUE;
@@ -2464,7 +2887,8 @@ run_worker (MilterClient *client, GError **error)
     GError *local_error = NULL;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    if (priv->listening_channel || priv->n_processing_sessions > 0) {
+    if (priv->listening_channel ||
+        g_atomic_int_get(&(priv->n_processing_sessions)) > 0) {
         local_error = g_error_new(MILTER_CLIENT_ERROR,
                                   MILTER_CLIENT_ERROR_RUNNING,
                                   "The milter client worker is already running"
@@ -2510,6 +2934,7 @@ run_worker (MilterClient *client, GError **error)
                                         accept_error_watch_func,
                                         client,
                                         NULL);
+    watch_log_flush(priv, loop);
     milter_event_loop_run(loop);
 
     return TRUE;
@@ -2538,7 +2963,7 @@ milter_client_shutdown (MilterClient *client)
             priv->listening_channel = NULL;
         }
 
-        if (priv->n_processing_sessions == 0)
+        if (g_atomic_int_get(&(priv->n_processing_sessions)) == 0)
             milter_event_loop_quit(priv->event_loop);
     }
     g_mutex_unlock(&(priv->quit_mutex));
@@ -2881,7 +3306,9 @@ milter_client_session_started (MilterClient *client)
     MilterClientPrivate *priv;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    priv->n_processing_sessions++;
+    /* The accept thread and session threads in multi-thread mode
+     * update the counters concurrently. */
+    g_atomic_int_inc(&(priv->n_processing_sessions));
 }
 
 void
@@ -2890,20 +3317,26 @@ milter_client_session_finished (MilterClient *client)
     MilterClientPrivate *priv;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    priv->n_processing_sessions--;
-    priv->n_processed_sessions++;
+    g_atomic_int_add(&(priv->n_processing_sessions), -1);
+    g_atomic_int_inc(&(priv->n_processed_sessions));
 }
 
 guint
 milter_client_get_n_processing_sessions (MilterClient *client)
 {
-    return MILTER_CLIENT_GET_PRIVATE(client)->n_processing_sessions;
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    return g_atomic_int_get(&(priv->n_processing_sessions));
 }
 
 gboolean
 milter_client_is_processing (MilterClient *client)
 {
-    return MILTER_CLIENT_GET_PRIVATE(client)->n_processing_sessions > 0;
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    return g_atomic_int_get(&(priv->n_processing_sessions)) > 0;
 }
 
 const gchar *
@@ -3120,6 +3553,8 @@ milter_client_fork (MilterClient *client)
 
     g_return_val_if_fail(client != NULL, -1);
 
+    milter_logger_flush(milter_logger());
+
     priv = MILTER_CLIENT_GET_PRIVATE(client);
     if (priv->custom_fork) {
         pid = priv->custom_fork(client);
@@ -3137,6 +3572,8 @@ milter_client_fork_without_custom (MilterClient *client)
 
     g_return_val_if_fail(client != NULL, -1);
 
+    milter_logger_flush(milter_logger());
+
     client_class = MILTER_CLIENT_GET_CLASS(client);
     return client_class->fork(client);
 }
@@ -3333,6 +3770,36 @@ milter_client_set_max_pending_finished_sessions (MilterClient  *client,
     klass->set_max_pending_finished_sessions(client, n_sessions);
 }
 
+gboolean
+milter_client_is_multi_thread_mode (MilterClient *client)
+{
+    return MILTER_CLIENT_GET_PRIVATE(client)->multi_thread_mode;
+}
+
+void
+milter_client_set_multi_thread_mode (MilterClient *client,
+                                     gboolean      multi_thread_mode)
+{
+    MILTER_CLIENT_GET_PRIVATE(client)->multi_thread_mode = multi_thread_mode;
+}
+
+guint
+milter_client_get_max_threads (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (priv->max_threads == 0)
+        return MILTER_CLIENT_DEFAULT_MAX_THREADS;
+    return priv->max_threads;
+}
+
+void
+milter_client_set_max_threads (MilterClient *client, guint max_threads)
+{
+    MILTER_CLIENT_GET_PRIVATE(client)->max_threads = max_threads;
+}
+
 static GArray *
 get_worker_pids (MilterClient *client)
 {
@@ -3351,6 +3818,36 @@ milter_client_get_worker_pids (MilterClient  *client)
     return klass->get_worker_pids(client);
 }
 
+static gboolean
+is_reuse_port (MilterClient *client)
+{
+    return MILTER_CLIENT_GET_PRIVATE(client)->reuse_port;
+}
+
+gboolean
+milter_client_is_reuse_port (MilterClient *client)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    return klass->is_reuse_port(client);
+}
+
+static void
+set_reuse_port (MilterClient *client, gboolean reuse_port)
+{
+    MILTER_CLIENT_GET_PRIVATE(client)->reuse_port = reuse_port;
+}
+
+void
+milter_client_set_reuse_port (MilterClient *client, gboolean reuse_port)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    klass->set_reuse_port(client, reuse_port);
+}
+
 
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
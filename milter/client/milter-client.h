@@ -64,6 +64,15 @@ G_BEGIN_DECLS
  */
 #define MILTER_CLIENT_MAX_N_WORKERS 1000
 
+/**
+ * MILTER_CLIENT_DEFAULT_MAX_THREADS:
+ *
+ * The default maximum number of session threads in
+ * multi-thread mode. See milter_client_get_max_threads()
+ * for more details.
+ */
+#define MILTER_CLIENT_DEFAULT_MAX_THREADS 10
+
 /**
  * MILTER_CLIENT_ERROR:
  *
@@ -201,6 +210,9 @@ struct _MilterClientClass
                                            guint         n_workers);
     void   (*worker_created)              (MilterClient *client);
     GArray *(*get_worker_pids)            (MilterClient *client);
+    gboolean (*is_reuse_port)             (MilterClient *client);
+    void   (*set_reuse_port)              (MilterClient *client,
+                                           gboolean      reuse_port);
 };
 
 
@@ -1024,6 +1036,60 @@ void                 milter_client_set_max_pending_finished_sessions
                                                      (MilterClient  *client,
                                                       guint          n_sessions);
 
+/**
+ * milter_client_is_multi_thread_mode:
+ * @client: a %MilterClient.
+ *
+ * Gets whether @client processes sessions in multi-thread
+ * mode or not.
+ *
+ * Returns: %TRUE if @client is in multi-thread mode,
+ *          %FALSE otherwise.
+ */
+gboolean             milter_client_is_multi_thread_mode
+                                                     (MilterClient  *client);
+
+/**
+ * milter_client_set_multi_thread_mode:
+ * @client: a %MilterClient.
+ * @multi_thread_mode: %TRUE to process sessions in multi-thread mode.
+ *
+ * Sets whether @client processes sessions in multi-thread
+ * mode. In multi-thread mode, accepted sessions are
+ * dispatched to session threads. Each session thread has
+ * its own event loop that is kept while @client is running
+ * and processes many sessions concurrently.
+ */
+void                 milter_client_set_multi_thread_mode
+                                                     (MilterClient  *client,
+                                                      gboolean       multi_thread_mode);
+
+/**
+ * milter_client_get_max_threads:
+ * @client: a %MilterClient.
+ *
+ * Gets the maximum number of session threads in
+ * multi-thread mode. A new session thread is started only
+ * when all existing session threads are processing
+ * sessions. So the number of session threads grows on
+ * demand up to the maximum number.
+ *
+ * Returns: the maximum number of session threads.
+ */
+guint                milter_client_get_max_threads   (MilterClient  *client);
+
+/**
+ * milter_client_set_max_threads:
+ * @client: a %MilterClient.
+ * @max_threads: the maximum number of session threads.
+ *
+ * Sets the maximum number of session threads in
+ * multi-thread mode. 0 means
+ * %MILTER_CLIENT_DEFAULT_MAX_THREADS.
+ */
+void                 milter_client_set_max_threads   (MilterClient  *client,
+                                                      guint          max_threads);
+
 /**
  * milter_client_get_worker_pids:
  * @client: a #MilterClient.
@@ -1035,6 +1101,34 @@ void                 milter_client_set_max_pending_finished_sessions
  */
 GArray              *milter_client_get_worker_pids   (MilterClient  *client);
 
+/**
+ * milter_client_is_reuse_port:
+ * @client: a %MilterClient.
+ *
+ * Gets whether each worker process listens on its own
+ * socket with SO_REUSEPORT or not.
+ *
+ * Returns: %TRUE if each worker listens on its own socket,
+ *          %FALSE otherwise.
+ */
+gboolean             milter_client_is_reuse_port     (MilterClient  *client);
+
+/**
+ * milter_client_set_reuse_port:
+ * @client: a %MilterClient.
+ * @reuse_port: %TRUE if each worker listens on its own socket.
+ *
+ * Sets whether each worker process listens on its own
+ * socket with SO_REUSEPORT. If it is %TRUE, the kernel
+ * distributes accepted connections to workers instead of
+ * waking up all workers for each connection. It is used
+ * only when milter_client_get_n_workers() is larger than 0
+ * and the connection spec is 'inet' or 'inet6'. Workers
+ * share one listen socket on other cases.
+ */
+void                 milter_client_set_reuse_port    (MilterClient  *client,
+                                                      gboolean       reuse_port);
+
 G_END_DECLS
 
 #endif /* __MILTER_CLIENT_CLIENT_H__ */
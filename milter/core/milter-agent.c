@@ -540,6 +540,31 @@ milter_agent_write_packet (MilterAgent *agent,
     return success;
 }
 
+gboolean
+milter_agent_write_packets (MilterAgent *agent,
+                            const gchar **packets,
+                            const gsize *packet_sizes,
+                            guint n_packets,
+                            GError **error)
+{
+    MilterAgentPrivate *priv;
+    guint i;
+
+    priv = MILTER_AGENT_GET_PRIVATE(agent);
+
+    if (!priv->writer)
+        return TRUE;
+
+    for (i = 0; i < n_packets; i++) {
+        if (!milter_writer_write(priv->writer,
+                                 packets[i], packet_sizes[i],
+                                 error))
+            return FALSE;
+    }
+
+    return milter_agent_flush(agent, error);
+}
+
 gboolean
 milter_agent_flush (MilterAgent *agent, GError **error)
 {
@@ -549,6 +574,38 @@ milter_agent_flush (MilterAgent *agent, GError **error)
     return agent_class->flush(agent, error);
 }
 
+/**
+ * milter_agent_drain:
+ * @agent: A #MilterAgent.
+ * @max_pending_size: The maximum size of unwritten data to
+ *   be left.
+ * @timeout: The maximum number of seconds to wait for the
+ *   writer.
+ * @error: Return location for an error, or %NULL.
+ *
+ * Writes unwritten data until at most @max_pending_size
+ * bytes are left. See milter_writer_drain() for details.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean
+milter_agent_drain (MilterAgent *agent,
+                    gsize max_pending_size,
+                    gdouble timeout,
+                    GError **error)
+{
+    MilterAgentPrivate *priv;
+
+    priv = MILTER_AGENT_GET_PRIVATE(agent);
+
+    if (!priv->writer)
+        return TRUE;
+
+    return milter_writer_drain(priv->writer, max_pending_size, timeout, error);
+}
+
 void
 milter_agent_set_writer (MilterAgent *agent, MilterWriter *writer)
 {
@@ -744,6 +801,19 @@ milter_agent_get_elapsed (MilterAgent *agent)
     }
 }
 
+gsize
+milter_agent_get_pending_write_size (MilterAgent *agent)
+{
+    MilterAgentPrivate *priv;
+
+    priv = MILTER_AGENT_GET_PRIVATE(agent);
+    if (priv->writer) {
+        return milter_writer_get_pending_size(priv->writer);
+    } else {
+        return 0;
+    }
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
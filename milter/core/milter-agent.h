@@ -74,8 +74,17 @@ gboolean             milter_agent_write_packet      (MilterAgent *agent,
                                                      const char *packet,
                                                      gsize packet_size,
                                                      GError **error);
+gboolean             milter_agent_write_packets     (MilterAgent *agent,
+                                                     const gchar **packets,
+                                                     const gsize *packet_sizes,
+                                                     guint n_packets,
+                                                     GError **error);
 gboolean             milter_agent_flush             (MilterAgent *agent,
                                                      GError **error);
+gboolean             milter_agent_drain             (MilterAgent *agent,
+                                                     gsize max_pending_size,
+                                                     gdouble timeout,
+                                                     GError **error);
 
 gboolean             milter_agent_start             (MilterAgent *agent,
                                                      GError     **error);
@@ -90,6 +99,8 @@ void                 milter_agent_set_event_loop    (MilterAgent *agent,
                                                      MilterEventLoop *loop);
 
 gdouble              milter_agent_get_elapsed       (MilterAgent *agent);
+gsize                milter_agent_get_pending_write_size
+                                                    (MilterAgent *agent);
 
 G_END_DECLS
 
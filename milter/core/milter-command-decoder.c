@@ -34,6 +34,7 @@
 #include "milter-command-decoder.h"
 #include "milter-logger.h"
 #include "milter-enum-types.h"
+#include "milter-utils.h"
 
 enum
 {
@@ -50,6 +51,7 @@ enum
     END_OF_MESSAGE,
     ABORT,
     QUIT,
+    QUIT_NEW_CONNECTION,
     UNKNOWN,
     LAST_SIGNAL
 };
@@ -220,6 +222,16 @@ milter_command_decoder_class_init (MilterCommandDecoderClass *klass)
                      NULL,
                      G_TYPE_NONE, 0);
 
+    signals[QUIT_NEW_CONNECTION] =
+        g_signal_new("quit-new-connection",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     G_STRUCT_OFFSET(MilterCommandDecoderClass,
+                                     quit_new_connection),
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE, 0);
+
     signals[UNKNOWN] =
         g_signal_new("unknown",
                      G_TYPE_FROM_CLASS(klass),
@@ -318,7 +330,7 @@ decode_define_macros (const gchar *buffer,
     gint i;
     gboolean success = TRUE;
 
-    macros = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    macros = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
 
     i = 0;
     while (i < length) {
@@ -348,16 +360,26 @@ decode_define_macros (const gchar *buffer,
         i += null_character_point + 1;
 
         if (*key) {
-            gchar *normalized_key;
+            const gchar *normalized_key;
             gint key_length;
 
             key_length = value - key - 1;
             if (key[0] == '{' && key[key_length - 1] == '}')
-                normalized_key = g_strndup(key + 1, key_length - 2);
+                normalized_key = milter_utils_intern_macro_name(key + 1,
+                                                                key_length - 2);
             else
-                normalized_key = g_strdup(key);
-
-            g_hash_table_insert(macros, normalized_key, g_strdup(value));
+                normalized_key = milter_utils_intern_macro_name(key,
+                                                                key_length);
+
+            if (normalized_key) {
+                g_hash_table_insert(macros,
+                                    (gpointer)normalized_key,
+                                    g_strdup(value));
+            } else {
+                milter_debug("[command-decoder][define-macro][ignore] "
+                             "invalid name: <%.*s>",
+                             MIN(key_length, 64), key);
+            }
         }
     }
 
@@ -876,6 +898,29 @@ decode_quit (MilterDecoder *decoder, GError **error)
     return TRUE;
 }
 
+static gboolean
+decode_quit_new_connection (MilterDecoder *decoder, GError **error)
+{
+    const gchar *buffer;
+    gint32 command_length;
+
+    command_length = milter_decoder_get_command_length(decoder);
+    buffer = milter_decoder_get_buffer(decoder);
+
+    if (!milter_decoder_check_command_length(
+            buffer + 1, command_length - 1, 0,
+            MILTER_DECODER_COMPARE_EXACT, error,
+            "QUIT_NC command"))
+        return FALSE;
+
+    milter_debug("[%u] [command-decoder][quit-new-connection]",
+                 milter_decoder_get_tag(decoder));
+
+    g_signal_emit(decoder, signals[QUIT_NEW_CONNECTION], 0);
+
+    return TRUE;
+}
+
 static gboolean
 decode_unknown (MilterDecoder *decoder, GError **error)
 {
@@ -984,6 +1029,9 @@ decode (MilterDecoder *decoder, GError **error)
     case MILTER_COMMAND_QUIT:
         success = decode_quit(decoder, error);
         break;
+    case MILTER_COMMAND_QUIT_NEW_CONNECTION:
+        success = decode_quit_new_connection(decoder, error);
+        break;
     case MILTER_COMMAND_UNKNOWN:
         success = decode_unknown(decoder, error);
         break;
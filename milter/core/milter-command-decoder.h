@@ -87,6 +87,7 @@ struct _MilterCommandDecoderClass
                                  gsize size);
     void (*abort)               (MilterCommandDecoder *decoder);
     void (*quit)                (MilterCommandDecoder *decoder);
+    void (*quit_new_connection) (MilterCommandDecoder *decoder);
     void (*unknown)             (MilterCommandDecoder *decoder,
                                  const gchar *command);
 };
@@ -46,6 +46,7 @@ struct _MilterDecoderPrivate
 {
     gint state;
     GString *buffer;
+    const gchar *command_content;
     gint32 command_length;
     guint tag;
 };
@@ -121,6 +122,7 @@ milter_decoder_init (MilterDecoder *decoder)
 
     priv->state = IN_START;
     priv->buffer = g_string_new(NULL);
+    priv->command_content = NULL;
     priv->tag = 0;
 }
 
@@ -364,6 +366,9 @@ milter_decoder_decode (MilterDecoder *decoder, const gchar *chunk, gsize size,
     MilterDecoderPrivate *priv;
     gboolean loop = TRUE;
     gboolean success = TRUE;
+    gboolean in_place;
+    const gchar *data;
+    gsize data_size, offset = 0;
 
     priv = MILTER_DECODER_GET_PRIVATE(decoder);
 
@@ -377,48 +382,61 @@ milter_decoder_decode (MilterDecoder *decoder, const gchar *chunk, gsize size,
                  "(%" G_GSIZE_FORMAT ")",
                  priv->tag, size,
                  priv->buffer->len);
-    g_string_append_len(priv->buffer, chunk, size);
+    /* Decodes the chunk in place when no partial packet is buffered.
+     * Only rest data that isn't decoded yet is copied to the buffer. */
+    in_place = (priv->buffer->len == 0);
+    if (in_place) {
+        data = chunk;
+        data_size = size;
+    } else {
+        g_string_append_len(priv->buffer, chunk, size);
+        data = priv->buffer->str;
+        data_size = priv->buffer->len;
+    }
     while (loop) {
         switch (priv->state) {
         case IN_START:
             milter_trace("[%u] [decoder][decode][start]", priv->tag);
-            if (priv->buffer->len == 0) {
+            if (data_size - offset == 0) {
                 loop = FALSE;
             } else {
                 priv->state = IN_COMMAND_LENGTH;
             }
             break;
         case IN_COMMAND_LENGTH:
-            if (priv->buffer->len < COMMAND_LENGTH_BYTES) {
+            if (data_size - offset < COMMAND_LENGTH_BYTES) {
                 milter_trace("[%u] [decoder][decode][length][need-more]",
                              priv->tag);
                 loop = FALSE;
             } else {
                 memcpy(&priv->command_length,
-                       priv->buffer->str,
+                       data + offset,
                        COMMAND_LENGTH_BYTES);
                 priv->command_length = g_ntohl(priv->command_length);
                 milter_trace("[%u] [decoder][decode][length] <%d>",
                              priv->tag, priv->command_length);
-                g_string_erase(priv->buffer, 0, COMMAND_LENGTH_BYTES);
+                offset += COMMAND_LENGTH_BYTES;
                 priv->state = IN_COMMAND_CONTENT;
             }
             break;
         case IN_COMMAND_CONTENT:
-            if (priv->buffer->len < priv->command_length) {
+            if (data_size - offset < (gsize)priv->command_length) {
                 milter_trace("[%u] [decoder][decode][content][need-more] "
                              "<%" G_GSIZE_FORMAT ">/<%d>",
                              priv->tag,
-                             priv->buffer->len, priv->command_length);
+                             data_size - offset, priv->command_length);
                 loop = FALSE;
             } else {
                 milter_trace("[%u] [decoder][decode][content][fill] "
                              "<%d> (%" G_GSIZE_FORMAT ")",
-                             priv->tag, priv->command_length, priv->buffer->len);
+                             priv->tag, priv->command_length,
+                             data_size - offset);
+                priv->command_content = data + offset;
                 g_signal_emit(decoder, signals[DECODE], 0, error, &success);
+                priv->command_content = NULL;
                 if (success) {
                     priv->state = IN_START;
-                    g_string_erase(priv->buffer, 0, priv->command_length);
+                    offset += priv->command_length;
                 } else {
                     priv->state = IN_ERROR;
                     loop = FALSE;
@@ -428,12 +446,20 @@ milter_decoder_decode (MilterDecoder *decoder, const gchar *chunk, gsize size,
         case IN_ERROR:
             milter_error("[%u] [decoder][decode][error] "
                          "<%d> (%" G_GSIZE_FORMAT ")",
-                         priv->tag, priv->command_length, priv->buffer->len);
+                         priv->tag, priv->command_length,
+                         data_size - offset);
             loop = FALSE;
             break;
         }
     }
 
+    if (in_place) {
+        if (offset < data_size)
+            g_string_append_len(priv->buffer, data + offset, data_size - offset);
+    } else {
+        g_string_erase(priv->buffer, 0, offset);
+    }
+
     return success;
 }
 
@@ -488,7 +514,12 @@ milter_decoder_end_decode (MilterDecoder *decoder, GError **error)
 const gchar *
 milter_decoder_get_buffer (MilterDecoder *decoder)
 {
-    return MILTER_DECODER_GET_PRIVATE(decoder)->buffer->str;
+    MilterDecoderPrivate *priv;
+
+    priv = MILTER_DECODER_GET_PRIVATE(decoder);
+    if (priv->command_content)
+        return priv->command_content;
+    return priv->buffer->str;
 }
 
 gint32
@@ -32,6 +32,23 @@
 
 G_DEFINE_ABSTRACT_TYPE(MilterEventLoop, milter_event_loop, G_TYPE_OBJECT)
 
+#define N_DEADLINE_SLOTS 512
+#define EXPIRED_DEADLINE_SLOT -1
+#define DEADLINE_TICK_USEC                                              \
+    ((gint64)(MILTER_EVENT_LOOP_DEADLINE_RESOLUTION * G_USEC_PER_SEC))
+
+typedef struct _DeadlineWheel DeadlineWheel;
+struct _DeadlineWheel
+{
+    gint ref_count;
+    MilterEventLoop *loop;
+    MilterEventLoopDeadline *slots[N_DEADLINE_SLOTS];
+    MilterEventLoopDeadline *expired;
+    guint n_deadlines;
+    guint ticker_id;
+    gint64 current_tick;
+};
+
 typedef struct _MilterEventLoopPrivate	MilterEventLoopPrivate;
 struct _MilterEventLoopPrivate
 {
@@ -40,6 +57,7 @@ struct _MilterEventLoopPrivate
     gpointer custom_iterate_user_data;
     GDestroyNotify custom_iterate_destroy;
     guint depth;
+    DeadlineWheel *deadline_wheel;
 };
 
 enum
@@ -97,6 +115,7 @@ milter_event_loop_init (MilterEventLoop *loop)
     priv->custom_iterate = NULL;
     priv->custom_iterate_user_data = NULL;
     priv->custom_iterate_destroy = NULL;
+    priv->deadline_wheel = NULL;
 }
 
 static void
@@ -114,6 +133,20 @@ dispose_custom_iterate (MilterEventLoopPrivate *priv)
     priv->custom_iterate_destroy   = NULL;
 }
 
+static void deadline_wheel_unref (DeadlineWheel *wheel);
+static void deadline_wheel_detach (DeadlineWheel *wheel);
+
+static void
+dispose_deadline_wheel (MilterEventLoopPrivate *priv)
+{
+    if (!priv->deadline_wheel)
+        return;
+
+    deadline_wheel_detach(priv->deadline_wheel);
+    deadline_wheel_unref(priv->deadline_wheel);
+    priv->deadline_wheel = NULL;
+}
+
 static void
 dispose (GObject *object)
 {
@@ -123,6 +156,7 @@ dispose (GObject *object)
 
     priv = MILTER_EVENT_LOOP_GET_PRIVATE(object);
     dispose_custom_iterate(priv);
+    dispose_deadline_wheel(priv);
 
     G_OBJECT_CLASS(milter_event_loop_parent_class)->dispose(object);
 }
@@ -551,6 +585,271 @@ milter_event_loop_remove (MilterEventLoop *loop, guint tag)
     return loop_class->remove(loop, tag);
 }
 
+static DeadlineWheel *
+deadline_wheel_new (MilterEventLoop *loop)
+{
+    DeadlineWheel *wheel;
+
+    wheel = g_new0(DeadlineWheel, 1);
+    wheel->ref_count = 1;
+    wheel->loop = loop;
+    wheel->expired = NULL;
+    wheel->n_deadlines = 0;
+    wheel->ticker_id = 0;
+    wheel->current_tick = 0;
+
+    return wheel;
+}
+
+static DeadlineWheel *
+deadline_wheel_ref (DeadlineWheel *wheel)
+{
+    wheel->ref_count++;
+    return wheel;
+}
+
+static void
+deadline_wheel_unref (DeadlineWheel *wheel)
+{
+    wheel->ref_count--;
+    if (wheel->ref_count == 0)
+        g_free(wheel);
+}
+
+static MilterEventLoopDeadline **
+deadline_wheel_get_list (DeadlineWheel *wheel, gint slot)
+{
+    if (slot == EXPIRED_DEADLINE_SLOT)
+        return &(wheel->expired);
+    else
+        return &(wheel->slots[slot]);
+}
+
+static void
+deadline_wheel_link (DeadlineWheel *wheel,
+                     MilterEventLoopDeadline *deadline,
+                     gint slot)
+{
+    MilterEventLoopDeadline **list;
+
+    list = deadline_wheel_get_list(wheel, slot);
+    deadline->previous = NULL;
+    deadline->next = *list;
+    if (*list)
+        (*list)->previous = deadline;
+    *list = deadline;
+    deadline->slot = slot;
+    deadline->wheel = wheel;
+    wheel->n_deadlines++;
+}
+
+static void
+deadline_wheel_unlink (MilterEventLoopDeadline *deadline)
+{
+    DeadlineWheel *wheel = deadline->wheel;
+
+    if (deadline->previous)
+        deadline->previous->next = deadline->next;
+    else
+        *deadline_wheel_get_list(wheel, deadline->slot) = deadline->next;
+    if (deadline->next)
+        deadline->next->previous = deadline->previous;
+    deadline->previous = NULL;
+    deadline->next = NULL;
+    deadline->wheel = NULL;
+    wheel->n_deadlines--;
+}
+
+static void
+deadline_wheel_detach (DeadlineWheel *wheel)
+{
+    gint i;
+
+    wheel->loop = NULL;
+    for (i = EXPIRED_DEADLINE_SLOT; i < N_DEADLINE_SLOTS; i++) {
+        MilterEventLoopDeadline **list;
+
+        list = deadline_wheel_get_list(wheel, i);
+        while (*list) {
+            deadline_wheel_unlink(*list);
+        }
+    }
+}
+
+static gint64
+deadline_get_current_tick (void)
+{
+    return g_get_monotonic_time() / DEADLINE_TICK_USEC;
+}
+
+static gboolean
+cb_deadline_tick (gpointer data)
+{
+    DeadlineWheel *wheel = data;
+    gint64 now_tick, n_ticks, i;
+    gboolean keep;
+
+    if (!wheel->loop) {
+        wheel->ticker_id = 0;
+        return FALSE;
+    }
+
+    now_tick = deadline_get_current_tick();
+    n_ticks = now_tick - wheel->current_tick;
+    if (n_ticks > N_DEADLINE_SLOTS)
+        n_ticks = N_DEADLINE_SLOTS;
+    for (i = 1; i <= n_ticks; i++) {
+        MilterEventLoopDeadline *deadline, *next;
+        gint slot;
+
+        slot = (wheel->current_tick + i) % N_DEADLINE_SLOTS;
+        for (deadline = wheel->slots[slot]; deadline; deadline = next) {
+            next = deadline->next;
+            if (deadline->expire_tick > now_tick)
+                continue;
+            deadline_wheel_unlink(deadline);
+            deadline_wheel_link(wheel, deadline, EXPIRED_DEADLINE_SLOT);
+        }
+    }
+    wheel->current_tick = now_tick;
+
+    /* A callback may set or cancel any deadline including
+     * expired ones. So we take expired deadlines one by one
+     * from the list instead of iterating over it. */
+    deadline_wheel_ref(wheel);
+    while (wheel->expired) {
+        MilterEventLoopDeadline *deadline = wheel->expired;
+
+        deadline_wheel_unlink(deadline);
+        deadline->function(deadline->user_data);
+    }
+
+    keep = (wheel->loop && wheel->n_deadlines > 0);
+    if (!keep)
+        wheel->ticker_id = 0;
+    deadline_wheel_unref(wheel);
+
+    return keep;
+}
+
+/**
+ * milter_event_loop_deadline_init: (skip)
+ * @deadline: A #MilterEventLoopDeadline.
+ *
+ * Initializes @deadline as an inactive deadline.
+ *
+ * Since: 2.3.3
+ */
+void
+milter_event_loop_deadline_init (MilterEventLoopDeadline *deadline)
+{
+    deadline->wheel = NULL;
+    deadline->slot = 0;
+    deadline->expire_tick = 0;
+    deadline->function = NULL;
+    deadline->user_data = NULL;
+    deadline->previous = NULL;
+    deadline->next = NULL;
+}
+
+/**
+ * milter_event_loop_deadline_set: (skip)
+ * @loop: A #MilterEventLoop.
+ * @deadline: A #MilterEventLoopDeadline.
+ * @interval_in_seconds: The interval to call @function.
+ * @function: The function to call when @deadline is expired.
+ * @user_data: User data to pass to @function.
+ *
+ * Sets @deadline to call @function after
+ * @interval_in_seconds. If @deadline is already active, it
+ * is reset. @function is called only once and its return
+ * value is ignored.
+ *
+ * Since: 2.3.3
+ */
+void
+milter_event_loop_deadline_set (MilterEventLoop *loop,
+                                MilterEventLoopDeadline *deadline,
+                                gdouble          interval_in_seconds,
+                                GSourceFunc      function,
+                                gpointer         user_data)
+{
+    MilterEventLoopPrivate *priv;
+    DeadlineWheel *wheel;
+    gint64 expire_tick;
+
+    g_return_if_fail(loop != NULL);
+    g_return_if_fail(deadline != NULL);
+    g_return_if_fail(function != NULL);
+    g_return_if_fail(interval_in_seconds >= 0);
+
+    if (deadline->wheel)
+        deadline_wheel_unlink(deadline);
+
+    priv = MILTER_EVENT_LOOP_GET_PRIVATE(loop);
+    if (!priv->deadline_wheel)
+        priv->deadline_wheel = deadline_wheel_new(loop);
+    wheel = priv->deadline_wheel;
+
+    if (wheel->ticker_id == 0) {
+        wheel->current_tick = deadline_get_current_tick();
+        wheel->ticker_id =
+            milter_event_loop_add_timeout_full(
+                loop,
+                G_PRIORITY_DEFAULT,
+                MILTER_EVENT_LOOP_DEADLINE_RESOLUTION,
+                cb_deadline_tick,
+                deadline_wheel_ref(wheel),
+                (GDestroyNotify)deadline_wheel_unref);
+    }
+
+    expire_tick =
+        (g_get_monotonic_time() +
+         (gint64)(interval_in_seconds * G_USEC_PER_SEC) +
+         DEADLINE_TICK_USEC - 1) / DEADLINE_TICK_USEC;
+    if (expire_tick <= wheel->current_tick)
+        expire_tick = wheel->current_tick + 1;
+    deadline->expire_tick = expire_tick;
+    deadline->function = function;
+    deadline->user_data = user_data;
+    deadline_wheel_link(wheel, deadline, expire_tick % N_DEADLINE_SLOTS);
+}
+
+/**
+ * milter_event_loop_deadline_cancel: (skip)
+ * @deadline: A #MilterEventLoopDeadline.
+ *
+ * Cancels @deadline. It does nothing if @deadline isn't
+ * active.
+ *
+ * Since: 2.3.3
+ */
+void
+milter_event_loop_deadline_cancel (MilterEventLoopDeadline *deadline)
+{
+    g_return_if_fail(deadline != NULL);
+
+    if (deadline->wheel)
+        deadline_wheel_unlink(deadline);
+}
+
+/**
+ * milter_event_loop_deadline_is_active: (skip)
+ * @deadline: A #MilterEventLoopDeadline.
+ *
+ * Returns: %TRUE if @deadline is set and isn't expired nor
+ *   cancelled yet, %FALSE otherwise.
+ *
+ * Since: 2.3.3
+ */
+gboolean
+milter_event_loop_deadline_is_active (MilterEventLoopDeadline *deadline)
+{
+    g_return_val_if_fail(deadline != NULL, FALSE);
+
+    return deadline->wheel != NULL;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -41,6 +41,7 @@ typedef enum
 
 typedef struct _MilterEventLoop         MilterEventLoop;
 typedef struct _MilterEventLoopClass    MilterEventLoopClass;
+typedef struct _MilterEventLoopDeadline MilterEventLoopDeadline;
 
 struct _MilterEventLoop
 {
@@ -83,6 +84,29 @@ struct _MilterEventLoopClass
                                   guint            id);
 };
 
+/*
+ * A deadline is a one-shot timer that is embedded in its
+ * owner. It is registered to the timer wheel of an event
+ * loop instead of the backend, so that setting, resetting
+ * and cancelling it don't allocate memory. Expired deadlines
+ * are dispatched in a batch on each tick of the wheel. Its
+ * resolution is MILTER_EVENT_LOOP_DEADLINE_RESOLUTION
+ * seconds.
+ */
+#define MILTER_EVENT_LOOP_DEADLINE_RESOLUTION 0.1
+
+struct _MilterEventLoopDeadline
+{
+    /*< private >*/
+    gpointer wheel;
+    gint slot;
+    gint64 expire_tick;
+    GSourceFunc function;
+    gpointer user_data;
+    MilterEventLoopDeadline *previous;
+    MilterEventLoopDeadline *next;
+};
+
 typedef void        (*MilterEventLoopCustomRunFunc)      (MilterEventLoop *loop);
 typedef gboolean    (*MilterEventLoopCustomIterateFunc)  (MilterEventLoop *loop,
                                                           gboolean         may_block,
@@ -164,6 +188,15 @@ guint                milter_event_loop_add_idle_full     (MilterEventLoop *loop,
 gboolean             milter_event_loop_remove            (MilterEventLoop *loop,
                                                           guint            id);
 
+void                 milter_event_loop_deadline_init     (MilterEventLoopDeadline *deadline);
+void                 milter_event_loop_deadline_set      (MilterEventLoop *loop,
+                                                          MilterEventLoopDeadline *deadline,
+                                                          gdouble          interval_in_seconds,
+                                                          GSourceFunc      function,
+                                                          gpointer         user_data);
+void                 milter_event_loop_deadline_cancel   (MilterEventLoopDeadline *deadline);
+gboolean             milter_event_loop_deadline_is_active(MilterEventLoopDeadline *deadline);
+
 G_END_DECLS
 
 #endif /* __MILTER_EVENT_LOOP_H__ */
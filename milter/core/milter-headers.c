@@ -112,9 +112,32 @@ milter_header_change_value (MilterHeader *header,
                                  MILTER_TYPE_HEADERS,     \
                                  MilterHeadersPrivate))
 
+/*
+ * Headers are stored in an array in the message order. Each
+ * header also knows its position in the array. Headers that
+ * have the same name in case-insensitive are also listed in
+ * a per-name occurrence list in the message order. So name
+ * lookups don't need to scan all headers.
+ */
+typedef struct _IndexedHeader IndexedHeader;
+struct _IndexedHeader
+{
+    MilterHeader header;
+    guint position;
+};
+
+typedef struct _Occurrences Occurrences;
+struct _Occurrences
+{
+    GPtrArray *headers;
+    gboolean mixed_case;
+};
+
 typedef struct _MilterHeadersPrivate MilterHeadersPrivate;
 struct _MilterHeadersPrivate
 {
+    GPtrArray *headers;
+    GHashTable *occurrences;
     GList *header_list;
 };
 
@@ -154,12 +177,39 @@ milter_headers_class_init (MilterHeadersClass *klass)
                              sizeof(MilterHeadersPrivate));
 }
 
+static IndexedHeader *
+indexed_header_new (const gchar *name, const gchar *value)
+{
+    IndexedHeader *indexed_header;
+
+    /* This can be freed by milter_header_free() because
+     * MilterHeader is the first member. */
+    indexed_header = g_new0(IndexedHeader, 1);
+    indexed_header->header.name = g_strdup(name);
+    indexed_header->header.value = g_strdup(value);
+
+    return indexed_header;
+}
+
+static void
+occurrences_free (Occurrences *occurrences)
+{
+    g_ptr_array_free(occurrences->headers, TRUE);
+    g_free(occurrences);
+}
+
 static void
 milter_headers_init (MilterHeaders *headers)
 {
     MilterHeadersPrivate *priv;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
+    priv->headers = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)milter_header_free);
+    priv->occurrences = g_hash_table_new_full(g_str_hash,
+                                              g_str_equal,
+                                              g_free,
+                                              (GDestroyNotify)occurrences_free);
     priv->header_list = NULL;
 }
 
@@ -171,11 +221,20 @@ dispose (GObject *object)
     priv = MILTER_HEADERS_GET_PRIVATE(object);
 
     if (priv->header_list) {
-        g_list_foreach(priv->header_list, (GFunc)milter_header_free, NULL);
         g_list_free(priv->header_list);
         priv->header_list = NULL;
     }
 
+    if (priv->occurrences) {
+        g_hash_table_unref(priv->occurrences);
+        priv->occurrences = NULL;
+    }
+
+    if (priv->headers) {
+        g_ptr_array_free(priv->headers, TRUE);
+        priv->headers = NULL;
+    }
+
     G_OBJECT_CLASS(milter_headers_parent_class)->dispose(object);
 }
 
@@ -205,6 +264,175 @@ get_property (GObject    *object,
     }
 }
 
+static gchar *
+occurrences_key (const gchar *name)
+{
+    if (!name)
+        return g_strdup("");
+    return g_ascii_strdown(name, -1);
+}
+
+static Occurrences *
+lookup_occurrences (MilterHeadersPrivate *priv, const gchar *name)
+{
+    Occurrences *occurrences;
+    gchar *key;
+
+    key = occurrences_key(name);
+    occurrences = g_hash_table_lookup(priv->occurrences, key);
+    g_free(key);
+
+    return occurrences;
+}
+
+/* Returns the index of the first header in occurrences
+ * whose position is position or larger. */
+static guint
+occurrences_bsearch (Occurrences *occurrences, guint position)
+{
+    guint low = 0, high = occurrences->headers->len;
+
+    while (low < high) {
+        guint middle = low + (high - low) / 2;
+        IndexedHeader *header;
+
+        header = g_ptr_array_index(occurrences->headers, middle);
+        if (header->position < position)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+static void
+invalidate_header_list (MilterHeadersPrivate *priv)
+{
+    if (!priv->header_list)
+        return;
+
+    g_list_free(priv->header_list);
+    priv->header_list = NULL;
+}
+
+static void
+update_positions (MilterHeadersPrivate *priv, guint start)
+{
+    guint i;
+
+    for (i = start; i < priv->headers->len; i++) {
+        IndexedHeader *header = g_ptr_array_index(priv->headers, i);
+        header->position = i;
+    }
+}
+
+static void
+insert_indexed_header (MilterHeadersPrivate *priv,
+                       guint position,
+                       IndexedHeader *header)
+{
+    Occurrences *occurrences;
+    gchar *key;
+
+    if (position > priv->headers->len)
+        position = priv->headers->len;
+
+    invalidate_header_list(priv);
+    g_ptr_array_insert(priv->headers, position, header);
+    update_positions(priv, position);
+
+    key = occurrences_key(header->header.name);
+    occurrences = g_hash_table_lookup(priv->occurrences, key);
+    if (occurrences) {
+        IndexedHeader *first_header;
+
+        g_free(key);
+        first_header = g_ptr_array_index(occurrences->headers, 0);
+        if (!string_equal(first_header->header.name, header->header.name))
+            occurrences->mixed_case = TRUE;
+        g_ptr_array_insert(occurrences->headers,
+                           occurrences_bsearch(occurrences, position),
+                           header);
+    } else {
+        occurrences = g_new0(Occurrences, 1);
+        occurrences->headers = g_ptr_array_new();
+        occurrences->mixed_case = FALSE;
+        g_ptr_array_add(occurrences->headers, header);
+        g_hash_table_insert(priv->occurrences, key, occurrences);
+    }
+}
+
+static void
+remove_indexed_header (MilterHeadersPrivate *priv, IndexedHeader *header)
+{
+    Occurrences *occurrences;
+    guint position;
+
+    position = header->position;
+
+    occurrences = lookup_occurrences(priv, header->header.name);
+    if (occurrences) {
+        g_ptr_array_remove_index(occurrences->headers,
+                                 occurrences_bsearch(occurrences, position));
+        if (occurrences->headers->len == 0) {
+            gchar *key;
+
+            key = occurrences_key(header->header.name);
+            g_hash_table_remove(priv->occurrences, key);
+            g_free(key);
+        } else if (occurrences->headers->len == 1) {
+            occurrences->mixed_case = FALSE;
+        }
+    }
+
+    invalidate_header_list(priv);
+    g_ptr_array_remove_index(priv->headers, position);
+    update_positions(priv, position);
+}
+
+/* Returns the index-th (1-origin) header that has the name. */
+static IndexedHeader *
+lookup_by_name_with_index (MilterHeadersPrivate *priv,
+                           const gchar *name,
+                           guint index)
+{
+    Occurrences *occurrences;
+    guint i, found_count = 0;
+
+    if (index < 1)
+        return NULL;
+
+    occurrences = lookup_occurrences(priv, name);
+    if (!occurrences)
+        return NULL;
+
+    if (!occurrences->mixed_case) {
+        IndexedHeader *header;
+
+        if (index > occurrences->headers->len)
+            return NULL;
+        header = g_ptr_array_index(occurrences->headers, index - 1);
+        if (!string_equal(header->header.name, name))
+            return NULL;
+        return header;
+    }
+
+    for (i = 0; i < occurrences->headers->len; i++) {
+        IndexedHeader *header = g_ptr_array_index(occurrences->headers, i);
+
+        if (!string_equal(header->header.name, name))
+            continue;
+
+        found_count++;
+
+        if (found_count == index)
+            return header;
+    }
+
+    return NULL;
+}
+
 MilterHeaders *
 milter_headers_new (void)
 {
@@ -221,14 +449,14 @@ MilterHeaders *
 milter_headers_copy (MilterHeaders *headers)
 {
     MilterHeaders *copied_headers;
-    GList *node;
     MilterHeadersPrivate *priv;
+    guint i;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
 
     copied_headers = milter_headers_new();
-    for (node = priv->header_list; node; node = g_list_next(node)) {
-        MilterHeader *header = node->data;
+    for (i = 0; i < priv->headers->len; i++) {
+        MilterHeader *header = g_ptr_array_index(priv->headers, i);
 
         milter_headers_append_header(copied_headers, header->name, header->value);
     }
@@ -240,12 +468,27 @@ milter_headers_copy (MilterHeaders *headers)
  * milter_headers_get_list:
  * @headers: A #MilterHeaders.
  *
+ * The returned list is valid until @headers is changed.
+ *
  * Returns: (transfer none) (element-type MilterHeader): The list of #MilterHeader.
  */
 const GList *
 milter_headers_get_list (MilterHeaders *headers)
 {
-    return MILTER_HEADERS_GET_PRIVATE(headers)->header_list;
+    MilterHeadersPrivate *priv;
+    guint i;
+
+    priv = MILTER_HEADERS_GET_PRIVATE(headers);
+    if (priv->header_list || priv->headers->len == 0)
+        return priv->header_list;
+
+    for (i = priv->headers->len; i > 0; i--) {
+        priv->header_list = g_list_prepend(priv->header_list,
+                                           g_ptr_array_index(priv->headers,
+                                                             i - 1));
+    }
+
+    return priv->header_list;
 }
 
 MilterHeader *
@@ -253,22 +496,22 @@ milter_headers_find (MilterHeaders *headers,
                      MilterHeader *header)
 {
     MilterHeadersPrivate *priv;
-    GList *found_node;
+    Occurrences *occurrences;
+    guint i;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
-    found_node = g_list_find_custom(priv->header_list,
-                                    header,
-                                    (GCompareFunc)milter_header_compare);
-    if (!found_node)
+    occurrences = lookup_occurrences(priv, header->name);
+    if (!occurrences)
         return NULL;
-    return (MilterHeader *)(found_node->data);
-}
 
-static gint
-milter_header_name_compare (MilterHeader *header1,
-                            const gchar *name)
-{
-    return milter_utils_strcmp0(header1->name, name);
+    for (i = 0; i < occurrences->headers->len; i++) {
+        MilterHeader *found_header = g_ptr_array_index(occurrences->headers, i);
+
+        if (milter_header_compare(found_header, header) == 0)
+            return found_header;
+    }
+
+    return NULL;
 }
 
 MilterHeader *
@@ -276,16 +519,9 @@ milter_headers_lookup_by_name (MilterHeaders *headers,
                                const gchar *name)
 {
     MilterHeadersPrivate *priv;
-    GList *found_node;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
-
-    found_node = g_list_find_custom(priv->header_list,
-                                    name,
-                                    (GCompareFunc)milter_header_name_compare);
-    if (!found_node)
-        return NULL;
-    return (MilterHeader*)found_node->data;
+    return (MilterHeader *)lookup_by_name_with_index(priv, name, 1);
 }
 
 MilterHeader *
@@ -293,17 +529,15 @@ milter_headers_get_nth_header (MilterHeaders *headers,
                                guint index)
 {
     MilterHeadersPrivate *priv;
-    gpointer nth_data;
 
     if (index < 1)
         return NULL;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
-    nth_data = g_list_nth_data(priv->header_list, index - 1);
-    if (!nth_data)
+    if (index > priv->headers->len)
         return NULL;
 
-    return (MilterHeader*)nth_data;
+    return g_ptr_array_index(priv->headers, index - 1);
 }
 
 gint
@@ -311,13 +545,18 @@ milter_headers_index_in_same_header_name (MilterHeaders *headers,
                                           MilterHeader *target)
 {
     MilterHeadersPrivate *priv;
-    GList *node;
+    Occurrences *occurrences;
+    guint i;
     guint found_count = 0;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
 
-    for (node = priv->header_list; node; node = g_list_next(node)) {
-        MilterHeader *header = node->data;
+    occurrences = lookup_occurrences(priv, target->name);
+    if (!occurrences)
+        return -1;
+
+    for (i = 0; i < occurrences->headers->len; i++) {
+        MilterHeader *header = g_ptr_array_index(occurrences->headers, i);
 
         if (!string_equal(header->name, target->name))
             continue;
@@ -343,8 +582,7 @@ milter_headers_remove (MilterHeaders *headers,
     if (!found_header)
         return FALSE;
 
-    priv->header_list = g_list_remove(priv->header_list, found_header);
-    milter_header_free(found_header);
+    remove_indexed_header(priv, (IndexedHeader *)found_header);
 
     return TRUE;
 }
@@ -355,26 +593,21 @@ milter_headers_add_header (MilterHeaders *headers,
                            const gchar *value)
 {
     MilterHeadersPrivate *priv;
-    GList *node, *same_name_header = NULL;
+    Occurrences *occurrences;
+    guint position;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
 
-    for (node = priv->header_list; node; node = g_list_next(node)) {
-        MilterHeader *header = node->data;
-        if (g_ascii_strcasecmp(header->name, name) == 0) {
-            same_name_header = node;
-            break;
-        }
-    }
+    occurrences = lookup_occurrences(priv, name);
+    if (occurrences) {
+        IndexedHeader *same_name_header;
 
-    if (same_name_header) {
-        priv->header_list = g_list_insert_before(priv->header_list,
-                                                 same_name_header,
-                                                 milter_header_new(name, value));
+        same_name_header = g_ptr_array_index(occurrences->headers, 0);
+        position = same_name_header->position;
     } else {
-        priv->header_list = g_list_append(priv->header_list,
-                                          milter_header_new(name, value));
+        position = priv->headers->len;
     }
+    insert_indexed_header(priv, position, indexed_header_new(name, value));
 
     return TRUE;
 }
@@ -387,8 +620,9 @@ milter_headers_append_header (MilterHeaders *headers,
     MilterHeadersPrivate *priv;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
-    priv->header_list = g_list_append(priv->header_list,
-                                      milter_header_new(name, value));
+    insert_indexed_header(priv,
+                          priv->headers->len,
+                          indexed_header_new(name, value));
 
     return TRUE;
 }
@@ -402,54 +636,27 @@ milter_headers_insert_header (MilterHeaders *headers,
     MilterHeadersPrivate *priv;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
-
-    priv->header_list = g_list_insert(priv->header_list,
-                                      milter_header_new(name, value),
-                                      position);
+    insert_indexed_header(priv, position, indexed_header_new(name, value));
 
     return TRUE;
 }
 
-static MilterHeader *
-milter_headers_lookup_by_name_with_index (MilterHeaders *headers,
-                                          const gchar *name,
-                                          guint index)
-{
-    MilterHeadersPrivate *priv;
-    GList *node;
-    guint found_count = 0;
-
-    priv = MILTER_HEADERS_GET_PRIVATE(headers);
-
-    for (node = priv->header_list; node; node = g_list_next(node)) {
-        MilterHeader *header = node->data;
-
-        if (!string_equal(header->name, name))
-            continue;
-
-        found_count++;
-
-        if (found_count == index)
-            return header;
-    }
-
-    return NULL;
-}
-
 gboolean
 milter_headers_change_header (MilterHeaders *headers,
                               const gchar *name,
                               guint index,
                               const gchar *value)
 {
-    MilterHeader *header;
+    MilterHeadersPrivate *priv;
+    IndexedHeader *header;
 
     if (!value)
         return milter_headers_delete_header(headers, name, index);
 
-    header = milter_headers_lookup_by_name_with_index(headers, name, index);
+    priv = MILTER_HEADERS_GET_PRIVATE(headers);
+    header = lookup_by_name_with_index(priv, name, index);
     if (header)
-        milter_header_change_value(header, value);
+        milter_header_change_value(&(header->header), value);
     else
         milter_headers_add_header(headers, name, value);
 
@@ -461,16 +668,15 @@ milter_headers_delete_header (MilterHeaders *headers,
                               const gchar *name,
                               guint index)
 {
-    MilterHeader *header;
     MilterHeadersPrivate *priv;
+    IndexedHeader *header;
 
-    header = milter_headers_lookup_by_name_with_index(headers, name, index);
+    priv = MILTER_HEADERS_GET_PRIVATE(headers);
+    header = lookup_by_name_with_index(priv, name, index);
     if (!header)
         return FALSE;
 
-    priv = MILTER_HEADERS_GET_PRIVATE(headers);
-    priv->header_list = g_list_remove(priv->header_list, header);
-    milter_header_free(header);
+    remove_indexed_header(priv, header);
 
     return TRUE;
 }
@@ -481,7 +687,7 @@ milter_headers_length (MilterHeaders *headers)
     MilterHeadersPrivate *priv;
 
     priv = MILTER_HEADERS_GET_PRIVATE(headers);
-    return g_list_length(priv->header_list);
+    return priv->headers->len;
 }
 
 /*
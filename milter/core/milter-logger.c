@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <glib.h>
@@ -43,6 +44,13 @@
      MILTER_LOG_LEVEL_STATISTICS)
 #define DEFAULT_ITEM                            \
     (MILTER_LOG_ITEM_TIME)
+#define FLUSH_INTERVAL 1 /* seconds */
+#define MAX_LOG_BUFFER_SIZE 65536
+#define IMMEDIATE_FLUSH_LEVEL                   \
+    (MILTER_LOG_LEVEL_CRITICAL |                \
+     MILTER_LOG_LEVEL_ERROR |                   \
+     MILTER_LOG_LEVEL_WARNING |                 \
+     MILTER_LOG_LEVEL_MESSAGE)
 
 #define MILTER_LOGGER_GET_PRIVATE(obj)                  \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                 \
@@ -75,8 +83,20 @@ struct _MilterLoggerPrivate
     MilterLogLevelFlags interesting_level;
     gchar *path;
     FILE *output;
+    gboolean colorize_resolved;
+    MilterLogColorize colorize;
+    GFlagsClass *level_flags_class;
+    glong last_flushed_time;
 };
 
+static void
+log_buffer_free (gpointer data)
+{
+    g_string_free(data, TRUE);
+}
+
+static GPrivate log_buffer = G_PRIVATE_INIT(log_buffer_free);
+
 enum
 {
     PROP_0,
@@ -220,6 +240,10 @@ milter_logger_init (MilterLogger *logger)
                         GUINT_TO_POINTER(priv->interesting_level));
     priv->path = NULL;
     priv->output = NULL;
+    priv->colorize_resolved = FALSE;
+    priv->colorize = MILTER_LOG_COLORIZE_DEFAULT;
+    priv->level_flags_class = g_type_class_ref(MILTER_TYPE_LOG_LEVEL_FLAGS);
+    priv->last_flushed_time = 0;
 }
 
 static void
@@ -231,6 +255,7 @@ dispose_path (MilterLoggerPrivate *priv)
         fclose(priv->output);
         priv->output = NULL;
     }
+    priv->colorize_resolved = FALSE;
 }
 
 static void
@@ -247,6 +272,11 @@ dispose (GObject *object)
 
     dispose_path(priv);
 
+    if (priv->level_flags_class) {
+        g_type_class_unref(priv->level_flags_class);
+        priv->level_flags_class = NULL;
+    }
+
     G_OBJECT_CLASS(milter_logger_parent_class)->dispose(object);
 }
 
@@ -402,13 +432,15 @@ log_message_colorize_console (GString *log,
         g_string_append(log, message);
 }
 
-static void
-log_message (MilterLoggerPrivate *priv, GString *log,
-             MilterLogLevelFlags level, const gchar *message)
+static MilterLogColorize
+resolve_colorize (MilterLoggerPrivate *priv)
 {
     const gchar *colorize_type;
     MilterLogColorize colorize = MILTER_LOG_COLORIZE_DEFAULT;
 
+    if (priv->colorize_resolved)
+        return priv->colorize;
+
     colorize_type = g_getenv("MILTER_LOG_COLORIZE");
     if (colorize_type)
         colorize = milter_utils_enum_from_string(MILTER_TYPE_LOG_COLORIZE,
@@ -431,7 +463,16 @@ log_message (MilterLoggerPrivate *priv, GString *log,
         }
     }
 
-    switch (colorize) {
+    priv->colorize = colorize;
+    priv->colorize_resolved = TRUE;
+    return colorize;
+}
+
+static void
+log_message (MilterLoggerPrivate *priv, GString *log,
+             MilterLogLevelFlags level, const gchar *message)
+{
+    switch (resolve_colorize(priv)) {
       case MILTER_LOG_COLORIZE_CONSOLE:
         log_message_colorize_console(log, level, message);
         break;
@@ -441,6 +482,25 @@ log_message (MilterLoggerPrivate *priv, GString *log,
     }
 }
 
+/* Same format as g_time_val_to_iso8601() without allocation. */
+static void
+format_time (GTimeVal *time_value, gchar *buffer, gsize buffer_size)
+{
+    struct tm tm;
+    time_t seconds;
+    gsize length;
+
+    seconds = time_value->tv_sec;
+    gmtime_r(&seconds, &tm);
+    length = strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (time_value->tv_usec != 0) {
+        g_snprintf(buffer + length, buffer_size - length,
+                   ".%06ldZ", (glong)time_value->tv_usec);
+    } else {
+        g_snprintf(buffer + length, buffer_size - length, "Z");
+    }
+}
+
 static inline void
 check_milter_debug (MilterLogLevelFlags level)
 {
@@ -485,7 +545,13 @@ milter_logger_default_log_handler (MilterLogger *logger, const gchar *domain,
 
     check_milter_debug(level);
 
-    log = g_string_new(NULL);
+    log = g_private_get(&log_buffer);
+    if (log) {
+        g_string_truncate(log, 0);
+    } else {
+        log = g_string_sized_new(256);
+        g_private_set(&log_buffer, log);
+    }
 
     target_item = priv->target_item;
     if (target_item == MILTER_LOG_ITEM_DEFAULT)
@@ -494,17 +560,17 @@ milter_logger_default_log_handler (MilterLogger *logger, const gchar *domain,
     if (target_item & MILTER_LOG_ITEM_LEVEL) {
         GFlagsClass *flags_class;
 
-        flags_class = g_type_class_ref(MILTER_TYPE_LOG_LEVEL_FLAGS);
-        if (flags_class) {
-            if (level & flags_class->mask) {
-                guint i;
-                for (i = 0; i < flags_class->n_values; i++) {
-                    GFlagsValue *value = flags_class->values + i;
-                    if (level & value->value)
-                        g_string_append_printf(log, "[%s]", value->value_nick);
+        flags_class = priv->level_flags_class;
+        if (flags_class && (level & flags_class->mask)) {
+            guint i;
+            for (i = 0; i < flags_class->n_values; i++) {
+                GFlagsValue *value = flags_class->values + i;
+                if (level & value->value) {
+                    g_string_append_c(log, '[');
+                    g_string_append(log, value->value_nick);
+                    g_string_append_c(log, ']');
                 }
             }
-            g_type_class_unref(flags_class);
         }
     }
 
@@ -512,11 +578,12 @@ milter_logger_default_log_handler (MilterLogger *logger, const gchar *domain,
         g_string_append_printf(log, "[%s]", domain);
 
     if (target_item & MILTER_LOG_ITEM_TIME) {
-        gchar *time_string;
+        gchar time_string[64];
 
-        time_string = g_time_val_to_iso8601(time_value);
-        g_string_append_printf(log, "[%s]", time_string);
-        g_free(time_string);
+        format_time(time_value, time_string, sizeof(time_string));
+        g_string_append_c(log, '[');
+        g_string_append(log, time_string);
+        g_string_append_c(log, ']');
     }
 
     if (target_item & MILTER_LOG_ITEM_NAME) {
@@ -543,14 +610,24 @@ milter_logger_default_log_handler (MilterLogger *logger, const gchar *domain,
     }
 
     log_message(priv, log, level, message);
-    g_string_append(log, "\n");
+    g_string_append_c(log, '\n');
     if (priv->output) {
-        fputs(log->str, priv->output);
-        fflush(priv->output);
+        /* The stream lock also guards last_flushed_time because
+         * logs may be written from multiple threads. */
+        flockfile(priv->output);
+        fwrite(log->str, 1, log->len, priv->output);
+        if ((level & IMMEDIATE_FLUSH_LEVEL) ||
+            time_value->tv_sec - priv->last_flushed_time >= FLUSH_INTERVAL) {
+            fflush(priv->output);
+            priv->last_flushed_time = time_value->tv_sec;
+        }
+        funlockfile(priv->output);
     } else {
         g_print("%s", log->str);
     }
-    g_string_free(log, TRUE);
+    if (log->allocated_len > MAX_LOG_BUFFER_SIZE) {
+        g_private_replace(&log_buffer, NULL);
+    }
 }
 
 /**
@@ -662,6 +739,7 @@ milter_logger_reopen (MilterLogger *logger)
 
     milter_info("[logger][reopen][close]");
     fclose(priv->output);
+    priv->colorize_resolved = FALSE;
     priv->output = fopen(priv->path, "a");
     if (!priv->output) {
         milter_warning("[logger][reopen][open][warning] <%s>: %s",
@@ -672,6 +750,33 @@ milter_logger_reopen (MilterLogger *logger)
     milter_info("[logger][reopen][open]");
 }
 
+/**
+ * milter_logger_flush:
+ * @logger: A #MilterLogger.
+ *
+ * Flushes buffered log messages to the output path. Log
+ * messages whose level is lower than message level may be
+ * buffered until the next log message after 1 second or
+ * this function is called. #MilterClient calls this
+ * periodically in its event loop.
+ *
+ * Since: 2.3.3
+ */
+void
+milter_logger_flush (MilterLogger *logger)
+{
+    MilterLoggerPrivate *priv;
+
+    priv = MILTER_LOGGER_GET_PRIVATE(logger);
+    if (!priv->output)
+        return;
+
+    flockfile(priv->output);
+    fflush(priv->output);
+    priv->last_flushed_time = g_get_real_time() / G_USEC_PER_SEC;
+    funlockfile(priv->output);
+}
+
 MilterLogLevelFlags
 milter_logger_get_target_level (MilterLogger *logger)
 {
@@ -208,6 +208,7 @@ milter_logger_log_literal(MilterLogger        *logger,
                           const gchar         *message);
 
 void             milter_logger_reopen         (MilterLogger        *logger);
+void             milter_logger_flush          (MilterLogger        *logger);
 
 MilterLogLevelFlags
                  milter_logger_get_target_level
@@ -34,6 +34,19 @@
                                  MILTER_TYPE_PROTOCOL_AGENT,            \
                                  MilterProtocolAgentPrivate))
 
+/*
+ * Macros are stored per macro context. Macro names are
+ * interned. So they aren't copied. A macro table received
+ * from MTA is shared by the leader and children. It's
+ * copied only when it's changed.
+ */
+typedef struct _MacroStage MacroStage;
+struct _MacroStage
+{
+    GHashTable *macros;
+    gboolean shared;
+};
+
 typedef struct _MilterProtocolAgentPrivate	MilterProtocolAgentPrivate;
 struct _MilterProtocolAgentPrivate
 {
@@ -99,6 +112,25 @@ milter_protocol_agent_class_init (MilterProtocolAgentClass *klass)
     g_type_class_add_private(gobject_class, sizeof(MilterProtocolAgentPrivate));
 }
 
+static MacroStage *
+macro_stage_new (GHashTable *macros, gboolean shared)
+{
+    MacroStage *stage;
+
+    stage = g_new(MacroStage, 1);
+    stage->macros = macros;
+    stage->shared = shared;
+
+    return stage;
+}
+
+static void
+macro_stage_free (MacroStage *stage)
+{
+    g_hash_table_unref(stage->macros);
+    g_free(stage);
+}
+
 static void
 milter_protocol_agent_init (MilterProtocolAgent *agent)
 {
@@ -107,7 +139,7 @@ milter_protocol_agent_init (MilterProtocolAgent *agent)
     priv = MILTER_PROTOCOL_AGENT_GET_PRIVATE(agent);
     priv->macros = g_hash_table_new_full(g_direct_hash, g_direct_equal,
                                          NULL,
-                                         (GDestroyNotify)g_hash_table_unref);
+                                         (GDestroyNotify)macro_stage_free);
     priv->available_macros = NULL;
     priv->macro_context = MILTER_COMMAND_UNKNOWN;
     priv->macros_requests = NULL;
@@ -180,23 +212,77 @@ get_property (GObject    *object,
     }
 }
 
+static GHashTable *
+lookup_macros (MilterProtocolAgentPrivate *priv, MilterCommand macro_context)
+{
+    MacroStage *stage;
+
+    stage = g_hash_table_lookup(priv->macros, GINT_TO_POINTER(macro_context));
+    if (!stage)
+        return NULL;
+    return stage->macros;
+}
+
+static guint
+n_available_macro_stages (MilterProtocolAgentPrivate *priv)
+{
+    guint i;
+
+    for (i = 0; macro_search_order[i] != 0; i++) {
+        if (macro_search_order[i] == priv->macro_context)
+            return i + 1;
+    }
+    return i;
+}
+
+/* Macros in later stages override ones in earlier stages. */
+static const gchar *
+lookup_available_macro (MilterProtocolAgentPrivate *priv, const gchar *name)
+{
+    guint i;
+
+    for (i = n_available_macro_stages(priv); i > 0; i--) {
+        GHashTable *macros;
+        const gchar *value;
+
+        macros = lookup_macros(priv, macro_search_order[i - 1]);
+        if (!macros)
+            continue;
+        value = g_hash_table_lookup(macros, name);
+        if (value)
+            return value;
+    }
+
+    return NULL;
+}
+
 const gchar *
 milter_protocol_agent_get_macro (MilterProtocolAgent *agent, const gchar *name)
 {
-    GHashTable *available_macros;
-    gchar *value;
+    MilterProtocolAgentPrivate *priv;
+    const gchar *value;
+    gsize name_length;
 
     if (!name)
         return NULL;
 
-    available_macros = milter_protocol_agent_get_available_macros(agent);
-    value = g_hash_table_lookup(available_macros, name);
-    if (!value) {
-        gchar *unbracket_name = NULL;
-
-        if (g_str_has_prefix(name, "{") && g_str_has_suffix(name, "}")) {
-            unbracket_name = g_strndup(name + 1, strlen(name) - 2);
-            value = g_hash_table_lookup(available_macros, unbracket_name);
+    priv = MILTER_PROTOCOL_AGENT_GET_PRIVATE(agent);
+    value = lookup_available_macro(priv, name);
+    if (value)
+        return value;
+
+    name_length = strlen(name);
+    if (name_length >= 2 && name[0] == '{' && name[name_length - 1] == '}') {
+        gchar buffer[64];
+        gchar *unbracket_name;
+
+        if (name_length - 2 < sizeof(buffer)) {
+            memcpy(buffer, name + 1, name_length - 2);
+            buffer[name_length - 2] = '\0';
+            value = lookup_available_macro(priv, buffer);
+        } else {
+            unbracket_name = g_strndup(name + 1, name_length - 2);
+            value = lookup_available_macro(priv, unbracket_name);
             g_free(unbracket_name);
         }
     }
@@ -208,6 +294,9 @@ milter_protocol_agent_get_macro (MilterProtocolAgent *agent, const gchar *name)
  * milter_protocol_agent_get_available_macros:
  * @agent: A #MilterProtocolAgent.
  *
+ * The returned hash table is valid until macros of @agent
+ * are changed.
+ *
  * Returns: (transfer none) (element-type utf8 utf8): The available macros of
  *   the agent.
  */
@@ -215,30 +304,31 @@ GHashTable *
 milter_protocol_agent_get_available_macros (MilterProtocolAgent *agent)
 {
     MilterProtocolAgentPrivate *priv;
-    gint i;
+    guint i, n_stages;
 
     priv = MILTER_PROTOCOL_AGENT_GET_PRIVATE(agent);
     if (priv->available_macros)
         return priv->available_macros;
 
-    priv->available_macros = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                                   g_free, g_free);
-    for (i = 0; macro_search_order[i] != 0; i++) {
+    /* Keys and values are borrowed from macro stages. */
+    priv->available_macros = g_hash_table_new(g_str_hash, g_str_equal);
+    n_stages = n_available_macro_stages(priv);
+    for (i = 0; i < n_stages; i++) {
         GHashTable *macros;
-        MilterCommand context;
+        GHashTableIter iter;
+        gpointer name, value;
 
-        context = macro_search_order[i];
+        macros = lookup_macros(priv, macro_search_order[i]);
+        if (!macros)
+            continue;
 
-        macros = g_hash_table_lookup(priv->macros, GINT_TO_POINTER(context));
-        if (macros)
-            milter_utils_merge_hash_string_string(priv->available_macros,
-                                                  macros);
-        if (context == priv->macro_context)
-            break;
+        g_hash_table_iter_init(&iter, macros);
+        while (g_hash_table_iter_next(&iter, &name, &value)) {
+            g_hash_table_insert(priv->available_macros, name, value);
+        }
     }
 
     return priv->available_macros;
-
 }
 
 /**
@@ -254,8 +344,7 @@ milter_protocol_agent_get_macros (MilterProtocolAgent *agent)
     MilterProtocolAgentPrivate *priv;
 
     priv = MILTER_PROTOCOL_AGENT_GET_PRIVATE(agent);
-    return g_hash_table_lookup(priv->macros,
-                               GINT_TO_POINTER(priv->macro_context));
+    return lookup_macros(priv, priv->macro_context);
 }
 
 void
@@ -291,30 +380,64 @@ milter_protocol_agent_clear_message_related_macros (MilterProtocolAgent *agent)
     clear_available_macros(priv);
 }
 
+static GHashTable *
+macros_new (void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+}
+
 static void
 update_macro (GHashTable *macros, const gchar *name, const gchar *value)
 {
+    const gchar *interned_name;
+
     if (value) {
-        g_hash_table_replace(macros, g_strdup(name), g_strdup(value));
+        interned_name = milter_utils_intern_macro_name(name, -1);
+        if (!interned_name) {
+            milter_debug("[protocol-agent][macro][ignore] invalid name: <%s>",
+                         name);
+            return;
+        }
+        g_hash_table_replace(macros, (gpointer)interned_name, g_strdup(value));
     } else {
         g_hash_table_remove(macros, name);
     }
 }
 
+static void
+cb_copy_macro (gpointer key, gpointer value, gpointer user_data)
+{
+    GHashTable *macros = user_data;
+    const gchar *macro_name = key;
+    const gchar *macro_value = value;
+
+    if (!macro_value)
+        return;
+
+    update_macro(macros, macro_name, macro_value);
+}
+
 static GHashTable *
 ensure_macros (MilterProtocolAgentPrivate *priv, MilterCommand macro_context)
 {
-    GHashTable *macros;
+    MacroStage *stage;
 
-    macros = g_hash_table_lookup(priv->macros, GINT_TO_POINTER(macro_context));
-    if (!macros) {
-        macros = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                       g_free, g_free);
+    stage = g_hash_table_lookup(priv->macros, GINT_TO_POINTER(macro_context));
+    if (!stage) {
+        stage = macro_stage_new(macros_new(), FALSE);
         g_hash_table_insert(priv->macros,
                             GINT_TO_POINTER(macro_context),
-                            macros);
+                            stage);
+    } else if (stage->shared) {
+        GHashTable *macros;
+
+        macros = macros_new();
+        g_hash_table_foreach(stage->macros, cb_copy_macro, macros);
+        g_hash_table_unref(stage->macros);
+        stage->macros = macros;
+        stage->shared = FALSE;
     }
-    return macros;
+    return stage->macros;
 }
 
 void
@@ -347,6 +470,7 @@ milter_protocol_agent_set_macros_valist (MilterProtocolAgent *agent,
         update_macro(macros, name, value);
         name = va_arg(var_args, gchar *);
     }
+    clear_available_macros(priv);
 }
 
 void
@@ -363,19 +487,6 @@ milter_protocol_agent_set_macros (MilterProtocolAgent *agent,
     va_end(var_args);
 }
 
-static void
-cb_copy_macro (gpointer key, gpointer value, gpointer user_data)
-{
-    GHashTable *macros = user_data;
-    const gchar *macro_name = key;
-    const gchar *macro_value = value;
-
-    if (!macro_value)
-        return;
-
-    g_hash_table_replace(macros, g_strdup(macro_name), g_strdup(macro_value));
-}
-
 void
 milter_protocol_agent_set_macros_hash_table (MilterProtocolAgent *agent,
                                              MilterCommand macro_context,
@@ -385,15 +496,39 @@ milter_protocol_agent_set_macros_hash_table (MilterProtocolAgent *agent,
     GHashTable *new_macros;
 
     priv = MILTER_PROTOCOL_AGENT_GET_PRIVATE(agent);
-    new_macros = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                       g_free, g_free);
+    new_macros = macros_new();
     g_hash_table_insert(priv->macros,
                         GINT_TO_POINTER(macro_context),
-                        new_macros);
+                        macro_stage_new(new_macros, FALSE));
     g_hash_table_foreach(macros, cb_copy_macro, new_macros);
     clear_available_macros(priv);
 }
 
+/**
+ * milter_protocol_agent_share_macros_hash_table:
+ * @agent: A #MilterProtocolAgent.
+ * @macro_context: The macro context of @macros.
+ * @macros: (element-type utf8 utf8): The macros to be shared.
+ *
+ * Uses @macros as the macros of @macro_context without
+ * copying. @agent just refers @macros. So @macros must not
+ * be changed after this call. @agent copies @macros when
+ * @agent changes them.
+ */
+void
+milter_protocol_agent_share_macros_hash_table (MilterProtocolAgent *agent,
+                                               MilterCommand macro_context,
+                                               GHashTable *macros)
+{
+    MilterProtocolAgentPrivate *priv;
+
+    priv = MILTER_PROTOCOL_AGENT_GET_PRIVATE(agent);
+    g_hash_table_insert(priv->macros,
+                        GINT_TO_POINTER(macro_context),
+                        macro_stage_new(g_hash_table_ref(macros), TRUE));
+    clear_available_macros(priv);
+}
+
 void
 milter_protocol_agent_set_macro (MilterProtocolAgent *agent,
                                  MilterCommand  macro_context,
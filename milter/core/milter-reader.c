@@ -45,6 +45,8 @@ struct _MilterReaderPrivate
     gboolean processing;
     gboolean shutdown_requested;
     guint tag;
+    gchar *buffer;
+    gsize buffer_size;
 };
 
 enum
@@ -128,24 +130,33 @@ milter_reader_init (MilterReader *reader)
     priv->processing = FALSE;
     priv->shutdown_requested = FALSE;
     priv->tag = 0;
+    priv->buffer = NULL;
+    priv->buffer_size = 0;
 }
 
-#define BUFFER_SIZE 4096
+#define INITIAL_BUFFER_SIZE 4096
+#define MAX_BUFFER_SIZE 262144
 static gboolean
-read_from_channel (MilterReader *reader, GIOChannel *channel)
+read_from_channel (MilterReader *reader, GIOChannel *channel,
+                   gboolean *filled)
 {
     MilterReaderPrivate *priv;
     gboolean error_occurred = FALSE;
     gboolean eof = FALSE;
     GIOStatus status;
-    gchar stream[BUFFER_SIZE + 1];
     gsize length = 0;
     GError *io_error = NULL;
 
     priv = MILTER_READER_GET_PRIVATE(reader);
 
-    status = g_io_channel_read_chars(channel, stream, BUFFER_SIZE,
+    if (!priv->buffer) {
+        priv->buffer_size = INITIAL_BUFFER_SIZE;
+        priv->buffer = g_new(gchar, priv->buffer_size + 1);
+    }
+
+    status = g_io_channel_read_chars(channel, priv->buffer, priv->buffer_size,
                                      &length, &io_error);
+    *filled = (status == G_IO_STATUS_NORMAL && length == priv->buffer_size);
     if (status == G_IO_STATUS_EOF) {
         milter_trace("[%u] [reader][eof]", priv->tag);
         eof = TRUE;
@@ -176,7 +187,31 @@ read_from_channel (MilterReader *reader, GIOChannel *channel)
                          priv->tag, length,
                          (condition & G_IO_IN) ? "contain" : "empty");
         }
-        g_signal_emit(reader, signals[FLOW], 0, stream, length);
+        priv->buffer[length] = '\0';
+        g_signal_emit(reader, signals[FLOW], 0, priv->buffer, length);
+    }
+
+    /* Grows the buffer for the next read when the peer sends more
+     * data than the buffer, e.g. large body chunks. */
+    if (*filled && priv->buffer_size < MAX_BUFFER_SIZE) {
+        priv->buffer_size = MIN(priv->buffer_size * 2, MAX_BUFFER_SIZE);
+        g_free(priv->buffer);
+        priv->buffer = g_new(gchar, priv->buffer_size + 1);
+        milter_trace("[%u] [reader][buffer][grow] <%" G_GSIZE_FORMAT ">",
+                     priv->tag, priv->buffer_size);
+    } else if (!*filled &&
+               priv->buffer_size > INITIAL_BUFFER_SIZE &&
+               length <= INITIAL_BUFFER_SIZE) {
+        /* Shrinks the buffer to the initial size when available data
+         * is drained and the peer sends only small packets again. It
+         * avoids keeping MAX_BUFFER_SIZE for each idle connection. */
+        milter_trace("[%u] [reader][buffer][shrink] <%" G_GSIZE_FORMAT "> -> "
+                     "<%" G_GSIZE_FORMAT ">",
+                     priv->tag, priv->buffer_size,
+                     (gsize)INITIAL_BUFFER_SIZE);
+        priv->buffer_size = INITIAL_BUFFER_SIZE;
+        g_free(priv->buffer);
+        priv->buffer = g_new(gchar, priv->buffer_size + 1);
     }
 
     return !error_occurred && !eof;
@@ -218,6 +253,8 @@ read_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
     MilterReaderPrivate *priv;
     MilterReader *reader = data;
     gboolean keep_callback = TRUE;
+    gboolean filled = FALSE;
+    gboolean nonblock;
 
     priv = MILTER_READER_GET_PRIVATE(reader);
     priv->processing = TRUE;
@@ -225,13 +262,19 @@ read_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
 
     if (!priv->shutdown_requested) {
         milter_trace("[%d] [reader][callback][read][reading] ...", priv->tag);
-        keep_callback = read_from_channel(reader, channel);
-        while (keep_callback &&
-               g_io_channel_get_buffered(priv->io_channel) &&
-               (g_io_channel_get_buffer_condition(priv->io_channel) & G_IO_IN)) {
-            milter_trace("[%d] [reader][callback][read][reading][buffer] ...",
+        keep_callback = read_from_channel(reader, channel, &filled);
+        /* Drains available data without returning to the event loop.
+         * It's safe only for non-blocking channel because read on
+         * blocking channel waits for the next data. */
+        nonblock = g_io_channel_get_flags(channel) & G_IO_FLAG_NONBLOCK;
+        while (keep_callback && !priv->shutdown_requested &&
+               ((nonblock && filled) ||
+                (g_io_channel_get_buffered(priv->io_channel) &&
+                 (g_io_channel_get_buffer_condition(priv->io_channel) &
+                  G_IO_IN)))) {
+            milter_trace("[%d] [reader][callback][read][reading][more] ...",
                          priv->tag);
-            keep_callback = read_from_channel(reader, channel);
+            keep_callback = read_from_channel(reader, channel, &filled);
         }
     }
 
@@ -360,6 +403,12 @@ dispose (GObject *object)
         priv->io_channel = NULL;
     }
 
+    if (priv->buffer) {
+        g_free(priv->buffer);
+        priv->buffer = NULL;
+        priv->buffer_size = 0;
+    }
+
     G_OBJECT_CLASS(milter_reader_parent_class)->dispose(object);
 }
 
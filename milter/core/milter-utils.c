@@ -477,6 +477,68 @@ milter_utils_merge_hash_string_string (GHashTable *dest, GHashTable *src)
                          dest);
 }
 
+/* Sendmail's MAXMACNAMELEN is 25. Names are interned into the
+ * global string table that is never freed. So only names that
+ * look like a macro name are interned to bound it. */
+#define MACRO_NAME_MAX_LENGTH 63
+
+static gboolean
+is_valid_macro_name (const gchar *name, gsize length)
+{
+    gsize i;
+
+    if (length == 0 || length > MACRO_NAME_MAX_LENGTH)
+        return FALSE;
+
+    if (length == 1)
+        return g_ascii_isgraph(name[0]);
+
+    if (name[0] == '{' && name[length - 1] == '}') {
+        name++;
+        length -= 2;
+        if (length == 0)
+            return FALSE;
+    }
+
+    for (i = 0; i < length; i++) {
+        if (!(g_ascii_isalnum(name[i]) || name[i] == '_' || name[i] == '-'))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * milter_utils_intern_macro_name:
+ * @name: A macro name.
+ * @length: The length of @name in bytes or -1 when @name is
+ *   NUL-terminated.
+ *
+ * @name must be a one character name or a name that
+ * consists of alphanumeric characters, "_" and "-" with or
+ * without braces. It must not be longer than 63 bytes.
+ *
+ * Returns: The canonical string of @name. The same names
+ *   always return the same pointer. It must not be freed. So
+ *   it can be used as a hash table key without copying.
+ *   %NULL is returned for an invalid name.
+ */
+const gchar *
+milter_utils_intern_macro_name (const gchar *name, gssize length)
+{
+    gchar buffer[MACRO_NAME_MAX_LENGTH + 1];
+
+    if (length < 0)
+        length = strlen(name);
+
+    if (!is_valid_macro_name(name, length))
+        return NULL;
+
+    memcpy(buffer, name, length);
+    buffer[length] = '\0';
+    return g_intern_string(buffer);
+}
+
 
 /**
  * milter_utils_inspect_list_pointer: (skip)
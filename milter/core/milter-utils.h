@@ -96,6 +96,8 @@ gchar    *milter_utils_inspect_hash_string_string
 void      milter_utils_merge_hash_string_string
                                              (GHashTable *dest,
                                               GHashTable *src);
+const gchar *milter_utils_intern_macro_name  (const gchar *name,
+                                              gssize       length);
 gchar    *milter_utils_inspect_list_pointer  (const GList *list);
 
 MilterMacroStage milter_utils_command_to_macro_stage
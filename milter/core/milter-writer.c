@@ -41,6 +41,7 @@ struct _MilterWriterPrivate
     GIOChannel *io_channel;
     MilterEventLoop *loop;
     GString *buffer;
+    gsize buffer_offset; /* written data in buffer */
     gsize flush_point;
     gboolean writing;
     guint write_watch_id;
@@ -134,6 +135,7 @@ milter_writer_init (MilterWriter *writer)
     priv->io_channel = NULL;
     priv->loop = NULL;
     priv->buffer = g_string_new(NULL);
+    priv->buffer_offset = 0;
     priv->flush_point = 0;
     priv->writing = FALSE;
     priv->write_watch_id = 0;
@@ -142,6 +144,42 @@ milter_writer_init (MilterWriter *writer)
     priv->tag = 0;
 }
 
+static gsize
+get_buffered_size (MilterWriterPrivate *priv)
+{
+    return priv->buffer->len - priv->buffer_offset;
+}
+
+static void
+consume_buffer (MilterWriterPrivate *priv, gsize size)
+{
+    priv->buffer_offset += size;
+    if (priv->buffer_offset == priv->buffer->len) {
+        g_string_truncate(priv->buffer, 0);
+        priv->buffer_offset = 0;
+    } else if (priv->buffer_offset >= get_buffered_size(priv)) {
+        /* Compact only when written data is larger than rest data
+         * to avoid moving large rest data on each partial write. */
+        g_string_erase(priv->buffer, 0, priv->buffer_offset);
+        priv->buffer_offset = 0;
+    }
+}
+
+static gboolean
+consume_flush_point (MilterWriterPrivate *priv, gsize written_size)
+{
+    if (priv->flush_point == 0)
+        return FALSE;
+
+    if (priv->flush_point <= written_size) {
+        priv->flush_point = 0;
+        return TRUE;
+    } else {
+        priv->flush_point -= written_size;
+        return FALSE;
+    }
+}
+
 static void
 clear_write_watch_id (MilterWriterPrivate *priv)
 {
@@ -194,10 +232,10 @@ dispose (GObject *object)
     }
 
     if (priv->buffer) {
-        if (priv->buffer->len > 0) {
+        if (get_buffered_size(priv) > 0) {
             milter_debug("[%u] [writer][dispose][buffer][unwritten] "
                          "<%" G_GSIZE_FORMAT ">",
-                         priv->tag, priv->buffer->len);
+                         priv->tag, get_buffered_size(priv));
         }
         g_string_free(priv->buffer, TRUE);
         priv->buffer = NULL;
@@ -345,9 +383,9 @@ write_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
 
     milter_trace("[%u] [writer][write-callback] [%u] "
                  "buffered: <%" G_GSIZE_FORMAT ">",
-                 priv->tag, priv->write_watch_id, priv->buffer->len);
+                 priv->tag, priv->write_watch_id, get_buffered_size(priv));
 
-    if (priv->buffer->len == 0) {
+    if (get_buffered_size(priv) == 0) {
         keep_callback = FALSE;
         milter_trace("[%u] [writer][write-callback][empty] [%u] "
                      "stop write watch because buffer is empty",
@@ -358,8 +396,8 @@ write_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
 
         priv->writing = TRUE;
         g_io_channel_write_chars(priv->io_channel,
-                                 priv->buffer->str,
-                                 priv->buffer->len,
+                                 priv->buffer->str + priv->buffer_offset,
+                                 get_buffered_size(priv),
                                  &written_size,
                                  &channel_error);
         priv->writing = FALSE;
@@ -368,19 +406,13 @@ write_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
             milter_trace("[%u] [writer][write-callback][unwritten] [%u] "
                          "no buffered chunks are written: "
                          "rest: <%" G_GSIZE_FORMAT ">",
-                         priv->tag, priv->write_watch_id, priv->buffer->len);
+                         priv->tag, priv->write_watch_id,
+                         get_buffered_size(priv));
         } else {
-            gboolean need_flush = FALSE;
-
-            if (priv->flush_point > 0) {
-                if (priv->flush_point <= written_size) {
-                    need_flush = TRUE;
-                    priv->flush_point = 0;
-                } else {
-                    priv->flush_point -= written_size;
-                }
-            }
-            g_string_erase(priv->buffer, 0, written_size);
+            gboolean need_flush;
+
+            need_flush = consume_flush_point(priv, written_size);
+            consume_buffer(priv, written_size);
             milter_trace("[%u] [writer][write-callback][wrote] [%u] "
                          "written: <%" G_GSIZE_FORMAT "> "
                          "rest: <%" G_GSIZE_FORMAT "> "
@@ -388,7 +420,7 @@ write_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
                          priv->tag,
                          priv->write_watch_id,
                          written_size,
-                         priv->buffer->len,
+                         get_buffered_size(priv),
                          need_flush ? "true" : "false");
             if (need_flush && priv->loop) {
                 request_flush(writer);
@@ -503,7 +535,7 @@ milter_writer_flush (MilterWriter *writer, GError **error)
     }
 
     if (priv->write_watch_id > 0) {
-        priv->flush_point = priv->buffer->len;
+        priv->flush_point = get_buffered_size(priv);
         milter_trace("[%u] [writer][flush][flush-point][set] [%u] "
                      "<%" G_GSIZE_FORMAT ">",
                      priv->tag,
@@ -516,6 +548,163 @@ milter_writer_flush (MilterWriter *writer, GError **error)
     return TRUE;
 }
 
+static gboolean
+cb_drain_writable (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    gboolean *writable = data;
+
+    *writable = TRUE;
+    return FALSE;
+}
+
+static gboolean
+cb_drain_timeout (gpointer data)
+{
+    gboolean *timed_out = data;
+
+    *timed_out = TRUE;
+    return FALSE;
+}
+
+/*
+ * This waits in a private context. It doesn't dispatch any
+ * other sources in the writer's event loop.
+ */
+static gboolean
+wait_writable (MilterWriterPrivate *priv, gdouble timeout)
+{
+    GMainContext *context;
+    GSource *watch_source;
+    GSource *timeout_source;
+    gboolean writable = FALSE;
+    gboolean timed_out = FALSE;
+
+    context = g_main_context_new();
+
+    watch_source = g_io_create_watch(priv->io_channel,
+                                     G_IO_OUT | G_IO_ERR | G_IO_HUP);
+    g_source_set_callback(watch_source,
+                          (GSourceFunc)cb_drain_writable, &writable,
+                          NULL);
+    g_source_attach(watch_source, context);
+
+    timeout_source = g_timeout_source_new(timeout * 1000);
+    g_source_set_callback(timeout_source, cb_drain_timeout, &timed_out, NULL);
+    g_source_attach(timeout_source, context);
+
+    while (!writable && !timed_out) {
+        g_main_context_iteration(context, TRUE);
+    }
+
+    g_source_destroy(watch_source);
+    g_source_unref(watch_source);
+    g_source_destroy(timeout_source);
+    g_source_unref(timeout_source);
+    g_main_context_unref(context);
+
+    return writable;
+}
+
+/**
+ * milter_writer_drain:
+ * @writer: A #MilterWriter.
+ * @max_pending_size: The maximum size of data to be left in
+ *   the buffer.
+ * @timeout: The maximum number of seconds to wait for the
+ *   channel to become writable.
+ * @error: Return location for an error, or %NULL.
+ *
+ * Writes buffered data to the channel without returning to
+ * the event loop until at most @max_pending_size bytes are
+ * left. It's for a producer that writes large data in one
+ * callback. The producer can keep the buffer size bounded
+ * by calling this after each write.
+ *
+ * Returns: %TRUE on success, %FALSE on write error or timeout.
+ *
+ * Since: 2.3.3
+ */
+gboolean
+milter_writer_drain (MilterWriter *writer,
+                     gsize max_pending_size,
+                     gdouble timeout,
+                     GError **error)
+{
+    MilterWriterPrivate *priv;
+
+    priv = MILTER_WRITER_GET_PRIVATE(writer);
+
+    if (!priv->io_channel) {
+        const gchar *message = "no write channel";
+        g_set_error(error,
+                    MILTER_WRITER_ERROR, MILTER_WRITER_ERROR_NO_CHANNEL,
+                    "%s", message);
+        milter_error("[%u] [writer][drain][error] %s",
+                     priv->tag, message);
+        return FALSE;
+    }
+
+    if (priv->writing) {
+        milter_trace("[%u] [writer][drain][skip] writing", priv->tag);
+        return TRUE;
+    }
+
+    while (get_buffered_size(priv) > max_pending_size) {
+        gsize written_size = 0;
+        GError *channel_error = NULL;
+
+        priv->writing = TRUE;
+        g_io_channel_write_chars(priv->io_channel,
+                                 priv->buffer->str + priv->buffer_offset,
+                                 get_buffered_size(priv),
+                                 &written_size,
+                                 &channel_error);
+        priv->writing = FALSE;
+
+        if (written_size > 0) {
+            gboolean need_flush;
+
+            need_flush = consume_flush_point(priv, written_size);
+            consume_buffer(priv, written_size);
+            milter_trace("[%u] [writer][drain][wrote] "
+                         "written: <%" G_GSIZE_FORMAT "> "
+                         "rest: <%" G_GSIZE_FORMAT ">",
+                         priv->tag,
+                         written_size,
+                         get_buffered_size(priv));
+            if (need_flush && priv->loop)
+                request_flush(writer);
+        }
+
+        if (channel_error) {
+            GError *drain_error = NULL;
+
+            milter_utils_set_error_with_sub_error(
+                &drain_error,
+                MILTER_WRITER_ERROR,
+                MILTER_WRITER_ERROR_IO_ERROR,
+                channel_error,
+                "failed to drain");
+            milter_error("[%u] [writer][drain][error] %s",
+                         priv->tag, drain_error->message);
+            g_propagate_error(error, drain_error);
+            return FALSE;
+        }
+
+        if (written_size == 0 && !wait_writable(priv, timeout)) {
+            const gchar *message = "timeout to wait for writable";
+            g_set_error(error,
+                        MILTER_WRITER_ERROR, MILTER_WRITER_ERROR_IO_ERROR,
+                        "%s: <%g>", message, timeout);
+            milter_error("[%u] [writer][drain][error] %s: <%g>",
+                         priv->tag, message, timeout);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 static gboolean
 error_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
 {
@@ -603,9 +792,9 @@ flush_buffer_on_shutdown (MilterWriter *writer)
 
     milter_trace("[%u] [writer][shutdown][flush-buffer] "
                  "<%" G_GSIZE_FORMAT ">",
-                 priv->tag, priv->buffer->len);
+                 priv->tag, get_buffered_size(priv));
 
-    if (priv->buffer->len == 0) {
+    if (get_buffered_size(priv) == 0) {
         milter_trace("[%u] [writer][shutdown][flush-buffer][skip] "
                      "no buffered data",
                      priv->tag);
@@ -619,8 +808,8 @@ flush_buffer_on_shutdown (MilterWriter *writer)
     }
 
     g_io_channel_write_chars(priv->io_channel,
-                             priv->buffer->str,
-                             priv->buffer->len,
+                             priv->buffer->str + priv->buffer_offset,
+                             get_buffered_size(priv),
                              &written_size,
                              &channel_error);
 
@@ -628,15 +817,15 @@ flush_buffer_on_shutdown (MilterWriter *writer)
         milter_trace("[%u] [writer][shutdown][flush-buffer][unwritten] "
                      "no buffered chunks are written: "
                      "rest: <%" G_GSIZE_FORMAT ">",
-                     priv->tag, priv->buffer->len);
+                     priv->tag, get_buffered_size(priv));
     } else {
-        g_string_erase(priv->buffer, 0, written_size);
+        consume_buffer(priv, written_size);
         milter_trace("[%u] [writer][shutdown][flush-buffer][wrote] "
                      "written: <%" G_GSIZE_FORMAT "> "
                      "rest: <%" G_GSIZE_FORMAT ">",
                      priv->tag,
                      written_size,
-                     priv->buffer->len);
+                     get_buffered_size(priv));
     }
 
     if (channel_error) {
@@ -695,6 +884,12 @@ milter_writer_shutdown (MilterWriter *writer)
     }
 }
 
+gsize
+milter_writer_get_pending_size (MilterWriter *writer)
+{
+    return get_buffered_size(MILTER_WRITER_GET_PRIVATE(writer));
+}
+
 guint
 milter_writer_get_tag (MilterWriter *writer)
 {
@@ -71,11 +71,17 @@ gboolean         milter_writer_write          (MilterWriter     *writer,
                                                GError          **error);
 gboolean         milter_writer_flush          (MilterWriter     *writer,
                                                GError          **error);
+gboolean         milter_writer_drain          (MilterWriter     *writer,
+                                               gsize             max_pending_size,
+                                               gdouble           timeout,
+                                               GError          **error);
 
 void             milter_writer_start          (MilterWriter     *writer,
                                                MilterEventLoop  *loop);
 gboolean         milter_writer_is_watching    (MilterWriter     *writer);
 void             milter_writer_shutdown       (MilterWriter     *writer);
+gsize            milter_writer_get_pending_size
+                                              (MilterWriter     *writer);
 
 guint            milter_writer_get_tag        (MilterWriter     *writer);
 void             milter_writer_set_tag        (MilterWriter     *writer,
@@ -44,6 +44,7 @@ struct _MilterManagerChildPrivate
     gboolean search_path;
     MilterStatus fallback_status;
     gboolean evaluation_mode;
+    gboolean reuse_connection;
 };
 
 enum
@@ -55,7 +56,8 @@ enum
     PROP_WORKING_DIRECTORY,
     PROP_SEARCH_PATH,
     PROP_FALLBACK_STATUS,
-    PROP_REPUTATION_MODE
+    PROP_REPUTATION_MODE,
+    PROP_REUSE_CONNECTION
 };
 
 MILTER_DEFINE_ERROR_EMITTABLE_TYPE(MilterManagerChild,
@@ -135,6 +137,14 @@ milter_manager_child_class_init (MilterManagerChildClass *klass)
                                 G_PARAM_READWRITE);
     g_object_class_install_property(gobject_class, PROP_REPUTATION_MODE, spec);
 
+    spec = g_param_spec_boolean("reuse-connection",
+                                "Reuse connection",
+                                "Whether the connection to the child is reused "
+                                "for the next session or not",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_REUSE_CONNECTION, spec);
+
     g_type_class_add_private(gobject_class,
                              sizeof(MilterManagerChildPrivate));
 }
@@ -152,6 +162,7 @@ milter_manager_child_init (MilterManagerChild *milter)
     priv->search_path = TRUE;
     priv->fallback_status = MILTER_STATUS_ACCEPT;
     priv->evaluation_mode = FALSE;
+    priv->reuse_connection = FALSE;
 }
 
 static void
@@ -223,6 +234,9 @@ set_property (GObject      *object,
     case PROP_REPUTATION_MODE:
         priv->evaluation_mode = g_value_get_boolean(value);
         break;
+    case PROP_REUSE_CONNECTION:
+        priv->reuse_connection = g_value_get_boolean(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -260,6 +274,9 @@ get_property (GObject    *object,
     case PROP_REPUTATION_MODE:
         g_value_set_boolean(value, priv->evaluation_mode);
         break;
+    case PROP_REUSE_CONNECTION:
+        g_value_set_boolean(value, priv->reuse_connection);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -332,6 +349,19 @@ milter_manager_child_is_evaluation_mode (MilterManagerChild *milter)
     return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->evaluation_mode;
 }
 
+void
+milter_manager_child_set_reuse_connection (MilterManagerChild *milter,
+                                           gboolean reuse_connection)
+{
+    MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->reuse_connection = reuse_connection;
+}
+
+gboolean
+milter_manager_child_is_reuse_connection (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->reuse_connection;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -83,6 +83,12 @@ void                  milter_manager_child_set_evaluation_mode
 gboolean              milter_manager_child_is_evaluation_mode
                                                        (MilterManagerChild *milter);
 
+void                  milter_manager_child_set_reuse_connection
+                                                       (MilterManagerChild *milter,
+                                                        gboolean reuse_connection);
+gboolean              milter_manager_child_is_reuse_connection
+                                                       (MilterManagerChild *milter);
+
 #endif /* __MILTER_MANAGER_CHILD_H__ */
 
 /*
@@ -23,12 +23,17 @@
 
 #include "milter-manager-children.h"
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
 #include <glib/gstdio.h>
 #include "milter-manager-configuration.h"
 #include "milter/core.h"
 #include "milter-manager-launch-command-encoder.h"
-
-#define MAX_ON_MEMORY_BODY_SIZE 5242880 /* 5Mbyte */
+#include "milter-manager-metrics.h"
+#include "milter-manager-connection-pool.h"
 
 #define MAX_SUPPORTED_MILTER_PROTOCOL_VERSION 6
 
@@ -64,11 +69,16 @@ struct _MilterManagerChildrenPrivate
     GQueue *reply_queue;
     GList *command_waiting_child_queue; /* storing child milters which is waiting for commands after DATA command */
     GList *command_queue; /* storing commands after DATA command */
+    GList *parallel_children; /* storing child milters which receive commands after DATA command concurrently */
+    GList *parallel_reply_waiting_children;
+    MilterStatus deferred_reply_status;
+    gboolean deferred_reply_for_message_oriented_command;
     PendingMessageRequest *pending_message_request;
     GHashTable *try_negotiate_ids;
     MilterManagerConfiguration *configuration;
     MilterMacrosRequests *macros_requests;
     MilterOption *option;
+    MilterOption *requested_option; /* the option requested by MTA */
     MilterStepFlags initial_yes_steps;
     MilterStepFlags requested_yes_steps;
     gboolean negotiated;
@@ -87,12 +97,22 @@ struct _MilterManagerChildrenPrivate
     MilterHeaders *headers;
     gint processing_header_index;
     GString *body;
-    GIOChannel *body_file;
-    gchar *body_file_name;
+    gint body_fd;
+    gsize body_file_size;
+    gchar *body_file_data; /* mmap()-ed body_fd */
+    gsize body_file_data_size;
     gchar *end_of_message_chunk;
     gsize end_of_message_size;
+    /* Header, end-of-header, body and end-of-message packets
+     * are encoded once and the same packet is written to all
+     * children. Define-macro packets are still encoded for
+     * each child because each child requests its own macros. */
+    MilterEncoder *encoder;
+    GPtrArray *header_packets;
+    GString *end_of_header_packet;
+    GString *end_of_message_packet;
     guint sending_body;
-    guint sent_body_offset;
+    gsize sent_body_offset;
     gboolean replaced_body_for_each_child;
     gboolean replaced_body;
     gchar *change_from;
@@ -111,6 +131,14 @@ struct _MilterManagerChildrenPrivate
     guint lazy_reply_negotiate_id;
 };
 
+typedef struct _HeaderPacket HeaderPacket;
+struct _HeaderPacket
+{
+    gchar *name;
+    gchar *value;
+    GString *packet;
+};
+
 typedef struct _NegotiateData NegotiateData;
 struct _NegotiateData
 {
@@ -180,6 +208,9 @@ static void prepare_retry_establish_connection
 static void remove_queue_in_negotiate
                            (MilterManagerChildren *children,
                             MilterManagerChild *child);
+static void remove_parallel_child
+                           (MilterManagerChildren *children,
+                            MilterServerContext *context);
 static MilterServerContext *get_first_child_in_command_waiting_child_queue
                            (MilterManagerChildren *children);
 static gboolean write_body (MilterManagerChildren *children,
@@ -213,6 +244,7 @@ static NegotiateTimeoutID *
                                                  guint            timeout_id);
 static void           negotiate_timeout_id_free (NegotiateTimeoutID *id);
 static void           negotiate_timeout_id_hash_value_free (gpointer data);
+static void           header_packet_free (HeaderPacket *packet);
 
 static void
 milter_manager_children_class_init (MilterManagerChildrenClass *klass)
@@ -261,6 +293,10 @@ milter_manager_children_init (MilterManagerChildren *milter)
     priv->reply_queue = g_queue_new();
     priv->command_waiting_child_queue = NULL;
     priv->command_queue = NULL;
+    priv->parallel_children = NULL;
+    priv->parallel_reply_waiting_children = NULL;
+    priv->deferred_reply_status = MILTER_STATUS_DEFAULT;
+    priv->deferred_reply_for_message_oriented_command = FALSE;
     priv->pending_message_request = NULL;
     priv->try_negotiate_ids =
         g_hash_table_new_full(g_direct_hash, g_direct_equal,
@@ -269,6 +305,7 @@ milter_manager_children_init (MilterManagerChildren *milter)
     priv->milters = NULL;
     priv->macros_requests = milter_macros_requests_new();
     priv->option = NULL;
+    priv->requested_option = NULL;
     priv->initial_yes_steps = MILTER_STEP_NONE;
     priv->requested_yes_steps = MILTER_STEP_NONE;
     priv->negotiated = FALSE;
@@ -281,10 +318,17 @@ milter_manager_children_init (MilterManagerChildren *milter)
     priv->headers = NULL;
     priv->processing_header_index = 0;
     priv->body = NULL;
-    priv->body_file = NULL;
-    priv->body_file_name = NULL;
+    priv->body_fd = -1;
+    priv->body_file_size = 0;
+    priv->body_file_data = NULL;
+    priv->body_file_data_size = 0;
     priv->end_of_message_chunk = NULL;
     priv->end_of_message_size = 0;
+    priv->encoder = milter_command_encoder_new();
+    priv->header_packets = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)header_packet_free);
+    priv->end_of_header_packet = NULL;
+    priv->end_of_message_packet = NULL;
     priv->sending_body = FALSE;
     priv->sent_body_offset = 0;
     priv->replaced_body = FALSE;
@@ -411,6 +455,17 @@ dispose_pending_message_request (MilterManagerChildrenPrivate *priv)
     }
 }
 
+static void
+unmap_body_file (MilterManagerChildrenPrivate *priv)
+{
+    if (!priv->body_file_data)
+        return;
+
+    munmap(priv->body_file_data, priv->body_file_data_size);
+    priv->body_file_data = NULL;
+    priv->body_file_data_size = 0;
+}
+
 static void
 dispose_body_related_data (MilterManagerChildrenPrivate *priv)
 {
@@ -421,16 +476,12 @@ dispose_body_related_data (MilterManagerChildrenPrivate *priv)
         priv->body = NULL;
     }
 
-    if (priv->body_file) {
-        g_io_channel_unref(priv->body_file);
-        priv->body_file = NULL;
-    }
-
-    if (priv->body_file_name) {
-        g_unlink(priv->body_file_name);
-        g_free(priv->body_file_name);
-        priv->body_file_name = NULL;
+    unmap_body_file(priv);
+    if (priv->body_fd >= 0) {
+        close(priv->body_fd);
+        priv->body_fd = -1;
     }
+    priv->body_file_size = 0;
 }
 
 static void
@@ -464,6 +515,18 @@ dispose_message_related_data (MilterManagerChildrenPrivate *priv)
         priv->command_queue = NULL;
     }
 
+    if (priv->parallel_children) {
+        g_list_free(priv->parallel_children);
+        priv->parallel_children = NULL;
+    }
+
+    if (priv->parallel_reply_waiting_children) {
+        g_list_free(priv->parallel_reply_waiting_children);
+        priv->parallel_reply_waiting_children = NULL;
+    }
+    priv->deferred_reply_status = MILTER_STATUS_DEFAULT;
+    priv->deferred_reply_for_message_oriented_command = FALSE;
+
     if (priv->original_headers) {
         g_object_unref(priv->original_headers);
         priv->original_headers = NULL;
@@ -481,6 +544,14 @@ dispose_message_related_data (MilterManagerChildrenPrivate *priv)
         priv->end_of_message_chunk = NULL;
     }
 
+    if (priv->header_packets)
+        g_ptr_array_set_size(priv->header_packets, 0);
+
+    if (priv->end_of_message_packet) {
+        g_string_free(priv->end_of_message_packet, TRUE);
+        priv->end_of_message_packet = NULL;
+    }
+
     if (priv->change_from) {
         g_free(priv->change_from);
         priv->change_from = NULL;
@@ -553,6 +624,11 @@ dispose (GObject *object)
         priv->option = NULL;
     }
 
+    if (priv->requested_option) {
+        g_object_unref(priv->requested_option);
+        priv->requested_option = NULL;
+    }
+
     if (priv->reply_statuses) {
         g_hash_table_unref(priv->reply_statuses);
         priv->reply_statuses = NULL;
@@ -561,6 +637,21 @@ dispose (GObject *object)
     dispose_reply_related_data(priv);
     dispose_message_related_data(priv);
 
+    if (priv->header_packets) {
+        g_ptr_array_unref(priv->header_packets);
+        priv->header_packets = NULL;
+    }
+
+    if (priv->end_of_header_packet) {
+        g_string_free(priv->end_of_header_packet, TRUE);
+        priv->end_of_header_packet = NULL;
+    }
+
+    if (priv->encoder) {
+        g_object_unref(priv->encoder);
+        priv->encoder = NULL;
+    }
+
     milter_manager_children_set_launcher_channel(MILTER_MANAGER_CHILDREN(object),
                                                  NULL, NULL);
 
@@ -871,6 +962,13 @@ report_result (MilterManagerChildren *children,
     const gchar *child_name;
     guint tag;
 
+    child_name = milter_server_context_get_name(context);
+    milter_manager_metrics_record_child(
+        child_name,
+        milter_server_context_get_last_state(context),
+        milter_server_context_get_status(context),
+        milter_server_context_get_elapsed(context));
+
     if (!(milter_need_log(MILTER_LOG_LEVEL_DEBUG |
                           MILTER_LOG_LEVEL_STATISTICS)))
         return;
@@ -878,8 +976,6 @@ report_result (MilterManagerChildren *children,
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
 
-    child_name = milter_server_context_get_name(context);
-
     state = milter_server_context_get_state(context);
     state_name = milter_utils_get_enum_nick_name(
         MILTER_TYPE_SERVER_CONTEXT_STATE, state);
@@ -917,6 +1013,7 @@ expire_child (MilterManagerChildren *children,
     report_result(children, context);
     milter_server_context_set_quitted(context, TRUE);
     teardown_server_context_signals(MILTER_MANAGER_CHILD(context), children);
+    remove_parallel_child(children, context);
 }
 
 static void
@@ -980,6 +1077,8 @@ milter_manager_children_is_waiting_reply (MilterManagerChildren *children)
     case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
     case MILTER_SERVER_CONTEXT_STATE_BODY:
     case MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE:
+        if (priv->parallel_reply_waiting_children)
+            return TRUE;
         current_child = get_first_child_in_command_waiting_child_queue(children);
         if (!current_child)
             return FALSE;
@@ -991,6 +1090,36 @@ milter_manager_children_is_waiting_reply (MilterManagerChildren *children)
     }
 }
 
+guint
+milter_manager_children_get_n_queued_commands (MilterManagerChildren *children)
+{
+    return g_list_length(MILTER_MANAGER_CHILDREN_GET_PRIVATE(children)->command_queue);
+}
+
+/* Returns the number of child milters that process the
+ * queued commands before @child or -1 if @child isn't
+ * waiting for them. */
+gint
+milter_manager_children_get_command_waiting_position (MilterManagerChildren *children,
+                                                      MilterManagerChild *child)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    return g_list_index(priv->command_waiting_child_queue, child);
+}
+
+gsize
+milter_manager_children_get_body_file_size (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (priv->body_fd < 0)
+        return 0;
+    return priv->body_file_size;
+}
+
 static gboolean
 process_pending_message_request (MilterManagerChildren *children)
 {
@@ -1095,84 +1224,157 @@ remove_child_from_queue (MilterManagerChildren *children,
     return status;
 }
 
-static gboolean
-emit_replace_body_signal_file (MilterManagerChildren *children)
+static void
+emit_body_file_error (MilterManagerChildren *children,
+                      const gchar *operation,
+                      gint error_number)
 {
     MilterManagerChildrenPrivate *priv;
     GError *error = NULL;
-    GIOStatus status = G_IO_STATUS_NORMAL;
-    gsize chunk_size;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
-    g_io_channel_seek_position(priv->body_file, 0, G_SEEK_SET, &error);
-    if (error) {
-        milter_error("[%u] [children][error][body][read][seek] %s",
-                     priv->tag, error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children),
-                                    error);
-        g_error_free(error);
-
-        return FALSE;
-    }
+    g_set_error(&error,
+                G_FILE_ERROR,
+                g_file_error_from_errno(error_number),
+                "failed to %s body file: %s",
+                operation, g_strerror(error_number));
+    milter_error("[%u] [children][error][body][%s] %s",
+                 priv->tag, operation, error->message);
+    milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children), error);
+    g_error_free(error);
+}
 
-    chunk_size =
-        milter_manager_configuration_get_chunk_size(priv->configuration);
-    while (status == G_IO_STATUS_NORMAL) {
-        gchar buffer[MILTER_CHUNK_SIZE + 1];
-        gsize read_size;
+static gboolean
+get_body (MilterManagerChildren *children, const gchar **body, gsize *size)
+{
+    MilterManagerChildrenPrivate *priv;
+    gpointer data;
 
-        status = g_io_channel_read_chars(priv->body_file,
-                                         buffer, chunk_size,
-                                         &read_size, &error);
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
-        if (status == G_IO_STATUS_NORMAL)
-            g_signal_emit_by_name(children, "replace-body", buffer, read_size);
+    if (priv->body) {
+        *body = priv->body->str;
+        *size = priv->body->len;
+        return TRUE;
     }
 
-    if (error) {
-        milter_error("[%u] [children][error][body][read] %s",
-                     priv->tag, error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children),
-                                    error);
-        g_error_free(error);
+    if (priv->body_fd < 0 || priv->body_file_size == 0) {
+        *body = NULL;
+        *size = 0;
+        return TRUE;
+    }
 
-        return FALSE;
+    if (!priv->body_file_data) {
+        data = mmap(NULL, priv->body_file_size, PROT_READ, MAP_SHARED,
+                    priv->body_fd, 0);
+        if (data == MAP_FAILED) {
+            emit_body_file_error(children, "map", errno);
+            return FALSE;
+        }
+        priv->body_file_data = data;
+        priv->body_file_data_size = priv->body_file_size;
     }
 
+    *body = priv->body_file_data;
+    *size = priv->body_file_data_size;
     return TRUE;
 }
 
 static gboolean
-emit_replace_body_signal_string (MilterManagerChildren *children)
+emit_replace_body_signal (MilterManagerChildren *children)
 {
     MilterManagerChildrenPrivate *priv;
-    gsize offset, chunk_size, write_size;
+    const gchar *body;
+    gsize body_size, offset, chunk_size, write_size;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    if (!get_body(children, &body, &body_size))
+        return FALSE;
+
     chunk_size =
         milter_manager_configuration_get_chunk_size(priv->configuration);
-    for (offset = 0; offset < priv->body->len; offset += write_size) {
-        write_size = MIN(priv->body->len - offset, chunk_size);
+    for (offset = 0; offset < body_size; offset += write_size) {
+        write_size = MIN(body_size - offset, chunk_size);
         g_signal_emit_by_name(children, "replace-body",
-                              priv->body->str + offset,
+                              body + offset,
                               write_size);
     }
 
     return TRUE;
 }
 
-static gboolean
-emit_replace_body_signal (MilterManagerChildren *children)
+static void
+header_packet_free (HeaderPacket *packet)
+{
+    g_free(packet->name);
+    g_free(packet->value);
+    g_string_free(packet->packet, TRUE);
+    g_free(packet);
+}
+
+/* The nth header is sent to each child in turn. Its packet is
+ * encoded again only when a previous child changed it or the
+ * child needs another value with leading space conversion. */
+static GString *
+get_header_packet (MilterManagerChildren *children,
+                   guint index,
+                   const gchar *name,
+                   const gchar *value)
 {
     MilterManagerChildrenPrivate *priv;
+    HeaderPacket *header_packet = NULL;
+    const gchar *packet;
+    gsize packet_size;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
-    if (priv->body)
-        return emit_replace_body_signal_string(children);
-    else
-        return emit_replace_body_signal_file(children);
+
+    if (index <= priv->header_packets->len) {
+        header_packet = g_ptr_array_index(priv->header_packets, index - 1);
+        if (header_packet &&
+            g_str_equal(header_packet->name, name) &&
+            g_str_equal(header_packet->value, value))
+            return header_packet->packet;
+    } else {
+        g_ptr_array_set_size(priv->header_packets, index);
+    }
+
+    milter_command_encoder_encode_header(MILTER_COMMAND_ENCODER(priv->encoder),
+                                         &packet, &packet_size,
+                                         name, value);
+    if (header_packet) {
+        g_free(header_packet->name);
+        g_free(header_packet->value);
+        g_string_truncate(header_packet->packet, 0);
+        g_string_append_len(header_packet->packet, packet, packet_size);
+    } else {
+        header_packet = g_new0(HeaderPacket, 1);
+        header_packet->packet = g_string_new_len(packet, packet_size);
+        g_ptr_array_index(priv->header_packets, index - 1) = header_packet;
+    }
+    header_packet->name = g_strdup(name);
+    header_packet->value = g_strdup(value);
+
+    return header_packet->packet;
+}
+
+static GString *
+get_end_of_header_packet (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->end_of_header_packet) {
+        const gchar *packet;
+        gsize packet_size;
+
+        milter_command_encoder_encode_end_of_header(
+            MILTER_COMMAND_ENCODER(priv->encoder), &packet, &packet_size);
+        priv->end_of_header_packet = g_string_new_len(packet, packet_size);
+    }
+
+    return priv->end_of_header_packet;
 }
 
 static MilterStatus
@@ -1183,6 +1385,7 @@ send_command_to_child (MilterManagerChildren *children,
     MilterManagerChildrenPrivate *priv;
     MilterManagerChild *child;
     MilterStatus status;
+    GString *packet;
 
     child = MILTER_MANAGER_CHILD(context);
     status = milter_manager_child_get_fallback_status(child);
@@ -1194,7 +1397,10 @@ send_command_to_child (MilterManagerChildren *children,
         break;
     case MILTER_COMMAND_END_OF_HEADER:
         priv->processing_state = MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER;
-        if (milter_server_context_end_of_header(context)) {
+        packet = get_end_of_header_packet(children);
+        if (milter_server_context_end_of_header_with_packet(context,
+                                                            packet->str,
+                                                            packet->len)) {
             status = MILTER_STATUS_PROGRESS;
             if (!milter_server_context_need_reply(context,
                                                  priv->processing_state)) {
@@ -1208,9 +1414,13 @@ send_command_to_child (MilterManagerChildren *children,
     case MILTER_COMMAND_END_OF_MESSAGE:
         priv->processing_header_index = 0;
         priv->processing_state = MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE;
-        if (milter_server_context_end_of_message(context,
-                                                 priv->end_of_message_chunk,
-                                                 priv->end_of_message_size))
+        packet = priv->end_of_message_packet;
+        if (milter_server_context_end_of_message_with_packet(
+                context,
+                priv->end_of_message_chunk,
+                priv->end_of_message_size,
+                packet ? packet->str : NULL,
+                packet ? packet->len : 0))
             status = MILTER_STATUS_PROGRESS;
         break;
     default:
@@ -1322,6 +1532,167 @@ emit_reply_for_message_oriented_command (MilterManagerChildren *children,
     emit_reply_status_of_state(children, state);
 }
 
+static gboolean
+is_parallel_child (MilterManagerChildren *children,
+                   MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    return g_list_find(priv->parallel_children, context) != NULL;
+}
+
+static gboolean
+can_process_message_in_parallel (MilterManagerChildren *children,
+                                 MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterOption *option;
+    MilterActionFlags action;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->configuration)
+        return FALSE;
+    if (!milter_manager_configuration_is_parallel_message_processing(
+            priv->configuration))
+        return FALSE;
+
+    /* modifications by a child in evaluation mode are never applied. */
+    if (milter_manager_child_is_evaluation_mode(MILTER_MANAGER_CHILD(context)))
+        return TRUE;
+
+    option = milter_server_context_get_option(context);
+    if (!option)
+        return FALSE;
+
+    /* a child that may change headers, body or envelope-from must see
+     * the message modified by the previous children. */
+    action = milter_option_get_action(option);
+    return !(action & (MILTER_ACTION_ADD_HEADERS |
+                       MILTER_ACTION_CHANGE_HEADERS |
+                       MILTER_ACTION_CHANGE_BODY |
+                       MILTER_ACTION_CHANGE_ENVELOPE_FROM));
+}
+
+static void
+flush_deferred_reply (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (priv->parallel_reply_waiting_children)
+        return;
+
+    if (priv->deferred_reply_for_message_oriented_command) {
+        milter_debug("[%u] [children][parallel][flush][message-oriented]",
+                     priv->tag);
+        priv->deferred_reply_for_message_oriented_command = FALSE;
+        emit_reply_for_message_oriented_command(children, priv->state);
+    } else if (priv->deferred_reply_status != MILTER_STATUS_DEFAULT) {
+        MilterStatus status;
+
+        status = priv->deferred_reply_status;
+        priv->deferred_reply_status = MILTER_STATUS_DEFAULT;
+        milter_debug("[%u] [children][parallel][flush] <%s>",
+                     priv->tag, status_to_signal_name(status));
+        g_signal_emit_by_name(children, status_to_signal_name(status));
+    }
+}
+
+static gboolean
+defer_reply (MilterManagerChildren *children, MilterStatus status)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->parallel_reply_waiting_children)
+        return FALSE;
+
+    switch (priv->state) {
+    case MILTER_SERVER_CONTEXT_STATE_HEADER:
+    case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
+    case MILTER_SERVER_CONTEXT_STATE_BODY:
+        break;
+    default:
+        return FALSE;
+        break;
+    }
+
+    milter_debug("[%u] [children][parallel][defer] <%s>: waiting %u child(ren)",
+                 priv->tag,
+                 status_to_signal_name(status),
+                 g_list_length(priv->parallel_reply_waiting_children));
+    priv->deferred_reply_status = status;
+    return TRUE;
+}
+
+static gboolean
+defer_reply_for_message_oriented_command (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->parallel_reply_waiting_children)
+        return FALSE;
+
+    milter_debug("[%u] [children][parallel][defer][message-oriented]: "
+                 "waiting %u child(ren)",
+                 priv->tag,
+                 g_list_length(priv->parallel_reply_waiting_children));
+    priv->deferred_reply_for_message_oriented_command = TRUE;
+    return TRUE;
+}
+
+static void
+wait_parallel_child_reply (MilterManagerChildren *children,
+                           MilterServerContext *context,
+                           MilterServerContextState state)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    if (!milter_server_context_need_reply(context, state))
+        return;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    priv->parallel_reply_waiting_children =
+        g_list_append(priv->parallel_reply_waiting_children, context);
+}
+
+static void
+receive_parallel_child_reply (MilterManagerChildren *children,
+                              MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+    GList *node;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    node = g_list_find(priv->parallel_reply_waiting_children, context);
+    if (!node)
+        return;
+
+    priv->parallel_reply_waiting_children =
+        g_list_delete_link(priv->parallel_reply_waiting_children, node);
+    flush_deferred_reply(children);
+}
+
+static void
+remove_parallel_child (MilterManagerChildren *children,
+                       MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!is_parallel_child(children, context))
+        return;
+
+    milter_debug("[%u] [children][parallel][remove] [%u] %s",
+                 priv->tag,
+                 milter_agent_get_tag(MILTER_AGENT(context)),
+                 milter_server_context_get_name(context));
+    priv->parallel_children = g_list_remove(priv->parallel_children, context);
+    receive_parallel_child_reply(children, context);
+}
+
 static MilterCommand
 fetch_first_command_for_child_in_queue (MilterServerContext *child,
                                         GList **queue)
@@ -1355,7 +1726,8 @@ send_first_command_to_next_child (MilterManagerChildren *children,
 
     next_child = get_first_child_in_command_waiting_child_queue(children);
     if (!next_child) {
-        emit_reply_for_message_oriented_command(children, priv->state);
+        if (!defer_reply_for_message_oriented_command(children))
+            emit_reply_for_message_oriented_command(children, priv->state);
         return MILTER_STATUS_PROGRESS;
     }
 
@@ -1376,6 +1748,9 @@ handle_status (MilterManagerChildren *children,
     if (status == MILTER_STATUS_PROGRESS)
         return;
 
+    if (defer_reply(children, status))
+        return;
+
     g_signal_emit_by_name(children, status_to_signal_name(status));
 }
 
@@ -1392,6 +1767,11 @@ cb_continue (MilterServerContext *context, gpointer user_data)
     state = milter_server_context_get_state(context);
     compile_reply_status(children, state, MILTER_STATUS_CONTINUE);
 
+    if (is_parallel_child(children, context)) {
+        receive_parallel_child_reply(children, context);
+        return;
+    }
+
     switch (state) {
     case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
         status = send_next_command(children, context, state);
@@ -1625,7 +2005,10 @@ cb_accept (MilterServerContext *context, gpointer user_data)
     case MILTER_SERVER_CONTEXT_STATE_BODY:
     case MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE:
         milter_server_context_set_processing_message(context, FALSE);
-        send_first_command_to_next_child(children, context);
+        if (is_parallel_child(children, context))
+            remove_parallel_child(children, context);
+        else
+            send_first_command_to_next_child(children, context);
         break;
     default:
         if (milter_need_error_log()) {
@@ -1721,9 +2104,14 @@ cb_skip (MilterServerContext *context, gpointer user_data)
 
     compile_reply_status(children, state, MILTER_STATUS_SKIP);
 
+    if (is_parallel_child(children, context)) {
+        receive_parallel_child_reply(children, context);
+        return;
+    }
+
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
     if (priv->state < MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE) {
-        g_signal_emit_by_name(children, "continue");
+        handle_status(children, MILTER_STATUS_CONTINUE);
     } else {
         send_next_command(children, context, state);
     }
@@ -2151,6 +2539,16 @@ cb_shutdown (MilterServerContext *context, gpointer user_data)
     g_signal_emit_by_name(children, "shutdown");
 }
 
+static void
+cb_stage_replied (MilterServerContext *context,
+                  MilterServerContextState state,
+                  gdouble elapsed,
+                  gpointer user_data)
+{
+    milter_manager_metrics_record_child_stage(
+        milter_server_context_get_name(context), state, elapsed);
+}
+
 static void
 cb_stopped (MilterServerContext *context, gpointer user_data)
 {
@@ -2183,7 +2581,10 @@ cb_stopped (MilterServerContext *context, gpointer user_data)
     case MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE:
         compile_reply_status(children, state, MILTER_STATUS_ACCEPT);
         milter_server_context_abort(context);
-        send_first_command_to_next_child(children, context);
+        if (is_parallel_child(children, context))
+            remove_parallel_child(children, context);
+        else
+            send_first_command_to_next_child(children, context);
         break;
     default:
         if (milter_need_error_log()) {
@@ -2215,6 +2616,7 @@ cb_writing_timeout (MilterServerContext *context, gpointer user_data)
     MilterManagerChild *child;
     MilterServerContextState state;
     MilterStatus fallback_status;
+    gboolean parallel;
 
     children = MILTER_MANAGER_CHILDREN(user_data);
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
@@ -2243,8 +2645,10 @@ cb_writing_timeout (MilterServerContext *context, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    parallel = is_parallel_child(children, context);
     expire_child(children, context);
-    remove_child_from_queue(children, context);
+    if (!parallel)
+        remove_child_from_queue(children, context);
 }
 
 static void
@@ -2255,6 +2659,7 @@ cb_reading_timeout (MilterServerContext *context, gpointer user_data)
     MilterManagerChild *child;
     MilterServerContextState state;
     MilterStatus fallback_status;
+    gboolean parallel;
 
     children = MILTER_MANAGER_CHILDREN(user_data);
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
@@ -2283,8 +2688,10 @@ cb_reading_timeout (MilterServerContext *context, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    parallel = is_parallel_child(children, context);
     expire_child(children, context);
-    remove_child_from_queue(children, context);
+    if (!parallel)
+        remove_child_from_queue(children, context);
 }
 
 static void
@@ -2295,6 +2702,7 @@ cb_end_of_message_timeout (MilterServerContext *context, gpointer user_data)
     MilterManagerChild *child;
     MilterServerContextState state;
     MilterStatus fallback_status;
+    gboolean parallel;
 
     children = MILTER_MANAGER_CHILDREN(user_data);
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
@@ -2324,8 +2732,10 @@ cb_end_of_message_timeout (MilterServerContext *context, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    parallel = is_parallel_child(children, context);
     expire_child(children, context);
-    remove_child_from_queue(children, context);
+    if (!parallel)
+        remove_child_from_queue(children, context);
 }
 
 static void
@@ -2337,6 +2747,7 @@ cb_error (MilterErrorEmittable *emittable, GError *error, gpointer user_data)
     MilterManagerChild *child;
     MilterServerContextState state;
     MilterStatus fallback_status;
+    gboolean parallel;
 
     context = MILTER_SERVER_CONTEXT(emittable);
     children = MILTER_MANAGER_CHILDREN(user_data);
@@ -2367,8 +2778,10 @@ cb_error (MilterErrorEmittable *emittable, GError *error, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    parallel = is_parallel_child(children, context);
     expire_child(children, context);
-    remove_child_from_queue(children, context);
+    if (!parallel)
+        remove_child_from_queue(children, context);
 }
 
 static void
@@ -2377,6 +2790,7 @@ cb_finished (MilterAgent *agent, gpointer user_data)
     MilterManagerChildren *children;
     MilterManagerChildrenPrivate *priv;
     MilterServerContext *context = MILTER_SERVER_CONTEXT(agent);
+    gboolean parallel;
 
     children = MILTER_MANAGER_CHILDREN(user_data);
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
@@ -2393,6 +2807,7 @@ cb_finished (MilterAgent *agent, gpointer user_data)
         compile_reply_status(children, state, fallback_status);
     }
 
+    parallel = is_parallel_child(children, context);
     expire_child(children, context);
 
     if (milter_need_debug_log()) {
@@ -2418,6 +2833,8 @@ cb_finished (MilterAgent *agent, gpointer user_data)
     case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
     case MILTER_SERVER_CONTEXT_STATE_BODY:
     case MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE:
+        if (parallel)
+            break;
         if (!priv->emitted_reply_for_message_oriented_command &&
             milter_server_context_is_processing(context)) {
             milter_debug("[%u] [children][unexpected] [%u] "
@@ -2463,6 +2880,7 @@ setup_server_context_signals (MilterManagerChildren *children,
     CONNECT(shutdown);
     CONNECT(skip);
 
+    CONNECT(stage_replied);
     CONNECT(stopped);
 
     CONNECT(writing_timeout);
@@ -2504,6 +2922,7 @@ teardown_server_context_signals (MilterManagerChild *child,
     DISCONNECT(shutdown);
     DISCONNECT(skip);
 
+    DISCONNECT(stage_replied);
     DISCONNECT(stopped);
 
     DISCONNECT(writing_timeout);
@@ -2920,6 +3339,120 @@ prepare_negotiate (MilterManagerChild *child,
     g_hash_table_insert(priv->try_negotiate_ids, negotiate_data, NULL);
 }
 
+static gboolean
+child_reuse_connection (MilterManagerChild *child,
+                        MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterServerContext *context;
+    const gchar *spec;
+    GIOChannel *channel;
+    MilterOption *option = NULL;
+    MilterMacrosRequests *macros_requests = NULL;
+    GError *error = NULL;
+    gboolean success;
+
+    context = MILTER_SERVER_CONTEXT(child);
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+
+    if (!milter_manager_child_is_reuse_connection(child))
+        return FALSE;
+
+    spec = milter_server_context_get_connection_spec(context);
+    if (!spec || !priv->requested_option)
+        return FALSE;
+
+    channel = milter_manager_connection_pool_checkout(spec,
+                                                      priv->requested_option,
+                                                      &option,
+                                                      &macros_requests);
+    if (!channel)
+        return FALSE;
+
+    success = milter_server_context_reuse_connection(context,
+                                                     channel,
+                                                     option,
+                                                     macros_requests,
+                                                     &error);
+    g_io_channel_unref(channel);
+    if (success) {
+        milter_debug("[%u] [children][milter][reuse] [%u] %s",
+                     priv->tag,
+                     milter_agent_get_tag(MILTER_AGENT(context)),
+                     milter_server_context_get_name(context));
+
+        setup_server_context_signals(children, context);
+        if (macros_requests)
+            milter_macros_requests_merge(priv->macros_requests,
+                                         macros_requests);
+        milter_option_merge(priv->option, option);
+        priv->requested_yes_steps |= milter_option_get_step_yes(option);
+        priv->negotiated = TRUE;
+        /* milter_manager_children_negotiate() replies when all
+         * children reuse their connections. */
+        g_queue_remove(priv->reply_queue, child);
+    } else {
+        milter_error("[%u] [children][error][reuse] [%u] %s: %s",
+                     priv->tag,
+                     milter_agent_get_tag(MILTER_AGENT(context)),
+                     milter_server_context_get_name(context),
+                     error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(option);
+    if (macros_requests)
+        g_object_unref(macros_requests);
+
+    return success;
+}
+
+static gboolean
+child_park_connection (MilterManagerChild *child,
+                       MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterServerContext *context;
+    const gchar *spec;
+    MilterOption *option;
+    MilterMacrosRequests *macros_requests;
+    GIOChannel *channel;
+
+    context = MILTER_SERVER_CONTEXT(child);
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+
+    if (!milter_manager_child_is_reuse_connection(child))
+        return FALSE;
+
+    spec = milter_server_context_get_connection_spec(context);
+    option = milter_server_context_get_option(context);
+    if (!spec || !option || !priv->requested_option)
+        return FALSE;
+
+    /* The child is expired while the connection is detached. */
+    option = milter_option_copy(option);
+    macros_requests =
+        milter_protocol_agent_get_macros_requests(MILTER_PROTOCOL_AGENT(context));
+    if (macros_requests)
+        g_object_ref(macros_requests);
+
+    channel = milter_server_context_quit_new_connection(context);
+    if (channel) {
+        milter_manager_connection_pool_park(spec,
+                                            priv->requested_option,
+                                            channel,
+                                            option,
+                                            macros_requests);
+        g_io_channel_unref(channel);
+    }
+
+    g_object_unref(option);
+    if (macros_requests)
+        g_object_unref(macros_requests);
+
+    return channel != NULL;
+}
+
 static gboolean
 child_establish_connection (MilterManagerChild *child,
                             MilterOption *option,
@@ -2933,6 +3466,9 @@ child_establish_connection (MilterManagerChild *child,
     context = MILTER_SERVER_CONTEXT(child);
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    if (!is_retry && child_reuse_connection(child, children))
+        return TRUE;
+
     if (!milter_server_context_establish_connection(context, &error)) {
         milter_error("[%u] [children][error][connection] [%u] %s: %s",
                      priv->tag,
@@ -3012,7 +3548,7 @@ init_command_waiting_child_queue (MilterManagerChildren *children, MilterCommand
         priv->command_queue = g_list_append(priv->command_queue,
                                             GINT_TO_POINTER(command));
 
-    if (priv->command_waiting_child_queue)
+    if (priv->command_waiting_child_queue || priv->parallel_children)
         return;
 
     for (node = priv->milters; node; node = g_list_next(node)) {
@@ -3020,11 +3556,18 @@ init_command_waiting_child_queue (MilterManagerChildren *children, MilterCommand
 
         context = MILTER_SERVER_CONTEXT(node->data);
         if (milter_server_context_is_processing_message(context)) {
-            if (milter_server_context_has_accepted_recipient(context)) {
+            if (!milter_server_context_has_accepted_recipient(context)) {
+                milter_server_context_abort(context);
+            } else if (can_process_message_in_parallel(children, context)) {
+                milter_debug("[%u] [children][parallel][add] [%u] %s",
+                             priv->tag,
+                             milter_agent_get_tag(MILTER_AGENT(context)),
+                             milter_server_context_get_name(context));
+                priv->parallel_children =
+                    g_list_append(priv->parallel_children, context);
+            } else {
                 priv->command_waiting_child_queue =
                     g_list_append(priv->command_waiting_child_queue, context);
-            } else {
-                milter_server_context_abort(context);
             }
         }
     }
@@ -3110,6 +3653,10 @@ milter_manager_children_negotiate (MilterManagerChildren *children,
 
     if (priv->option)
         g_object_unref(priv->option);
+    if (priv->requested_option) {
+        g_object_unref(priv->requested_option);
+        priv->requested_option = NULL;
+    }
     priv->option = option;
     if (priv->option) {
         g_object_ref(priv->option);
@@ -3119,6 +3666,7 @@ milter_manager_children_negotiate (MilterManagerChildren *children,
                                       MAX_SUPPORTED_MILTER_PROTOCOL_VERSION);
         }
         priv->initial_yes_steps = milter_option_get_step_yes(priv->option);
+        priv->requested_option = milter_option_copy(priv->option);
     }
 
     if (!priv->milters) {
@@ -3156,6 +3704,17 @@ milter_manager_children_negotiate (MilterManagerChildren *children,
     }
     g_list_free(copied_milters);
 
+    if (g_queue_is_empty(priv->reply_queue)) {
+        /* All children reuse negotiated connections. */
+        dispose_lazy_reply_negotiate_id(priv);
+        priv->lazy_reply_negotiate_id =
+            milter_event_loop_add_idle_full(priv->event_loop,
+                                            G_PRIORITY_DEFAULT,
+                                            cb_idle_reply_negotiate_on_no_child,
+                                            children,
+                                            NULL);
+    }
+
     return success;
 }
 
@@ -3202,7 +3761,7 @@ milter_manager_children_define_macro (MilterManagerChildren *children,
         default:
             break;
         }
-        milter_protocol_agent_set_macros_hash_table(agent, command, macros);
+        milter_protocol_agent_share_macros_hash_table(agent, command, macros);
     }
     return TRUE;
 }
@@ -3563,6 +4122,7 @@ send_next_header_to_child (MilterManagerChildren *children, MilterServerContext
     MilterManagerChildrenPrivate *priv;
     MilterHeader *header;
     gint value_offset = 0;
+    GString *packet;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
     priv->processing_state = MILTER_SERVER_CONTEXT_STATE_HEADER;
@@ -3578,9 +4138,15 @@ send_next_header_to_child (MilterManagerChildren *children, MilterServerContext
             value_offset = 1;
     }
 
-    if (milter_server_context_header(context,
-                                     header->name,
-                                     header->value + value_offset)) {
+    packet = get_header_packet(children,
+                               priv->processing_header_index,
+                               header->name,
+                               header->value + value_offset);
+    if (milter_server_context_header_with_packet(context,
+                                                 header->name,
+                                                 header->value + value_offset,
+                                                 packet->str,
+                                                 packet->len)) {
         MilterStatus status = MILTER_STATUS_PROGRESS;
         if (!milter_server_context_need_reply(context, priv->processing_state)) {
             g_signal_emit_by_name(context, "continue");
@@ -3601,6 +4167,131 @@ need_data_commmand_emulation (MilterManagerChildrenPrivate *priv)
             milter_option_get_version(priv->option) >= 4);
 }
 
+static gboolean
+send_command_to_parallel_child (MilterManagerChildren *children,
+                                MilterServerContext *context,
+                                MilterCommand command,
+                                const gchar *name,
+                                const gchar *value,
+                                const gchar *chunk,
+                                gsize size,
+                                const gchar *body_packet,
+                                gsize body_packet_size)
+{
+    MilterManagerChildrenPrivate *priv;
+    gint value_offset = 0;
+    GString *packet;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+
+    switch (command) {
+    case MILTER_COMMAND_HEADER:
+        if (need_header_value_leading_space_conversion(children, context)) {
+            if (value && value[0] == ' ')
+                value_offset = 1;
+        }
+        packet = get_header_packet(children,
+                                   milter_headers_length(priv->headers),
+                                   name, value + value_offset);
+        return milter_server_context_header_with_packet(context,
+                                                        name,
+                                                        value + value_offset,
+                                                        packet->str,
+                                                        packet->len);
+        break;
+    case MILTER_COMMAND_END_OF_HEADER:
+        packet = get_end_of_header_packet(children);
+        return milter_server_context_end_of_header_with_packet(context,
+                                                               packet->str,
+                                                               packet->len);
+        break;
+    case MILTER_COMMAND_BODY:
+        return milter_server_context_body_with_packet(context, chunk, size,
+                                                      body_packet,
+                                                      body_packet_size);
+        break;
+    case MILTER_COMMAND_END_OF_MESSAGE:
+        packet = priv->end_of_message_packet;
+        return milter_server_context_end_of_message_with_packet(
+            context, chunk, size,
+            packet ? packet->str : NULL,
+            packet ? packet->len : 0);
+        break;
+    default:
+        break;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+send_command_to_parallel_children (MilterManagerChildren *children,
+                                   MilterCommand command,
+                                   const gchar *name,
+                                   const gchar *value,
+                                   const gchar *chunk,
+                                   gsize size,
+                                   const gchar *body_packet,
+                                   gsize body_packet_size)
+{
+    MilterManagerChildrenPrivate *priv;
+    GList *node, *targets;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->parallel_children)
+        return FALSE;
+
+    targets = g_list_copy(priv->parallel_children);
+    for (node = targets; node; node = g_list_next(node)) {
+        MilterServerContext *context = MILTER_SERVER_CONTEXT(node->data);
+
+        /* the child may be removed by a reply of the previous child. */
+        if (!is_parallel_child(children, context))
+            continue;
+
+        if (command == MILTER_COMMAND_BODY &&
+            milter_server_context_get_skip_body(context))
+            continue;
+
+        /* register before sending because the child may reply
+         * synchronously. */
+        wait_parallel_child_reply(children, context, priv->state);
+        if (!send_command_to_parallel_child(children, context, command,
+                                            name, value, chunk, size,
+                                            body_packet, body_packet_size)) {
+            MilterManagerChild *child;
+
+            child = MILTER_MANAGER_CHILD(context);
+            compile_reply_status(children,
+                                 milter_server_context_get_state(context),
+                                 milter_manager_child_get_fallback_status(child));
+            remove_parallel_child(children, context);
+        }
+    }
+    milter_debug("[%u] [children][parallel][sent] <%c> %d",
+                 priv->tag, command, g_list_length(targets));
+    g_list_free(targets);
+
+    return TRUE;
+}
+
+static gboolean
+reply_without_serial_children (MilterManagerChildren *children,
+                               MilterCommand command)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (command == MILTER_COMMAND_END_OF_MESSAGE) {
+        if (!defer_reply_for_message_oriented_command(children))
+            emit_reply_for_message_oriented_command(children, priv->state);
+    } else {
+        handle_status(children, MILTER_STATUS_CONTINUE);
+    }
+
+    return TRUE;
+}
+
 gboolean
 milter_manager_children_header (MilterManagerChildren *children,
                                 const gchar           *name,
@@ -3636,6 +4327,11 @@ milter_manager_children_header (MilterManagerChildren *children,
     milter_headers_append_header(priv->headers, name, value);
     init_command_waiting_child_queue(children, MILTER_COMMAND_HEADER);
 
+    if (send_command_to_parallel_children(children, MILTER_COMMAND_HEADER,
+                                          name, value, NULL, 0, NULL, 0) &&
+        !get_first_child_in_command_waiting_child_queue(children))
+        return reply_without_serial_children(children, MILTER_COMMAND_HEADER);
+
     return MILTER_STATUS_PROGRESS ==
         send_command_to_first_waiting_child(children, MILTER_COMMAND_HEADER);
 }
@@ -3670,6 +4366,13 @@ milter_manager_children_end_of_header (MilterManagerChildren *children)
     priv->processing_state = priv->state;
     init_command_waiting_child_queue(children, MILTER_COMMAND_END_OF_HEADER);
 
+    if (send_command_to_parallel_children(children,
+                                          MILTER_COMMAND_END_OF_HEADER,
+                                          NULL, NULL, NULL, 0, NULL, 0) &&
+        !get_first_child_in_command_waiting_child_queue(children))
+        return reply_without_serial_children(children,
+                                             MILTER_COMMAND_END_OF_HEADER);
+
     return MILTER_STATUS_PROGRESS ==
         send_command_to_first_waiting_child(children,
                                             MILTER_COMMAND_END_OF_HEADER);
@@ -3679,12 +4382,13 @@ static gboolean
 open_body_file (MilterManagerChildren *children)
 {
     gint fd;
+    gchar *body_file_name = NULL;
     GError *error = NULL;
     MilterManagerChildrenPrivate *priv;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
-    fd = g_file_open_tmp(NULL, &priv->body_file_name, &error);
+    fd = g_file_open_tmp(NULL, &body_file_name, &error);
     if (error) {
         milter_error("[%u] [children][error][body][open] %s",
                      priv->tag, error->message);
@@ -3693,18 +4397,13 @@ open_body_file (MilterManagerChildren *children)
         g_error_free(error);
         return FALSE;
     }
-    priv->body_file = g_io_channel_unix_new(fd);
-    g_io_channel_set_close_on_unref(priv->body_file, TRUE);
+    /* The file is removed automatically when it is closed. */
+    g_unlink(body_file_name);
+    g_free(body_file_name);
 
-    g_io_channel_set_encoding(priv->body_file, NULL, &error);
-    if (error) {
-        milter_error("[%u] [children][error][body][encoding] %s",
-                     priv->tag, error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children),
-                                    error);
-        g_error_free(error);
-        return FALSE;
-    }
+    priv->body_fd = fd;
+    priv->body_file_size = 0;
+    milter_manager_metrics_record_body_spill();
 
     return TRUE;
 }
@@ -3714,30 +4413,30 @@ write_body_to_file (MilterManagerChildren *children,
                     const gchar *chunk,
                     gsize size)
 {
-    GError *error = NULL;
-    gsize written_size;
     MilterManagerChildrenPrivate *priv;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
-    if (!priv->body_file && !open_body_file(children))
+    if (priv->body_fd < 0 && !open_body_file(children))
         return FALSE;
 
-    if (!priv->body_file)
-        return TRUE;
-
     if (!chunk || size == 0)
         return TRUE;
 
-    g_io_channel_write_chars(priv->body_file, chunk, size, &written_size, &error);
-    if (error) {
-        milter_error("[%u] [children][error][body][write] %s",
-                     priv->tag,
-                     error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children),
-                                    error);
-        g_error_free(error);
-        return FALSE;
+    unmap_body_file(priv);
+    while (size > 0) {
+        gssize written_size;
+
+        written_size = write(priv->body_fd, chunk, size);
+        if (written_size < 0) {
+            if (errno == EINTR)
+                continue;
+            emit_body_file_error(children, "write", errno);
+            return FALSE;
+        }
+        chunk += written_size;
+        size -= written_size;
+        priv->body_file_size += written_size;
     }
 
     return TRUE;
@@ -3749,6 +4448,7 @@ write_body_to_string (MilterManagerChildren *children,
                       gsize size)
 {
     MilterManagerChildrenPrivate *priv;
+    guint max_on_memory_body_size;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
@@ -3757,7 +4457,10 @@ write_body_to_string (MilterManagerChildren *children,
     else
         g_string_append_len(priv->body, chunk, size);
 
-    if (priv->body->len > MAX_ON_MEMORY_BODY_SIZE) {
+    max_on_memory_body_size =
+        milter_manager_configuration_get_max_on_memory_body_size(
+            priv->configuration);
+    if (priv->body->len > max_on_memory_body_size) {
         gboolean success;
 
         success = write_body_to_file(children, priv->body->str, priv->body->len);
@@ -3778,7 +4481,7 @@ write_body (MilterManagerChildren *children,
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
-    if (priv->body_file)
+    if (priv->body_fd >= 0)
         return write_body_to_file(children, chunk, size);
     else
         return write_body_to_string(children, chunk, size);
@@ -3792,6 +4495,8 @@ milter_manager_children_body (MilterManagerChildren *children,
     MilterManagerChildrenPrivate *priv;
     MilterServerContext *first_child;
     MilterServerContextState state = MILTER_SERVER_CONTEXT_STATE_BODY;
+    const gchar *packet = NULL;
+    gsize packet_size = 0;
 
     if (!milter_manager_children_check_processing_message(children))
         return FALSE;
@@ -3821,10 +4526,12 @@ milter_manager_children_body (MilterManagerChildren *children,
     init_command_waiting_child_queue(children, MILTER_COMMAND_BODY);
 
     first_child = get_first_child_in_command_waiting_child_queue(children);
-    if (!first_child)
+    if (!first_child && !priv->parallel_children)
         return FALSE;
 
-    if (!write_body(children, chunk, size))
+    /* the body is stored only for replaying to the following serial
+     * children. */
+    if (first_child && !write_body(children, chunk, size))
         return FALSE;
 
     priv->state = state;
@@ -3832,6 +4539,20 @@ milter_manager_children_body (MilterManagerChildren *children,
     priv->replaced_body_for_each_child = FALSE;
     priv->sending_body = FALSE;
 
+    if (size <= MILTER_CHUNK_SIZE)
+        milter_command_encoder_encode_body(
+            MILTER_COMMAND_ENCODER(priv->encoder),
+            &packet, &packet_size, chunk, size, NULL);
+
+    if (send_command_to_parallel_children(children, MILTER_COMMAND_BODY,
+                                          NULL, NULL, chunk, size,
+                                          packet, packet_size)) {
+        first_child = get_first_child_in_command_waiting_child_queue(children);
+        if (!first_child)
+            return reply_without_serial_children(children,
+                                                 MILTER_COMMAND_BODY);
+    }
+
     if (milter_server_context_get_skip_body(first_child)) {
         /*
          * If the first child is not needed the command,
@@ -3841,51 +4562,11 @@ milter_manager_children_body (MilterManagerChildren *children,
         g_signal_emit_by_name(first_child, "continue");
         return TRUE;
     } else {
-        return milter_server_context_body(first_child, chunk, size);
-    }
-
-}
-
-static MilterStatus
-init_child_for_body_string (MilterManagerChildren *children,
-                            MilterServerContext *context)
-{
-    MilterManagerChildrenPrivate *priv;
-
-    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
-    priv->sent_body_offset = 0;
-
-    return MILTER_STATUS_NOT_CHANGE;
-}
-
-static MilterStatus
-init_child_for_body_file (MilterManagerChildren *children,
-                          MilterServerContext *context)
-{
-    MilterManagerChildrenPrivate *priv;
-    GError *error = NULL;
-
-    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
-    if (!priv->body_file)
-        return MILTER_STATUS_NOT_CHANGE;
-
-    g_io_channel_seek_position(priv->body_file, 0, G_SEEK_SET, &error);
-    if (error) {
-        MilterManagerChild *child;
-
-        milter_error("[%u] [children][error][body][send][seek] [%u] %s: %s",
-                     priv->tag,
-                     milter_agent_get_tag(MILTER_AGENT(context)),
-                     error->message,
-                     milter_server_context_get_name(context));
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children), error);
-        g_error_free(error);
-
-        child = MILTER_MANAGER_CHILD(context);
-        return milter_manager_child_get_fallback_status(child);
+        return milter_server_context_body_with_packet(first_child,
+                                                      chunk, size,
+                                                      packet, packet_size);
     }
 
-    return MILTER_STATUS_NOT_CHANGE;
 }
 
 static MilterStatus
@@ -3905,96 +4586,39 @@ init_child_for_body (MilterManagerChildren *children,
 
     priv->replaced_body_for_each_child = FALSE;
     priv->sending_body = TRUE;
-    if (priv->body)
-        return init_child_for_body_string(children, context);
-    else
-        return init_child_for_body_file(children, context);
+    priv->sent_body_offset = 0;
+
+    return MILTER_STATUS_NOT_CHANGE;
 }
 
 static MilterStatus
-send_body_to_child_file (MilterManagerChildren *children,
-                         MilterServerContext *context)
+send_body_chunk_to_child (MilterManagerChildren *children,
+                          MilterServerContext *context)
 {
     MilterStatus status = MILTER_STATUS_PROGRESS;
-    GError *error = NULL;
-    GIOStatus io_status = G_IO_STATUS_NORMAL;
     MilterManagerChildrenPrivate *priv;
-    gchar buffer[MILTER_CHUNK_SIZE + 1];
-    gsize read_size, chunk_size;
     MilterManagerChild *child;
+    const gchar *body;
+    gsize body_size, chunk_size, write_size;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
-    if (!priv->body_file)
-        return MILTER_STATUS_NOT_CHANGE;
-
-    chunk_size =
-        milter_manager_configuration_get_chunk_size(priv->configuration);
-    io_status = g_io_channel_read_chars(priv->body_file,
-                                        buffer, chunk_size,
-                                        &read_size, &error);
-
     child = MILTER_MANAGER_CHILD(context);
-    switch (io_status) {
-    case G_IO_STATUS_ERROR:
-        status = milter_manager_child_get_fallback_status(child);
-        break;
-    case G_IO_STATUS_NORMAL:
-        if (milter_server_context_body(context, buffer, read_size)) {
-            status = MILTER_STATUS_PROGRESS;
-        } else {
-            status = milter_manager_child_get_fallback_status(child);
-        }
-        break;
-    case G_IO_STATUS_EOF:
-        status = MILTER_STATUS_NOT_CHANGE;
-        break;
-    case G_IO_STATUS_AGAIN:
-        status = MILTER_STATUS_PROGRESS;
-        break;
-    default:
-        status = milter_manager_child_get_fallback_status(child);
-        break;
-    }
-
-    if (error) {
-        milter_error("[%u] [children][error][body][send] [%u] %s: %s",
-                     priv->tag,
-                     milter_agent_get_tag(MILTER_AGENT(context)),
-                     error->message,
-                     milter_server_context_get_name(context));
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children), error);
-        g_error_free(error);
-
-        status = milter_manager_child_get_fallback_status(child);
-    }
-
-    return status;
-}
 
-static MilterStatus
-send_body_to_child_string (MilterManagerChildren *children,
-                           MilterServerContext *context)
-{
-    MilterStatus status = MILTER_STATUS_PROGRESS;
-    MilterManagerChildrenPrivate *priv;
-    gsize chunk_size, write_size;
+    if (!get_body(children, &body, &body_size))
+        return milter_manager_child_get_fallback_status(child);
 
-    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
-    if (priv->sent_body_offset >= priv->body->len)
+    if (priv->sent_body_offset >= body_size)
         return MILTER_STATUS_NOT_CHANGE;
 
     chunk_size =
         milter_manager_configuration_get_chunk_size(priv->configuration);
-    write_size = MIN(priv->body->len - priv->sent_body_offset, chunk_size);
+    write_size = MIN(body_size - priv->sent_body_offset, chunk_size);
     if (milter_server_context_body(context,
-                                   priv->body->str + priv->sent_body_offset,
+                                   body + priv->sent_body_offset,
                                    write_size)) {
         priv->sent_body_offset += write_size;
         init_command_waiting_child_queue(children, MILTER_COMMAND_BODY);
     } else {
-        MilterManagerChild *child;
-
-        child = MILTER_MANAGER_CHILD(context);
         status = milter_manager_child_get_fallback_status(child);
     }
 
@@ -4015,10 +4639,7 @@ send_body_to_child (MilterManagerChildren *children, MilterServerContext *contex
         return MILTER_STATUS_NOT_CHANGE;
     }
 
-    if (priv->body)
-        status = send_body_to_child_string(children, context);
-    else
-        status = send_body_to_child_file(children, context);
+    status = send_body_chunk_to_child(children, context);
 
     if (status == MILTER_STATUS_PROGRESS &&
         !milter_server_context_need_reply(context, priv->processing_state)) {
@@ -4037,6 +4658,8 @@ milter_manager_children_end_of_message (MilterManagerChildren *children,
                                         gsize                  size)
 {
     MilterManagerChildrenPrivate *priv;
+    const gchar *packet;
+    gsize packet_size;
 
     if (!milter_manager_children_check_processing_message(children))
         return FALSE;
@@ -4072,11 +4695,25 @@ milter_manager_children_end_of_message (MilterManagerChildren *children,
         g_free(priv->end_of_message_chunk);
     priv->end_of_message_chunk = g_strdup(chunk);
     priv->end_of_message_size = size;
-    if (priv->body_file)
-        g_io_channel_seek_position(priv->body_file, 0, G_SEEK_SET, NULL);
+
+    if (priv->end_of_message_packet)
+        g_string_free(priv->end_of_message_packet, TRUE);
+    milter_command_encoder_encode_end_of_message(
+        MILTER_COMMAND_ENCODER(priv->encoder),
+        &packet, &packet_size, chunk, size);
+    priv->end_of_message_packet = g_string_new_len(packet, packet_size);
 
     priv->state = MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE;
     priv->processing_state = priv->state;
+
+    if (send_command_to_parallel_children(children,
+                                          MILTER_COMMAND_END_OF_MESSAGE,
+                                          NULL, NULL, chunk, size,
+                                          NULL, 0) &&
+        !get_first_child_in_command_waiting_child_queue(children))
+        return reply_without_serial_children(children,
+                                             MILTER_COMMAND_END_OF_MESSAGE);
+
     return MILTER_STATUS_PROGRESS ==
         send_command_to_first_waiting_child(children,
                                             MILTER_COMMAND_END_OF_MESSAGE);
@@ -4085,14 +4722,17 @@ milter_manager_children_end_of_message (MilterManagerChildren *children,
 gboolean
 milter_manager_children_quit (MilterManagerChildren *children)
 {
-    GList *child;
+    GList *child, *copied_milters;
     MilterManagerChildrenPrivate *priv;
     gboolean success = TRUE;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
     set_state(children, MILTER_SERVER_CONTEXT_STATE_QUIT);
-    for (child = priv->milters; child; child = g_list_next(child)) {
+    /* Parking a connection finishes the child synchronously. */
+    copied_milters = g_list_copy(priv->milters);
+    g_list_foreach(copied_milters, (GFunc)g_object_ref, NULL);
+    for (child = copied_milters; child; child = g_list_next(child)) {
         MilterServerContext *context;
         MilterServerContextState state;
 
@@ -4105,9 +4745,16 @@ milter_manager_children_quit (MilterManagerChildren *children)
         if (state == MILTER_SERVER_CONTEXT_STATE_QUIT)
             continue;
 
+        if (child_park_connection(MILTER_MANAGER_CHILD(context), children))
+            continue;
+        if (milter_server_context_is_quitted(context))
+            continue;
+
         if (!milter_server_context_quit(context))
             success = FALSE;
     }
+    g_list_foreach(copied_milters, (GFunc)g_object_unref, NULL);
+    g_list_free(copied_milters);
 
     if (!priv->finished)
         milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(children));
@@ -158,6 +158,13 @@ MilterOption          *milter_manager_children_get_option   (MilterManagerChildr
 
 gboolean               milter_manager_children_is_waiting_reply
                                                             (MilterManagerChildren *children);
+guint                  milter_manager_children_get_n_queued_commands
+                                                            (MilterManagerChildren *children);
+gint                   milter_manager_children_get_command_waiting_position
+                                                            (MilterManagerChildren *children,
+                                                             MilterManagerChild    *child);
+gsize                  milter_manager_children_get_body_file_size
+                                                            (MilterManagerChildren *children);
 
 
 #endif /* __MILTER_MANAGER_CHILDREN_H__ */
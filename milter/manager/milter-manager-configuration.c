@@ -36,6 +36,8 @@
 #define DEFAULT_FALLBACK_STATUS_AT_DISCONNECT MILTER_STATUS_TEMPORARY_FAILURE
 #define DEFAULT_MAINTENANCE_INTERVAL 10
 #define DEFAULT_CONNECTION_CHECK_INTERVAL 0
+#define DEFAULT_CONNECTION_CHECK_BATCH_SIZE 30
+#define DEFAULT_MAX_ON_MEMORY_BODY_SIZE 5242880 /* 5Mbyte */
 
 #define MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(obj)                   \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
@@ -74,6 +76,7 @@ struct _MilterManagerConfigurationPrivate
     gchar *custom_configuration_directory;
     GHashTable *locations;
     guint connection_check_interval;
+    guint connection_check_batch_size;
     MilterClientEventLoopBackend event_loop_backend;
     guint n_workers;
     guint default_packet_buffer_size;
@@ -81,8 +84,23 @@ struct _MilterManagerConfigurationPrivate
     gchar *syslog_facility;
     guint chunk_size;
     guint max_pending_finished_sessions;
+    gboolean parallel_message_processing;
+    guint max_on_memory_body_size;
+    gboolean reuse_port;
+    gboolean use_tcp_connection_table;
+    MilterManagerConfigurationSnapshot *snapshot;
+    gboolean snapshot_dirty;
+    gboolean reloading;
 };
 
+struct _MilterManagerConfigurationSnapshot
+{
+    gint ref_count;
+    GList *eggs;
+};
+
+static GMutex snapshot_mutex;
+
 enum
 {
     PROP_0,
@@ -111,6 +129,7 @@ enum
     PROP_MAX_FILE_DESCRIPTORS,
     PROP_CUSTOM_CONFIGURATION_DIRECTORY,
     PROP_CONNECTION_CHECK_INTERVAL,
+    PROP_CONNECTION_CHECK_BATCH_SIZE,
     PROP_EVENT_LOOP_BACKEND,
     PROP_N_WORKERS,
     PROP_DEFAULT_PACKET_BUFFER_SIZE,
@@ -118,7 +137,11 @@ enum
     PROP_USE_SYSLOG,
     PROP_SYSLOG_FACILITY,
     PROP_CHUNK_SIZE,
-    PROP_MAX_PENDING_FINISHED_SESSIONS
+    PROP_MAX_PENDING_FINISHED_SESSIONS,
+    PROP_PARALLEL_MESSAGE_PROCESSING,
+    PROP_MAX_ON_MEMORY_BODY_SIZE,
+    PROP_REUSE_PORT,
+    PROP_USE_TCP_CONNECTION_TABLE
 };
 
 enum
@@ -398,6 +421,18 @@ milter_manager_configuration_class_init (MilterManagerConfigurationClass *klass)
                                     PROP_CONNECTION_CHECK_INTERVAL,
                                     spec);
 
+    spec = g_param_spec_uint("connection-check-batch-size",
+                             "Connection check batch size",
+                             "The max number of leaders to be checked "
+                             "per connection check. 0 means all leaders.",
+                             0,
+                             G_MAXUINT,
+                             DEFAULT_CONNECTION_CHECK_BATCH_SIZE,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
+    g_object_class_install_property(gobject_class,
+                                    PROP_CONNECTION_CHECK_BATCH_SIZE,
+                                    spec);
+
 
     spec = g_param_spec_enum("event-loop-backend",
                              "Event loop backend",
@@ -465,6 +500,45 @@ milter_manager_configuration_class_init (MilterManagerConfigurationClass *klass)
                                     PROP_MAX_PENDING_FINISHED_SESSIONS,
                                     spec);
 
+    spec = g_param_spec_boolean("parallel-message-processing",
+                                "Parallel message processing",
+                                "Whether milter-manager sends message "
+                                "content to child milters that don't modify "
+                                "message concurrently",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_PARALLEL_MESSAGE_PROCESSING,
+                                    spec);
+
+    spec = g_param_spec_uint("max-on-memory-body-size",
+                             "Maximum on memory body size",
+                             "The maximum body size kept on memory. "
+                             "Larger body is stored into a temporary file",
+                             0, G_MAXUINT, DEFAULT_MAX_ON_MEMORY_BODY_SIZE,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_MAX_ON_MEMORY_BODY_SIZE,
+                                    spec);
+
+    spec = g_param_spec_boolean("reuse-port",
+                                "Reuse port",
+                                "Whether each worker listens on its own "
+                                "SO_REUSEPORT socket or not",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_REUSE_PORT, spec);
+
+    spec = g_param_spec_boolean("use-tcp-connection-table",
+                                "Use TCP connection table",
+                                "Whether check connections of leaders "
+                                "by the TCP connection table or not",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_USE_TCP_CONNECTION_TABLE,
+                                    spec);
+
     signals[CONNECTED] =
         g_signal_new("connected",
                      G_TYPE_FROM_CLASS(klass),
@@ -514,11 +588,19 @@ milter_manager_configuration_init (MilterManagerConfiguration *configuration)
                                             g_free,
                                             (GDestroyNotify)g_dataset_destroy);
     priv->connection_check_interval = DEFAULT_CONNECTION_CHECK_INTERVAL;
+    priv->connection_check_batch_size = DEFAULT_CONNECTION_CHECK_BATCH_SIZE;
     priv->n_workers = 0;
     priv->default_packet_buffer_size = 0;
     priv->syslog_facility = NULL;
     priv->chunk_size = MILTER_CHUNK_SIZE;
     priv->max_pending_finished_sessions = 0;
+    priv->parallel_message_processing = FALSE;
+    priv->max_on_memory_body_size = DEFAULT_MAX_ON_MEMORY_BODY_SIZE;
+    priv->reuse_port = FALSE;
+    priv->use_tcp_connection_table = FALSE;
+    priv->snapshot = NULL;
+    priv->snapshot_dirty = TRUE;
+    priv->reloading = FALSE;
 
     config_dir_env = g_getenv("MILTER_MANAGER_CONFIG_DIR");
     if (config_dir_env)
@@ -555,6 +637,13 @@ dispose (GObject *object)
         priv->locations = NULL;
     }
 
+    g_mutex_lock(&snapshot_mutex);
+    if (priv->snapshot) {
+        milter_manager_configuration_snapshot_unref(priv->snapshot);
+        priv->snapshot = NULL;
+    }
+    g_mutex_unlock(&snapshot_mutex);
+
     G_OBJECT_CLASS(milter_manager_configuration_parent_class)->dispose(object);
 }
 
@@ -668,6 +757,10 @@ set_property (GObject      *object,
         milter_manager_configuration_set_connection_check_interval(
             config, g_value_get_uint(value));
         break;
+    case PROP_CONNECTION_CHECK_BATCH_SIZE:
+        milter_manager_configuration_set_connection_check_batch_size(
+            config, g_value_get_uint(value));
+        break;
     case PROP_EVENT_LOOP_BACKEND:
         milter_manager_configuration_set_event_loop_backend(
             config, g_value_get_enum(value));
@@ -696,6 +789,22 @@ set_property (GObject      *object,
         milter_manager_configuration_set_max_pending_finished_sessions(
             config, g_value_get_uint(value));
         break;
+    case PROP_PARALLEL_MESSAGE_PROCESSING:
+        milter_manager_configuration_set_parallel_message_processing(
+            config, g_value_get_boolean(value));
+        break;
+    case PROP_MAX_ON_MEMORY_BODY_SIZE:
+        milter_manager_configuration_set_max_on_memory_body_size(
+            config, g_value_get_uint(value));
+        break;
+    case PROP_REUSE_PORT:
+        milter_manager_configuration_set_reuse_port(
+            config, g_value_get_boolean(value));
+        break;
+    case PROP_USE_TCP_CONNECTION_TABLE:
+        milter_manager_configuration_set_use_tcp_connection_table(
+            config, g_value_get_boolean(value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -787,6 +896,9 @@ get_property (GObject    *object,
     case PROP_CONNECTION_CHECK_INTERVAL:
         g_value_set_uint(value, priv->connection_check_interval);
         break;
+    case PROP_CONNECTION_CHECK_BATCH_SIZE:
+        g_value_set_uint(value, priv->connection_check_batch_size);
+        break;
     case PROP_EVENT_LOOP_BACKEND:
         g_value_set_enum(value, priv->event_loop_backend);
         break;
@@ -811,6 +923,18 @@ get_property (GObject    *object,
     case PROP_MAX_PENDING_FINISHED_SESSIONS:
         g_value_set_uint(value, priv->max_pending_finished_sessions);
         break;
+    case PROP_PARALLEL_MESSAGE_PROCESSING:
+        g_value_set_boolean(value, priv->parallel_message_processing);
+        break;
+    case PROP_MAX_ON_MEMORY_BODY_SIZE:
+        g_value_set_uint(value, priv->max_on_memory_body_size);
+        break;
+    case PROP_REUSE_PORT:
+        g_value_set_boolean(value, priv->reuse_port);
+        break;
+    case PROP_USE_TCP_CONNECTION_TABLE:
+        g_value_set_boolean(value, priv->use_tcp_connection_table);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -1152,16 +1276,82 @@ milter_manager_configuration_load_custom_if_exist (MilterManagerConfiguration *c
     return FALSE;
 }
 
+static MilterManagerConfigurationSnapshot *
+snapshot_new (GList *eggs)
+{
+    MilterManagerConfigurationSnapshot *snapshot;
+    GList *node;
+
+    snapshot = g_new0(MilterManagerConfigurationSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->eggs = NULL;
+    for (node = eggs; node; node = g_list_next(node)) {
+        snapshot->eggs = g_list_prepend(snapshot->eggs,
+                                        g_object_ref(node->data));
+    }
+    snapshot->eggs = g_list_reverse(snapshot->eggs);
+
+    return snapshot;
+}
+
+/* Must be called with snapshot_mutex locked. */
+static void
+publish_snapshot (MilterManagerConfigurationPrivate *priv)
+{
+    if (priv->snapshot)
+        milter_manager_configuration_snapshot_unref(priv->snapshot);
+    priv->snapshot = snapshot_new(priv->eggs);
+    priv->snapshot_dirty = FALSE;
+    milter_debug("[configuration][snapshot][publish] <%u>",
+                 g_list_length(priv->snapshot->eggs));
+}
+
+/* Must be called with snapshot_mutex locked. The egg list
+ * must be changed in the same critical section because
+ * publish_snapshot() walks it from other threads. */
+static void
+mark_snapshot_dirty (MilterManagerConfigurationPrivate *priv)
+{
+    priv->snapshot_dirty = TRUE;
+}
+
+static void
+reload_finish (MilterManagerConfigurationPrivate *priv, gboolean success)
+{
+    g_mutex_lock(&snapshot_mutex);
+    priv->reloading = FALSE;
+    if (success) {
+        publish_snapshot(priv);
+    } else if (priv->snapshot) {
+        /* Keep running with the last complete egg list instead
+         * of a half-built one. */
+        priv->snapshot_dirty = FALSE;
+        milter_info("[configuration][snapshot][keep] <%u>",
+                    g_list_length(priv->snapshot->eggs));
+    }
+    g_mutex_unlock(&snapshot_mutex);
+}
+
 gboolean
 milter_manager_configuration_reload (MilterManagerConfiguration *configuration,
                                      GError **error)
 {
+    MilterManagerConfigurationPrivate *priv;
     GError *local_error = NULL;
 
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+
+    g_mutex_lock(&snapshot_mutex);
+    if (!priv->snapshot)
+        publish_snapshot(priv);
+    priv->reloading = TRUE;
+    g_mutex_unlock(&snapshot_mutex);
+
     if (!milter_manager_configuration_clear(configuration, &local_error)) {
         milter_error("[configuration][load][clear][error] <%s>: %s",
                      CONFIG_FILE_NAME, local_error->message);
         g_propagate_error(error, local_error);
+        reload_finish(priv, FALSE);
         return FALSE;
     }
 
@@ -1170,6 +1360,7 @@ milter_manager_configuration_reload (MilterManagerConfiguration *configuration,
         milter_error("[configuration][load][error] <%s>: %s",
                      CONFIG_FILE_NAME, local_error->message);
         g_propagate_error(error, local_error);
+        reload_finish(priv, FALSE);
         return FALSE;
     }
 
@@ -1178,9 +1369,12 @@ milter_manager_configuration_reload (MilterManagerConfiguration *configuration,
         milter_error("[configuration][load][custom][error] <%s>: %s",
                      CUSTOM_CONFIG_FILE_NAME, local_error->message);
         g_propagate_error(error, local_error);
+        reload_finish(priv, FALSE);
         return FALSE;
     }
 
+    reload_finish(priv, TRUE);
+
     return TRUE;
 }
 
@@ -1650,7 +1844,10 @@ milter_manager_configuration_add_egg (MilterManagerConfiguration *configuration,
     priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
 
     g_object_ref(egg);
+    g_mutex_lock(&snapshot_mutex);
     priv->eggs = g_list_append(priv->eggs, egg);
+    mark_snapshot_dirty(priv);
+    g_mutex_unlock(&snapshot_mutex);
 }
 
 /**
@@ -1708,32 +1905,46 @@ milter_manager_configuration_remove_egg_by_name (MilterManagerConfiguration *con
                                                  const gchar *name)
 {
     MilterManagerConfigurationPrivate *priv;
+    MilterManagerEgg *removed_egg = NULL;
     GList *node;
 
     priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
 
+    g_mutex_lock(&snapshot_mutex);
     for (node = priv->eggs; node; node = g_list_next(node)) {
         MilterManagerEgg *egg = node->data;
 
         if (g_str_equal(name, milter_manager_egg_get_name(egg))) {
             priv->eggs = g_list_delete_link(priv->eggs, node);
-            g_object_unref(egg);
+            removed_egg = egg;
+            mark_snapshot_dirty(priv);
             break;
         }
     }
+    g_mutex_unlock(&snapshot_mutex);
+
+    if (removed_egg)
+        g_object_unref(removed_egg);
 }
 
 void
 milter_manager_configuration_clear_eggs (MilterManagerConfiguration *configuration)
 {
     MilterManagerConfigurationPrivate *priv;
+    GList *eggs;
 
     priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
 
-    if (priv->eggs) {
-        g_list_foreach(priv->eggs, (GFunc)g_object_unref, NULL);
-        g_list_free(priv->eggs);
-        priv->eggs = NULL;
+    g_mutex_lock(&snapshot_mutex);
+    eggs = priv->eggs;
+    priv->eggs = NULL;
+    if (eggs)
+        mark_snapshot_dirty(priv);
+    g_mutex_unlock(&snapshot_mutex);
+
+    if (eggs) {
+        g_list_foreach(eggs, (GFunc)g_object_unref, NULL);
+        g_list_free(eggs);
     }
 }
 
@@ -1742,12 +1953,84 @@ milter_manager_configuration_setup_children (MilterManagerConfiguration *configu
                                              MilterManagerChildren *children,
                                              MilterClientContext *context)
 {
-    GList *node;
+    MilterManagerConfigurationSnapshot *snapshot;
+
+    snapshot = milter_manager_configuration_get_snapshot(configuration);
+    milter_manager_configuration_snapshot_setup_children(snapshot,
+                                                         children,
+                                                         context);
+    milter_manager_configuration_snapshot_unref(snapshot);
+}
+
+/**
+ * milter_manager_configuration_get_snapshot:
+ * @configuration: A #MilterManagerConfiguration.
+ *
+ * Returns: (transfer full): The current published snapshot of
+ *   @configuration. It isn't changed while a reload is in
+ *   progress. Call milter_manager_configuration_snapshot_unref()
+ *   when it is no longer needed.
+ */
+MilterManagerConfigurationSnapshot *
+milter_manager_configuration_get_snapshot (MilterManagerConfiguration *configuration)
+{
     MilterManagerConfigurationPrivate *priv;
+    MilterManagerConfigurationSnapshot *snapshot;
 
     priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
 
-    for (node = priv->eggs; node; node = g_list_next(node)) {
+    g_mutex_lock(&snapshot_mutex);
+    if (!priv->snapshot || (priv->snapshot_dirty && !priv->reloading))
+        publish_snapshot(priv);
+    snapshot = milter_manager_configuration_snapshot_ref(priv->snapshot);
+    g_mutex_unlock(&snapshot_mutex);
+
+    return snapshot;
+}
+
+MilterManagerConfigurationSnapshot *
+milter_manager_configuration_snapshot_ref (MilterManagerConfigurationSnapshot *snapshot)
+{
+    g_return_val_if_fail(snapshot != NULL, NULL);
+
+    g_atomic_int_inc(&(snapshot->ref_count));
+    return snapshot;
+}
+
+void
+milter_manager_configuration_snapshot_unref (MilterManagerConfigurationSnapshot *snapshot)
+{
+    g_return_if_fail(snapshot != NULL);
+
+    if (!g_atomic_int_dec_and_test(&(snapshot->ref_count)))
+        return;
+
+    g_list_foreach(snapshot->eggs, (GFunc)g_object_unref, NULL);
+    g_list_free(snapshot->eggs);
+    g_free(snapshot);
+}
+
+/**
+ * milter_manager_configuration_snapshot_get_eggs:
+ * @snapshot: A #MilterManagerConfigurationSnapshot.
+ *
+ * Returns: (transfer none) (element-type MilterManagerEgg):
+ *   A list of #MilterManagerEgg in @snapshot.
+ */
+const GList *
+milter_manager_configuration_snapshot_get_eggs (MilterManagerConfigurationSnapshot *snapshot)
+{
+    return snapshot->eggs;
+}
+
+void
+milter_manager_configuration_snapshot_setup_children (MilterManagerConfigurationSnapshot *snapshot,
+                                                      MilterManagerChildren *children,
+                                                      MilterClientContext *context)
+{
+    GList *node;
+
+    for (node = snapshot->eggs; node; node = g_list_next(node)) {
         MilterManagerChild *child;
         MilterManagerEgg *egg = node->data;
 
@@ -1989,11 +2272,16 @@ clear_manager (MilterManagerConfigurationPrivate *priv)
     priv->max_connections = 0;
     priv->max_file_descriptors = 0;
     priv->connection_check_interval = DEFAULT_CONNECTION_CHECK_INTERVAL;
+    priv->connection_check_batch_size = DEFAULT_CONNECTION_CHECK_BATCH_SIZE;
     priv->event_loop_backend = MILTER_CLIENT_EVENT_LOOP_BACKEND_GLIB;
     priv->n_workers = 0;
     priv->default_packet_buffer_size = 0;
     priv->chunk_size = MILTER_CHUNK_SIZE;
     priv->max_pending_finished_sessions = 0;
+    priv->parallel_message_processing = FALSE;
+    priv->max_on_memory_body_size = DEFAULT_MAX_ON_MEMORY_BODY_SIZE;
+    priv->reuse_port = FALSE;
+    priv->use_tcp_connection_table = FALSE;
 }
 
 static void
@@ -2118,6 +2406,8 @@ milter_manager_configuration_fork (MilterManagerConfiguration *configuration)
 {
     MilterManagerConfigurationClass *configuration_class;
 
+    milter_logger_flush(milter_logger());
+
     configuration_class = MILTER_MANAGER_CONFIGURATION_GET_CLASS(configuration);
     if (configuration_class->fork) {
         return configuration_class->fork(configuration);
@@ -2342,6 +2632,25 @@ milter_manager_configuration_set_connection_check_interval (MilterManagerConfigu
     priv->connection_check_interval = interval_in_seconds;
 }
 
+guint
+milter_manager_configuration_get_connection_check_batch_size (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->connection_check_batch_size;
+}
+
+void
+milter_manager_configuration_set_connection_check_batch_size (MilterManagerConfiguration *configuration,
+                                                              guint                       batch_size)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->connection_check_batch_size = batch_size;
+}
+
 MilterClientEventLoopBackend
 milter_manager_configuration_get_event_loop_backend (MilterManagerConfiguration *configuration)
 {
@@ -2484,6 +2793,82 @@ milter_manager_configuration_set_max_pending_finished_sessions (MilterManagerCon
     priv->max_pending_finished_sessions = n_sessions;
 }
 
+gboolean
+milter_manager_configuration_is_parallel_message_processing (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->parallel_message_processing;
+}
+
+void
+milter_manager_configuration_set_parallel_message_processing (MilterManagerConfiguration *configuration,
+                                                              gboolean                    parallel)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->parallel_message_processing = parallel;
+}
+
+guint
+milter_manager_configuration_get_max_on_memory_body_size (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->max_on_memory_body_size;
+}
+
+void
+milter_manager_configuration_set_max_on_memory_body_size (MilterManagerConfiguration *configuration,
+                                                          guint                       size)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->max_on_memory_body_size = size;
+}
+
+gboolean
+milter_manager_configuration_is_reuse_port (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->reuse_port;
+}
+
+void
+milter_manager_configuration_set_reuse_port (MilterManagerConfiguration *configuration,
+                                             gboolean                    reuse_port)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->reuse_port = reuse_port;
+}
+
+gboolean
+milter_manager_configuration_is_use_tcp_connection_table (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->use_tcp_connection_table;
+}
+
+void
+milter_manager_configuration_set_use_tcp_connection_table (MilterManagerConfiguration *configuration,
+                                                           gboolean                    use_tcp_connection_table)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->use_tcp_connection_table = use_tcp_connection_table;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -46,6 +46,7 @@ typedef enum
 } MilterManagerConfigurationError;
 
 typedef struct _MilterManagerConfigurationClass MilterManagerConfigurationClass;
+typedef struct _MilterManagerConfigurationSnapshot MilterManagerConfigurationSnapshot;
 
 struct _MilterManagerConfiguration
 {
@@ -289,6 +290,28 @@ void          milter_manager_configuration_setup_children
                                      (MilterManagerConfiguration *configuration,
                                       MilterManagerChildren      *children,
                                       MilterClientContext        *context);
+
+/*
+ * A snapshot is an immutable list of eggs published by the
+ * configuration. A session pins the snapshot it started with
+ * so that it never sees a half-built egg list while the
+ * configuration is reloaded. An old snapshot is freed when
+ * the last session that pins it unrefs it.
+ */
+MilterManagerConfigurationSnapshot *
+              milter_manager_configuration_get_snapshot
+                                     (MilterManagerConfiguration *configuration);
+MilterManagerConfigurationSnapshot *
+              milter_manager_configuration_snapshot_ref
+                                     (MilterManagerConfigurationSnapshot *snapshot);
+void          milter_manager_configuration_snapshot_unref
+                                     (MilterManagerConfigurationSnapshot *snapshot);
+const GList  *milter_manager_configuration_snapshot_get_eggs
+                                     (MilterManagerConfigurationSnapshot *snapshot);
+void          milter_manager_configuration_snapshot_setup_children
+                                     (MilterManagerConfigurationSnapshot *snapshot,
+                                      MilterManagerChildren      *children,
+                                      MilterClientContext        *context);
 void          milter_manager_configuration_add_applicable_condition
                                      (MilterManagerConfiguration *configuration,
                                       MilterManagerApplicableCondition *condition);
@@ -350,6 +373,11 @@ guint         milter_manager_configuration_get_connection_check_interval
 void          milter_manager_configuration_set_connection_check_interval
                                      (MilterManagerConfiguration *configuration,
                                       guint                       interval_in_seconds);
+guint         milter_manager_configuration_get_connection_check_batch_size
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_connection_check_batch_size
+                                     (MilterManagerConfiguration *configuration,
+                                      guint                       batch_size);
 MilterClientEventLoopBackend
               milter_manager_configuration_get_event_loop_backend
                                      (MilterManagerConfiguration *configuration);
@@ -396,6 +424,30 @@ void          milter_manager_configuration_set_max_pending_finished_sessions
                                      (MilterManagerConfiguration *configuration,
                                       guint                       n_sessions);
 
+gboolean      milter_manager_configuration_is_parallel_message_processing
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_parallel_message_processing
+                                     (MilterManagerConfiguration *configuration,
+                                      gboolean                    parallel);
+
+guint         milter_manager_configuration_get_max_on_memory_body_size
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_max_on_memory_body_size
+                                     (MilterManagerConfiguration *configuration,
+                                      guint                       size);
+
+gboolean      milter_manager_configuration_is_reuse_port
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_reuse_port
+                                     (MilterManagerConfiguration *configuration,
+                                      gboolean                    reuse_port);
+
+gboolean      milter_manager_configuration_is_use_tcp_connection_table
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_use_tcp_connection_table
+                                     (MilterManagerConfiguration *configuration,
+                                      gboolean                    use_tcp_connection_table);
+
 G_END_DECLS
 
 #endif /* __MILTER_MANAGER_CONFIGURATION_H__ */
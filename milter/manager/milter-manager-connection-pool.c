@@ -0,0 +1,270 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <poll.h>
+
+#include "milter-manager-connection-pool.h"
+
+#define MAX_PARKED_CONNECTIONS 32
+#define MAX_IDLE_TIME (60 * G_USEC_PER_SEC)
+
+typedef struct _ParkedConnection
+{
+    MilterOption *requested_option;
+    GIOChannel *channel;
+    MilterOption *option;
+    MilterMacrosRequests *macros_requests;
+    gint64 parked_time;
+} ParkedConnection;
+
+static GMutex pool_mutex;
+static GHashTable *pools = NULL;
+
+static void
+parked_connection_free (ParkedConnection *connection)
+{
+    g_object_unref(connection->requested_option);
+    g_io_channel_unref(connection->channel);
+    g_object_unref(connection->option);
+    if (connection->macros_requests)
+        g_object_unref(connection->macros_requests);
+    g_free(connection);
+}
+
+static void
+pool_free (gpointer data)
+{
+    GQueue *pool = data;
+
+    g_queue_free_full(pool, (GDestroyNotify)parked_connection_free);
+}
+
+static gboolean
+is_expired (ParkedConnection *connection, gint64 now)
+{
+    return now - connection->parked_time > MAX_IDLE_TIME;
+}
+
+/* A parked connection must not have anything to read. If it
+ * has, the child milter closed it or sent garbage. */
+static gboolean
+is_alive (ParkedConnection *connection)
+{
+    struct pollfd poll_fd;
+
+    poll_fd.fd = g_io_channel_unix_get_fd(connection->channel);
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    return poll(&poll_fd, 1, 0) == 0;
+}
+
+static void
+remove_expired_connections (GQueue *pool, gint64 now)
+{
+    while (!g_queue_is_empty(pool)) {
+        ParkedConnection *connection = g_queue_peek_head(pool);
+        if (!is_expired(connection, now))
+            break;
+        g_queue_pop_head(pool);
+        parked_connection_free(connection);
+    }
+}
+
+void
+milter_manager_connection_pool_park (const gchar *spec,
+                                     MilterOption *requested_option,
+                                     GIOChannel *channel,
+                                     MilterOption *option,
+                                     MilterMacrosRequests *macros_requests)
+{
+    GQueue *pool;
+    ParkedConnection *connection;
+    gint64 now;
+
+    now = g_get_monotonic_time();
+
+    connection = g_new(ParkedConnection, 1);
+    connection->requested_option = milter_option_copy(requested_option);
+    connection->channel = g_io_channel_ref(channel);
+    connection->option = milter_option_copy(option);
+    connection->macros_requests = macros_requests;
+    if (connection->macros_requests)
+        g_object_ref(connection->macros_requests);
+    connection->parked_time = now;
+
+    g_mutex_lock(&pool_mutex);
+    if (!pools)
+        pools = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      g_free, pool_free);
+    pool = g_hash_table_lookup(pools, spec);
+    if (!pool) {
+        pool = g_queue_new();
+        g_hash_table_insert(pools, g_strdup(spec), pool);
+    }
+    remove_expired_connections(pool, now);
+    if (g_queue_get_length(pool) >= MAX_PARKED_CONNECTIONS)
+        parked_connection_free(g_queue_pop_head(pool));
+    g_queue_push_tail(pool, connection);
+    g_mutex_unlock(&pool_mutex);
+
+    milter_debug("[connection-pool][park] [%s] %d",
+                 spec, g_io_channel_unix_get_fd(channel));
+}
+
+GIOChannel *
+milter_manager_connection_pool_checkout (const gchar *spec,
+                                         MilterOption *requested_option,
+                                         MilterOption **option,
+                                         MilterMacrosRequests **macros_requests)
+{
+    GQueue *pool = NULL;
+    GList *node, *previous_node;
+    ParkedConnection *found_connection = NULL;
+    GIOChannel *channel = NULL;
+
+    g_mutex_lock(&pool_mutex);
+    if (pools)
+        pool = g_hash_table_lookup(pools, spec);
+    if (pool) {
+        remove_expired_connections(pool, g_get_monotonic_time());
+        /* The most recently parked connection is preferred. */
+        for (node = pool->tail; node; node = previous_node) {
+            ParkedConnection *connection = node->data;
+
+            previous_node = g_list_previous(node);
+            if (!is_alive(connection)) {
+                g_queue_delete_link(pool, node);
+                parked_connection_free(connection);
+                continue;
+            }
+            if (milter_option_equal(connection->requested_option,
+                                    requested_option)) {
+                g_queue_delete_link(pool, node);
+                found_connection = connection;
+                break;
+            }
+        }
+    }
+    g_mutex_unlock(&pool_mutex);
+
+    if (!found_connection) {
+        milter_debug("[connection-pool][checkout][miss] [%s]", spec);
+        return NULL;
+    }
+
+    channel = g_io_channel_ref(found_connection->channel);
+    *option = g_object_ref(found_connection->option);
+    *macros_requests = found_connection->macros_requests;
+    if (*macros_requests)
+        g_object_ref(*macros_requests);
+    parked_connection_free(found_connection);
+
+    milter_debug("[connection-pool][checkout][hit] [%s] %d",
+                 spec, g_io_channel_unix_get_fd(channel));
+
+    return channel;
+}
+
+static gboolean
+sweep_pool (gpointer key, gpointer value, gpointer user_data)
+{
+    GQueue *pool = value;
+    gint64 *now = user_data;
+    GList *node, *next_node;
+
+    remove_expired_connections(pool, *now);
+    for (node = pool->head; node; node = next_node) {
+        ParkedConnection *connection = node->data;
+
+        next_node = g_list_next(node);
+        if (is_alive(connection))
+            continue;
+        g_queue_delete_link(pool, node);
+        parked_connection_free(connection);
+    }
+
+    return g_queue_is_empty(pool);
+}
+
+static void
+count_connections (gpointer key, gpointer value, gpointer user_data)
+{
+    GQueue *pool = value;
+    guint *n_connections = user_data;
+
+    *n_connections += g_queue_get_length(pool);
+}
+
+/* Connections of a child milter that isn't used any more are
+ * never checked out. They are closed here instead of waiting
+ * for the next park or checkout of the same spec. */
+guint
+milter_manager_connection_pool_sweep (void)
+{
+    gint64 now;
+    guint n_connections = 0;
+
+    now = g_get_monotonic_time();
+
+    g_mutex_lock(&pool_mutex);
+    if (pools) {
+        g_hash_table_foreach_remove(pools, sweep_pool, &now);
+        g_hash_table_foreach(pools, count_connections, &n_connections);
+    }
+    g_mutex_unlock(&pool_mutex);
+
+    milter_debug("[connection-pool][sweep] %u", n_connections);
+
+    return n_connections;
+}
+
+guint
+milter_manager_connection_pool_get_n_connections (const gchar *spec)
+{
+    GQueue *pool = NULL;
+    guint n_connections = 0;
+
+    g_mutex_lock(&pool_mutex);
+    if (pools)
+        pool = g_hash_table_lookup(pools, spec);
+    if (pool)
+        n_connections = g_queue_get_length(pool);
+    g_mutex_unlock(&pool_mutex);
+
+    return n_connections;
+}
+
+void
+milter_manager_connection_pool_clear (void)
+{
+    g_mutex_lock(&pool_mutex);
+    if (pools) {
+        g_hash_table_unref(pools);
+        pools = NULL;
+    }
+    g_mutex_unlock(&pool_mutex);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
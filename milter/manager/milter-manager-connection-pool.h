@@ -0,0 +1,58 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_CONNECTION_POOL_H__
+#define __MILTER_MANAGER_CONNECTION_POOL_H__
+
+#include <milter/core.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Connections to child milters that are finished by
+ * SMFIC_QUIT_NC are parked in the pool of the process. They
+ * are grouped by the connection spec of the child milter
+ * and the option that is requested by MTA because a parked
+ * connection is negotiated with the option.
+ */
+void        milter_manager_connection_pool_park
+                                        (const gchar          *spec,
+                                         MilterOption         *requested_option,
+                                         GIOChannel           *channel,
+                                         MilterOption         *option,
+                                         MilterMacrosRequests *macros_requests);
+GIOChannel *milter_manager_connection_pool_checkout
+                                        (const gchar           *spec,
+                                         MilterOption          *requested_option,
+                                         MilterOption         **option,
+                                         MilterMacrosRequests **macros_requests);
+guint       milter_manager_connection_pool_sweep
+                                        (void);
+guint       milter_manager_connection_pool_get_n_connections
+                                        (const gchar          *spec);
+void        milter_manager_connection_pool_clear
+                                        (void);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_CONNECTION_POOL_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
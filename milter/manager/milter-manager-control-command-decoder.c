@@ -31,6 +31,7 @@ enum
     RELOAD,
     STOP_CHILD,
     GET_STATUS,
+    GET_METRICS,
     LAST_SIGNAL
 };
 
@@ -114,6 +115,16 @@ milter_manager_control_command_decoder_class_init (MilterManagerControlCommandDe
                      NULL,
                      G_TYPE_NONE, 0);
 
+    signals[GET_METRICS] =
+        g_signal_new("get-metrics",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     G_STRUCT_OFFSET(MilterManagerControlCommandDecoderClass,
+                                     get_metrics),
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE, 0);
+
 }
 
 static void
@@ -201,6 +212,23 @@ decode_get_status (MilterDecoder *decoder,
     return TRUE;
 }
 
+static gboolean
+decode_get_metrics (MilterDecoder *decoder,
+                    const gchar *content, gint length,
+                    GError **error)
+{
+    if (!milter_decoder_check_command_length(
+            content, length, 0,
+            MILTER_DECODER_COMPARE_EXACT, error,
+            "get-metrics command"))
+        return FALSE;
+
+    milter_debug("[control-command-decoder][get-metrics]");
+    g_signal_emit(decoder, signals[GET_METRICS], 0);
+
+    return TRUE;
+}
+
 static gboolean
 decode (MilterDecoder *decoder, GError **error)
 {
@@ -238,6 +266,8 @@ decode (MilterDecoder *decoder, GError **error)
 */
     } else if (g_str_equal(buffer, MILTER_MANAGER_CONTROL_COMMAND_GET_STATUS)) {
         success = decode_get_status(decoder, content, content_length, error);
+    } else if (g_str_equal(buffer, MILTER_MANAGER_CONTROL_COMMAND_GET_METRICS)) {
+        success = decode_get_metrics(decoder, content, content_length, error);
     } else {
         g_set_error(error,
                     MILTER_MANAGER_CONTROL_COMMAND_DECODER_ERROR,
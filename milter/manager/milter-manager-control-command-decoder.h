@@ -61,6 +61,7 @@ struct _MilterManagerControlCommandDecoderClass
     void (*stop_child)           (MilterManagerControlCommandDecoder *decoder,
                                   const gchar *name);
     void (*get_status)           (MilterManagerControlCommandDecoder *decoder);
+    void (*get_metrics)          (MilterManagerControlCommandDecoder *decoder);
 };
 
 GQuark         milter_manager_control_command_decoder_error_quark (void);
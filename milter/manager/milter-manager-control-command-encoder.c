@@ -109,6 +109,23 @@ milter_manager_control_command_encoder_encode_get_status (MilterManagerControlCo
     milter_encoder_pack(base_encoder, packet, packet_size);
 }
 
+void
+milter_manager_control_command_encoder_encode_get_metrics (MilterManagerControlCommandEncoder *encoder,
+                                                           const gchar **packet,
+                                                           gsize *packet_size)
+{
+    MilterEncoder *base_encoder;
+    GString *buffer;
+
+    base_encoder = MILTER_ENCODER(encoder);
+    milter_encoder_clear_buffer(base_encoder);
+    buffer = milter_encoder_get_buffer(base_encoder);
+
+    g_string_append(buffer, MILTER_MANAGER_CONTROL_COMMAND_GET_METRICS);
+    g_string_append_c(buffer, '\0');
+    milter_encoder_pack(base_encoder, packet, packet_size);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -65,6 +65,10 @@ void             milter_manager_control_command_encoder_encode_get_status
                                             (MilterManagerControlCommandEncoder *encoder,
                                              const gchar  **packet,
                                              gsize         *packet_size);
+void             milter_manager_control_command_encoder_encode_get_metrics
+                                            (MilterManagerControlCommandEncoder *encoder,
+                                             const gchar  **packet,
+                                             gsize         *packet_size);
 
 G_END_DECLS
 
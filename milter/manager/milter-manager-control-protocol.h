@@ -29,12 +29,14 @@ G_BEGIN_DECLS
 #define MILTER_MANAGER_CONTROL_COMMAND_RELOAD "reload"
 #define MILTER_MANAGER_CONTROL_COMMAND_STOP_CHILD "stop-child"
 #define MILTER_MANAGER_CONTROL_COMMAND_GET_STATUS "get-status"
+#define MILTER_MANAGER_CONTROL_COMMAND_GET_METRICS "get-metrics"
 
 #define MILTER_MANAGER_CONTROL_REPLY_SUCCESS "success"
 #define MILTER_MANAGER_CONTROL_REPLY_FAILURE "failure"
 #define MILTER_MANAGER_CONTROL_REPLY_ERROR "error"
 #define MILTER_MANAGER_CONTROL_REPLY_CONFIGURATION "configuration"
 #define MILTER_MANAGER_CONTROL_REPLY_STATUS "status"
+#define MILTER_MANAGER_CONTROL_REPLY_METRICS "metrics"
 
 G_END_DECLS
 
@@ -128,6 +128,25 @@ milter_manager_control_reply_encoder_encode_status (
     milter_encoder_pack(base_encoder, packet, packet_size);
 }
 
+void
+milter_manager_control_reply_encoder_encode_metrics (
+    MilterManagerControlReplyEncoder *encoder,
+    const gchar **packet, gsize *packet_size,
+    const gchar *metrics, gsize metrics_size)
+{
+    MilterEncoder *base_encoder;
+    GString *buffer;
+
+    base_encoder = MILTER_ENCODER(encoder);
+    milter_encoder_clear_buffer(base_encoder);
+    buffer = milter_encoder_get_buffer(base_encoder);
+
+    g_string_append(buffer, MILTER_MANAGER_CONTROL_REPLY_METRICS);
+    g_string_append_c(buffer, '\0');
+    g_string_append_len(buffer, metrics, metrics_size);
+    milter_encoder_pack(base_encoder, packet, packet_size);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -83,6 +83,13 @@ void             milter_manager_control_reply_encoder_encode_status
                                              const gchar   *status,
                                              gsize          status_size);
 
+void             milter_manager_control_reply_encoder_encode_metrics
+                                            (MilterManagerControlReplyEncoder *encoder,
+                                             const gchar  **packet,
+                                             gsize         *packet_size,
+                                             const gchar   *metrics,
+                                             gsize          metrics_size);
+
 G_END_DECLS
 
 #endif /* __MILTER_MANAGER_CONTROL_REPLY_ENCODER_H__ */
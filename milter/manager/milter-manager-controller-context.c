@@ -22,11 +22,15 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <string.h>
+#include <unistd.h>
 
 #include "milter-manager-controller-context.h"
 #include "milter-manager-enum-types.h"
 #include "milter-manager-control-command-decoder.h"
 #include "milter-manager-control-reply-encoder.h"
+#include "milter-manager-leader.h"
+#include "milter-manager-children.h"
+#include "milter-manager-metrics.h"
 
 #define MILTER_MANAGER_CONTROLLER_CONTEXT_GET_PRIVATE(obj)              \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
@@ -211,10 +215,260 @@ cb_decoder_reload (MilterManagerControlCommandDecoder *decoder,
     }
 }
 
+static void
+append_number_element (GString *status, const gchar *name,
+                       const gchar *format, guint indent, ...)
+{
+    va_list args;
+    gchar *content;
+
+    va_start(args, indent);
+    content = g_strdup_vprintf(format, args);
+    va_end(args);
+    milter_utils_xml_append_text_element(status, name, content, indent);
+    g_free(content);
+}
+
+static void
+append_elapsed_element (GString *status, const gchar *name,
+                        gdouble elapsed, guint indent)
+{
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_ascii_formatd(buffer, sizeof(buffer), "%.6f", elapsed);
+    milter_utils_xml_append_text_element(status, name, buffer, indent);
+}
+
+static void
+collect_process_status (MilterManagerControllerContext *context,
+                        GString *status, guint indent)
+{
+    MilterManagerControllerContextPrivate *priv;
+    MilterClient *client;
+    guint i, n_workers;
+
+    priv = MILTER_MANAGER_CONTROLLER_CONTEXT_GET_PRIVATE(context);
+    client = MILTER_CLIENT(priv->manager);
+
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "<process>\n");
+    append_number_element(status, "pid", "%d", indent + 2, (gint)getpid());
+    append_number_element(status, "n-processing-sessions", "%u", indent + 2,
+                          milter_client_get_n_processing_sessions(client));
+    append_number_element(status, "n-sessions", "%" G_GUINT64_FORMAT,
+                          indent + 2,
+                          milter_manager_metrics_get_n_sessions(0));
+    append_number_element(status, "n-body-spills", "%" G_GUINT64_FORMAT,
+                          indent + 2,
+                          milter_manager_metrics_get_n_body_spills(0));
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "</process>\n");
+
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "<workers>\n");
+    n_workers = milter_manager_metrics_get_n_workers();
+    for (i = 1; i <= n_workers; i++) {
+        milter_utils_append_indent(status, indent + 2);
+        g_string_append(status, "<worker>\n");
+        append_number_element(status, "id", "%u", indent + 4, i);
+        append_number_element(status, "pid", "%d", indent + 4,
+                              (gint)milter_manager_metrics_get_worker_pid(i));
+        append_number_element(status, "n-sessions", "%" G_GUINT64_FORMAT,
+                              indent + 4,
+                              milter_manager_metrics_get_n_sessions(i));
+        append_number_element(status, "n-body-spills", "%" G_GUINT64_FORMAT,
+                              indent + 4,
+                              milter_manager_metrics_get_n_body_spills(i));
+        milter_utils_append_indent(status, indent + 2);
+        g_string_append(status, "</worker>\n");
+    }
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "</workers>\n");
+}
+
+static void
+collect_child_status (MilterManagerChildren *children,
+                      MilterManagerChild *child,
+                      GString *status, guint indent)
+{
+    MilterServerContext *server_context;
+    MilterAgent *agent;
+    const gchar *name;
+    gint position;
+
+    server_context = MILTER_SERVER_CONTEXT(child);
+    agent = MILTER_AGENT(child);
+
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "<child>\n");
+    name = milter_server_context_get_name(server_context);
+    if (name)
+        milter_utils_xml_append_text_element(status, "name", name, indent + 2);
+    milter_utils_xml_append_enum_element(
+        status, "state",
+        MILTER_TYPE_SERVER_CONTEXT_STATE,
+        milter_server_context_get_state(server_context),
+        indent + 2);
+    milter_utils_xml_append_boolean_element(
+        status, "processing",
+        milter_server_context_is_processing(server_context),
+        indent + 2);
+    position = milter_manager_children_get_command_waiting_position(children,
+                                                                     child);
+    if (position >= 0)
+        append_number_element(status, "command-waiting-position", "%d",
+                              indent + 2, position);
+    append_number_element(status, "pending-write-size",
+                          "%" G_GSIZE_FORMAT, indent + 2,
+                          milter_agent_get_pending_write_size(agent));
+    append_elapsed_element(status, "elapsed",
+                           milter_server_context_get_elapsed(server_context),
+                           indent + 2);
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "</child>\n");
+}
+
+static void
+collect_leaders_status (MilterManagerControllerContext *context,
+                        GString *status, guint indent)
+{
+    MilterManagerControllerContextPrivate *priv;
+    const GList *node;
+
+    priv = MILTER_MANAGER_CONTROLLER_CONTEXT_GET_PRIVATE(context);
+
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "<leaders>\n");
+    for (node = milter_manager_get_leaders(priv->manager);
+         node;
+         node = g_list_next(node)) {
+        MilterManagerLeader *leader = node->data;
+        MilterManagerChildren *children;
+        MilterClientContext *client_context;
+        GList *child_node;
+
+        milter_utils_append_indent(status, indent + 2);
+        g_string_append(status, "<leader>\n");
+        append_number_element(status, "tag", "%u", indent + 4,
+                              milter_manager_leader_get_tag(leader));
+        milter_utils_xml_append_enum_element(
+            status, "state",
+            MILTER_TYPE_MANAGER_LEADER_STATE,
+            milter_manager_leader_get_state(leader),
+            indent + 4);
+        client_context = milter_manager_leader_get_client_context(leader);
+        if (client_context) {
+            MilterAgent *agent = MILTER_AGENT(client_context);
+
+            append_number_element(status, "pending-write-size",
+                                  "%" G_GSIZE_FORMAT, indent + 4,
+                                  milter_agent_get_pending_write_size(agent));
+            append_elapsed_element(status, "elapsed",
+                                   milter_agent_get_elapsed(agent),
+                                   indent + 4);
+        }
+
+        children = milter_manager_leader_get_children(leader);
+        if (children) {
+            append_number_element(
+                status, "n-queued-commands", "%u", indent + 4,
+                milter_manager_children_get_n_queued_commands(children));
+            append_number_element(
+                status, "body-file-size", "%" G_GSIZE_FORMAT, indent + 4,
+                milter_manager_children_get_body_file_size(children));
+            milter_utils_append_indent(status, indent + 4);
+            g_string_append(status, "<children>\n");
+            for (child_node = milter_manager_children_get_children(children);
+                 child_node;
+                 child_node = g_list_next(child_node)) {
+                collect_child_status(children, child_node->data,
+                                     status, indent + 6);
+            }
+            milter_utils_append_indent(status, indent + 4);
+            g_string_append(status, "</children>\n");
+        }
+        milter_utils_append_indent(status, indent + 2);
+        g_string_append(status, "</leader>\n");
+    }
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "</leaders>\n");
+}
+
+static void
+collect_milters_status (MilterManagerControllerContext *context,
+                        GString *status, guint indent)
+{
+    MilterManagerControllerContextPrivate *priv;
+    MilterManagerConfiguration *config;
+    const GList *node;
+    const gdouble percentiles[] = {0.5, 0.9, 0.99};
+    const gchar *percentile_names[] = {"p50", "p90", "p99"};
+
+    priv = MILTER_MANAGER_CONTROLLER_CONTEXT_GET_PRIVATE(context);
+    config = milter_manager_get_configuration(priv->manager);
+
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "<milters>\n");
+    for (node = milter_manager_configuration_get_eggs(config);
+         node;
+         node = g_list_next(node)) {
+        MilterManagerEgg *egg = node->data;
+        const gchar *name, *spec;
+        guint i;
+
+        name = milter_manager_egg_get_name(egg);
+        spec = milter_manager_egg_get_connection_spec(egg);
+
+        milter_utils_append_indent(status, indent + 2);
+        g_string_append(status, "<milter>\n");
+        if (name)
+            milter_utils_xml_append_text_element(status, "name", name,
+                                                 indent + 4);
+        if (spec)
+            milter_utils_xml_append_text_element(status, "spec", spec,
+                                                 indent + 4);
+        milter_utils_xml_append_boolean_element(
+            status, "enabled", milter_manager_egg_is_enabled(egg),
+            indent + 4);
+        if (name) {
+            for (i = 0; i < G_N_ELEMENTS(percentiles); i++) {
+                gdouble latency;
+
+                latency = milter_manager_metrics_get_child_duration_percentile(
+                    name, percentiles[i]);
+                if (latency < 0)
+                    break;
+                append_elapsed_element(status, percentile_names[i], latency,
+                                       indent + 4);
+            }
+        }
+        milter_utils_append_indent(status, indent + 2);
+        g_string_append(status, "</milter>\n");
+    }
+    milter_utils_append_indent(status, indent);
+    g_string_append(status, "</milters>\n");
+}
+
+/* Only in-memory structures are walked. No I/O is done
+ * until the whole snapshot is written as one packet.
+ *
+ * Leaders live in the process that accepted the connection. In
+ * worker mode, they are in worker processes and the controller
+ * in the master can't see them. <leaders> is omitted in the
+ * case rather than reporting an empty list. */
 static void
 collect_status (MilterManagerControllerContext *context, GString *status)
 {
-    g_string_append(status, "FIXME");
+    MilterManagerControllerContextPrivate *priv;
+
+    priv = MILTER_MANAGER_CONTROLLER_CONTEXT_GET_PRIVATE(context);
+
+    g_string_append(status, "<status>\n");
+    collect_process_status(context, status, 2);
+    if (milter_client_get_n_workers(MILTER_CLIENT(priv->manager)) == 0)
+        collect_leaders_status(context, status, 2);
+    collect_milters_status(context, status, 2);
+    g_string_append(status, "</status>\n");
 }
 
 static void
@@ -248,6 +502,36 @@ cb_decoder_get_status (MilterManagerControlCommandDecoder *decoder,
     }
 }
 
+static void
+cb_decoder_get_metrics (MilterManagerControlCommandDecoder *decoder,
+                        gpointer user_data)
+{
+    MilterManagerControllerContext *context = user_data;
+    gchar *metrics;
+    GError *error = NULL;
+    MilterAgent *agent;
+    MilterEncoder *base_encoder;
+    MilterManagerControlReplyEncoder *encoder;
+    const gchar *packet;
+    gsize packet_size;
+
+    metrics = milter_manager_metrics_to_open_metrics();
+    agent = MILTER_AGENT(context);
+    base_encoder = milter_agent_get_encoder(agent);
+    encoder = MILTER_MANAGER_CONTROL_REPLY_ENCODER(base_encoder);
+    milter_manager_control_reply_encoder_encode_metrics(encoder,
+                                                        &packet,
+                                                        &packet_size,
+                                                        metrics,
+                                                        strlen(metrics));
+    g_free(metrics);
+    if (!milter_agent_write_packet(agent, packet, packet_size, &error)) {
+        milter_error("[controller][error][write][metrics] %s",
+                     error->message);
+        g_error_free(error);
+    }
+}
+
 static MilterDecoder *
 decoder_new (MilterAgent *agent)
 {
@@ -263,6 +547,7 @@ decoder_new (MilterAgent *agent)
     CONNECT(get_configuration);
     CONNECT(reload);
     CONNECT(get_status);
+    CONNECT(get_metrics);
 
 #undef CONNECT
 
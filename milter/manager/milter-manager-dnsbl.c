@@ -0,0 +1,937 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "milter-manager-dnsbl.h"
+
+#ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define DNS_PORT 53
+#define DNS_HEADER_SIZE 12
+#define DNS_MESSAGE_SIZE 512
+#define DNS_TYPE_A 1
+#define DNS_CLASS_IN 1
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_NXDOMAIN 3
+
+#define DEFAULT_TIMEOUT 5.0
+#define DEFAULT_NEGATIVE_CACHE_TTL 60
+#define RESOLV_CONF_PATH "/etc/resolv.conf"
+
+#define N_CACHE_ENTRIES 4096
+#define N_CACHE_PROBES 8
+#define QUERY_DOMAIN_SIZE 256
+#define MAX_ANSWERS 8
+
+#define LOOKUP_REQUESTED_KEY "milter-manager-dnsbl-lookup-requested"
+
+/* An entry is written by one process at a time and read by
+ * any process without lock. The sequence is odd while the
+ * entry is written. A reader retries nothing: it treats a
+ * torn read as a cache miss. */
+typedef struct _CacheEntry
+{
+    guint sequence;
+    guint hash;
+    gint64 expire_time;
+    guint n_answers;
+    guint32 answers[MAX_ANSWERS];
+    gchar query_domain[QUERY_DOMAIN_SIZE];
+} CacheEntry;
+
+typedef struct _NameServer
+{
+    MilterGenericSocketAddress address;
+    socklen_t address_length;
+} NameServer;
+
+typedef struct _Query
+{
+    MilterManagerDNSBLLookup *lookup;
+    gchar *query_domain;
+    guint16 id;
+    guint name_server_index;
+    GIOChannel *channel;
+    guint watch_id;
+    gboolean done;
+} Query;
+
+struct _MilterManagerDNSBLLookup
+{
+    MilterEventLoop *loop;
+    GArray *name_servers;
+    GList *queries;
+    guint n_waiting_queries;
+    guint retry_id;
+    MilterManagerDNSBLLookupFinishedFunc finished;
+    gpointer user_data;
+};
+
+static CacheEntry *cache = NULL;
+static gboolean cache_shared = FALSE;
+static GMutex cache_mutex;
+
+static GMutex dnsbl_mutex;
+static GPtrArray *services = NULL;
+static GArray *name_servers = NULL;
+static gboolean name_servers_configured = FALSE;
+static gdouble timeout = DEFAULT_TIMEOUT;
+static guint negative_cache_ttl = DEFAULT_NEGATIVE_CACHE_TTL;
+
+GQuark
+milter_manager_dnsbl_error_quark (void)
+{
+    return g_quark_from_static_string("milter-manager-dnsbl-error-quark");
+}
+
+static void
+free_cache (void)
+{
+    if (!cache)
+        return;
+
+    if (cache_shared) {
+        munmap(cache, sizeof(CacheEntry) * N_CACHE_ENTRIES);
+    } else {
+        g_free(cache);
+    }
+    cache = NULL;
+    cache_shared = FALSE;
+}
+
+static void
+allocate_cache (void)
+{
+    gpointer memory;
+
+    memory = mmap(NULL, sizeof(CacheEntry) * N_CACHE_ENTRIES,
+                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                  -1, 0);
+    if (memory == MAP_FAILED) {
+        milter_warning("[dnsbl][cache][allocate][shared][error] %s: "
+                       "DNSBL cache isn't shared with worker processes",
+                       g_strerror(errno));
+        cache = g_new0(CacheEntry, N_CACHE_ENTRIES);
+        cache_shared = FALSE;
+    } else {
+        cache = memory;
+        cache_shared = TRUE;
+    }
+}
+
+static CacheEntry *
+get_cache (void)
+{
+    CacheEntry *entries;
+
+    entries = g_atomic_pointer_get(&cache);
+    if (G_LIKELY(entries))
+        return entries;
+
+    g_mutex_lock(&cache_mutex);
+    if (!cache)
+        allocate_cache();
+    entries = cache;
+    g_mutex_unlock(&cache_mutex);
+
+    return entries;
+}
+
+void
+milter_manager_dnsbl_init (void)
+{
+    g_mutex_lock(&cache_mutex);
+    free_cache();
+    allocate_cache();
+    g_mutex_unlock(&cache_mutex);
+}
+
+void
+milter_manager_dnsbl_quit (void)
+{
+    g_mutex_lock(&cache_mutex);
+    free_cache();
+    g_mutex_unlock(&cache_mutex);
+
+    milter_manager_dnsbl_clear_services();
+    milter_manager_dnsbl_clear_name_servers();
+}
+
+void
+milter_manager_dnsbl_add_service (const gchar *domain)
+{
+    g_mutex_lock(&dnsbl_mutex);
+    if (!services)
+        services = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(services, g_ascii_strdown(domain, -1));
+    g_mutex_unlock(&dnsbl_mutex);
+}
+
+void
+milter_manager_dnsbl_clear_services (void)
+{
+    g_mutex_lock(&dnsbl_mutex);
+    if (services) {
+        g_ptr_array_unref(services);
+        services = NULL;
+    }
+    g_mutex_unlock(&dnsbl_mutex);
+}
+
+static gboolean
+parse_name_server (const gchar *address, guint port, NameServer *name_server)
+{
+    memset(name_server, 0, sizeof(*name_server));
+    if (inet_pton(AF_INET, address,
+                  &(name_server->address.address.inet.sin_addr)) == 1) {
+        name_server->address.address.inet.sin_family = AF_INET;
+        name_server->address.address.inet.sin_port = g_htons(port);
+        name_server->address_length = sizeof(struct sockaddr_in);
+        return TRUE;
+    }
+    if (inet_pton(AF_INET6, address,
+                  &(name_server->address.address.inet6.sin6_addr)) == 1) {
+        name_server->address.address.inet6.sin6_family = AF_INET6;
+        name_server->address.address.inet6.sin6_port = g_htons(port);
+        name_server->address_length = sizeof(struct sockaddr_in6);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean
+milter_manager_dnsbl_add_name_server (const gchar *address,
+                                      guint port,
+                                      GError **error)
+{
+    NameServer name_server;
+    GArray *new_name_servers;
+
+    if (!parse_name_server(address, port, &name_server)) {
+        g_set_error(error,
+                    MILTER_MANAGER_DNSBL_ERROR,
+                    MILTER_MANAGER_DNSBL_ERROR_INVALID_NAME_SERVER,
+                    "name server must be an IP address: <%s>", address);
+        return FALSE;
+    }
+
+    /* Running lookups refer to the current array. A new array is
+     * used for them. */
+    g_mutex_lock(&dnsbl_mutex);
+    new_name_servers = g_array_new(FALSE, FALSE, sizeof(NameServer));
+    if (name_servers) {
+        if (name_servers_configured)
+            g_array_append_vals(new_name_servers,
+                                name_servers->data, name_servers->len);
+        g_array_unref(name_servers);
+    }
+    g_array_append_val(new_name_servers, name_server);
+    name_servers = new_name_servers;
+    name_servers_configured = TRUE;
+    g_mutex_unlock(&dnsbl_mutex);
+
+    return TRUE;
+}
+
+void
+milter_manager_dnsbl_clear_name_servers (void)
+{
+    g_mutex_lock(&dnsbl_mutex);
+    if (name_servers) {
+        g_array_unref(name_servers);
+        name_servers = NULL;
+    }
+    name_servers_configured = FALSE;
+    g_mutex_unlock(&dnsbl_mutex);
+}
+
+/* Must be called with dnsbl_mutex. */
+static void
+load_default_name_servers (void)
+{
+    gchar *content = NULL;
+    gchar **lines, **line;
+
+    name_servers = g_array_new(FALSE, FALSE, sizeof(NameServer));
+    if (g_file_get_contents(RESOLV_CONF_PATH, &content, NULL, NULL)) {
+        lines = g_strsplit(content, "\n", -1);
+        for (line = lines; *line; line++) {
+            gchar **words;
+            NameServer name_server;
+
+            words = g_strsplit_set(g_strstrip(*line), " \t", -1);
+            if (words[0] && g_str_equal(words[0], "nameserver") &&
+                words[1] &&
+                parse_name_server(words[1], DNS_PORT, &name_server)) {
+                g_array_append_val(name_servers, name_server);
+            }
+            g_strfreev(words);
+        }
+        g_strfreev(lines);
+        g_free(content);
+    }
+
+    if (name_servers->len == 0) {
+        NameServer name_server;
+
+        parse_name_server("127.0.0.1", DNS_PORT, &name_server);
+        g_array_append_val(name_servers, name_server);
+    }
+}
+
+gdouble
+milter_manager_dnsbl_get_timeout (void)
+{
+    return timeout;
+}
+
+void
+milter_manager_dnsbl_set_timeout (gdouble new_timeout)
+{
+    timeout = new_timeout > 0 ? new_timeout : DEFAULT_TIMEOUT;
+}
+
+guint
+milter_manager_dnsbl_get_negative_cache_ttl (void)
+{
+    return negative_cache_ttl;
+}
+
+void
+milter_manager_dnsbl_set_negative_cache_ttl (guint ttl)
+{
+    negative_cache_ttl = ttl;
+}
+
+void
+milter_manager_dnsbl_request_lookup (MilterClientContext *context)
+{
+    g_object_set_data(G_OBJECT(context), LOOKUP_REQUESTED_KEY,
+                      GINT_TO_POINTER(TRUE));
+}
+
+gboolean
+milter_manager_dnsbl_is_lookup_requested (MilterClientContext *context)
+{
+    return GPOINTER_TO_INT(g_object_get_data(G_OBJECT(context),
+                                             LOOKUP_REQUESTED_KEY));
+}
+
+static gboolean
+cache_read (const gchar *query_domain, CacheEntry *found)
+{
+    CacheEntry *entries;
+    guint hash, i;
+    gint64 now;
+
+    if (strlen(query_domain) >= QUERY_DOMAIN_SIZE)
+        return FALSE;
+
+    entries = get_cache();
+    hash = g_str_hash(query_domain);
+    now = g_get_monotonic_time();
+    for (i = 0; i < N_CACHE_PROBES; i++) {
+        CacheEntry *entry;
+        guint sequence;
+
+        entry = entries + (hash + i) % N_CACHE_ENTRIES;
+        sequence = __atomic_load_n(&(entry->sequence), __ATOMIC_ACQUIRE);
+        if (sequence % 2 == 1)
+            continue;
+        memcpy(found, entry, sizeof(CacheEntry));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&(entry->sequence), __ATOMIC_RELAXED) != sequence)
+            continue;
+        if (found->hash != hash)
+            continue;
+        found->query_domain[QUERY_DOMAIN_SIZE - 1] = '\0';
+        if (strcmp(found->query_domain, query_domain) != 0)
+            continue;
+        return found->expire_time > now;
+    }
+
+    return FALSE;
+}
+
+static void
+cache_write (const gchar *query_domain,
+             const guint32 *answers, guint n_answers,
+             guint ttl)
+{
+    CacheEntry *entries, *entry = NULL;
+    guint hash, i, sequence;
+    gint64 now;
+
+    if (ttl == 0 || strlen(query_domain) >= QUERY_DOMAIN_SIZE)
+        return;
+
+    entries = get_cache();
+    hash = g_str_hash(query_domain);
+    now = g_get_monotonic_time();
+    /* Use the entry for the same domain, an expired entry or
+     * the entry that expires first in this order. */
+    for (i = 0; i < N_CACHE_PROBES; i++) {
+        CacheEntry *candidate;
+
+        candidate = entries + (hash + i) % N_CACHE_ENTRIES;
+        if (candidate->hash == hash &&
+            strncmp(candidate->query_domain, query_domain,
+                    QUERY_DOMAIN_SIZE) == 0) {
+            entry = candidate;
+            break;
+        }
+        if (!entry ||
+            (entry->expire_time > now &&
+             candidate->expire_time < entry->expire_time))
+            entry = candidate;
+    }
+
+    sequence = __atomic_load_n(&(entry->sequence), __ATOMIC_RELAXED);
+    if (sequence % 2 == 1)
+        return;
+    if (!__atomic_compare_exchange_n(&(entry->sequence),
+                                     &sequence, sequence + 1,
+                                     FALSE,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+
+    if (n_answers > MAX_ANSWERS)
+        n_answers = MAX_ANSWERS;
+    entry->hash = hash;
+    entry->expire_time = now + (gint64)ttl * G_USEC_PER_SEC;
+    entry->n_answers = n_answers;
+    memcpy(entry->answers, answers, sizeof(guint32) * n_answers);
+    strncpy(entry->query_domain, query_domain, QUERY_DOMAIN_SIZE);
+
+    __atomic_store_n(&(entry->sequence), sequence + 2, __ATOMIC_RELEASE);
+}
+
+gboolean
+milter_manager_dnsbl_get_cached_answers (const gchar *query_domain,
+                                         GList **answers)
+{
+    CacheEntry entry;
+    gchar *normalized_query_domain;
+    gboolean found;
+    guint i;
+
+    normalized_query_domain = g_ascii_strdown(query_domain, -1);
+    found = cache_read(normalized_query_domain, &entry);
+    g_free(normalized_query_domain);
+    if (!found)
+        return FALSE;
+
+    if (answers) {
+        *answers = NULL;
+        for (i = 0; i < entry.n_answers && i < MAX_ANSWERS; i++) {
+            gchar address[INET_ADDRSTRLEN];
+
+            inet_ntop(AF_INET, &(entry.answers[i]), address, sizeof(address));
+            *answers = g_list_prepend(*answers, g_strdup(address));
+        }
+        *answers = g_list_reverse(*answers);
+    }
+
+    return TRUE;
+}
+
+void
+milter_manager_dnsbl_clear_cache (void)
+{
+    CacheEntry *entries;
+    guint i;
+
+    entries = get_cache();
+    for (i = 0; i < N_CACHE_ENTRIES; i++) {
+        CacheEntry *entry = entries + i;
+        guint sequence;
+
+        sequence = __atomic_load_n(&(entry->sequence), __ATOMIC_RELAXED);
+        if (sequence % 2 == 1)
+            continue;
+        if (!__atomic_compare_exchange_n(&(entry->sequence),
+                                         &sequence, sequence + 1,
+                                         FALSE,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+        entry->expire_time = 0;
+        __atomic_store_n(&(entry->sequence), sequence + 2, __ATOMIC_RELEASE);
+    }
+}
+
+static gsize
+build_query (const gchar *query_domain, guint16 id, guint8 *message)
+{
+    gsize size = 0;
+    const gchar *label;
+
+    message[size++] = id >> 8;
+    message[size++] = id & 0xff;
+    message[size++] = 0x01; /* RD */
+    message[size++] = 0x00;
+    message[size++] = 0x00; /* QDCOUNT */
+    message[size++] = 0x01;
+    memset(message + size, 0, 6); /* ANCOUNT, NSCOUNT, ARCOUNT */
+    size += 6;
+
+    label = query_domain;
+    while (*label) {
+        const gchar *end;
+        gsize label_size;
+
+        end = strchr(label, '.');
+        label_size = end ? (gsize)(end - label) : strlen(label);
+        if (label_size == 0 || label_size > 63 ||
+            size + 1 + label_size + 5 > DNS_MESSAGE_SIZE)
+            return 0;
+        message[size++] = label_size;
+        memcpy(message + size, label, label_size);
+        size += label_size;
+        if (!end)
+            break;
+        label = end + 1;
+    }
+    message[size++] = 0x00;
+    message[size++] = 0x00;
+    message[size++] = DNS_TYPE_A;
+    message[size++] = 0x00;
+    message[size++] = DNS_CLASS_IN;
+
+    return size;
+}
+
+static gboolean
+skip_name (const guint8 *message, gsize size, gsize *offset)
+{
+    while (*offset < size) {
+        guint8 length = message[*offset];
+
+        if ((length & 0xc0) == 0xc0) {
+            *offset += 2;
+            return *offset <= size;
+        }
+        if (length & 0xc0)
+            return FALSE;
+        *offset += 1 + length;
+        if (length == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#define READ_UINT16(message, offset)                    \
+    ((guint16)(((message)[(offset)] << 8) | (message)[(offset) + 1]))
+#define READ_UINT32(message, offset)                            \
+    (((guint32)READ_UINT16(message, offset) << 16) |            \
+     READ_UINT16(message, (offset) + 2))
+
+/* Returns FALSE for a broken response or a response for
+ * another query. */
+static gboolean
+parse_response (const guint8 *message, gsize size, guint16 id,
+                guint *rcode,
+                guint32 *answers, guint *n_answers, guint *ttl)
+{
+    guint n_questions, n_resources, i;
+    gsize offset;
+
+    if (size < DNS_HEADER_SIZE)
+        return FALSE;
+    if (READ_UINT16(message, 0) != id)
+        return FALSE;
+    if (!(message[2] & 0x80)) /* QR */
+        return FALSE;
+
+    *rcode = message[3] & 0x0f;
+    *n_answers = 0;
+    *ttl = G_MAXUINT32;
+    n_questions = READ_UINT16(message, 4);
+    n_resources = READ_UINT16(message, 6);
+
+    offset = DNS_HEADER_SIZE;
+    for (i = 0; i < n_questions; i++) {
+        if (!skip_name(message, size, &offset))
+            return FALSE;
+        offset += 4;
+    }
+    for (i = 0; i < n_resources; i++) {
+        guint type, klass, data_length;
+
+        if (!skip_name(message, size, &offset))
+            return FALSE;
+        if (offset + 10 > size)
+            return FALSE;
+        type = READ_UINT16(message, offset);
+        klass = READ_UINT16(message, offset + 2);
+        data_length = READ_UINT16(message, offset + 8);
+        if (offset + 10 + data_length > size)
+            return FALSE;
+        if (type == DNS_TYPE_A && klass == DNS_CLASS_IN && data_length == 4) {
+            guint resource_ttl;
+
+            resource_ttl = READ_UINT32(message, offset + 4);
+            if (resource_ttl < *ttl)
+                *ttl = resource_ttl;
+            if (*n_answers < MAX_ANSWERS) {
+                memcpy(answers + *n_answers, message + offset + 10, 4);
+                (*n_answers)++;
+            }
+        }
+        offset += 10 + data_length;
+    }
+    if (*n_answers == 0)
+        *ttl = 0;
+
+    return TRUE;
+}
+
+static void
+query_close (Query *query)
+{
+    if (query->watch_id > 0) {
+        milter_event_loop_remove(query->lookup->loop, query->watch_id);
+        query->watch_id = 0;
+    }
+    if (query->channel) {
+        g_io_channel_unref(query->channel);
+        query->channel = NULL;
+    }
+}
+
+static void
+query_free (Query *query)
+{
+    query_close(query);
+    g_free(query->query_domain);
+    g_free(query);
+}
+
+static void
+lookup_free (MilterManagerDNSBLLookup *lookup)
+{
+    if (lookup->retry_id > 0)
+        milter_event_loop_remove(lookup->loop, lookup->retry_id);
+    g_list_free_full(lookup->queries, (GDestroyNotify)query_free);
+    g_array_unref(lookup->name_servers);
+    g_object_unref(lookup->loop);
+    g_free(lookup);
+}
+
+static void
+lookup_finish (MilterManagerDNSBLLookup *lookup)
+{
+    if (lookup->finished)
+        lookup->finished(lookup->user_data);
+    lookup_free(lookup);
+}
+
+static void
+query_done (Query *query)
+{
+    MilterManagerDNSBLLookup *lookup = query->lookup;
+
+    query->done = TRUE;
+    lookup->n_waiting_queries--;
+    if (lookup->n_waiting_queries == 0)
+        lookup_finish(lookup);
+}
+
+typedef enum {
+    RECEIVE_WAITING,
+    RECEIVE_DONE,
+    RECEIVE_ERROR
+} ReceiveResult;
+
+static ReceiveResult
+receive_response (Query *query)
+{
+    guint8 message[DNS_MESSAGE_SIZE];
+    gssize size;
+    guint rcode, n_answers, ttl;
+    guint32 answers[MAX_ANSWERS];
+
+    size = recv(g_io_channel_unix_get_fd(query->channel),
+                message, sizeof(message), 0);
+    if (size < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return RECEIVE_WAITING;
+        milter_debug("[dnsbl][lookup][receive][error] <%s>: %s",
+                     query->query_domain, g_strerror(errno));
+        return RECEIVE_ERROR;
+    }
+
+    if (!parse_response(message, size, query->id,
+                        &rcode, answers, &n_answers, &ttl))
+        return RECEIVE_WAITING;
+
+    milter_debug("[dnsbl][lookup][response] <%s>: rcode=%u answers=%u ttl=%u",
+                 query->query_domain, rcode, n_answers, ttl);
+    if (rcode == DNS_RCODE_NXDOMAIN) {
+        cache_write(query->query_domain, NULL, 0, negative_cache_ttl);
+    } else if (rcode == DNS_RCODE_NOERROR && n_answers > 0) {
+        cache_write(query->query_domain, answers, n_answers, ttl);
+    }
+
+    return RECEIVE_DONE;
+}
+
+static gboolean query_send (Query *query);
+
+static gboolean
+cb_response (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    Query *query = data;
+    ReceiveResult result;
+
+    result = receive_response(query);
+    if (result == RECEIVE_WAITING && !(condition & (G_IO_ERR | G_IO_HUP)))
+        return TRUE;
+
+    /* The watch is removed by returning FALSE. The event loop
+     * keeps its own reference of the channel. */
+    query->watch_id = 0;
+    if (result != RECEIVE_DONE) {
+        g_io_channel_unref(query->channel);
+        query->channel = NULL;
+        query->name_server_index++;
+        if (query_send(query))
+            return FALSE;
+    }
+    query_done(query);
+    return FALSE;
+}
+
+/* Sends the query to the current name server or the next
+ * name server that accepts it. */
+static gboolean
+query_send (Query *query)
+{
+    MilterManagerDNSBLLookup *lookup = query->lookup;
+    guint8 message[DNS_MESSAGE_SIZE];
+    gsize size;
+
+    size = build_query(query->query_domain, query->id, message);
+    if (size == 0)
+        return FALSE;
+
+    for (; query->name_server_index < lookup->name_servers->len;
+         query->name_server_index++) {
+        NameServer *name_server;
+        gint fd;
+
+        name_server = &g_array_index(lookup->name_servers, NameServer,
+                                     query->name_server_index);
+        fd = socket(name_server->address.address.base.sa_family,
+                    SOCK_DGRAM, 0);
+        if (fd == -1) {
+            milter_warning("[dnsbl][lookup][socket][error] %s",
+                           g_strerror(errno));
+            continue;
+        }
+        if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 ||
+            connect(fd, &(name_server->address.address.base),
+                    name_server->address_length) == -1 ||
+            send(fd, message, size, 0) != (gssize)size) {
+            milter_warning("[dnsbl][lookup][send][error] <%s>: %s",
+                           query->query_domain, g_strerror(errno));
+            close(fd);
+            continue;
+        }
+
+        query->channel = g_io_channel_unix_new(fd);
+        g_io_channel_set_close_on_unref(query->channel, TRUE);
+        query->watch_id = milter_event_loop_watch_io(lookup->loop,
+                                                     query->channel,
+                                                     G_IO_IN |
+                                                     G_IO_ERR | G_IO_HUP,
+                                                     cb_response,
+                                                     query);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Called every timeout / n_name_servers seconds. Waiting
+ * queries are sent to the next name server. Queries that
+ * all name servers didn't answer are failed. */
+static gboolean
+cb_retry (gpointer user_data)
+{
+    MilterManagerDNSBLLookup *lookup = user_data;
+    GList *node;
+    guint n_failed_queries = 0;
+
+    for (node = lookup->queries; node; node = g_list_next(node)) {
+        Query *query = node->data;
+
+        if (query->done)
+            continue;
+        query_close(query);
+        query->name_server_index++;
+        if (!query_send(query)) {
+            milter_debug("[dnsbl][lookup][timeout] <%s>", query->query_domain);
+            query->done = TRUE;
+            n_failed_queries++;
+        }
+    }
+
+    lookup->n_waiting_queries -= n_failed_queries;
+    if (lookup->n_waiting_queries > 0)
+        return TRUE;
+
+    lookup->retry_id = 0;
+    lookup_finish(lookup);
+    return FALSE;
+}
+
+static gchar *
+reverse_address (const struct sockaddr *address, socklen_t address_length)
+{
+    const struct sockaddr_in *address_inet;
+    const guint8 *octets;
+
+    if (address->sa_family != AF_INET ||
+        address_length < sizeof(struct sockaddr_in))
+        return NULL;
+
+    address_inet = (const struct sockaddr_in *)address;
+    octets = (const guint8 *)&(address_inet->sin_addr);
+    return g_strdup_printf("%u.%u.%u.%u",
+                           octets[3], octets[2], octets[1], octets[0]);
+}
+
+/**
+ * milter_manager_dnsbl_lookup:
+ * @loop: the event loop that runs the lookup.
+ * @address: the address of the connected host.
+ * @address_length: the length of @address.
+ * @finished: the function called when all queries are
+ *            answered or timed out.
+ * @user_data: the data passed to @finished.
+ *
+ * Starts looking up @address in the registered DNSBL
+ * services that aren't cached yet. Answers are stored in
+ * the cache. The lookup is freed after @finished is called.
+ *
+ * Returns: the lookup or %NULL when nothing needs to be
+ * looked up. @finished isn't called for %NULL.
+ *
+ * Since: 2.3.3
+ */
+MilterManagerDNSBLLookup *
+milter_manager_dnsbl_lookup (MilterEventLoop *loop,
+                             const struct sockaddr *address,
+                             socklen_t address_length,
+                             MilterManagerDNSBLLookupFinishedFunc finished,
+                             gpointer user_data)
+{
+    MilterManagerDNSBLLookup *lookup;
+    gchar *reversed_address;
+    GList *node;
+    guint i;
+
+    reversed_address = reverse_address(address, address_length);
+    if (!reversed_address)
+        return NULL;
+
+    lookup = g_new0(MilterManagerDNSBLLookup, 1);
+    g_mutex_lock(&dnsbl_mutex);
+    if (!name_servers)
+        load_default_name_servers();
+    lookup->name_servers = g_array_ref(name_servers);
+    for (i = 0; services && i < services->len; i++) {
+        Query *query;
+        gchar *query_domain;
+
+        query_domain = g_strconcat(reversed_address, ".",
+                                   g_ptr_array_index(services, i),
+                                   NULL);
+        if (milter_manager_dnsbl_get_cached_answers(query_domain, NULL)) {
+            g_free(query_domain);
+            continue;
+        }
+        query = g_new0(Query, 1);
+        query->lookup = lookup;
+        query->query_domain = query_domain;
+        query->id = g_random_int_range(0, G_MAXUINT16 + 1);
+        lookup->queries = g_list_prepend(lookup->queries, query);
+    }
+    g_mutex_unlock(&dnsbl_mutex);
+    g_free(reversed_address);
+
+    lookup->loop = g_object_ref(loop);
+    lookup->finished = finished;
+    lookup->user_data = user_data;
+    for (node = lookup->queries; node; node = g_list_next(node)) {
+        Query *query = node->data;
+
+        if (query_send(query)) {
+            lookup->n_waiting_queries++;
+        } else {
+            query->done = TRUE;
+        }
+    }
+
+    if (lookup->n_waiting_queries == 0) {
+        lookup_free(lookup);
+        return NULL;
+    }
+
+    lookup->retry_id =
+        milter_event_loop_add_timeout(loop,
+                                      timeout / lookup->name_servers->len,
+                                      cb_retry,
+                                      lookup);
+
+    return lookup;
+}
+
+/**
+ * milter_manager_dnsbl_lookup_cancel:
+ * @lookup: the lookup returned by milter_manager_dnsbl_lookup().
+ *
+ * Stops @lookup without calling its finished function and
+ * frees it. It must not be called from the finished function. Answers that are already received stay cached.
+ *
+ * Since: 2.3.3
+ */
+void
+milter_manager_dnsbl_lookup_cancel (MilterManagerDNSBLLookup *lookup)
+{
+    lookup_free(lookup);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
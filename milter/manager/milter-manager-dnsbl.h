@@ -0,0 +1,90 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_DNSBL_H__
+#define __MILTER_MANAGER_DNSBL_H__
+
+#include <milter/client.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_DNSBL_ERROR (milter_manager_dnsbl_error_quark())
+
+typedef enum
+{
+    MILTER_MANAGER_DNSBL_ERROR_INVALID_NAME_SERVER
+} MilterManagerDNSBLError;
+
+typedef struct _MilterManagerDNSBLLookup MilterManagerDNSBLLookup;
+
+typedef void (*MilterManagerDNSBLLookupFinishedFunc) (gpointer user_data);
+
+GQuark    milter_manager_dnsbl_error_quark     (void);
+
+/*
+ * DNSBL services are looked up by UDP queries on the event
+ * loop of the session. Answers are cached in memory shared
+ * with worker processes when milter_manager_dnsbl_init() is
+ * called before workers are forked.
+ *
+ * Only NXDOMAIN is cached negatively. Timeouts and error
+ * responses aren't cached.
+ */
+void      milter_manager_dnsbl_init            (void);
+void      milter_manager_dnsbl_quit            (void);
+
+void      milter_manager_dnsbl_add_service     (const gchar *domain);
+void      milter_manager_dnsbl_clear_services  (void);
+gboolean  milter_manager_dnsbl_add_name_server (const gchar *address,
+                                                guint        port,
+                                                GError     **error);
+void      milter_manager_dnsbl_clear_name_servers
+                                               (void);
+gdouble   milter_manager_dnsbl_get_timeout     (void);
+void      milter_manager_dnsbl_set_timeout     (gdouble      timeout);
+guint     milter_manager_dnsbl_get_negative_cache_ttl
+                                               (void);
+void      milter_manager_dnsbl_set_negative_cache_ttl
+                                               (guint        ttl);
+
+void      milter_manager_dnsbl_request_lookup  (MilterClientContext *context);
+gboolean  milter_manager_dnsbl_is_lookup_requested
+                                               (MilterClientContext *context);
+
+MilterManagerDNSBLLookup *
+          milter_manager_dnsbl_lookup          (MilterEventLoop       *loop,
+                                                const struct sockaddr *address,
+                                                socklen_t              address_length,
+                                                MilterManagerDNSBLLookupFinishedFunc
+                                                                       finished,
+                                                gpointer               user_data);
+void      milter_manager_dnsbl_lookup_cancel   (MilterManagerDNSBLLookup *lookup);
+
+gboolean  milter_manager_dnsbl_get_cached_answers
+                                               (const gchar *query_domain,
+                                                GList      **answers);
+void      milter_manager_dnsbl_clear_cache     (void);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_DNSBL_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
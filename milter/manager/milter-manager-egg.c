@@ -21,9 +21,16 @@
 #  include <config.h>
 #endif /* HAVE_CONFIG_H */
 
+#include <string.h>
+#include <arpa/inet.h>
+
 #include "milter-manager-egg.h"
 #include "milter-manager-enum-types.h"
 
+/* Resolved addresses of host names in connection specs are
+ * used for this seconds. */
+#define CONNECTION_ADDRESS_TTL 60
+
 #define TIMEOUT_LEEWAY 3
 #define DEFAULT_CONNECTION_TIMEOUT \
     (MILTER_SERVER_CONTEXT_DEFAULT_CONNECTION_TIMEOUT - TIMEOUT_LEEWAY)
@@ -46,6 +53,11 @@ struct _MilterManagerEggPrivate
     gchar *description;
     gboolean enabled;
     gchar *connection_spec;
+    gint connection_domain;
+    struct sockaddr *connection_address;
+    socklen_t connection_address_length;
+    gint64 connection_address_expire_time;
+    GMutex connection_address_mutex;
     gdouble connection_timeout;
     gdouble writing_timeout;
     gdouble reading_timeout;
@@ -56,6 +68,7 @@ struct _MilterManagerEggPrivate
     GList *applicable_conditions;
     MilterStatus fallback_status;
     gboolean evaluation_mode;
+    gboolean reuse_connection;
 };
 
 enum
@@ -73,7 +86,8 @@ enum
     PROP_COMMAND,
     PROP_COMMAND_OPTIONS,
     PROP_FALLBACK_STATUS,
-    PROP_REPUTATION_MODE
+    PROP_REPUTATION_MODE,
+    PROP_REUSE_CONNECTION
 };
 
 enum
@@ -90,6 +104,7 @@ MILTER_DEFINE_ERROR_EMITTABLE_TYPE(MilterManagerEgg,
                                    G_TYPE_OBJECT)
 
 static void dispose        (GObject         *object);
+static void finalize       (GObject         *object);
 static void set_property   (GObject         *object,
                             guint            prop_id,
                             const GValue    *value,
@@ -108,6 +123,7 @@ milter_manager_egg_class_init (MilterManagerEggClass *klass)
     gobject_class = G_OBJECT_CLASS(klass);
 
     gobject_class->dispose      = dispose;
+    gobject_class->finalize     = finalize;
     gobject_class->set_property = set_property;
     gobject_class->get_property = get_property;
 
@@ -215,6 +231,14 @@ milter_manager_egg_class_init (MilterManagerEggClass *klass)
                                 G_PARAM_READWRITE);
     g_object_class_install_property(gobject_class, PROP_REPUTATION_MODE, spec);
 
+    spec = g_param_spec_boolean("reuse-connection",
+                                "Reuse connection",
+                                "Whether the connection to the milter is reused "
+                                "for the next session or not",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_REUSE_CONNECTION, spec);
+
     signals[HATCHED] =
         g_signal_new("hatched",
                      G_TYPE_FROM_CLASS(klass),
@@ -248,6 +272,11 @@ milter_manager_egg_init (MilterManagerEgg *egg)
     priv->description = NULL;
     priv->enabled = TRUE;
     priv->connection_spec = NULL;
+    priv->connection_domain = PF_UNSPEC;
+    priv->connection_address = NULL;
+    priv->connection_address_length = 0;
+    priv->connection_address_expire_time = 0;
+    g_mutex_init(&(priv->connection_address_mutex));
     priv->connection_timeout = DEFAULT_CONNECTION_TIMEOUT;
     priv->writing_timeout = DEFAULT_WRITING_TIMEOUT;
     priv->reading_timeout = DEFAULT_READING_TIMEOUT;
@@ -258,6 +287,7 @@ milter_manager_egg_init (MilterManagerEgg *egg)
     priv->applicable_conditions = NULL;
     priv->fallback_status = MILTER_STATUS_ACCEPT;
     priv->evaluation_mode = FALSE;
+    priv->reuse_connection = FALSE;
 }
 
 static void
@@ -284,6 +314,11 @@ dispose (GObject *object)
         priv->connection_spec = NULL;
     }
 
+    if (priv->connection_address) {
+        g_free(priv->connection_address);
+        priv->connection_address = NULL;
+    }
+
     if (priv->user_name) {
         g_free(priv->user_name);
         priv->user_name = NULL;
@@ -304,6 +339,17 @@ dispose (GObject *object)
     G_OBJECT_CLASS(milter_manager_egg_parent_class)->dispose(object);
 }
 
+static void
+finalize (GObject *object)
+{
+    MilterManagerEggPrivate *priv;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(object);
+    g_mutex_clear(&(priv->connection_address_mutex));
+
+    G_OBJECT_CLASS(milter_manager_egg_parent_class)->finalize(object);
+}
+
 static void
 set_property (GObject      *object,
               guint         prop_id,
@@ -355,6 +401,10 @@ set_property (GObject      *object,
     case PROP_REPUTATION_MODE:
         milter_manager_egg_set_evaluation_mode(egg, g_value_get_boolean(value));
         break;
+    case PROP_REUSE_CONNECTION:
+        milter_manager_egg_set_reuse_connection(egg,
+                                                g_value_get_boolean(value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -410,6 +460,9 @@ get_property (GObject    *object,
     case PROP_REPUTATION_MODE:
         g_value_set_boolean(value, priv->evaluation_mode);
         break;
+    case PROP_REUSE_CONNECTION:
+        g_value_set_boolean(value, priv->reuse_connection);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -450,11 +503,106 @@ hatch (const gchar *first_name, ...)
  * Returns: (transfer full) (nullable):
  *   A newly created milter manager egg hatch.
  */
+/* Unix domain socket specs and IP address specs are parsed
+ * only once. Specs that have a host name are resolved again
+ * after CONNECTION_ADDRESS_TTL seconds to follow DNS changes. */
+static gboolean
+connection_spec_has_host_name (const gchar *spec)
+{
+    const gchar *host;
+    guint8 address[sizeof(struct in6_addr)];
+
+    if (!g_str_has_prefix(spec, "inet:") && !g_str_has_prefix(spec, "inet6:"))
+        return FALSE;
+
+    host = strchr(spec, '@');
+    if (!host)
+        return FALSE;
+    host++;
+    if (host[0] == '[')
+        return FALSE;
+    if (inet_pton(AF_INET, host, address) == 1 ||
+        inet_pton(AF_INET6, host, address) == 1)
+        return FALSE;
+
+    return TRUE;
+}
+
+static gint64
+compute_connection_address_expire_time (const gchar *spec)
+{
+    if (!spec || !connection_spec_has_host_name(spec))
+        return 0;
+
+    return g_get_monotonic_time() + CONNECTION_ADDRESS_TTL * G_USEC_PER_SEC;
+}
+
+/* Must be called with connection_address_mutex. */
+static void
+resolve_connection_address (MilterManagerEgg *egg)
+{
+    MilterManagerEggPrivate *priv;
+    GError *error = NULL;
+    gint domain;
+    struct sockaddr *address = NULL;
+    socklen_t address_length;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    if (milter_connection_parse_spec(priv->connection_spec,
+                                     &domain,
+                                     &address,
+                                     &address_length,
+                                     &error)) {
+        g_free(priv->connection_address);
+        priv->connection_address = address;
+        priv->connection_domain = domain;
+        priv->connection_address_length = address_length;
+    } else {
+        milter_warning("[egg][resolve][error] <%s>: %s: "
+                       "use the previous address",
+                       priv->name ? priv->name : "(null)",
+                       error->message);
+        g_error_free(error);
+        if (address)
+            g_free(address);
+    }
+    priv->connection_address_expire_time =
+        compute_connection_address_expire_time(priv->connection_spec);
+}
+
+static struct sockaddr *
+copy_connection_address (MilterManagerEgg *egg,
+                         gint *domain,
+                         socklen_t *address_length)
+{
+    MilterManagerEggPrivate *priv;
+    struct sockaddr *address = NULL;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    g_mutex_lock(&(priv->connection_address_mutex));
+    if (priv->connection_address &&
+        priv->connection_address_expire_time > 0 &&
+        priv->connection_address_expire_time <= g_get_monotonic_time())
+        resolve_connection_address(egg);
+    if (priv->connection_address) {
+        address = g_memdup(priv->connection_address,
+                           priv->connection_address_length);
+        *domain = priv->connection_domain;
+        *address_length = priv->connection_address_length;
+    }
+    g_mutex_unlock(&(priv->connection_address_mutex));
+
+    return address;
+}
+
 MilterManagerChild *
 milter_manager_egg_hatch (MilterManagerEgg *egg)
 {
     MilterManagerChild *child;
     MilterManagerEggPrivate *priv;
+    struct sockaddr *address;
+    gint domain = PF_UNSPEC;
+    socklen_t address_length = 0;
 
     priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
 
@@ -468,9 +616,22 @@ milter_manager_egg_hatch (MilterManagerEgg *egg)
                   "command-options", priv->command_options,
                   "fallback-status", priv->fallback_status,
                   "evaluation-mode", priv->evaluation_mode,
+                  "reuse-connection", priv->reuse_connection,
                   NULL);
 
-    if (priv->connection_spec) {
+    address = copy_connection_address(egg, &domain, &address_length);
+    if (address) {
+        /* The spec isn't parsed for each session. See
+         * copy_connection_address(). */
+        milter_server_context_set_connection_address(
+            MILTER_SERVER_CONTEXT(child),
+            priv->connection_spec,
+            domain,
+            address,
+            address_length);
+        g_free(address);
+        g_signal_emit(egg, signals[HATCHED], 0, child);
+    } else if (priv->connection_spec) {
         GError *error = NULL;
         MilterServerContext *context;
 
@@ -563,16 +724,30 @@ milter_manager_egg_set_connection_spec (MilterManagerEgg *egg,
                                                &address_length,
                                                &spec_error);
 
-    if (address)
-        g_free(address);
-
     if (success) {
+        g_mutex_lock(&(priv->connection_address_mutex));
         if (priv->connection_spec)
             g_free(priv->connection_spec);
         priv->connection_spec = g_strdup(spec);
+        if (priv->connection_address)
+            g_free(priv->connection_address);
+        priv->connection_address = address;
+        if (address) {
+            priv->connection_domain = domain;
+            priv->connection_address_length = address_length;
+        } else {
+            priv->connection_domain = PF_UNSPEC;
+            priv->connection_address_length = 0;
+        }
+        priv->connection_address_expire_time =
+            compute_connection_address_expire_time(spec);
+        g_mutex_unlock(&(priv->connection_address_mutex));
     } else {
         GError *wrapped_error = NULL;
 
+        if (address)
+            g_free(address);
+
         milter_utils_set_error_with_sub_error(&wrapped_error,
                                               MILTER_MANAGER_EGG_ERROR,
                                               MILTER_MANAGER_EGG_ERROR_INVALID,
@@ -738,6 +913,19 @@ milter_manager_egg_is_evaluation_mode (MilterManagerEgg *egg)
     return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->evaluation_mode;
 }
 
+void
+milter_manager_egg_set_reuse_connection (MilterManagerEgg *egg,
+                                         gboolean          reuse_connection)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->reuse_connection = reuse_connection;
+}
+
+gboolean
+milter_manager_egg_is_reuse_connection (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->reuse_connection;
+}
+
 void
 milter_manager_egg_add_applicable_condition (MilterManagerEgg *egg,
                                              MilterManagerApplicableCondition *condition)
@@ -828,6 +1016,9 @@ milter_manager_egg_merge (MilterManagerEgg *egg,
 
     milter_manager_egg_set_enabled(egg,
                                    milter_manager_egg_is_enabled(other_egg));
+    milter_manager_egg_set_reuse_connection(
+        egg,
+        milter_manager_egg_is_reuse_connection(other_egg));
 
     user_name = milter_manager_egg_get_user_name(other_egg);
     if (user_name)
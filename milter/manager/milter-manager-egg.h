@@ -134,6 +134,11 @@ void                milter_manager_egg_set_evaluation_mode
                                                  gboolean          evaluation_mode);
 gboolean            milter_manager_egg_is_evaluation_mode
                                                 (MilterManagerEgg *egg);
+void                milter_manager_egg_set_reuse_connection
+                                                (MilterManagerEgg *egg,
+                                                 gboolean          reuse_connection);
+gboolean            milter_manager_egg_is_reuse_connection
+                                                (MilterManagerEgg *egg);
 
 void                milter_manager_egg_add_applicable_condition
                                                 (MilterManagerEgg *egg,
@@ -24,6 +24,8 @@
 #include "milter-manager-leader.h"
 #include "milter-manager-enum-types.h"
 #include "milter-manager-children.h"
+#include "milter-manager-tcp-connection-table.h"
+#include "milter-manager-dnsbl.h"
 
 #define MILTER_MANAGER_LEADER_GET_PRIVATE(obj)                   \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                          \
@@ -34,6 +36,7 @@ typedef struct _MilterManagerLeaderPrivate MilterManagerLeaderPrivate;
 struct _MilterManagerLeaderPrivate
 {
     MilterManagerConfiguration *configuration;
+    MilterManagerConfigurationSnapshot *configuration_snapshot;
     MilterClientContext *client_context;
     MilterManagerChildren *children;
     MilterManagerLeaderState state;
@@ -42,6 +45,10 @@ struct _MilterManagerLeaderPrivate
     GIOChannel *launcher_write_channel;
     gboolean processing;
     guint tag;
+    MilterManagerDNSBLLookup *dnsbl_lookup;
+    gchar *connect_host_name;
+    struct sockaddr *connect_address;
+    socklen_t connect_address_length;
 };
 
 enum
@@ -85,6 +92,8 @@ static void teardown_children_signals
                             MilterManagerChildren *children);
 static void reply          (MilterManagerLeader *leader,
                             MilterStatus         status);
+static void cancel_dnsbl_lookup
+                           (MilterManagerLeader *leader);
 static gboolean boolean_handled_accumulator
                            (GSignalInvocationHint *hint,
                             GValue                *return_accumulator,
@@ -146,6 +155,7 @@ milter_manager_leader_init (MilterManagerLeader *leader)
 
     priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
     priv->configuration = NULL;
+    priv->configuration_snapshot = NULL;
     priv->client_context = NULL;
     priv->children = NULL;
     priv->state = MILTER_MANAGER_LEADER_STATE_START;
@@ -154,6 +164,10 @@ milter_manager_leader_init (MilterManagerLeader *leader)
     priv->launcher_write_channel = NULL;
     priv->processing = FALSE;
     priv->tag = 0;
+    priv->dnsbl_lookup = NULL;
+    priv->connect_host_name = NULL;
+    priv->connect_address = NULL;
+    priv->connect_address_length = 0;
 }
 
 gboolean
@@ -255,6 +269,8 @@ dispose (GObject *object)
 
     milter_debug("[%u] [leader][dispose]", priv->tag);
 
+    cancel_dnsbl_lookup(leader);
+
     if (priv->configuration) {
         g_object_unref(priv->configuration);
         priv->configuration = NULL;
@@ -270,6 +286,12 @@ dispose (GObject *object)
         g_object_unref(priv->children);
         priv->children = NULL;
     }
+
+    if (priv->configuration_snapshot) {
+        milter_manager_configuration_snapshot_unref(
+            priv->configuration_snapshot);
+        priv->configuration_snapshot = NULL;
+    }
     milter_manager_leader_set_launcher_channel(leader, NULL, NULL);
 
 
@@ -334,10 +356,97 @@ get_property (GObject    *object,
     }
 }
 
+/* The same as Milter::SocketAddress#local? in Ruby. */
+static gboolean
+is_local_address (MilterGenericSocketAddress *address)
+{
+    switch (address->address.base.sa_family) {
+      case AF_UNIX:
+        return TRUE;
+      case AF_INET:
+      {
+          guint32 ipv4_address;
+
+          ipv4_address = g_ntohl(address->address.inet.sin_addr.s_addr);
+          return ((ipv4_address & 0xff000000) == 0x7f000000 ||
+                  (ipv4_address & 0xff000000) == 0x0a000000 ||
+                  (ipv4_address & 0xfff00000) == 0xac100000 ||
+                  (ipv4_address & 0xffff0000) == 0xc0a80000);
+      }
+      case AF_INET6:
+        return (IN6_IS_ADDR_LOOPBACK(&(address->address.inet6.sin6_addr)) ||
+                IN6_IS_ADDR_LINKLOCAL(&(address->address.inet6.sin6_addr)));
+      default:
+        return FALSE;
+    }
+}
+
+static gboolean
+check_tcp_connection (MilterManagerLeader *leader)
+{
+    MilterManagerLeaderPrivate *priv;
+    MilterGenericSocketAddress *mta_address;
+    struct sockaddr *address;
+    socklen_t address_length;
+    guint16 port;
+    MilterManagerTCPState state;
+    gboolean connected = TRUE;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+
+    /* SMTP connections are visible only when MTA is on this host. */
+    mta_address = milter_client_context_get_socket_address(priv->client_context);
+    if (!mta_address || !is_local_address(mta_address))
+        return TRUE;
+
+    if (!priv->children)
+        return TRUE;
+    if (!milter_manager_children_get_smtp_client_address(priv->children,
+                                                         &address,
+                                                         &address_length))
+        return TRUE;
+
+    switch (address->sa_family) {
+      case AF_INET:
+        port = ((struct sockaddr_in *)address)->sin_port;
+        break;
+      case AF_INET6:
+        port = ((struct sockaddr_in6 *)address)->sin6_port;
+        break;
+      default:
+        g_free(address);
+        return TRUE;
+    }
+
+    if (port == 0) {
+        milter_warning("[%u] [leader][connection-check][warning] "
+                       "can't detect disconnected connection because "
+                       "SMTP client port address is unknown",
+                       priv->tag);
+    } else if (milter_manager_tcp_connection_table_lookup(address,
+                                                          address_length,
+                                                          FALSE,
+                                                          &state,
+                                                          NULL)) {
+        connected = (state != MILTER_MANAGER_TCP_STATE_CLOSE_WAIT);
+    }
+    g_free(address);
+
+    return connected;
+}
+
 static gboolean
 connection_check_default (MilterManagerLeader *leader)
 {
+    MilterManagerLeaderPrivate *priv;
     gboolean connecting = TRUE;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+    if (priv->configuration &&
+        milter_manager_configuration_is_use_tcp_connection_table(
+            priv->configuration)) {
+        connecting = check_tcp_connection(leader);
+    }
     return connecting;
 }
 
@@ -999,9 +1108,13 @@ milter_manager_leader_negotiate (MilterManagerLeader *leader,
     event_loop = milter_agent_get_event_loop(MILTER_AGENT(priv->client_context));
     priv->children = milter_manager_children_new(priv->configuration,
                                                  event_loop);
-    milter_manager_configuration_setup_children(priv->configuration,
-                                                priv->children,
-                                                priv->client_context);
+    if (!priv->configuration_snapshot)
+        priv->configuration_snapshot =
+            milter_manager_configuration_get_snapshot(priv->configuration);
+    milter_manager_configuration_snapshot_setup_children(
+        priv->configuration_snapshot,
+        priv->children,
+        priv->client_context);
     fallback_status =
         milter_manager_configuration_get_fallback_status(priv->configuration);
     if (!priv->children)
@@ -1022,6 +1135,87 @@ milter_manager_leader_negotiate (MilterManagerLeader *leader,
     }
 }
 
+static void
+clear_connect_arguments (MilterManagerLeaderPrivate *priv)
+{
+    if (priv->connect_host_name) {
+        g_free(priv->connect_host_name);
+        priv->connect_host_name = NULL;
+    }
+    if (priv->connect_address) {
+        g_free(priv->connect_address);
+        priv->connect_address = NULL;
+    }
+    priv->connect_address_length = 0;
+}
+
+static void
+cancel_dnsbl_lookup (MilterManagerLeader *leader)
+{
+    MilterManagerLeaderPrivate *priv;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+    if (priv->dnsbl_lookup) {
+        milter_manager_dnsbl_lookup_cancel(priv->dnsbl_lookup);
+        priv->dnsbl_lookup = NULL;
+    }
+    clear_connect_arguments(priv);
+}
+
+static void
+cb_dnsbl_lookup_finished (gpointer user_data)
+{
+    MilterManagerLeader *leader = user_data;
+    MilterManagerLeaderPrivate *priv;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+    priv->dnsbl_lookup = NULL;
+    milter_debug("[%u] [leader][dnsbl][finished]", priv->tag);
+
+    if (priv->state == MILTER_MANAGER_LEADER_STATE_CONNECT &&
+        !milter_manager_children_connect(priv->children,
+                                         priv->connect_host_name,
+                                         priv->connect_address,
+                                         priv->connect_address_length)) {
+        reply(leader,
+              milter_manager_configuration_get_fallback_status(
+                  priv->configuration));
+    }
+    clear_connect_arguments(priv);
+}
+
+/* Children are connected after DNSBL services are looked up
+ * without blocking other sessions. Applicable conditions
+ * that use DNSBL read the cached answers. */
+static gboolean
+start_dnsbl_lookup (MilterManagerLeader *leader,
+                    const gchar         *host_name,
+                    struct sockaddr     *address,
+                    socklen_t            address_length)
+{
+    MilterManagerLeaderPrivate *priv;
+    MilterEventLoop *loop;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+    if (!milter_manager_dnsbl_is_lookup_requested(priv->client_context))
+        return FALSE;
+
+    loop = milter_agent_get_event_loop(MILTER_AGENT(priv->client_context));
+    priv->dnsbl_lookup = milter_manager_dnsbl_lookup(loop,
+                                                     address,
+                                                     address_length,
+                                                     cb_dnsbl_lookup_finished,
+                                                     leader);
+    if (!priv->dnsbl_lookup)
+        return FALSE;
+
+    milter_debug("[%u] [leader][dnsbl][start]", priv->tag);
+    priv->connect_host_name = g_strdup(host_name);
+    priv->connect_address = g_memdup(address, address_length);
+    priv->connect_address_length = address_length;
+    return TRUE;
+}
+
 MilterStatus
 milter_manager_leader_connect (MilterManagerLeader *leader,
                                const gchar         *host_name,
@@ -1039,6 +1233,9 @@ milter_manager_leader_connect (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (start_dnsbl_lookup(leader, host_name, address, address_length))
+        return MILTER_STATUS_PROGRESS;
+
     if (milter_manager_children_connect(priv->children, host_name,
                                         address, address_length)) {
         return MILTER_STATUS_PROGRESS;
@@ -1279,6 +1476,7 @@ milter_manager_leader_quit (MilterManagerLeader *leader)
 
     priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
     priv->state = MILTER_MANAGER_LEADER_STATE_QUIT;
+    cancel_dnsbl_lookup(leader);
 
     fallback_status =
         milter_manager_configuration_get_fallback_status(priv->configuration);
@@ -1297,6 +1495,7 @@ milter_manager_leader_abort (MilterManagerLeader *leader)
 
     priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
     priv->state = MILTER_MANAGER_LEADER_STATE_ABORT;
+    cancel_dnsbl_lookup(leader);
 
     fallback_status =
         milter_manager_configuration_get_fallback_status(priv->configuration);
@@ -1375,6 +1574,24 @@ milter_manager_leader_get_children (MilterManagerLeader *leader)
     return MILTER_MANAGER_LEADER_GET_PRIVATE(leader)->children;
 }
 
+MilterManagerLeaderState
+milter_manager_leader_get_state (MilterManagerLeader *leader)
+{
+    return MILTER_MANAGER_LEADER_GET_PRIVATE(leader)->state;
+}
+
+/**
+ * milter_manager_leader_get_client_context:
+ * @leader: A #MilterManagerLeader.
+ *
+ * Returns: (transfer none): The client context of @leader.
+ */
+MilterClientContext *
+milter_manager_leader_get_client_context (MilterManagerLeader *leader)
+{
+    return MILTER_MANAGER_LEADER_GET_PRIVATE(leader)->client_context;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
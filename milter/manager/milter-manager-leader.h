@@ -163,6 +163,11 @@ void                  milter_manager_leader_set_tag
 
 MilterManagerChildren *milter_manager_leader_get_children
                                           (MilterManagerLeader *leader);
+MilterManagerLeaderState
+                      milter_manager_leader_get_state
+                                          (MilterManagerLeader *leader);
+MilterClientContext  *milter_manager_leader_get_client_context
+                                          (MilterManagerLeader *leader);
 
 G_END_DECLS
 
@@ -179,6 +179,10 @@ milter_manager_quit (void)
     }
 
     _milter_manager_configuration_quit();
+    milter_manager_metrics_quit();
+    milter_manager_dnsbl_quit();
+    milter_manager_connection_pool_clear();
+    milter_manager_tcp_connection_table_clear();
 
     g_log_remove_handler("milter-manager", milter_manager_log_handler_id);
     milter_server_quit();
@@ -438,7 +442,9 @@ start_process_launcher_process (MilterManager *manager)
                                                             reply_pipe_p,
                                                             &read_channel,
                                                             &write_channel);
-        if (start_process_launcher(read_channel, write_channel, daemon)) {
+        success = start_process_launcher(read_channel, write_channel, daemon);
+        milter_logger_flush(milter_logger());
+        if (success) {
             _exit(EXIT_SUCCESS);
         } else {
             _exit(EXIT_FAILURE);
@@ -704,6 +710,9 @@ milter_manager_main (void)
     SET_SIGNAL_ACTION(USR1, usr1, reopen_log_action);
 #undef SET_SIGNAL_ACTION
 
+    milter_manager_metrics_init(milter_client_get_n_workers(client));
+    milter_manager_dnsbl_init();
+
     if (!milter_client_run(client, &error)) {
         milter_manager_error("failed to start milter-manager process: %s",
                              error->message);
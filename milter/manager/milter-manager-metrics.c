@@ -0,0 +1,638 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "milter-manager-metrics.h"
+
+#ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define MAX_CHILDREN 64
+#define CHILD_NAME_SIZE 256
+#define N_STATUSES (MILTER_STATUS_ERROR + 1)
+#define N_SESSION_STATES (MILTER_CLIENT_CONTEXT_STATE_FINISHED + 1)
+#define N_CHILD_STATES (MILTER_SERVER_CONTEXT_STATE_ABORT + 1)
+#define FIRST_CHILD_STAGE MILTER_SERVER_CONTEXT_STATE_NEGOTIATE
+#define LAST_CHILD_STAGE MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE
+#define N_CHILD_STAGES (LAST_CHILD_STAGE - FIRST_CHILD_STAGE + 1)
+#define N_DURATION_BUCKETS 14
+
+/* Counters are only updated by the process that owns the slot
+ * but sessions may run in several threads in multi-thread
+ * mode. Relaxed atomic operations are enough for counters. */
+#define COUNTER_ADD(counter, n)                                 \
+    __atomic_add_fetch(&(counter), (n), __ATOMIC_RELAXED)
+#define COUNTER_GET(counter)                                    \
+    __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+static const gdouble duration_buckets[N_DURATION_BUCKETS] = {
+    0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+    1, 2.5, 5, 10, 30, 60
+};
+
+typedef struct _Histogram
+{
+    guint64 counts[N_DURATION_BUCKETS + 1];
+    guint64 sum_usec;
+} Histogram;
+
+typedef struct _ChildMetrics
+{
+    gchar name[CHILD_NAME_SIZE];
+    guint64 results[N_CHILD_STATES][N_STATUSES];
+    Histogram duration;
+    /* From a command to its reply. */
+    Histogram stage_durations[N_CHILD_STAGES];
+} ChildMetrics;
+
+typedef struct _Slot
+{
+    GPid pid;
+    guint64 n_body_spills;
+    guint64 results[N_SESSION_STATES][N_STATUSES];
+    Histogram duration;
+    gint n_children;
+    ChildMetrics children[MAX_CHILDREN];
+} Slot;
+
+static Slot *slots = NULL;
+static guint n_slots = 0;
+static gboolean slots_shared = FALSE;
+static Slot *current_slot = NULL;
+static GMutex metrics_mutex;
+
+static void
+free_slots (void)
+{
+    if (!slots)
+        return;
+
+    if (slots_shared) {
+        munmap(slots, sizeof(Slot) * n_slots);
+    } else {
+        g_free(slots);
+    }
+    slots = NULL;
+    n_slots = 0;
+    slots_shared = FALSE;
+    current_slot = NULL;
+}
+
+static void
+allocate_slots (guint n)
+{
+    gpointer memory;
+
+    memory = mmap(NULL, sizeof(Slot) * n,
+                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                  -1, 0);
+    if (memory == MAP_FAILED) {
+        milter_warning("[metrics][allocate][shared][error] %s: "
+                       "metrics of worker processes aren't reported",
+                       g_strerror(errno));
+        slots = g_new0(Slot, n);
+        slots_shared = FALSE;
+    } else {
+        slots = memory;
+        slots_shared = TRUE;
+    }
+    n_slots = n;
+    current_slot = slots;
+    current_slot->pid = getpid();
+}
+
+void
+milter_manager_metrics_init (guint n_workers)
+{
+    g_mutex_lock(&metrics_mutex);
+    free_slots();
+    allocate_slots(n_workers + 1);
+    g_mutex_unlock(&metrics_mutex);
+}
+
+void
+milter_manager_metrics_quit (void)
+{
+    g_mutex_lock(&metrics_mutex);
+    free_slots();
+    g_mutex_unlock(&metrics_mutex);
+}
+
+void
+milter_manager_metrics_set_worker_id (guint worker_id)
+{
+    g_mutex_lock(&metrics_mutex);
+    if (worker_id < n_slots) {
+        current_slot = slots + worker_id;
+        current_slot->pid = getpid();
+    } else {
+        milter_warning("[metrics][worker-id][out-of-range] %u >= %u",
+                       worker_id, n_slots);
+    }
+    g_mutex_unlock(&metrics_mutex);
+}
+
+static Slot *
+get_current_slot (void)
+{
+    Slot *slot;
+
+    slot = g_atomic_pointer_get(&current_slot);
+    if (G_LIKELY(slot))
+        return slot;
+
+    g_mutex_lock(&metrics_mutex);
+    if (!current_slot)
+        allocate_slots(1);
+    slot = current_slot;
+    g_mutex_unlock(&metrics_mutex);
+
+    return slot;
+}
+
+static void
+histogram_observe (Histogram *histogram, gdouble seconds)
+{
+    guint i;
+
+    if (seconds < 0)
+        seconds = 0;
+    for (i = 0; i < N_DURATION_BUCKETS; i++) {
+        if (seconds <= duration_buckets[i])
+            break;
+    }
+    COUNTER_ADD(histogram->counts[i], 1);
+    COUNTER_ADD(histogram->sum_usec, (guint64)(seconds * G_USEC_PER_SEC));
+}
+
+void
+milter_manager_metrics_record_session (MilterClientContextState last_state,
+                                       MilterStatus status,
+                                       gdouble elapsed)
+{
+    Slot *slot;
+
+    slot = get_current_slot();
+    if ((guint)last_state < N_SESSION_STATES && (guint)status < N_STATUSES)
+        COUNTER_ADD(slot->results[last_state][status], 1);
+    histogram_observe(&(slot->duration), elapsed);
+}
+
+void
+milter_manager_metrics_record_body_spill (void)
+{
+    COUNTER_ADD(get_current_slot()->n_body_spills, 1);
+}
+
+static ChildMetrics *
+find_child (Slot *slot, const gchar *name)
+{
+    gchar key[CHILD_NAME_SIZE];
+    gint i, n_children;
+    ChildMetrics *child = NULL;
+
+    g_strlcpy(key, name, sizeof(key));
+
+    n_children = g_atomic_int_get(&(slot->n_children));
+    for (i = 0; i < n_children; i++) {
+        if (strcmp(slot->children[i].name, key) == 0)
+            return slot->children + i;
+    }
+
+    g_mutex_lock(&metrics_mutex);
+    for (; i < slot->n_children; i++) {
+        if (strcmp(slot->children[i].name, key) == 0) {
+            child = slot->children + i;
+            break;
+        }
+    }
+    if (!child) {
+        if (slot->n_children < MAX_CHILDREN) {
+            child = slot->children + slot->n_children;
+            strcpy(child->name, key);
+            g_atomic_int_inc(&(slot->n_children));
+        } else {
+            milter_debug("[metrics][child][full] <%s>", key);
+        }
+    }
+    g_mutex_unlock(&metrics_mutex);
+
+    return child;
+}
+
+void
+milter_manager_metrics_record_child (const gchar *name,
+                                     MilterServerContextState last_state,
+                                     MilterStatus status,
+                                     gdouble elapsed)
+{
+    ChildMetrics *child;
+
+    if (!name)
+        return;
+
+    child = find_child(get_current_slot(), name);
+    if (!child)
+        return;
+
+    if ((guint)last_state < N_CHILD_STATES && (guint)status < N_STATUSES)
+        COUNTER_ADD(child->results[last_state][status], 1);
+    histogram_observe(&(child->duration), elapsed);
+}
+
+void
+milter_manager_metrics_record_child_stage (const gchar *name,
+                                           MilterServerContextState stage,
+                                           gdouble elapsed)
+{
+    ChildMetrics *child;
+
+    if (!name)
+        return;
+    if (stage < FIRST_CHILD_STAGE || LAST_CHILD_STAGE < stage)
+        return;
+
+    child = find_child(get_current_slot(), name);
+    if (!child)
+        return;
+
+    histogram_observe(&(child->stage_durations[stage - FIRST_CHILD_STAGE]),
+                      elapsed);
+}
+
+guint
+milter_manager_metrics_get_n_workers (void)
+{
+    guint n_workers;
+
+    g_mutex_lock(&metrics_mutex);
+    n_workers = n_slots > 0 ? n_slots - 1 : 0;
+    g_mutex_unlock(&metrics_mutex);
+
+    return n_workers;
+}
+
+GPid
+milter_manager_metrics_get_worker_pid (guint worker_id)
+{
+    GPid pid = 0;
+
+    g_mutex_lock(&metrics_mutex);
+    if (worker_id < n_slots)
+        pid = slots[worker_id].pid;
+    g_mutex_unlock(&metrics_mutex);
+
+    return pid;
+}
+
+static guint64
+histogram_count (Histogram *histogram)
+{
+    guint i;
+    guint64 count = 0;
+
+    for (i = 0; i < N_DURATION_BUCKETS + 1; i++) {
+        count += COUNTER_GET(histogram->counts[i]);
+    }
+    return count;
+}
+
+guint64
+milter_manager_metrics_get_n_sessions (guint worker_id)
+{
+    guint64 n_sessions = 0;
+
+    g_mutex_lock(&metrics_mutex);
+    if (worker_id < n_slots)
+        n_sessions = histogram_count(&(slots[worker_id].duration));
+    g_mutex_unlock(&metrics_mutex);
+
+    return n_sessions;
+}
+
+guint64
+milter_manager_metrics_get_n_body_spills (guint worker_id)
+{
+    guint64 n_body_spills = 0;
+
+    g_mutex_lock(&metrics_mutex);
+    if (worker_id < n_slots)
+        n_body_spills = COUNTER_GET(slots[worker_id].n_body_spills);
+    g_mutex_unlock(&metrics_mutex);
+
+    return n_body_spills;
+}
+
+/* Estimates a percentile by linear interpolation in the
+ * matched bucket like Prometheus's histogram_quantile(). */
+gdouble
+milter_manager_metrics_get_child_duration_percentile (const gchar *name,
+                                                      gdouble percentile)
+{
+    guint64 counts[N_DURATION_BUCKETS + 1];
+    guint64 total = 0, cumulative = 0;
+    gdouble rank, lower, upper;
+    guint i, j;
+    gchar key[CHILD_NAME_SIZE];
+
+    g_strlcpy(key, name, sizeof(key));
+    memset(counts, 0, sizeof(counts));
+
+    g_mutex_lock(&metrics_mutex);
+    for (i = 0; i < n_slots; i++) {
+        gint k, n_children;
+
+        n_children = g_atomic_int_get(&(slots[i].n_children));
+        for (k = 0; k < n_children; k++) {
+            ChildMetrics *child = slots[i].children + k;
+
+            if (strcmp(child->name, key) != 0)
+                continue;
+            for (j = 0; j < N_DURATION_BUCKETS + 1; j++) {
+                counts[j] += COUNTER_GET(child->duration.counts[j]);
+            }
+        }
+    }
+    g_mutex_unlock(&metrics_mutex);
+
+    for (j = 0; j < N_DURATION_BUCKETS + 1; j++) {
+        total += counts[j];
+    }
+    if (total == 0)
+        return -1.0;
+
+    rank = CLAMP(percentile, 0.0, 1.0) * total;
+    for (j = 0; j < N_DURATION_BUCKETS; j++) {
+        if (cumulative + counts[j] >= rank && counts[j] > 0)
+            break;
+        cumulative += counts[j];
+    }
+    if (j == N_DURATION_BUCKETS)
+        return duration_buckets[N_DURATION_BUCKETS - 1];
+
+    lower = j == 0 ? 0.0 : duration_buckets[j - 1];
+    upper = duration_buckets[j];
+    return lower + (upper - lower) * (rank - cumulative) / counts[j];
+}
+
+static void
+append_label_value (GString *output, const gchar *value)
+{
+    const gchar *p;
+
+    g_string_append_c(output, '"');
+    for (p = value; *p; p++) {
+        switch (*p) {
+          case '\\':
+            g_string_append(output, "\\\\");
+            break;
+          case '"':
+            g_string_append(output, "\\\"");
+            break;
+          case '\n':
+            g_string_append(output, "\\n");
+            break;
+          default:
+            g_string_append_c(output, *p);
+            break;
+        }
+    }
+    g_string_append_c(output, '"');
+}
+
+static void
+append_results (GString *output, const gchar *name, const gchar *labels,
+                guint64 *results, guint n_states, GType state_type)
+{
+    guint state, status;
+
+    for (state = 0; state < n_states; state++) {
+        for (status = 0; status < N_STATUSES; status++) {
+            guint64 count;
+            gchar *state_name, *status_name;
+
+            count = COUNTER_GET(results[state * N_STATUSES + status]);
+            if (count == 0)
+                continue;
+
+            state_name = milter_utils_get_enum_nick_name(state_type, state);
+            status_name = milter_utils_get_enum_nick_name(MILTER_TYPE_STATUS,
+                                                          status);
+            g_string_append_printf(output,
+                                   "%s_total{%s,stage=\"%s\",status=\"%s\"} "
+                                   "%" G_GUINT64_FORMAT "\n",
+                                   name, labels, state_name, status_name,
+                                   count);
+            g_free(state_name);
+            g_free(status_name);
+        }
+    }
+}
+
+static void
+append_histogram (GString *output, const gchar *name, const gchar *labels,
+                  Histogram *histogram)
+{
+    guint i;
+    guint64 count = 0;
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+    for (i = 0; i < N_DURATION_BUCKETS; i++) {
+        count += COUNTER_GET(histogram->counts[i]);
+        g_ascii_formatd(buffer, sizeof(buffer), "%g", duration_buckets[i]);
+        g_string_append_printf(output,
+                               "%s_bucket{%s,le=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                               name, labels, buffer, count);
+    }
+    count += COUNTER_GET(histogram->counts[N_DURATION_BUCKETS]);
+    g_string_append_printf(output,
+                           "%s_bucket{%s,le=\"+Inf\"} %" G_GUINT64_FORMAT "\n",
+                           name, labels, count);
+    g_string_append_printf(output,
+                           "%s_count{%s} %" G_GUINT64_FORMAT "\n",
+                           name, labels, count);
+    g_ascii_formatd(buffer, sizeof(buffer), "%.6f",
+                    COUNTER_GET(histogram->sum_usec) /
+                    (gdouble)G_USEC_PER_SEC);
+    g_string_append_printf(output, "%s_sum{%s} %s\n", name, labels, buffer);
+}
+
+static gchar *
+child_labels (guint worker_id, ChildMetrics *child)
+{
+    GString *labels;
+
+    labels = g_string_new(NULL);
+    g_string_append_printf(labels, "worker=\"%u\",child=", worker_id);
+    append_label_value(labels, child->name);
+    return g_string_free(labels, FALSE);
+}
+
+gchar *
+milter_manager_metrics_to_open_metrics (void)
+{
+    GString *output;
+    guint i;
+
+    output = g_string_new(NULL);
+
+    g_mutex_lock(&metrics_mutex);
+
+    g_string_append(output,
+                    "# TYPE milter_manager_sessions counter\n"
+                    "# HELP milter_manager_sessions "
+                    "Finished sessions by the last stage and status.\n");
+    for (i = 0; i < n_slots; i++) {
+        gchar labels[64];
+
+        g_snprintf(labels, sizeof(labels), "worker=\"%u\"", i);
+        append_results(output, "milter_manager_sessions", labels,
+                       &(slots[i].results[0][0]), N_SESSION_STATES,
+                       MILTER_TYPE_CLIENT_CONTEXT_STATE);
+    }
+
+    g_string_append(output,
+                    "# TYPE milter_manager_session_duration_seconds histogram\n"
+                    "# UNIT milter_manager_session_duration_seconds seconds\n"
+                    "# HELP milter_manager_session_duration_seconds "
+                    "Elapsed time of finished sessions.\n");
+    for (i = 0; i < n_slots; i++) {
+        gchar labels[64];
+
+        if (histogram_count(&(slots[i].duration)) == 0)
+            continue;
+        g_snprintf(labels, sizeof(labels), "worker=\"%u\"", i);
+        append_histogram(output, "milter_manager_session_duration_seconds",
+                         labels, &(slots[i].duration));
+    }
+
+    g_string_append(output,
+                    "# TYPE milter_manager_body_spills counter\n"
+                    "# HELP milter_manager_body_spills "
+                    "Message bodies written to temporary files.\n");
+    for (i = 0; i < n_slots; i++) {
+        guint64 n_body_spills;
+
+        n_body_spills = COUNTER_GET(slots[i].n_body_spills);
+        if (n_body_spills == 0)
+            continue;
+        g_string_append_printf(output,
+                               "milter_manager_body_spills_total{worker=\"%u\"} "
+                               "%" G_GUINT64_FORMAT "\n",
+                               i, n_body_spills);
+    }
+
+    g_string_append(output,
+                    "# TYPE milter_manager_child_results counter\n"
+                    "# HELP milter_manager_child_results "
+                    "Finished child milters by the last stage and status.\n");
+    for (i = 0; i < n_slots; i++) {
+        gint j, n_children;
+
+        n_children = g_atomic_int_get(&(slots[i].n_children));
+        for (j = 0; j < n_children; j++) {
+            ChildMetrics *child = slots[i].children + j;
+            gchar *labels;
+
+            labels = child_labels(i, child);
+            append_results(output, "milter_manager_child_results", labels,
+                           &(child->results[0][0]), N_CHILD_STATES,
+                           MILTER_TYPE_SERVER_CONTEXT_STATE);
+            g_free(labels);
+        }
+    }
+
+    g_string_append(output,
+                    "# TYPE milter_manager_child_duration_seconds histogram\n"
+                    "# UNIT milter_manager_child_duration_seconds seconds\n"
+                    "# HELP milter_manager_child_duration_seconds "
+                    "Elapsed time of finished child milters.\n");
+    for (i = 0; i < n_slots; i++) {
+        gint j, n_children;
+
+        n_children = g_atomic_int_get(&(slots[i].n_children));
+        for (j = 0; j < n_children; j++) {
+            ChildMetrics *child = slots[i].children + j;
+            gchar *labels;
+
+            if (histogram_count(&(child->duration)) == 0)
+                continue;
+            labels = child_labels(i, child);
+            append_histogram(output, "milter_manager_child_duration_seconds",
+                             labels, &(child->duration));
+            g_free(labels);
+        }
+    }
+
+    g_string_append(output,
+                    "# TYPE milter_manager_child_stage_duration_seconds "
+                    "histogram\n"
+                    "# UNIT milter_manager_child_stage_duration_seconds "
+                    "seconds\n"
+                    "# HELP milter_manager_child_stage_duration_seconds "
+                    "Elapsed time from a command to its reply "
+                    "by child milter and stage.\n");
+    for (i = 0; i < n_slots; i++) {
+        gint j, n_children;
+
+        n_children = g_atomic_int_get(&(slots[i].n_children));
+        for (j = 0; j < n_children; j++) {
+            ChildMetrics *child = slots[i].children + j;
+            guint k;
+
+            for (k = 0; k < N_CHILD_STAGES; k++) {
+                Histogram *histogram = child->stage_durations + k;
+                gchar *labels, *stage_labels, *stage_name;
+
+                if (histogram_count(histogram) == 0)
+                    continue;
+                labels = child_labels(i, child);
+                stage_name = milter_utils_get_enum_nick_name(
+                    MILTER_TYPE_SERVER_CONTEXT_STATE, FIRST_CHILD_STAGE + k);
+                stage_labels = g_strdup_printf("%s,stage=\"%s\"",
+                                               labels, stage_name);
+                append_histogram(output,
+                                 "milter_manager_child_stage_duration_seconds",
+                                 stage_labels, histogram);
+                g_free(stage_labels);
+                g_free(stage_name);
+                g_free(labels);
+            }
+        }
+    }
+
+    g_mutex_unlock(&metrics_mutex);
+
+    g_string_append(output, "# EOF\n");
+
+    return g_string_free(output, FALSE);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,70 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_METRICS_H__
+#define __MILTER_MANAGER_METRICS_H__
+
+#include <milter/client.h>
+#include <milter/server.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Metrics are kept in one slot per process: slot 0 is the
+ * master process and slot N is the Nth worker process. Slots
+ * are allocated in memory shared with worker processes by
+ * milter_manager_metrics_init() before workers are forked
+ * so that the master process can report all of them.
+ */
+void      milter_manager_metrics_init            (guint n_workers);
+void      milter_manager_metrics_quit            (void);
+void      milter_manager_metrics_set_worker_id   (guint worker_id);
+
+void      milter_manager_metrics_record_session  (MilterClientContextState last_state,
+                                                  MilterStatus             status,
+                                                  gdouble                  elapsed);
+void      milter_manager_metrics_record_child    (const gchar             *name,
+                                                  MilterServerContextState last_state,
+                                                  MilterStatus             status,
+                                                  gdouble                  elapsed);
+void      milter_manager_metrics_record_child_stage
+                                                 (const gchar             *name,
+                                                  MilterServerContextState stage,
+                                                  gdouble                  elapsed);
+void      milter_manager_metrics_record_body_spill
+                                                 (void);
+
+guint     milter_manager_metrics_get_n_workers   (void);
+GPid      milter_manager_metrics_get_worker_pid  (guint worker_id);
+guint64   milter_manager_metrics_get_n_sessions  (guint worker_id);
+guint64   milter_manager_metrics_get_n_body_spills
+                                                 (guint worker_id);
+gdouble   milter_manager_metrics_get_child_duration_percentile
+                                                 (const gchar *name,
+                                                  gdouble      percentile);
+
+gchar    *milter_manager_metrics_to_open_metrics (void);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_METRICS_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
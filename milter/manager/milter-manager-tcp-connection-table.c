@@ -0,0 +1,556 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef __linux__
+#  include <linux/netlink.h>
+#  include <linux/sock_diag.h>
+#  include <linux/inet_diag.h>
+#endif
+
+#include "milter-manager-tcp-connection-table.h"
+
+#define DEFAULT_LIFETIME 5.0
+
+typedef struct _TCPConnectionKey
+{
+    guint16 family;
+    guint16 port; /* network byte order */
+    guint8 address[16];
+} TCPConnectionKey;
+
+typedef struct _TCPConnection
+{
+    TCPConnectionKey remote;
+    MilterManagerTCPState state;
+    MilterGenericSocketAddress local_address;
+} TCPConnection;
+
+static GMutex table_mutex;
+static GHashTable *connections = NULL;
+static gint64 last_update_time = 0;
+static gdouble lifetime = DEFAULT_LIFETIME;
+#ifdef __linux__
+static gboolean netlink_available = TRUE;
+#endif
+
+static guint
+tcp_connection_key_hash (gconstpointer data)
+{
+    const guint8 *bytes = data;
+    guint hash = 2166136261U;
+    gsize i;
+
+    for (i = 0; i < sizeof(TCPConnectionKey); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static gboolean
+tcp_connection_key_equal (gconstpointer key1, gconstpointer key2)
+{
+    return memcmp(key1, key2, sizeof(TCPConnectionKey)) == 0;
+}
+
+/* IPv4 peers of IPv6 sockets are indexed as IPv4 because
+ * MTA reports them as IPv4. */
+static gint
+normalize_address (gint family, const guint8 **address)
+{
+    static const guint8 ipv4_mapped_prefix[12] =
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+
+    if (family == AF_INET6 &&
+        memcmp(*address, ipv4_mapped_prefix, sizeof(ipv4_mapped_prefix)) == 0) {
+        *address += sizeof(ipv4_mapped_prefix);
+        return AF_INET;
+    }
+    return family;
+}
+
+static void
+tcp_connection_key_init (TCPConnectionKey *key,
+                         gint family,
+                         const guint8 *address,
+                         guint16 port)
+{
+    memset(key, 0, sizeof(*key));
+    key->family = normalize_address(family, &address);
+    key->port = port;
+    memcpy(key->address, address, key->family == AF_INET ? 4 : 16);
+}
+
+static gboolean
+tcp_connection_key_init_by_socket_address (TCPConnectionKey *key,
+                                           const struct sockaddr *address,
+                                           socklen_t address_length)
+{
+    switch (address->sa_family) {
+      case AF_INET:
+      {
+          const struct sockaddr_in *inet;
+
+          if (address_length < sizeof(struct sockaddr_in))
+              return FALSE;
+          inet = (const struct sockaddr_in *)address;
+          tcp_connection_key_init(key, AF_INET,
+                                  (const guint8 *)&(inet->sin_addr),
+                                  inet->sin_port);
+          return TRUE;
+      }
+      case AF_INET6:
+      {
+          const struct sockaddr_in6 *inet6;
+
+          if (address_length < sizeof(struct sockaddr_in6))
+              return FALSE;
+          inet6 = (const struct sockaddr_in6 *)address;
+          tcp_connection_key_init(key, AF_INET6,
+                                  (const guint8 *)&(inet6->sin6_addr),
+                                  inet6->sin6_port);
+          return TRUE;
+      }
+      default:
+        return FALSE;
+    }
+}
+
+static MilterManagerTCPState
+state_from_kernel (guint state)
+{
+    if (state > MILTER_MANAGER_TCP_STATE_CLOSING)
+        return MILTER_MANAGER_TCP_STATE_UNKNOWN;
+    return state;
+}
+
+static void
+add_connection (GHashTable *table,
+                gint family,
+                const guint8 *local_address,
+                guint16 local_port,
+                const guint8 *remote_address,
+                guint16 remote_port,
+                guint state)
+{
+    TCPConnection *connection, *existing_connection;
+    MilterGenericSocketAddress *local;
+
+    connection = g_new0(TCPConnection, 1);
+    tcp_connection_key_init(&(connection->remote),
+                            family, remote_address, remote_port);
+    connection->state = state_from_kernel(state);
+
+    local = &(connection->local_address);
+    if (normalize_address(family, &local_address) == AF_INET) {
+        local->address.inet.sin_family = AF_INET;
+        local->address.inet.sin_port = local_port;
+        memcpy(&(local->address.inet.sin_addr), local_address, 4);
+    } else {
+        local->address.inet6.sin6_family = AF_INET6;
+        local->address.inet6.sin6_port = local_port;
+        memcpy(&(local->address.inet6.sin6_addr), local_address, 16);
+    }
+
+    /* A new connection from the same address and port may
+     * be in the table with an old TIME_WAIT connection. */
+    existing_connection = g_hash_table_lookup(table, &(connection->remote));
+    if (existing_connection &&
+        existing_connection->state == MILTER_MANAGER_TCP_STATE_ESTABLISHED) {
+        g_free(connection);
+        return;
+    }
+    g_hash_table_replace(table, &(connection->remote), connection);
+}
+
+#ifdef __linux__
+static gboolean
+collect_by_netlink (GHashTable *table, gint family, GError **error)
+{
+    gint fd;
+    struct {
+        struct nlmsghdr header;
+        struct inet_diag_req_v2 request;
+    } message;
+    struct sockaddr_nl kernel_address;
+    guint32 buffer[8192];
+    gboolean done = FALSE;
+    gboolean success = TRUE;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (fd == -1) {
+        g_set_error(error,
+                    G_FILE_ERROR,
+                    g_file_error_from_errno(errno),
+                    "failed to open NETLINK_SOCK_DIAG socket: %s",
+                    g_strerror(errno));
+        return FALSE;
+    }
+
+    memset(&message, 0, sizeof(message));
+    message.header.nlmsg_len = sizeof(message);
+    message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    message.request.sdiag_family = family;
+    message.request.sdiag_protocol = IPPROTO_TCP;
+    /* Listening sockets don't have remote address. */
+    message.request.idiag_states =
+        ((1 << (MILTER_MANAGER_TCP_STATE_CLOSING + 1)) - 1) &
+        ~(1 << MILTER_MANAGER_TCP_STATE_UNKNOWN) &
+        ~(1 << MILTER_MANAGER_TCP_STATE_LISTEN);
+
+    memset(&kernel_address, 0, sizeof(kernel_address));
+    kernel_address.nl_family = AF_NETLINK;
+    if (sendto(fd, &message, sizeof(message), 0,
+               (struct sockaddr *)&kernel_address,
+               sizeof(kernel_address)) == -1) {
+        g_set_error(error,
+                    G_FILE_ERROR,
+                    g_file_error_from_errno(errno),
+                    "failed to send NETLINK_SOCK_DIAG request: %s",
+                    g_strerror(errno));
+        close(fd);
+        return FALSE;
+    }
+
+    while (!done) {
+        gint size;
+        struct nlmsghdr *header;
+
+        size = recv(fd, buffer, sizeof(buffer), 0);
+        if (size == -1) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(error,
+                        G_FILE_ERROR,
+                        g_file_error_from_errno(errno),
+                        "failed to receive NETLINK_SOCK_DIAG response: %s",
+                        g_strerror(errno));
+            success = FALSE;
+            break;
+        }
+        if (size == 0)
+            break;
+
+        for (header = (struct nlmsghdr *)buffer;
+             NLMSG_OK(header, size);
+             header = NLMSG_NEXT(header, size)) {
+            struct inet_diag_msg *diag;
+
+            if (header->nlmsg_type == NLMSG_DONE) {
+                done = TRUE;
+                break;
+            }
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *netlink_error = NLMSG_DATA(header);
+
+                g_set_error(error,
+                            G_FILE_ERROR,
+                            g_file_error_from_errno(-netlink_error->error),
+                            "NETLINK_SOCK_DIAG request is failed: %s",
+                            g_strerror(-netlink_error->error));
+                success = FALSE;
+                done = TRUE;
+                break;
+            }
+            if (header->nlmsg_type != SOCK_DIAG_BY_FAMILY)
+                continue;
+
+            diag = NLMSG_DATA(header);
+            add_connection(table,
+                           diag->idiag_family,
+                           (const guint8 *)diag->id.idiag_src,
+                           diag->id.idiag_sport,
+                           (const guint8 *)diag->id.idiag_dst,
+                           diag->id.idiag_dport,
+                           diag->idiag_state);
+        }
+    }
+    close(fd);
+
+    return success;
+}
+
+/* /proc/net/tcp{,6} shows each 32bit word of address as a
+ * hexadecimal number in host byte order. */
+static gboolean
+parse_proc_address (const gchar *hex_address, gint family, guint32 *address)
+{
+    guint i, n_words;
+
+    n_words = (family == AF_INET) ? 1 : 4;
+    if (strlen(hex_address) != n_words * 8)
+        return FALSE;
+
+    for (i = 0; i < n_words; i++) {
+        gchar word[9];
+
+        memcpy(word, hex_address + i * 8, 8);
+        word[8] = '\0';
+        address[i] = (guint32)strtoul(word, NULL, 16);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+collect_by_proc (GHashTable *table, gint family, GError **error)
+{
+    const gchar *path;
+    FILE *file;
+    gchar line[512];
+
+    path = (family == AF_INET) ? "/proc/net/tcp" : "/proc/net/tcp6";
+    file = fopen(path, "r");
+    if (!file) {
+        if (family == AF_INET6 && errno == ENOENT)
+            return TRUE;
+        g_set_error(error,
+                    G_FILE_ERROR,
+                    g_file_error_from_errno(errno),
+                    "failed to open: <%s>: %s",
+                    path, g_strerror(errno));
+        return FALSE;
+    }
+
+    /* The first line is header. */
+    if (fgets(line, sizeof(line), file)) {
+        while (fgets(line, sizeof(line), file)) {
+            gchar local_hex_address[33], remote_hex_address[33];
+            guint local_port, remote_port, state;
+            guint32 local_address[4], remote_address[4];
+
+            if (sscanf(line, " %*u: %32[0-9A-Fa-f]:%x %32[0-9A-Fa-f]:%x %x",
+                       local_hex_address, &local_port,
+                       remote_hex_address, &remote_port,
+                       &state) != 5)
+                continue;
+            if (state == MILTER_MANAGER_TCP_STATE_LISTEN)
+                continue;
+            if (!parse_proc_address(local_hex_address, family, local_address))
+                continue;
+            if (!parse_proc_address(remote_hex_address, family, remote_address))
+                continue;
+
+            add_connection(table,
+                           family,
+                           (const guint8 *)local_address,
+                           htons(local_port),
+                           (const guint8 *)remote_address,
+                           htons(remote_port),
+                           state);
+        }
+    }
+    fclose(file);
+
+    return TRUE;
+}
+#endif
+
+static gboolean
+collect (GHashTable *table, GError **error)
+{
+#ifdef __linux__
+    gint families[] = {AF_INET, AF_INET6};
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(families); i++) {
+        if (netlink_available) {
+            GError *netlink_error = NULL;
+
+            if (collect_by_netlink(table, families[i], &netlink_error))
+                continue;
+
+            if (families[i] == AF_INET) {
+                milter_info("[tcp-connection-table][netlink][unavailable] "
+                            "use /proc/net/tcp{,6} instead: %s",
+                            netlink_error->message);
+                netlink_available = FALSE;
+            }
+            g_error_free(netlink_error);
+        }
+        if (!collect_by_proc(table, families[i], error))
+            return FALSE;
+    }
+
+    return TRUE;
+#else
+    g_set_error(error,
+                G_FILE_ERROR,
+                G_FILE_ERROR_NOSYS,
+                "TCP connection table isn't supported on this platform");
+    return FALSE;
+#endif
+}
+
+static gboolean
+update (GError **error)
+{
+    GHashTable *new_connections;
+
+    new_connections = g_hash_table_new_full(tcp_connection_key_hash,
+                                            tcp_connection_key_equal,
+                                            NULL,
+                                            g_free);
+    if (!collect(new_connections, error)) {
+        g_hash_table_unref(new_connections);
+        return FALSE;
+    }
+
+    if (connections)
+        g_hash_table_unref(connections);
+    connections = new_connections;
+    last_update_time = g_get_monotonic_time();
+    milter_debug("[tcp-connection-table][update] <%u>",
+                 g_hash_table_size(connections));
+
+    return TRUE;
+}
+
+static gboolean
+update_with_log (void)
+{
+    GError *error = NULL;
+
+    if (update(&error))
+        return TRUE;
+
+    milter_error("[tcp-connection-table][error][update] %s", error->message);
+    g_error_free(error);
+    return FALSE;
+}
+
+static gboolean
+need_update (void)
+{
+    if (!connections)
+        return TRUE;
+    if (lifetime <= 0.0)
+        return TRUE;
+    return g_get_monotonic_time() - last_update_time >
+        lifetime * G_USEC_PER_SEC;
+}
+
+gboolean
+milter_manager_tcp_connection_table_is_available (void)
+{
+#ifdef __linux__
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+gdouble
+milter_manager_tcp_connection_table_get_lifetime (void)
+{
+    gdouble current_lifetime;
+
+    g_mutex_lock(&table_mutex);
+    current_lifetime = lifetime;
+    g_mutex_unlock(&table_mutex);
+
+    return current_lifetime;
+}
+
+void
+milter_manager_tcp_connection_table_set_lifetime (gdouble new_lifetime)
+{
+    g_mutex_lock(&table_mutex);
+    lifetime = new_lifetime;
+    g_mutex_unlock(&table_mutex);
+}
+
+gboolean
+milter_manager_tcp_connection_table_update (GError **error)
+{
+    gboolean success;
+
+    g_mutex_lock(&table_mutex);
+    success = update(error);
+    g_mutex_unlock(&table_mutex);
+
+    return success;
+}
+
+gboolean
+milter_manager_tcp_connection_table_lookup (const struct sockaddr *remote_address,
+                                            socklen_t remote_address_length,
+                                            gboolean update_on_miss,
+                                            MilterManagerTCPState *state,
+                                            MilterGenericSocketAddress *local_address)
+{
+    TCPConnectionKey key;
+    TCPConnection *connection = NULL;
+    gboolean updated = FALSE;
+
+    if (!tcp_connection_key_init_by_socket_address(&key,
+                                                   remote_address,
+                                                   remote_address_length))
+        return FALSE;
+
+    g_mutex_lock(&table_mutex);
+    if (need_update())
+        updated = update_with_log();
+    if (connections)
+        connection = g_hash_table_lookup(connections, &key);
+    if (!connection && update_on_miss && !updated) {
+        if (update_with_log())
+            connection = g_hash_table_lookup(connections, &key);
+    }
+    if (connection) {
+        if (state)
+            *state = connection->state;
+        if (local_address)
+            *local_address = connection->local_address;
+    }
+    g_mutex_unlock(&table_mutex);
+
+    return connection != NULL;
+}
+
+void
+milter_manager_tcp_connection_table_clear (void)
+{
+    g_mutex_lock(&table_mutex);
+    if (connections) {
+        g_hash_table_unref(connections);
+        connections = NULL;
+    }
+    last_update_time = 0;
+    lifetime = DEFAULT_LIFETIME;
+    g_mutex_unlock(&table_mutex);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,76 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_TCP_CONNECTION_TABLE_H__
+#define __MILTER_MANAGER_TCP_CONNECTION_TABLE_H__
+
+#include <milter/core.h>
+
+G_BEGIN_DECLS
+
+/* The same order as TCP states in the Linux kernel. */
+typedef enum
+{
+    MILTER_MANAGER_TCP_STATE_UNKNOWN,
+    MILTER_MANAGER_TCP_STATE_ESTABLISHED,
+    MILTER_MANAGER_TCP_STATE_SYN_SENT,
+    MILTER_MANAGER_TCP_STATE_SYN_RECV,
+    MILTER_MANAGER_TCP_STATE_FIN_WAIT1,
+    MILTER_MANAGER_TCP_STATE_FIN_WAIT2,
+    MILTER_MANAGER_TCP_STATE_TIME_WAIT,
+    MILTER_MANAGER_TCP_STATE_CLOSE,
+    MILTER_MANAGER_TCP_STATE_CLOSE_WAIT,
+    MILTER_MANAGER_TCP_STATE_LAST_ACK,
+    MILTER_MANAGER_TCP_STATE_LISTEN,
+    MILTER_MANAGER_TCP_STATE_CLOSING
+} MilterManagerTCPState;
+
+/*
+ * TCP connections of the host are indexed by their remote
+ * address in the table of the process. It is a replacement
+ * of parsing netstat result. It is available only on Linux
+ * because it uses NETLINK_SOCK_DIAG or /proc/net/tcp{,6}.
+ *
+ * The table is rebuilt on lookup when it is older than
+ * lifetime seconds.
+ */
+gboolean    milter_manager_tcp_connection_table_is_available
+                                        (void);
+gdouble     milter_manager_tcp_connection_table_get_lifetime
+                                        (void);
+void        milter_manager_tcp_connection_table_set_lifetime
+                                        (gdouble                     lifetime);
+gboolean    milter_manager_tcp_connection_table_update
+                                        (GError                    **error);
+gboolean    milter_manager_tcp_connection_table_lookup
+                                        (const struct sockaddr      *remote_address,
+                                         socklen_t                   remote_address_length,
+                                         gboolean                    update_on_miss,
+                                         MilterManagerTCPState      *state,
+                                         MilterGenericSocketAddress *local_address);
+void        milter_manager_tcp_connection_table_clear
+                                        (void);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_TCP_CONNECTION_TABLE_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
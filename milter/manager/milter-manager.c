@@ -30,20 +30,25 @@
 #include <unistd.h>
 
 #include "milter-manager.h"
+#include "milter-manager-connection-pool.h"
 #include "milter-manager-leader.h"
+#include "milter-manager-metrics.h"
+#include "milter-manager-tcp-connection-table.h"
 
 #define MILTER_MANAGER_GET_PRIVATE(obj)                 \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                 \
                                  MILTER_TYPE_MANAGER,   \
                                  MilterManagerPrivate))
 
+#define CONNECTION_POOL_SWEEP_INTERVAL 30.0
+
 typedef struct _MilterManagerPrivate MilterManagerPrivate;
 struct _MilterManagerPrivate
 {
     MilterManagerConfiguration *configuration;
-    GList *leaders;
-    GList *next_connection_checked_leader;
-    gboolean connection_checking;
+    GQueue *leaders;
+    GHashTable *leader_links;
+    GList *checking_leader_link;
 
     GIOChannel *launcher_read_channel;
     GIOChannel *launcher_write_channel;
@@ -51,6 +56,8 @@ struct _MilterManagerPrivate
     guint periodical_connection_checker_id;
     guint current_periodical_connection_check_interval;
 
+    guint connection_pool_sweeper_id;
+
     GList *finished_leaders;
 
     gboolean is_custom_n_workers;
@@ -140,6 +147,9 @@ static void   set_max_pending_finished_sessions
 static void   workers_created             (MilterClient *client,
                                            guint         n_workers);
 static void   worker_created              (MilterClient *client);
+static gboolean is_reuse_port             (MilterClient *client);
+static void   set_reuse_port              (MilterClient *client,
+                                           gboolean      reuse_port);
 
 static void
 milter_manager_class_init (MilterManagerClass *klass)
@@ -195,6 +205,8 @@ milter_manager_class_init (MilterManagerClass *klass)
         set_max_pending_finished_sessions;
     client_class->workers_created = workers_created;
     client_class->worker_created = worker_created;
+    client_class->is_reuse_port = is_reuse_port;
+    client_class->set_reuse_port = set_reuse_port;
 
     spec = g_param_spec_object("configuration",
                                "Configuration",
@@ -215,9 +227,9 @@ milter_manager_init (MilterManager *manager)
     priv = MILTER_MANAGER_GET_PRIVATE(manager);
 
     priv->configuration = NULL;
-    priv->leaders = NULL;
-    priv->next_connection_checked_leader = NULL;
-    priv->connection_checking = FALSE;
+    priv->leaders = g_queue_new();
+    priv->leader_links = g_hash_table_new(g_direct_hash, g_direct_equal);
+    priv->checking_leader_link = NULL;
 
     priv->launcher_read_channel = NULL;
     priv->launcher_write_channel = NULL;
@@ -225,6 +237,8 @@ milter_manager_init (MilterManager *manager)
     priv->periodical_connection_checker_id = 0;
     priv->current_periodical_connection_check_interval = 0;
 
+    priv->connection_pool_sweeper_id = 0;
+
     priv->finished_leaders = NULL;
 }
 
@@ -252,6 +266,22 @@ dispose_periodical_connection_checker (MilterManager *manager)
     priv->periodical_connection_checker_id = 0;
 }
 
+static void
+dispose_connection_pool_sweeper (MilterManager *manager)
+{
+    MilterManagerPrivate *priv;
+    MilterEventLoop *loop;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+
+    if (priv->connection_pool_sweeper_id == 0)
+        return;
+
+    loop = milter_client_get_event_loop(MILTER_CLIENT(manager));
+    milter_event_loop_remove(loop, priv->connection_pool_sweeper_id);
+    priv->connection_pool_sweeper_id = 0;
+}
+
 static void
 dispose_finished_leaders (MilterManagerPrivate *priv)
 {
@@ -282,6 +312,7 @@ dispose (GObject *object)
     priv = MILTER_MANAGER_GET_PRIVATE(manager);
 
     dispose_periodical_connection_checker(manager);
+    dispose_connection_pool_sweeper(manager);
     dispose_finished_leaders(priv);
 
     if (priv->configuration) {
@@ -291,10 +322,13 @@ dispose (GObject *object)
     }
 
     if (priv->leaders) {
-        g_list_free(priv->leaders);
+        g_queue_free(priv->leaders);
         priv->leaders = NULL;
     }
-    priv->next_connection_checked_leader = NULL;
+    if (priv->leader_links) {
+        g_hash_table_unref(priv->leader_links);
+        priv->leader_links = NULL;
+    }
 
     milter_manager_set_launcher_channel(MILTER_MANAGER(object), NULL, NULL);
 
@@ -360,37 +394,95 @@ milter_manager_new (MilterManagerConfiguration *configuration)
                         NULL);
 }
 
+static void
+remove_leader (MilterManagerPrivate *priv, MilterManagerLeader *leader)
+{
+    GList *link;
+
+    if (!priv->leader_links)
+        return;
+
+    link = g_hash_table_lookup(priv->leader_links, leader);
+    if (!link)
+        return;
+
+    g_hash_table_remove(priv->leader_links, leader);
+    /* connection_check() owns the link while it checks the leader. */
+    if (link == priv->checking_leader_link)
+        return;
+    g_queue_delete_link(priv->leaders, link);
+}
+
+static void
+update_tcp_connection_table (MilterManagerPrivate *priv)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_configuration_is_use_tcp_connection_table(
+            priv->configuration))
+        return;
+
+    if (!milter_manager_tcp_connection_table_update(&error)) {
+        milter_error("[manager][connection-check][error] "
+                     "failed to update TCP connection table: %s",
+                     error->message);
+        g_error_free(error);
+    }
+}
+
+/*
+ * priv->leaders is ordered by the last checked time. The
+ * least recently checked leaders are at the head. Checked
+ * and still connected leaders are moved to the tail. So
+ * each check is O(batch size) not O(the number of leaders).
+ */
 static gboolean
 connection_check (gpointer data)
 {
     MilterManager *manager = data;
     MilterManagerPrivate *priv;
-    GList *node, *next_node;
-    guint i;
-    guint n_leaders_per_connection_check = 30; /* FIXME: make customizable */
+    guint i, n_leaders, batch_size;
 
     priv = MILTER_MANAGER_GET_PRIVATE(manager);
 
-    priv->connection_checking = TRUE;
-
-    if (!priv->next_connection_checked_leader)
-        priv->next_connection_checked_leader = priv->leaders;
-    node = priv->next_connection_checked_leader;
-    i = 0;
-    while (node && i < n_leaders_per_connection_check) {
-        MilterManagerLeader *leader = node->data;
-        next_node = g_list_next(node);
-        if (!milter_manager_leader_check_connection(leader)) {
-            priv->leaders = g_list_delete_link(priv->leaders, node);
+    n_leaders = g_queue_get_length(priv->leaders);
+    batch_size = milter_manager_configuration_get_connection_check_batch_size(
+        priv->configuration);
+    if (batch_size > 0 && batch_size < n_leaders)
+        n_leaders = batch_size;
+
+    if (n_leaders > 0)
+        update_tcp_connection_table(priv);
+
+    for (i = 0; i < n_leaders && !g_queue_is_empty(priv->leaders); i++) {
+        MilterManagerLeader *leader;
+        GList *link;
+        gboolean connected;
+
+        link = g_queue_pop_head_link(priv->leaders);
+        leader = link->data;
+        priv->checking_leader_link = link;
+        connected = milter_manager_leader_check_connection(leader);
+        priv->checking_leader_link = NULL;
+
+        if (g_hash_table_lookup(priv->leader_links, leader) != link) {
+            g_list_free_1(link);
+        } else if (connected) {
+            g_queue_push_tail_link(priv->leaders, link);
+        } else {
+            g_hash_table_remove(priv->leader_links, leader);
+            g_list_free_1(link);
         }
-        node = next_node;
-        i++;
     }
-    priv->next_connection_checked_leader = node;
 
-    priv->connection_checking = FALSE;
+    if (g_queue_is_empty(priv->leaders)) {
+        milter_debug("[manager][connection-check][stop] no leaders");
+        priv->periodical_connection_checker_id = 0;
+        priv->current_periodical_connection_check_interval = 0;
+        return FALSE;
+    }
 
-    return priv->leaders != NULL;
+    return TRUE;
 }
 
 static void
@@ -424,6 +516,45 @@ start_periodical_connection_checker (MilterManager *manager)
     }
 }
 
+static gboolean
+cb_sweep_connection_pool (gpointer user_data)
+{
+    MilterManager *manager = user_data;
+    MilterManagerPrivate *priv;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+
+    if (milter_manager_connection_pool_sweep() > 0)
+        return TRUE;
+
+    milter_debug("[manager][connection-pool][sweep][stop] no connections");
+    priv->connection_pool_sweeper_id = 0;
+    return FALSE;
+}
+
+/* Connections are parked when a session is finished. Idle
+ * ones are closed periodically while the pool isn't empty. */
+static void
+start_connection_pool_sweeper (MilterManager *manager)
+{
+    MilterManagerPrivate *priv;
+    MilterEventLoop *loop;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+
+    if (priv->connection_pool_sweeper_id > 0)
+        return;
+
+    milter_debug("[manager][connection-pool][sweep][start] <%g>",
+                 CONNECTION_POOL_SWEEP_INTERVAL);
+    loop = milter_client_get_event_loop(MILTER_CLIENT(manager));
+    priv->connection_pool_sweeper_id =
+        milter_event_loop_add_timeout(loop,
+                                      CONNECTION_POOL_SWEEP_INTERVAL,
+                                      cb_sweep_connection_pool,
+                                      manager);
+}
+
 static MilterStatus
 cb_client_negotiate (MilterClientContext *context, MilterOption *option,
                      MilterMacrosRequests *macros_requests, gpointer user_data)
@@ -634,11 +765,28 @@ cb_client_timeout (MilterClientContext *context, gpointer user_data)
     milter_manager_leader_timeout(leader);
 }
 
+static void
+cb_client_quit_new_connection (MilterClientContext *context,
+                               gpointer user_data)
+{
+    /* Children are negotiated for the current connection. The
+     * next connection needs new children. So we close the
+     * connection and MTA reconnects. */
+    milter_debug("[%u] [manager][quit-new-connection][shutdown]",
+                 milter_agent_get_tag(MILTER_AGENT(context)));
+    milter_agent_shutdown(MILTER_AGENT(context));
+}
+
 static void
 cb_client_finished (MilterClientContext *context, gpointer user_data)
 {
     MilterManagerLeader *leader = user_data;
 
+    milter_manager_metrics_record_session(
+        milter_client_context_get_last_state(context),
+        milter_client_context_get_status(context),
+        milter_agent_get_elapsed(MILTER_AGENT(context)));
+
     if (milter_need_log(MILTER_LOG_LEVEL_DEBUG |
                         MILTER_LOG_LEVEL_STATISTICS)) {
         MilterAgent *agent;
@@ -720,6 +868,7 @@ teardown_client_context_signals (MilterClientContext *context,
     DISCONNECT(abort);
     DISCONNECT(define_macro);
     DISCONNECT(timeout);
+    DISCONNECT(quit_new_connection);
 
     DISCONNECT(finished);
 
@@ -743,19 +892,14 @@ cb_leader_finished (MilterFinishedEmittable *emittable, gpointer user_data)
     teardown_client_context_signals(client_context, leader, finish_data);
 
     priv = MILTER_MANAGER_GET_PRIVATE(finish_data->manager);
-    if (!priv->connection_checking) {
-        GList *node;
-        node = g_list_find(priv->leaders, leader);
-        if (node) {
-            if (priv->next_connection_checked_leader == node)
-                priv->next_connection_checked_leader = g_list_next(node);
-            priv->leaders = g_list_delete_link(priv->leaders, node);
-        }
-        if (!priv->leaders) {
-            milter_debug("[manager][connection-check][dispose] no leaders");
-            dispose_periodical_connection_checker(finish_data->manager);
-        }
+    remove_leader(priv, leader);
+    if (priv->leaders &&
+        g_queue_is_empty(priv->leaders) &&
+        !priv->checking_leader_link) {
+        milter_debug("[manager][connection-check][dispose] no leaders");
+        dispose_periodical_connection_checker(finish_data->manager);
     }
+    start_connection_pool_sweeper(finish_data->manager);
 
     priv->finished_leaders = g_list_prepend(priv->finished_leaders, leader);
 
@@ -773,7 +917,8 @@ setup_context_signals (MilterClientContext *context,
     priv = MILTER_MANAGER_GET_PRIVATE(manager);
 
     leader = milter_manager_leader_new(priv->configuration, context);
-    priv->leaders = g_list_prepend(priv->leaders, leader);
+    g_queue_push_tail(priv->leaders, leader);
+    g_hash_table_insert(priv->leader_links, leader, priv->leaders->tail);
 
 #define CONNECT(name)                                   \
     g_signal_connect(context, #name,                    \
@@ -794,6 +939,7 @@ setup_context_signals (MilterClientContext *context,
     CONNECT(abort);
     CONNECT(define_macro);
     CONNECT(timeout);
+    CONNECT(quit_new_connection);
 
     CONNECT(finished);
 
@@ -1016,6 +1162,32 @@ set_max_connections (MilterClient *client, guint max_connections)
                                                      max_connections);
 }
 
+static gboolean
+is_reuse_port (MilterClient *client)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    return milter_manager_configuration_is_reuse_port(configuration);
+}
+
+static void
+set_reuse_port (MilterClient *client, gboolean reuse_port)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    milter_manager_configuration_set_reuse_port(configuration, reuse_port);
+}
+
 static const gchar *
 get_effective_user (MilterClient *client)
 {
@@ -1405,6 +1577,7 @@ static void
 worker_created (MilterClient *client)
 {
     milter_debug("[manager][worker-created] pid=<%d>", getpid());
+    milter_manager_metrics_set_worker_id(milter_client_get_worker_id(client));
 }
 
 /**
@@ -1429,7 +1602,12 @@ milter_manager_get_configuration (MilterManager *manager)
 const GList *
 milter_manager_get_leaders (MilterManager *manager)
 {
-    return MILTER_MANAGER_GET_PRIVATE(manager)->leaders;
+    MilterManagerPrivate *priv;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    if (!priv->leaders)
+        return NULL;
+    return priv->leaders->head;
 }
 
 static void
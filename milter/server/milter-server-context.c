@@ -60,6 +60,8 @@ enum
 
     STATE_TRANSITED,
 
+    STAGE_REPLIED,
+
     LAST_SIGNAL
 };
 
@@ -96,7 +98,8 @@ struct _MilterServerContextPrivate
     gdouble writing_timeout;
     gdouble reading_timeout;
     gdouble end_of_message_timeout;
-    guint timeout_id;
+    MilterEventLoopDeadline timeout;
+    gboolean timeout_expired;
     guint connect_watch_id;
 
     gboolean skip_body;
@@ -108,6 +111,7 @@ struct _MilterServerContextPrivate
     gboolean sent_end_of_message;
 
     GTimer *elapsed;
+    gint64 command_written_time;
 
     gboolean negotiated;
     gboolean processing_message;
@@ -116,6 +120,10 @@ struct _MilterServerContextPrivate
     gchar *current_recipient;
 
     MilterMessageResult *message_result;
+
+    /* The agent's encoder keeps the command packet while macros
+     * are encoded. */
+    MilterEncoder *macro_encoder;
 };
 
 enum
@@ -444,6 +452,16 @@ milter_server_context_class_init (MilterServerContextClass *klass)
                      NULL,
                      G_TYPE_NONE, 1, MILTER_TYPE_SERVER_CONTEXT_STATE);
 
+    signals[STAGE_REPLIED] =
+        g_signal_new("stage-replied",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     G_STRUCT_OFFSET(MilterServerContextClass, stage_replied),
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE, 2,
+                     MILTER_TYPE_SERVER_CONTEXT_STATE, G_TYPE_DOUBLE);
+
     g_type_class_add_private(gobject_class, sizeof(MilterServerContextPrivate));
 }
 
@@ -472,7 +490,8 @@ milter_server_context_init (MilterServerContext *context)
     priv->process_body_count = 0;
     priv->sent_end_of_message = FALSE;
 
-    priv->timeout_id = 0;
+    milter_event_loop_deadline_init(&(priv->timeout));
+    priv->timeout_expired = FALSE;
     priv->connection_timeout = MILTER_SERVER_CONTEXT_DEFAULT_CONNECTION_TIMEOUT;
     priv->writing_timeout = MILTER_SERVER_CONTEXT_DEFAULT_WRITING_TIMEOUT;
     priv->reading_timeout = MILTER_SERVER_CONTEXT_DEFAULT_READING_TIMEOUT;
@@ -485,6 +504,7 @@ milter_server_context_init (MilterServerContext *context)
     priv->elapsed = g_timer_new();
     g_timer_stop(priv->elapsed);
     g_timer_reset(priv->elapsed);
+    priv->command_written_time = 0;
 
     priv->negotiated = FALSE;
     priv->processing_message = FALSE;
@@ -493,6 +513,26 @@ milter_server_context_init (MilterServerContext *context)
     priv->current_recipient = NULL;
 
     priv->message_result = NULL;
+
+    priv->macro_encoder = NULL;
+}
+
+/* Emits "stage-replied" with the elapsed time from the last
+ * written command to the first reply for it. */
+static void
+emit_stage_replied (MilterServerContext *context)
+{
+    MilterServerContextPrivate *priv;
+    gdouble elapsed;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    if (priv->command_written_time == 0)
+        return;
+
+    elapsed = (g_get_monotonic_time() - priv->command_written_time) /
+        (gdouble)G_USEC_PER_SEC;
+    priv->command_written_time = 0;
+    g_signal_emit(context, signals[STAGE_REPLIED], 0, priv->state, elapsed);
 }
 
 static void
@@ -505,18 +545,15 @@ disable_timeout (MilterServerContext *context)
         const gchar *name;
 
         name = milter_server_context_get_name(context);
-        milter_debug("[%u] [server][timeout][disable] [%s] [%u] (%p)",
+        milter_debug("[%u] [server][timeout][disable] [%s] [%s] (%p)",
                      milter_agent_get_tag(MILTER_AGENT(context)),
                      NULL_SAFE_NAME(name),
-                     priv->timeout_id,
+                     milter_event_loop_deadline_is_active(&(priv->timeout)) ?
+                     "active" : "inactive",
                      context);
     }
-    if (priv->timeout_id > 0) {
-        MilterEventLoop *loop;
-        loop = milter_agent_get_event_loop(MILTER_AGENT(context));
-        milter_event_loop_remove(loop, priv->timeout_id);
-        priv->timeout_id = 0;
-    }
+    milter_event_loop_deadline_cancel(&(priv->timeout));
+    priv->timeout_expired = FALSE;
 }
 
 static void
@@ -666,6 +703,11 @@ dispose (GObject *object)
 
     dispose_message_result(priv);
 
+    if (priv->macro_encoder) {
+        g_object_unref(priv->macro_encoder);
+        priv->macro_encoder = NULL;
+    }
+
     G_OBJECT_CLASS(milter_server_context_parent_class)->dispose(object);
 }
 
@@ -893,12 +935,12 @@ cb_writing_timeout (gpointer data)
         priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
         if (priv)
             name = milter_server_context_get_name(context);
-        milter_debug("[%u] [server][timeout][writing] [%s] [%u] (%p)",
+        milter_debug("[%u] [server][timeout][writing] [%s] (%p)",
                      priv ? milter_agent_get_tag(agent) : 0,
                      NULL_SAFE_NAME(name),
-                     priv ? priv->timeout_id : 0,
                      context);
     }
+    MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->timeout_expired = TRUE;
     g_signal_emit(context, signals[WRITING_TIMEOUT], 0);
     milter_agent_shutdown(agent);
 
@@ -919,12 +961,12 @@ cb_end_of_message_timeout (gpointer data)
         priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
         if (priv)
             name = milter_server_context_get_name(context);
-        milter_debug("[%u] [server][timeout][end-of-message] [%s] [%u] (%p)",
+        milter_debug("[%u] [server][timeout][end-of-message] [%s] (%p)",
                      priv ? milter_agent_get_tag(agent) : 0,
                      NULL_SAFE_NAME(name),
-                     priv ? priv->timeout_id : 0,
                      context);
     }
+    MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->timeout_expired = TRUE;
     g_signal_emit(context, signals[END_OF_MESSAGE_TIMEOUT], 0);
     milter_agent_shutdown(agent);
 
@@ -945,12 +987,12 @@ cb_reading_timeout (gpointer data)
         priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
         if (priv)
             name = milter_server_context_get_name(context);
-        milter_debug("[%u] [server][timeout][reading] [%s] [%u] (%p)",
+        milter_debug("[%u] [server][timeout][reading] [%s] (%p)",
                      priv ? milter_agent_get_tag(agent) : 0,
                      NULL_SAFE_NAME(name),
-                     priv ? priv->timeout_id : 0,
                      context);
     }
+    MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->timeout_expired = TRUE;
     g_signal_emit(context, signals[READING_TIMEOUT], 0);
     milter_agent_shutdown(agent);
 
@@ -964,7 +1006,8 @@ milter_server_context_is_processing (MilterServerContext *context)
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
 
-    return priv->timeout_id != 0;
+    return priv->timeout_expired ||
+        milter_event_loop_deadline_is_active(&(priv->timeout));
 }
 
 static GHashTable *
@@ -994,19 +1037,18 @@ filter_macros (GHashTable *macros, GList *request_symbols)
     return filtered_macros;
 }
 
-static void
-prepend_macro (MilterServerContext *context, GString *packed_packet,
-               MilterCommand command)
+static gboolean
+encode_macro (MilterServerContext *context, MilterCommand command,
+              const gchar **packet, gsize *packet_size)
 {
+    MilterServerContextPrivate *priv;
     GHashTable *macros, *filtered_macros = NULL, *target_macros;
     GList *request_symbols = NULL;
-    const gchar *packet = NULL;
-    gsize packet_size;
-    MilterEncoder *encoder;
     MilterAgent *agent;
     MilterProtocolAgent *protocol_agent;
     MilterMacrosRequests *macros_requests;
 
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
     agent = MILTER_AGENT(context);
     protocol_agent = MILTER_PROTOCOL_AGENT(context);
 
@@ -1015,7 +1057,7 @@ prepend_macro (MilterServerContext *context, GString *packed_packet,
     milter_protocol_agent_set_macro_context(protocol_agent,
                                             MILTER_COMMAND_UNKNOWN);
     if (!macros || g_hash_table_size(macros) == 0)
-        return;
+        return FALSE;
 
     target_macros = macros;
     macros_requests = milter_protocol_agent_get_macros_requests(protocol_agent);
@@ -1026,17 +1068,17 @@ prepend_macro (MilterServerContext *context, GString *packed_packet,
         if (request_symbols)
             filtered_macros = filter_macros(macros, request_symbols);
         if (!filtered_macros)
-            return;
+            return FALSE;
         target_macros = filtered_macros;
     }
 
-    encoder = milter_agent_get_encoder(agent);
-    milter_command_encoder_encode_define_macro(MILTER_COMMAND_ENCODER(encoder),
-                                               &packet, &packet_size,
-                                               command,
-                                               target_macros);
-    if (filtered_macros)
-        g_hash_table_unref(filtered_macros);
+    if (!priv->macro_encoder)
+        priv->macro_encoder = milter_command_encoder_new();
+    milter_command_encoder_encode_define_macro(
+        MILTER_COMMAND_ENCODER(priv->macro_encoder),
+        packet, packet_size,
+        command,
+        target_macros);
 
     if (milter_need_debug_log()) {
         gchar *command_name;
@@ -1054,8 +1096,10 @@ prepend_macro (MilterServerContext *context, GString *packed_packet,
         g_free(command_name);
         g_free(inspected_macros);
     }
+    if (filtered_macros)
+        g_hash_table_unref(filtered_macros);
 
-    g_string_prepend_len(packed_packet, packet, packet_size);
+    return TRUE;
 }
 
 static void
@@ -1161,21 +1205,20 @@ reset_end_of_message_timeout (MilterServerContext *context)
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
     agent = MILTER_AGENT(context);
     loop = milter_agent_get_event_loop(agent);
-    priv->timeout_id =
-        milter_event_loop_add_timeout(loop,
-                                      priv->end_of_message_timeout,
-                                      cb_end_of_message_timeout,
-                                      context);
+    milter_event_loop_deadline_set(loop,
+                                   &(priv->timeout),
+                                   priv->end_of_message_timeout,
+                                   cb_end_of_message_timeout,
+                                   context);
     if (milter_need_debug_log()) {
         const gchar *name;
 
         name = milter_server_context_get_name(context);
         milter_debug("[%u] [server][timeout][end-of-message][registered][%g] "
-                     "[%s] <%u> (%p)",
+                     "[%s] (%p)",
                      milter_agent_get_tag(agent),
                      priv->end_of_message_timeout,
                      NULL_SAFE_NAME(name),
-                     priv->timeout_id,
                      context);
     }
 }
@@ -1206,17 +1249,13 @@ increment_process_body_count (MilterServerContext *context)
 }
 
 static gboolean
-flush_body (MilterServerContext *context)
+write_body_packet (MilterServerContext *context,
+                   const gchar *packet, gsize packet_size)
 {
     MilterServerContextPrivate *priv;
     guint tag = 0;
     const gchar *name = NULL;
-    MilterEncoder *encoder;
-    MilterCommandEncoder *command_encoder;
     MilterServerContextState state = MILTER_SERVER_CONTEXT_STATE_BODY;
-    const gchar *packet = NULL;
-    gsize packet_size;
-    gsize packed_size;
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
 
@@ -1225,26 +1264,15 @@ flush_body (MilterServerContext *context)
         name = milter_server_context_get_name(context);
     }
 
-    milter_debug("[%u] [server][body][flush] [%s] <%" G_GSIZE_FORMAT ">",
-                 tag, NULL_SAFE_NAME(name), priv->body->len);
-
     milter_debug("[%u] [server][timer][continue] [%s] %g",
                  tag, NULL_SAFE_NAME(name),
                  g_timer_elapsed(priv->elapsed, NULL));
     g_timer_continue(priv->elapsed);
-    encoder = milter_agent_get_encoder(MILTER_AGENT(context));
-    command_encoder = MILTER_COMMAND_ENCODER(encoder);
     append_body_response_queue(context);
 
-    milter_command_encoder_encode_body(command_encoder,
-                                       &packet, &packet_size,
-                                       priv->body->str,
-                                       priv->body->len,
-                                       &packed_size);
     if (!write_packet(context, packet, packet_size, state))
         return FALSE;
 
-    g_string_erase(priv->body, 0, packed_size);
     increment_process_body_count(context);
 
     g_timer_stop(priv->elapsed);
@@ -1255,6 +1283,38 @@ flush_body (MilterServerContext *context)
     return TRUE;
 }
 
+static gboolean
+flush_body (MilterServerContext *context)
+{
+    MilterServerContextPrivate *priv;
+    MilterEncoder *encoder;
+    const gchar *packet = NULL;
+    gsize packet_size;
+    gsize packed_size;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+
+    if (milter_need_debug_log()) {
+        milter_debug("[%u] [server][body][flush] [%s] <%" G_GSIZE_FORMAT ">",
+                     milter_agent_get_tag(MILTER_AGENT(context)),
+                     NULL_SAFE_NAME(milter_server_context_get_name(context)),
+                     priv->body->len);
+    }
+
+    encoder = milter_agent_get_encoder(MILTER_AGENT(context));
+    milter_command_encoder_encode_body(MILTER_COMMAND_ENCODER(encoder),
+                                       &packet, &packet_size,
+                                       priv->body->str,
+                                       priv->body->len,
+                                       &packed_size);
+    if (!write_body_packet(context, packet, packet_size))
+        return FALSE;
+
+    g_string_erase(priv->body, 0, packed_size);
+
+    return TRUE;
+}
+
 static gboolean
 process_next_state_body (MilterServerContext *context)
 {
@@ -1282,17 +1342,16 @@ process_next_state_body (MilterServerContext *context)
 
     disable_timeout(context);
     loop = milter_agent_get_event_loop(MILTER_AGENT(context));
-    priv->timeout_id =
-        milter_event_loop_add_timeout(loop,
-                                      priv->reading_timeout,
-                                      cb_reading_timeout,
-                                      context);
+    milter_event_loop_deadline_set(loop,
+                                   &(priv->timeout),
+                                   priv->reading_timeout,
+                                   cb_reading_timeout,
+                                   context);
     milter_debug("[%u] [server][timeout][reading][registered][%g] "
-                 "[%s] <%u> (%p)",
+                 "[%s] (%p)",
                  tag,
                  priv->reading_timeout,
                  NULL_SAFE_NAME(name),
-                 priv->timeout_id,
                  context);
 
     return TRUE;
@@ -1393,17 +1452,16 @@ process_next_state (MilterServerContext *context,
             MilterEventLoop *loop;
 
             loop = milter_agent_get_event_loop(agent);
-            priv->timeout_id =
-                milter_event_loop_add_timeout(loop,
-                                              priv->reading_timeout,
-                                              cb_reading_timeout,
-                                              context);
+            milter_event_loop_deadline_set(loop,
+                                           &(priv->timeout),
+                                           priv->reading_timeout,
+                                           cb_reading_timeout,
+                                           context);
             milter_debug("[%u] [server][timeout][reading][registered][%g] "
-                         "[%s] <%u> (%p)",
+                         "[%s] (%p)",
                          tag,
                          priv->reading_timeout,
                          NULL_SAFE_NAME(name),
-                         priv->timeout_id,
                          context);
         } else {
             g_timer_stop(priv->elapsed);
@@ -1481,7 +1539,10 @@ write_packet (MilterServerContext *context,
 {
     GError *agent_error = NULL;
     MilterServerContextPrivate *priv;
-    GString *packed_packet;
+    MilterCommand macro_command = MILTER_COMMAND_UNKNOWN;
+    const gchar *packets[2];
+    gsize packet_sizes[2];
+    guint n_packets = 0;
     guint tag;
     MilterEventLoop *loop;
     const gchar *name;
@@ -1501,6 +1562,7 @@ write_packet (MilterServerContext *context,
     switch (next_state) {
     case MILTER_SERVER_CONTEXT_STATE_ABORT:
     case MILTER_SERVER_CONTEXT_STATE_QUIT:
+        priv->command_written_time = 0;
         break;
     default:
         if (milter_server_context_is_processing(context)) {
@@ -1535,62 +1597,73 @@ write_packet (MilterServerContext *context,
             g_timer_continue(priv->elapsed);
         }
         disable_timeout(context);
-        priv->timeout_id = milter_event_loop_add_timeout(loop,
-                                                         priv->writing_timeout,
-                                                         cb_writing_timeout,
-                                                         context);
+        if (next_state != MILTER_SERVER_CONTEXT_STATE_DEFINE_MACRO)
+            priv->command_written_time = g_get_monotonic_time();
+        milter_event_loop_deadline_set(loop,
+                                       &(priv->timeout),
+                                       priv->writing_timeout,
+                                       cb_writing_timeout,
+                                       context);
         if (milter_need_debug_log()) {
             const gchar *name;
 
             name = milter_server_context_get_name(context);
             milter_debug("[%u] [server][timeout][writing][registered][%g] "
-                         "[%s] <%u> (%p)",
+                         "[%s] (%p)",
                          tag,
                          priv->writing_timeout,
                          NULL_SAFE_NAME(name),
-                         priv->timeout_id,
                          context);
         }
         break;
     }
 
-    packed_packet = g_string_new_len(packet, packet_size);
     switch (next_state) {
     case MILTER_SERVER_CONTEXT_STATE_HELO:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_HELO);
+        macro_command = MILTER_COMMAND_HELO;
         break;
     case MILTER_SERVER_CONTEXT_STATE_CONNECT:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_CONNECT);
+        macro_command = MILTER_COMMAND_CONNECT;
         break;
     case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_ENVELOPE_FROM);
+        macro_command = MILTER_COMMAND_ENVELOPE_FROM;
         break;
     case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_ENVELOPE_RECIPIENT);
+        macro_command = MILTER_COMMAND_ENVELOPE_RECIPIENT;
         break;
     case MILTER_SERVER_CONTEXT_STATE_DATA:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_DATA);
+        macro_command = MILTER_COMMAND_DATA;
         break;
     case MILTER_SERVER_CONTEXT_STATE_HEADER:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_HEADER);
+        macro_command = MILTER_COMMAND_HEADER;
         break;
     case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_END_OF_HEADER);
+        macro_command = MILTER_COMMAND_END_OF_HEADER;
         break;
     case MILTER_SERVER_CONTEXT_STATE_BODY:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_BODY);
+        macro_command = MILTER_COMMAND_BODY;
         break;
     case MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE:
-        prepend_macro(context, packed_packet, MILTER_COMMAND_END_OF_MESSAGE);
+        macro_command = MILTER_COMMAND_END_OF_MESSAGE;
         break;
     default:
         break;
     }
 
-    milter_agent_write_packet(MILTER_AGENT(context),
-                              packed_packet->str, packed_packet->len,
-                              &agent_error);
-    g_string_free(packed_packet, TRUE);
+    /* Macros are written before the command packet without
+     * concatenating them into a new buffer. */
+    if (macro_command != MILTER_COMMAND_UNKNOWN &&
+        encode_macro(context, macro_command,
+                     &packets[n_packets], &packet_sizes[n_packets])) {
+        n_packets++;
+    }
+    packets[n_packets] = packet;
+    packet_sizes[n_packets] = packet_size;
+    n_packets++;
+
+    milter_agent_write_packets(MILTER_AGENT(context),
+                               packets, packet_sizes, n_packets,
+                               &agent_error);
 
     if (agent_error) {
         GError *error = NULL;
@@ -2072,10 +2145,21 @@ gboolean
 milter_server_context_header (MilterServerContext *context,
                               const gchar         *header_name,
                               const gchar         *header_value)
+{
+    return milter_server_context_header_with_packet(context,
+                                                    header_name,
+                                                    header_value,
+                                                    NULL, 0);
+}
+
+gboolean
+milter_server_context_header_with_packet (MilterServerContext *context,
+                                          const gchar         *header_name,
+                                          const gchar         *header_value,
+                                          const gchar         *packet,
+                                          gsize                packet_size)
 {
     MilterServerContextPrivate *priv;
-    const gchar *packet = NULL;
-    gsize packet_size;
     MilterEncoder *encoder;
     gboolean stop = FALSE;
     guint tag;
@@ -2116,10 +2200,12 @@ milter_server_context_header (MilterServerContext *context,
         return TRUE;
     }
 
-    encoder = milter_agent_get_encoder(MILTER_AGENT(context));
-    milter_command_encoder_encode_header(MILTER_COMMAND_ENCODER(encoder),
-                                         &packet, &packet_size,
-                                         header_name, header_value);
+    if (!packet) {
+        encoder = milter_agent_get_encoder(MILTER_AGENT(context));
+        milter_command_encoder_encode_header(MILTER_COMMAND_ENCODER(encoder),
+                                             &packet, &packet_size,
+                                             header_name, header_value);
+    }
 
     return write_packet(context, packet, packet_size,
                         MILTER_SERVER_CONTEXT_STATE_HEADER);
@@ -2127,10 +2213,16 @@ milter_server_context_header (MilterServerContext *context,
 
 gboolean
 milter_server_context_end_of_header (MilterServerContext *context)
+{
+    return milter_server_context_end_of_header_with_packet(context, NULL, 0);
+}
+
+gboolean
+milter_server_context_end_of_header_with_packet (MilterServerContext *context,
+                                                 const gchar         *packet,
+                                                 gsize                packet_size)
 {
     MilterServerContextPrivate *priv;
-    const gchar *packet = NULL;
-    gsize packet_size;
     MilterEncoder *encoder;
     gboolean stop = FALSE;
     guint tag = 0;
@@ -2172,9 +2264,11 @@ milter_server_context_end_of_header (MilterServerContext *context)
         return TRUE;
     }
 
-    encoder = milter_agent_get_encoder(MILTER_AGENT(context));
-    milter_command_encoder_encode_end_of_header(MILTER_COMMAND_ENCODER(encoder),
-                                                &packet, &packet_size);
+    if (!packet) {
+        encoder = milter_agent_get_encoder(MILTER_AGENT(context));
+        milter_command_encoder_encode_end_of_header(
+            MILTER_COMMAND_ENCODER(encoder), &packet, &packet_size);
+    }
 
     return write_packet(context, packet, packet_size,
                         MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER);
@@ -2184,6 +2278,17 @@ gboolean
 milter_server_context_body (MilterServerContext *context,
                             const gchar         *chunk,
                             gsize                size)
+{
+    return milter_server_context_body_with_packet(context, chunk, size,
+                                                  NULL, 0);
+}
+
+gboolean
+milter_server_context_body_with_packet (MilterServerContext *context,
+                                        const gchar         *chunk,
+                                        gsize                size,
+                                        const gchar         *packet,
+                                        gsize                packet_size)
 {
     MilterServerContextState state = MILTER_SERVER_CONTEXT_STATE_BODY;
     gboolean stop = FALSE;
@@ -2225,6 +2330,11 @@ milter_server_context_body (MilterServerContext *context,
         return TRUE;
     }
 
+    /* The packet can be used only when it has the whole chunk
+     * and no previous chunk is pending. */
+    if (packet && priv->body->len == 0 && size <= MILTER_CHUNK_SIZE)
+        return write_body_packet(context, packet, packet_size);
+
     g_string_append_len(priv->body, chunk, size);
     return flush_body(context);
 }
@@ -2233,10 +2343,20 @@ gboolean
 milter_server_context_end_of_message (MilterServerContext *context,
                                       const gchar         *chunk,
                                       gsize                size)
+{
+    return milter_server_context_end_of_message_with_packet(context,
+                                                            chunk, size,
+                                                            NULL, 0);
+}
+
+gboolean
+milter_server_context_end_of_message_with_packet (MilterServerContext *context,
+                                                  const gchar         *chunk,
+                                                  gsize                size,
+                                                  const gchar         *packet,
+                                                  gsize                packet_size)
 {
     MilterServerContextPrivate *priv;
-    const gchar *packet = NULL;
-    gsize packet_size;
     MilterEncoder *encoder;
     gboolean stop = FALSE;
     guint tag = 0;
@@ -2268,10 +2388,12 @@ milter_server_context_end_of_message (MilterServerContext *context,
         return TRUE;
     }
 
-    encoder = milter_agent_get_encoder(MILTER_AGENT(context));
-    milter_command_encoder_encode_end_of_message(MILTER_COMMAND_ENCODER(encoder),
-                                                 &packet, &packet_size,
-                                                 chunk, size);
+    if (!packet) {
+        encoder = milter_agent_get_encoder(MILTER_AGENT(context));
+        milter_command_encoder_encode_end_of_message(
+            MILTER_COMMAND_ENCODER(encoder), &packet, &packet_size,
+            chunk, size);
+    }
 
     return write_packet(context, packet, packet_size,
                         MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE);
@@ -2299,6 +2421,65 @@ milter_server_context_quit (MilterServerContext *context)
                         MILTER_SERVER_CONTEXT_STATE_QUIT);
 }
 
+GIOChannel *
+milter_server_context_quit_new_connection (MilterServerContext *context)
+{
+    MilterServerContextPrivate *priv;
+    MilterAgent *agent;
+    const gchar *packet = NULL;
+    gsize packet_size;
+    MilterEncoder *encoder;
+    GIOChannel *channel;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    agent = MILTER_AGENT(context);
+
+    if (!priv->client_channel ||
+        !priv->negotiated ||
+        priv->quitted ||
+        milter_server_context_is_processing(context)) {
+        milter_debug("[%u] [server][quit-new-connection][not-reusable] [%s]",
+                     milter_agent_get_tag(agent),
+                     milter_server_context_get_name(context));
+        return NULL;
+    }
+
+    /* Unwritten data before SMFIC_QUIT_NC may be lost by
+     * shutdown. The connection is quitted normally instead. */
+    if (milter_agent_get_pending_write_size(agent) > 0) {
+        milter_debug("[%u] [server][quit-new-connection][pending] [%s] "
+                     "<%" G_GSIZE_FORMAT ">",
+                     milter_agent_get_tag(agent),
+                     milter_server_context_get_name(context),
+                     milter_agent_get_pending_write_size(agent));
+        return NULL;
+    }
+
+    priv->quitted = TRUE;
+
+    milter_debug("[%u] [server][send][quit-new-connection] [%s]",
+                 milter_agent_get_tag(agent),
+                 milter_server_context_get_name(context));
+    encoder = milter_agent_get_encoder(agent);
+    milter_command_encoder_encode_quit_new_connection(
+        MILTER_COMMAND_ENCODER(encoder), &packet, &packet_size);
+    if (!write_packet(context, packet, packet_size,
+                      MILTER_SERVER_CONTEXT_STATE_QUIT))
+        return NULL;
+
+    channel = g_io_channel_ref(priv->client_channel);
+    milter_agent_shutdown(agent);
+    if (milter_agent_get_pending_write_size(agent) > 0) {
+        milter_debug("[%u] [server][quit-new-connection][unflushed] [%s]",
+                     milter_agent_get_tag(agent),
+                     milter_server_context_get_name(context));
+        g_io_channel_unref(channel);
+        return NULL;
+    }
+
+    return channel;
+}
+
 
 gboolean
 milter_server_context_abort (MilterServerContext *context)
@@ -2406,6 +2587,7 @@ cb_decoder_negotiate_reply (MilterDecoder *decoder,
     state = priv->state;
 
     disable_timeout(context);
+    emit_stage_replied(context);
 
     if (milter_need_log(MILTER_LOG_LEVEL_ERROR |
                         MILTER_LOG_LEVEL_DEBUG)) {
@@ -2530,6 +2712,7 @@ cb_decoder_continue (MilterReplyDecoder *decoder, gpointer user_data)
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
 
     disable_timeout(context);
+    emit_stage_replied(context);
 
     if (milter_need_debug_log()) {
         gchar *state_name;
@@ -2599,6 +2782,7 @@ cb_decoder_reply_code (MilterReplyDecoder *decoder,
     const gchar *name = NULL;
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    emit_stage_replied(context);
 
     if (milter_need_debug_log()) {
         tag = milter_agent_get_tag(MILTER_AGENT(context));
@@ -2694,6 +2878,7 @@ cb_decoder_temporary_failure (MilterReplyDecoder *decoder, gpointer user_data)
     }
 
     disable_timeout(context);
+    emit_stage_replied(context);
     g_timer_stop(priv->elapsed);
 
     if (milter_need_debug_log()) {
@@ -2756,6 +2941,7 @@ cb_decoder_reject (MilterReplyDecoder *decoder, gpointer user_data)
     }
 
     disable_timeout(context);
+    emit_stage_replied(context);
     g_timer_stop(priv->elapsed);
 
     if (milter_need_debug_log()) {
@@ -2806,6 +2992,7 @@ cb_decoder_accept (MilterReplyDecoder *decoder, gpointer user_data)
     priv->status = MILTER_STATUS_ACCEPT;
 
     disable_timeout(context);
+    emit_stage_replied(context);
     g_timer_stop(priv->elapsed);
 
     if (milter_need_debug_log()) {
@@ -2855,6 +3042,7 @@ cb_decoder_discard (MilterReplyDecoder *decoder, gpointer user_data)
     priv->status = MILTER_STATUS_DISCARD;
 
     disable_timeout(context);
+    emit_stage_replied(context);
     g_timer_stop(priv->elapsed);
 
     if (milter_need_debug_log()) {
@@ -3191,6 +3379,7 @@ cb_decoder_connection_failure (MilterReplyDecoder *decoder, gpointer user_data)
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(user_data);
 
     disable_timeout(context);
+    emit_stage_replied(context);
     g_timer_stop(priv->elapsed);
 
     priv->status = MILTER_STATUS_ERROR;
@@ -3222,6 +3411,7 @@ cb_decoder_shutdown (MilterReplyDecoder *decoder, gpointer user_data)
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(user_data);
 
     disable_timeout(context);
+    emit_stage_replied(context);
     g_timer_stop(priv->elapsed);
 
     if (milter_need_debug_log()) {
@@ -3257,6 +3447,7 @@ cb_decoder_skip (MilterReplyDecoder *decoder, gpointer user_data)
     }
 
     disable_timeout(context);
+    emit_stage_replied(context);
 
     milter_debug("[%u] [server][receive][skip] [%s]", tag, name);
 
@@ -3345,6 +3536,34 @@ milter_server_context_set_connection_spec (MilterServerContext *context,
     return success;
 }
 
+void
+milter_server_context_set_connection_address (MilterServerContext   *context,
+                                              const gchar           *spec,
+                                              gint                   domain,
+                                              const struct sockaddr *address,
+                                              socklen_t              address_size)
+{
+    MilterServerContextPrivate *priv;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+
+    if (priv->address)
+        g_free(priv->address);
+    priv->address = g_memdup(address, address_size);
+    priv->address_size = address_size;
+    priv->domain = domain;
+
+    if (priv->spec)
+        g_free(priv->spec);
+    priv->spec = g_strdup(spec);
+}
+
+const gchar *
+milter_server_context_get_connection_spec (MilterServerContext *context)
+{
+    return MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->spec;
+}
+
 static gboolean
 cb_connection_timeout (gpointer data)
 {
@@ -3357,14 +3576,15 @@ cb_connection_timeout (gpointer data)
     if (priv)
         name = milter_server_context_get_name(context);
     agent = MILTER_AGENT(context);
-    milter_debug("[%u] [server][timeout][connection] [%s] [%u] (%p)",
+    milter_debug("[%u] [server][timeout][connection] [%s] (%p)",
                  priv ? milter_agent_get_tag(agent) : 0,
                  NULL_SAFE_NAME(name),
-                 priv ? priv->timeout_id : 0,
                  context);
     milter_error("[%u] [server][timeout][connection] [%s]",
                  priv ? milter_agent_get_tag(agent) : 0,
                  NULL_SAFE_NAME(name));
+    if (priv)
+        priv->timeout_expired = TRUE;
     g_signal_emit(context, signals[CONNECTION_TIMEOUT], 0);
 
     return FALSE;
@@ -3528,21 +3748,21 @@ milter_server_context_establish_connection (MilterServerContext *context,
                                    connect_watch_func, context);
 
     disable_timeout(context);
-    priv->timeout_id = milter_event_loop_add_timeout(loop,
-                                                     priv->connection_timeout,
-                                                     cb_connection_timeout,
-                                                     context);
+    milter_event_loop_deadline_set(loop,
+                                   &(priv->timeout),
+                                   priv->connection_timeout,
+                                   cb_connection_timeout,
+                                   context);
     if (milter_need_debug_log()) {
         const gchar *name = NULL;
 
         if (priv)
             name = milter_server_context_get_name(context);
         milter_debug("[%u] [server][timeout][connection][registered][%g] "
-                     "[%s] <%u> (%p)",
+                     "[%s] (%p)",
                      milter_agent_get_tag(agent),
                      priv->connection_timeout,
                      NULL_SAFE_NAME(name),
-                     priv->timeout_id,
                      context);
     }
 
@@ -3577,6 +3797,46 @@ milter_server_context_establish_connection (MilterServerContext *context,
     return TRUE;
 }
 
+gboolean
+milter_server_context_reuse_connection (MilterServerContext *context,
+                                        GIOChannel *channel,
+                                        MilterOption *option,
+                                        MilterMacrosRequests *macros_requests,
+                                        GError **error)
+{
+    MilterServerContextPrivate *priv;
+    MilterAgent *agent;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    agent = MILTER_AGENT(context);
+
+    dispose_client_channel(priv);
+    priv->client_channel = g_io_channel_ref(channel);
+    prepare_reader(context);
+    prepare_writer(context);
+    if (!milter_agent_start(agent, error)) {
+        dispose_client_channel(priv);
+        return FALSE;
+    }
+
+    milter_server_context_set_option(context, option);
+    milter_protocol_agent_set_macros_requests(MILTER_PROTOCOL_AGENT(context),
+                                              macros_requests);
+    priv->negotiated = TRUE;
+    priv->quitted = FALSE;
+    milter_server_context_set_state(context,
+                                    MILTER_SERVER_CONTEXT_STATE_NEGOTIATE);
+    g_timer_start(priv->elapsed);
+    g_timer_stop(priv->elapsed);
+
+    milter_debug("[%u] [server][reused] [%s] %d",
+                 milter_agent_get_tag(agent),
+                 milter_server_context_get_name(context),
+                 g_io_channel_unix_get_fd(channel));
+
+    return TRUE;
+}
+
 void
 milter_server_context_set_connection_timeout (MilterServerContext *context,
                                               gdouble timeout)
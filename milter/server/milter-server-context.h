@@ -208,6 +208,9 @@ struct _MilterServerContextClass
 
     void (*state_transited)     (MilterServerContext *context,
                                  MilterServerContextState state);
+    void (*stage_replied)       (MilterServerContext *context,
+                                 MilterServerContextState state,
+                                 gdouble elapsed);
 };
 
 GQuark               milter_server_context_error_quark (void);
@@ -317,6 +320,40 @@ gboolean             milter_server_context_set_connection_spec
                                                         const gchar *spec,
                                                         GError **error);
 
+/**
+ * milter_server_context_set_connection_address:
+ * @context: a %MilterServerContext.
+ * @spec: the connection spec of client.
+ * @domain: the protocol family of @address.
+ * @address: the parsed address of @spec.
+ * @address_size: the size of @address.
+ *
+ * Sets a connection specification of client that is already
+ * parsed by milter_connection_parse_spec(). It doesn't
+ * parse @spec again nor resolve host name in @spec.
+ *
+ * Since: 2.3.3
+ */
+void                 milter_server_context_set_connection_address
+                                                       (MilterServerContext *context,
+                                                        const gchar *spec,
+                                                        gint domain,
+                                                        const struct sockaddr *address,
+                                                        socklen_t address_size);
+
+/**
+ * milter_server_context_get_connection_spec:
+ * @context: a %MilterServerContext.
+ *
+ * Gets the connection specification of client.
+ *
+ * Returns: the connection spec of client or %NULL.
+ *
+ * Since: 2.3.3
+ */
+const gchar         *milter_server_context_get_connection_spec
+                                                       (MilterServerContext *context);
+
 /**
  * milter_server_context_establish_connection:
  * @context: a %MilterServerContext.
@@ -332,6 +369,33 @@ gboolean             milter_server_context_establish_connection
                                                        (MilterServerContext *context,
                                                         GError **error);
 
+/**
+ * milter_server_context_reuse_connection:
+ * @context: a %MilterServerContext.
+ * @channel: a connection returned by
+ *   milter_server_context_quit_new_connection().
+ * @option: the option negotiated on @channel.
+ * @macros_requests: (nullable): the macros requests
+ *   negotiated on @channel.
+ * @error: return location for an error, or %NULL.
+ *
+ * Uses @channel as the connection to client instead of
+ * establishing a new connection. @context is treated as
+ * negotiated with @option and @macros_requests. So the
+ * next command is CONNECT. If starting is failed and
+ * @error is not %NULL, error detail is stored into @error.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean             milter_server_context_reuse_connection
+                                                       (MilterServerContext  *context,
+                                                        GIOChannel           *channel,
+                                                        MilterOption         *option,
+                                                        MilterMacrosRequests *macros_requests,
+                                                        GError              **error);
+
 
 /**
  * milter_server_context_get_status:
@@ -500,6 +564,31 @@ gboolean             milter_server_context_header      (MilterServerContext *con
                                                         const gchar         *name,
                                                         const gchar         *value);
 
+/**
+ * milter_server_context_header_with_packet:
+ * @context: a %MilterServerContext.
+ * @name: the header name.
+ * @value: the header value.
+ * @packet: (nullable): the header command packet encoded
+ *   from @name and @value or %NULL.
+ * @packet_size: the size of @packet.
+ *
+ * Sends a header like milter_server_context_header() but
+ * writes @packet instead of encoding it again. It's useful
+ * to send the same header to multiple contexts. Macros are
+ * still encoded for @context.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean             milter_server_context_header_with_packet
+                                                       (MilterServerContext *context,
+                                                        const gchar         *name,
+                                                        const gchar         *value,
+                                                        const gchar         *packet,
+                                                        gsize                packet_size);
+
 /**
  * milter_server_context_end_of_header:
  * @context: a %MilterServerContext.
@@ -511,6 +600,24 @@ gboolean             milter_server_context_header      (MilterServerContext *con
 gboolean             milter_server_context_end_of_header
                                                        (MilterServerContext *context);
 
+/**
+ * milter_server_context_end_of_header_with_packet:
+ * @context: a %MilterServerContext.
+ * @packet: (nullable): the end-of-header command packet or %NULL.
+ * @packet_size: the size of @packet.
+ *
+ * Same as milter_server_context_end_of_header() but writes
+ * @packet instead of encoding it again.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean             milter_server_context_end_of_header_with_packet
+                                                       (MilterServerContext *context,
+                                                        const gchar         *packet,
+                                                        gsize                packet_size);
+
 /**
  * milter_server_context_body:
  * @context: a %MilterServerContext.
@@ -525,6 +632,31 @@ gboolean             milter_server_context_body        (MilterServerContext *con
                                                         const gchar         *chunk,
                                                         gsize                size);
 
+/**
+ * milter_server_context_body_with_packet:
+ * @context: a %MilterServerContext.
+ * @chunk: the body chunk.
+ * @size: the size of @chunk.
+ * @packet: (nullable): the body command packet that has
+ *   the whole @chunk or %NULL.
+ * @packet_size: the size of @packet.
+ *
+ * Same as milter_server_context_body() but writes @packet
+ * instead of encoding @chunk again. @packet isn't used when
+ * @context still has a part of the previous chunk to be
+ * sent or @size is larger than %MILTER_CHUNK_SIZE.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean             milter_server_context_body_with_packet
+                                                       (MilterServerContext *context,
+                                                        const gchar         *chunk,
+                                                        gsize                size,
+                                                        const gchar         *packet,
+                                                        gsize                packet_size);
+
 /**
  * milter_server_context_end_of_message:
  * @context: a %MilterServerContext.
@@ -541,6 +673,29 @@ gboolean             milter_server_context_end_of_message
                                                         const gchar         *chunk,
                                                         gsize                size);
 
+/**
+ * milter_server_context_end_of_message_with_packet:
+ * @context: a %MilterServerContext.
+ * @chunk: the body chunk. maybe %NULL.
+ * @size: the size of @chunk.
+ * @packet: (nullable): the end-of-message command packet
+ *   encoded from @chunk or %NULL.
+ * @packet_size: the size of @packet.
+ *
+ * Same as milter_server_context_end_of_message() but writes
+ * @packet instead of encoding @chunk again.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 2.3.3
+ */
+gboolean             milter_server_context_end_of_message_with_packet
+                                                       (MilterServerContext *context,
+                                                        const gchar         *chunk,
+                                                        gsize                size,
+                                                        const gchar         *packet,
+                                                        gsize                packet_size);
+
 /**
  * milter_server_context_quit:
  * @context: a %MilterServerContext.
@@ -551,6 +706,29 @@ gboolean             milter_server_context_end_of_message
  */
 gboolean             milter_server_context_quit        (MilterServerContext *context);
 
+/**
+ * milter_server_context_quit_new_connection:
+ * @context: a %MilterServerContext.
+ *
+ * Quits the current connection but keeps the socket for
+ * the next connection (SMFIC_QUIT_NC). @context stops
+ * using the socket and it is returned. Pass it to
+ * milter_server_context_reuse_connection() of a new
+ * context for the next connection. The client must
+ * support SMFIC_QUIT_NC.
+ *
+ * %NULL is returned when the socket can't be reused. For
+ * example, it is returned when @context isn't negotiated
+ * yet or is waiting for a reply.
+ *
+ * Returns: (transfer full) (nullable): the socket of the
+ *   connection or %NULL.
+ *
+ * Since: 2.3.3
+ */
+GIOChannel          *milter_server_context_quit_new_connection
+                                                       (MilterServerContext *context);
+
 /**
  * milter_server_context_abort:
  * @context: a %MilterServerContext.
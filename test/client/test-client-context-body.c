@@ -25,6 +25,9 @@
 #include <netinet/in.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 #include <milter/client.h>
 
@@ -34,6 +37,8 @@
 
 void test_replace_body (void);
 void test_replace_body_large (void);
+void test_replace_body_fd (void);
+void test_replace_body_stalled_mta (void);
 
 static MilterEventLoop *loop;
 
@@ -49,15 +54,27 @@ static GError *error_in_callback;
 static GString *expected_packet;
 
 static GString *body;
+static gint body_fd;
+static gboolean keep_writer;
+
+static GIOChannel *socket_channel;
+static MilterWriter *socket_writer;
+static gint peer_fd;
 
 static MilterStatus
 cb_end_of_message (MilterClientContext *context,
                    const gchar *chunk, gsize size,
                    gpointer user_data)
 {
-    milter_client_context_replace_body(context, body->str, body->len,
-                                       &error_in_callback);
-    milter_agent_set_writer(MILTER_AGENT(context), NULL);
+    if (body_fd == -1) {
+        milter_client_context_replace_body(context, body->str, body->len,
+                                           &error_in_callback);
+    } else {
+        milter_client_context_replace_body_fd(context, body_fd,
+                                              &error_in_callback);
+    }
+    if (!keep_writer)
+        milter_agent_set_writer(MILTER_AGENT(context), NULL);
 
     return MILTER_STATUS_CONTINUE;
 }
@@ -112,6 +129,12 @@ cut_setup (void)
     expected_packet = g_string_new(NULL);
 
     body = g_string_new(NULL);
+    body_fd = -1;
+    keep_writer = FALSE;
+
+    socket_channel = NULL;
+    socket_writer = NULL;
+    peer_fd = -1;
 }
 
 void
@@ -138,6 +161,16 @@ cut_teardown (void)
 
     if (body)
         g_string_free(body, TRUE);
+
+    if (body_fd != -1)
+        close(body_fd);
+
+    if (socket_channel)
+        g_io_channel_unref(socket_channel);
+    if (socket_writer)
+        g_object_unref(socket_writer);
+    if (peer_fd != -1)
+        close(peer_fd);
 }
 
 typedef void (*HookFunction) (void);
@@ -217,6 +250,154 @@ test_replace_body_large (void)
                             actual_data->str, actual_data->len);
 }
 
+void
+test_replace_body_fd (void)
+{
+    GString *actual_data;
+    gsize i, rest_size;
+    const gchar *packet;
+    gsize packet_size;
+    gsize packed_size = 0;
+    gchar *body_path = NULL;
+    GError *error = NULL;
+
+    for (i = 0; i < MILTER_CHUNK_SIZE + 500; i++) {
+        g_string_append_c(body, 'X');
+    }
+    body_fd = g_file_open_tmp(NULL, &body_path, &error);
+    gcut_assert_error(error);
+    unlink(body_path);
+    g_free(body_path);
+    cut_assert_equal_int(body->len, write(body_fd, body->str, body->len));
+    cut_assert_equal_int(0, lseek(body_fd, 0, SEEK_SET));
+
+    milter_command_encoder_encode_end_of_message(command_encoder,
+                                                 &packet, &packet_size,
+                                                 NULL, 0);
+    gcut_assert_error(feed(packet, packet_size));
+
+    milter_reply_encoder_encode_replace_body(reply_encoder,
+                                             &packet, &packet_size,
+                                             body->str, body->len,
+                                             &packed_size);
+    g_string_append_len(expected_packet, packet, packet_size);
+
+    rest_size = body->len - packed_size;
+    milter_reply_encoder_encode_replace_body(reply_encoder,
+                                             &packet, &packet_size,
+                                             body->str + packed_size,
+                                             rest_size, &packed_size);
+    g_string_append_len(expected_packet, packet, packet_size);
+
+    actual_data = gcut_string_io_channel_get_string(channel);
+    cut_assert_equal_memory(expected_packet->str, expected_packet->len,
+                            actual_data->str, actual_data->len);
+}
+
+static void
+setup_socket_pair_writer (void)
+{
+    gint fds[2];
+    gint send_buffer_size = 4096;
+    GError *error = NULL;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        cut_error_errno();
+    peer_fd = fds[1];
+    if (fcntl(peer_fd, F_SETFL, O_NONBLOCK) == -1)
+        cut_error_errno();
+    if (setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF,
+                   &send_buffer_size, sizeof(send_buffer_size)) == -1)
+        cut_error_errno();
+
+    socket_channel = g_io_channel_unix_new(fds[0]);
+    g_io_channel_set_close_on_unref(socket_channel, TRUE);
+    g_io_channel_set_encoding(socket_channel, NULL, NULL);
+    g_io_channel_set_buffered(socket_channel, FALSE);
+    g_io_channel_set_flags(socket_channel, G_IO_FLAG_NONBLOCK, &error);
+    gcut_assert_error(error);
+
+    socket_writer = milter_writer_io_channel_new(socket_channel);
+    milter_agent_set_writer(MILTER_AGENT(context), socket_writer);
+    milter_writer_start(socket_writer, loop);
+}
+
+static void
+read_peer (GString *data)
+{
+    gchar buffer[4096];
+    gssize read_size;
+
+    while ((read_size = read(peer_fd, buffer, sizeof(buffer))) > 0) {
+        g_string_append_len(data, buffer, read_size);
+    }
+    if (read_size == -1 && errno != EAGAIN)
+        cut_error_errno();
+}
+
+static void
+string_free (GString *string)
+{
+    g_string_free(string, TRUE);
+}
+
+void
+test_replace_body_stalled_mta (void)
+{
+    GString *actual_data;
+    GTimer *timer;
+    const gchar *packet;
+    gsize packet_size;
+    gsize i, offset, packed_size = 0;
+    GError *error = NULL;
+
+    cut_trace(setup_socket_pair_writer());
+    keep_writer = TRUE;
+
+    for (i = 0; i < MILTER_CHUNK_SIZE * 64; i++) {
+        g_string_append_c(body, 'X');
+    }
+    for (offset = 0; offset < body->len; offset += packed_size) {
+        milter_reply_encoder_encode_replace_body(reply_encoder,
+                                                 &packet, &packet_size,
+                                                 body->str + offset,
+                                                 body->len - offset,
+                                                 &packed_size);
+        g_string_append_len(expected_packet, packet, packet_size);
+    }
+
+    timer = g_timer_new();
+    cut_take(timer, (CutDestroyFunction)g_timer_destroy);
+    milter_command_encoder_encode_end_of_message(command_encoder,
+                                                 &packet, &packet_size,
+                                                 NULL, 0);
+    milter_client_context_feed(context, packet, packet_size, &error);
+    gcut_assert_error(error);
+    gcut_assert_error(error_in_callback);
+    cut_assert_operator(g_timer_elapsed(timer, NULL), <, 1.0);
+
+    /* The MTA doesn't read longer than the drain timeout. */
+    g_timer_start(timer);
+    while (g_timer_elapsed(timer, NULL) < 6.0) {
+        milter_event_loop_iterate(loop, FALSE);
+        g_usleep(G_USEC_PER_SEC / 10);
+    }
+    cut_assert_operator_uint(milter_agent_get_pending_write_size(
+                                 MILTER_AGENT(context)), >, 0);
+
+    actual_data = g_string_new(NULL);
+    cut_take(actual_data, (CutDestroyFunction)string_free);
+    g_timer_start(timer);
+    while (actual_data->len < expected_packet->len &&
+           g_timer_elapsed(timer, NULL) < 10.0) {
+        milter_event_loop_iterate(loop, FALSE);
+        read_peer(actual_data);
+    }
+    cut_assert_operator_uint(actual_data->len, >=, expected_packet->len);
+    cut_assert_equal_memory(expected_packet->str, expected_packet->len,
+                            actual_data->str, expected_packet->len);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
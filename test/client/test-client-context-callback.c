@@ -60,6 +60,7 @@ void test_feed_body (gconstpointer data);
 void data_feed_end_of_message (void);
 void test_feed_end_of_message (gconstpointer data);
 void test_feed_quit (void);
+void test_feed_quit_new_connection (void);
 void test_feed_abort (void);
 void test_feed_abort_outsize_message_processing (void);
 void test_write_error (void);
@@ -101,6 +102,7 @@ static gint n_unknowns;
 static gint n_unknown_responses;
 static gint n_errors;
 static gint n_finished_emissions;
+static gint n_quit_new_connections;
 
 static MilterOption *negotiate_option;
 static MilterMacrosRequests *negotiate_macros_requests;
@@ -492,6 +494,12 @@ cb_finished (MilterFinishedEmittable *emittable, gpointer user_data)
     n_finished_emissions++;
 }
 
+static void
+cb_quit_new_connection (MilterClientContext *context, gpointer user_data)
+{
+    n_quit_new_connections++;
+}
+
 static void
 setup_signals (MilterClientContext *context)
 {
@@ -518,6 +526,8 @@ setup_signals (MilterClientContext *context)
 #undef CONNECT
     g_signal_connect(context, "error", G_CALLBACK(cb_error), NULL);
     g_signal_connect(context, "finished", G_CALLBACK(cb_finished), NULL);
+    g_signal_connect(context, "quit-new-connection",
+                     G_CALLBACK(cb_quit_new_connection), NULL);
     g_signal_connect(context, "define-macro", G_CALLBACK(cb_define_macro), NULL);
 }
 
@@ -569,6 +579,7 @@ cut_setup (void)
     n_unknown_responses = 0;
     n_errors = 0;
     n_finished_emissions = 0;
+    n_quit_new_connections = 0;
     n_define_macros = 0;
 
     negotiate_option = NULL;
@@ -1588,6 +1599,40 @@ test_feed_quit (void)
                                                available_macros);
 }
 
+void
+test_feed_quit_new_connection (void)
+{
+    struct sockaddr_in address;
+    const gchar host_name[] = "mx.local.net";
+    const gchar *packet;
+    gsize packet_size;
+    gint n_connects_before;
+
+    test_feed_end_of_message(feed_end_of_message_pre_hook_with_macro);
+    clear_reuse_data();
+
+    milter_command_encoder_encode_quit_new_connection(encoder,
+                                                      &packet, &packet_size);
+    gcut_assert_error(feed(packet, packet_size));
+    cut_assert_equal_int(1, n_quit_new_connections);
+    cut_assert_equal_int(0, n_finished_emissions);
+    milter_assert_equal_state(NEGOTIATE_REPLIED);
+
+    n_connects_before = n_connects;
+    address.sin_family = AF_INET;
+    address.sin_port = g_htons(50443);
+    inet_pton(AF_INET, "192.168.123.123", &(address.sin_addr));
+    milter_command_encoder_encode_connect(encoder,
+                                          &packet, &packet_size,
+                                          host_name,
+                                          (const struct sockaddr *)&address,
+                                          sizeof(address));
+    gcut_assert_error(feed(packet, packet_size));
+    cut_assert_equal_int(n_connects_before + 1, n_connects);
+    milter_assert_equal_state(CONNECT_REPLIED);
+    cut_assert_equal_int(0, n_finished_emissions);
+}
+
 void
 test_feed_abort (void)
 {
@@ -74,6 +74,9 @@ void test_custom_fork (void);
 void test_default_packet_buffer_size (void);
 void test_worker_id (void);
 void test_max_pending_finished_sessions (void);
+void test_multi_thread_mode (void);
+void test_max_threads (void);
+void test_n_processing_sessions_in_threads (void);
 
 static MilterEventLoop *loop;
 
@@ -1103,6 +1106,65 @@ test_max_pending_finished_sessions (void)
         29, milter_client_get_max_pending_finished_sessions(client));
 }
 
+void
+test_multi_thread_mode (void)
+{
+    cut_assert_false(milter_client_is_multi_thread_mode(client));
+    milter_client_set_multi_thread_mode(client, TRUE);
+    cut_assert_true(milter_client_is_multi_thread_mode(client));
+}
+
+void
+test_max_threads (void)
+{
+    cut_assert_equal_uint(MILTER_CLIENT_DEFAULT_MAX_THREADS,
+                          milter_client_get_max_threads(client));
+    milter_client_set_max_threads(client, 29);
+    cut_assert_equal_uint(29, milter_client_get_max_threads(client));
+    milter_client_set_max_threads(client, 0);
+    cut_assert_equal_uint(MILTER_CLIENT_DEFAULT_MAX_THREADS,
+                          milter_client_get_max_threads(client));
+}
+
+#define N_SESSION_THREADS 8
+#define N_SESSIONS_PER_THREAD 10000
+static gpointer
+process_sessions_in_thread (gpointer data)
+{
+    MilterClient *client = data;
+    gint i;
+
+    for (i = 0; i < N_SESSIONS_PER_THREAD; i++) {
+        milter_client_session_started(client);
+        milter_client_session_finished(client);
+    }
+
+    return NULL;
+}
+
+void
+test_n_processing_sessions_in_threads (void)
+{
+    GThread *threads[N_SESSION_THREADS];
+    gint i;
+
+    for (i = 0; i < N_SESSION_THREADS; i++) {
+        threads[i] = g_thread_new("session", process_sessions_in_thread,
+                                  client);
+    }
+    for (i = 0; i < N_SESSIONS_PER_THREAD; i++) {
+        milter_client_session_started(client);
+    }
+    for (i = 0; i < N_SESSION_THREADS; i++) {
+        g_thread_join(threads[i]);
+    }
+
+    cut_assert_equal_uint(N_SESSIONS_PER_THREAD,
+                          milter_client_get_n_processing_sessions(client));
+    cut_assert_true(milter_client_is_processing(client));
+}
+#undef N_SESSIONS_PER_THREAD
+#undef N_SESSION_THREADS
 
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
@@ -60,6 +60,7 @@ void test_decode_connect_with_invalid_ipv4_address (void);
 void test_decode_connect_with_invalid_ipv6_address (void);
 void test_decode_helo (void);
 void test_decode_helo_without_null (void);
+void test_decode_helo_split_chunks (void);
 void test_decode_envelope_from (void);
 void test_decode_envelope_from_without_null (void);
 void test_decode_envelope_recipient (void);
@@ -78,6 +79,8 @@ void test_decode_abort (void);
 void test_decode_abort_with_garbage (void);
 void test_decode_quit (void);
 void test_decode_quit_with_garbage (void);
+void test_decode_quit_new_connection (void);
+void test_decode_quit_new_connection_with_garbage (void);
 void test_decode_unknown (void);
 void test_decode_unknown_without_null (void);
 void test_decode_unexpected_command (void);
@@ -101,6 +104,7 @@ static gint n_bodies;
 static gint n_end_of_messages;
 static gint n_aborts;
 static gint n_quits;
+static gint n_quit_new_connections;
 static gint n_unknowns;
 
 static MilterOption *negotiate_option;
@@ -169,6 +173,8 @@ cb_helo (MilterDecoder *decoder, const gchar *fqdn, gpointer user_data)
 {
     n_helos++;
 
+    if (helo_fqdn)
+        g_free(helo_fqdn);
     helo_fqdn = g_strdup(fqdn);
 }
 
@@ -251,6 +257,12 @@ cb_quit (MilterDecoder *decoder, gpointer user_data)
     n_quits++;
 }
 
+static void
+cb_quit_new_connection (MilterDecoder *decoder, gpointer user_data)
+{
+    n_quit_new_connections++;
+}
+
 static void
 cb_unknown (MilterDecoder *decoder, const gchar *command, gpointer user_data)
 {
@@ -280,6 +292,7 @@ setup_signals (MilterDecoder *decoder)
     CONNECT(end_of_message);
     CONNECT(abort);
     CONNECT(quit);
+    CONNECT(quit_new_connection);
     CONNECT(unknown);
 
 #undef CONNECT
@@ -307,6 +320,7 @@ setup (void)
     n_end_of_messages = 0;
     n_aborts = 0;
     n_quits = 0;
+    n_quit_new_connections = 0;
     n_unknowns = 0;
 
     buffer = g_string_new(NULL);
@@ -1253,6 +1267,30 @@ test_decode_helo_without_null (void)
     gcut_assert_equal_error(expected_error, actual_error);
 }
 
+void
+test_decode_helo_split_chunks (void)
+{
+    const gchar packets[] =
+        "\0\0\0\x08" "Hdelian\0"
+        "\0\0\0\x08" "Hmilter\0";
+    gsize packets_size = sizeof(packets) - 1;
+    GError *error = NULL;
+
+    milter_decoder_decode(decoder, packets, 14, &error);
+    gcut_assert_error(error);
+    cut_assert_equal_int(1, n_helos);
+    cut_assert_equal_string("delian", helo_fqdn);
+
+    milter_decoder_decode(decoder, packets + 14, 3, &error);
+    gcut_assert_error(error);
+    cut_assert_equal_int(1, n_helos);
+
+    milter_decoder_decode(decoder, packets + 17, packets_size - 17, &error);
+    gcut_assert_error(error);
+    cut_assert_equal_int(2, n_helos);
+    cut_assert_equal_string("milter", helo_fqdn);
+}
+
 void
 test_decode_envelope_from (void)
 {
@@ -1594,6 +1632,30 @@ test_decode_quit_with_garbage (void)
     gcut_assert_equal_error(expected_error, actual_error);
 }
 
+void
+test_decode_quit_new_connection (void)
+{
+    g_string_append(buffer, "K");
+    gcut_assert_error(decode());
+
+    cut_assert_equal_int(1, n_quit_new_connections);
+    cut_assert_equal_int(0, n_quits);
+}
+
+void
+test_decode_quit_new_connection_with_garbage (void)
+{
+    g_string_append(buffer, "K");
+    g_string_append(buffer, "XXX");
+
+    expected_error = g_error_new(MILTER_DECODER_ERROR,
+                                 MILTER_DECODER_ERROR_LONG_COMMAND_LENGTH,
+                                 "needless 3 bytes were received "
+                                 "on QUIT_NC command: 0x58 0x58 0x58 (XXX)");
+    actual_error = decode();
+    gcut_assert_equal_error(expected_error, actual_error);
+}
+
 void
 test_decode_unknown (void)
 {
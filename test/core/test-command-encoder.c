@@ -53,6 +53,7 @@ void test_encode_end_of_message (void);
 void test_encode_end_of_message_with_data (void);
 void test_encode_abort (void);
 void test_encode_quit (void);
+void test_encode_quit_new_connection (void);
 void test_encode_unknown (void);
 
 static MilterCommandEncoder *encoder;
@@ -619,6 +620,20 @@ test_encode_quit (void)
     cut_assert_equal_memory(expected->str, expected->len, actual, actual_size);
 }
 
+void
+test_encode_quit_new_connection (void)
+{
+    const gchar *actual;
+    gsize actual_size = 0;
+
+    g_string_append(expected, "K");
+    pack(expected);
+
+    milter_command_encoder_encode_quit_new_connection(encoder,
+                                                      &actual, &actual_size);
+    cut_assert_equal_memory(expected->str, expected->len, actual, actual_size);
+}
+
 void
 test_encode_unknown (void)
 {
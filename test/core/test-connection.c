@@ -49,6 +49,7 @@ void test_listen (void);
 void test_listen_exist_socket (void);
 void test_listen_remove_failure (void);
 void test_listen_nonexistent_path (void);
+void test_listen_reuse_port (void);
 
 static struct sockaddr *actual_address;
 static socklen_t actual_address_size;
@@ -58,6 +59,9 @@ static GError *actual_error;
 
 static gchar *tmp_dir;
 
+static GIOChannel *channel1;
+static GIOChannel *channel2;
+
 void
 setup (void)
 {
@@ -67,6 +71,9 @@ setup (void)
     expected_error = NULL;
     actual_error = NULL;
 
+    channel1 = NULL;
+    channel2 = NULL;
+
     tmp_dir = g_build_filename(milter_test_get_base_dir(),
                                "tmp",
                                NULL);
@@ -86,6 +93,11 @@ teardown (void)
     if (actual_error)
         g_error_free(actual_error);
 
+    if (channel1)
+        g_io_channel_unref(channel1);
+    if (channel2)
+        g_io_channel_unref(channel2);
+
     if (tmp_dir) {
         g_chmod(tmp_dir, 0755);
         cut_remove_path(tmp_dir, NULL);
@@ -618,6 +630,27 @@ test_listen_nonexistent_path (void)
     cut_assert_equal_int(0, address_size);
 }
 
+void
+test_listen_reuse_port (void)
+{
+    const gchar *spec = "inet:9998@127.0.0.1";
+    GError *error = NULL;
+
+#ifndef SO_REUSEPORT
+    cut_omit("SO_REUSEPORT isn't supported");
+#endif
+
+    channel1 = milter_connection_listen_full(spec, 5, NULL, NULL,
+                                             FALSE, TRUE, &error);
+    gcut_assert_error(error);
+    cut_assert_true(milter_connection_is_reuse_port(channel1));
+
+    channel2 = milter_connection_listen_full(spec, 5, NULL, NULL,
+                                             FALSE, TRUE, &error);
+    gcut_assert_error(error);
+    cut_assert_true(milter_connection_is_reuse_port(channel2));
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -5,6 +5,8 @@
 #endif
 
 #include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include <milter/core/milter-enum-types.h>
 #include <milter/core/milter-event-loop.h>
@@ -17,9 +19,22 @@ void data_add_timeout (void);
 void test_add_timeout (gconstpointer data);
 void data_add_timeout_negative (void);
 void test_add_timeout_negative (gconstpointer data);
+void data_deadline (void);
+void test_deadline (gconstpointer data);
+void data_deadline_cancel (void);
+void test_deadline_cancel (gconstpointer data);
+void data_watch_io (void);
+void test_watch_io (gconstpointer data);
+void data_watch_io_read_level (void);
+void test_watch_io_read_level (gconstpointer data);
+void data_watch_io_write_level (void);
+void test_watch_io_write_level (gconstpointer data);
+void data_idle_priority (void);
+void test_idle_priority (gconstpointer data);
 
 static gboolean timeout_waiting;
 static guint n_timeouts;
+static GString *idle_labels;
 
 static gboolean
 cb_timeout (gpointer data)
@@ -31,11 +46,31 @@ cb_timeout (gpointer data)
     return FALSE;
 }
 
+static MilterEventLoop *
+event_loop_new (GType event_loop_type)
+{
+    MilterEventLoop *loop = NULL;
+
+    if (event_loop_type == MILTER_TYPE_GLIB_EVENT_LOOP) {
+        loop = milter_glib_event_loop_new(NULL);
+    } else if (event_loop_type == MILTER_TYPE_LIBEV_EVENT_LOOP) {
+        loop = milter_libev_event_loop_new();
+    }
+    return loop;
+}
+
 void
 cut_setup (void)
 {
     timeout_waiting = TRUE;
     n_timeouts = 0;
+    idle_labels = g_string_new(NULL);
+}
+
+void
+cut_teardown (void)
+{
+    g_string_free(idle_labels, TRUE);
 }
 
 void data_add_timeout (void)
@@ -61,11 +96,7 @@ void test_add_timeout (gconstpointer data)
     GType event_loop_type = gcut_data_get_type(data, "event-loop-type");
     gint interval = gcut_data_get_int(data, "interval");
 
-    if (event_loop_type == MILTER_TYPE_GLIB_EVENT_LOOP) {
-        loop = milter_glib_event_loop_new(NULL);
-    } else if (event_loop_type == MILTER_TYPE_LIBEV_EVENT_LOOP) {
-        loop = milter_libev_event_loop_new();
-    }
+    loop = event_loop_new(event_loop_type);
 
     guint id = milter_event_loop_add_timeout(loop, interval, cb_timeout, &timeout_waiting);
     while (timeout_waiting) {
@@ -98,13 +129,264 @@ void test_add_timeout_negative (gconstpointer data)
     GType event_loop_type = gcut_data_get_type(data, "event-loop-type");
     gint interval = gcut_data_get_int(data, "interval");
 
-    if (event_loop_type == MILTER_TYPE_GLIB_EVENT_LOOP) {
-        loop = milter_glib_event_loop_new(NULL);
-    } else if (event_loop_type == MILTER_TYPE_LIBEV_EVENT_LOOP) {
-        loop = milter_libev_event_loop_new();
-    }
+    loop = event_loop_new(event_loop_type);
 
     guint id = milter_event_loop_add_timeout(loop, interval, cb_timeout, &timeout_waiting);
     cut_assert_equal_uint(0, id);
     milter_event_loop_quit(loop);
 }
+
+void
+data_deadline (void)
+{
+#define ADD_DATUM(label, event_loop_type)                               \
+    gcut_add_datum(label,                                               \
+                   "event-loop-type", G_TYPE_GTYPE,                     \
+                   MILTER_TYPE_ ## event_loop_type ## _EVENT_LOOP,      \
+                   NULL)
+
+    ADD_DATUM("glib", GLIB);
+    ADD_DATUM("libev", LIBEV);
+
+#undef ADD_DATUM
+}
+
+void
+test_deadline (gconstpointer data)
+{
+    MilterEventLoop *loop;
+    MilterEventLoopDeadline deadline;
+    gboolean reset_waiting = TRUE;
+
+    loop = event_loop_new(gcut_data_get_type(data, "event-loop-type"));
+    gcut_take_object(G_OBJECT(loop));
+
+    milter_event_loop_deadline_init(&deadline);
+    cut_assert_false(milter_event_loop_deadline_is_active(&deadline));
+
+    milter_event_loop_deadline_set(loop, &deadline, 10,
+                                   cb_timeout, &reset_waiting);
+    milter_event_loop_deadline_set(loop, &deadline, 0.1,
+                                   cb_timeout, &timeout_waiting);
+    cut_assert_true(milter_event_loop_deadline_is_active(&deadline));
+    while (timeout_waiting) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    cut_assert_false(milter_event_loop_deadline_is_active(&deadline));
+    cut_assert_true(reset_waiting);
+    cut_assert_equal_uint(1, n_timeouts);
+}
+
+void
+data_deadline_cancel (void)
+{
+    data_deadline();
+}
+
+void
+test_deadline_cancel (gconstpointer data)
+{
+    MilterEventLoop *loop;
+    MilterEventLoopDeadline deadline;
+    gboolean deadline_waiting = TRUE;
+    guint id;
+
+    loop = event_loop_new(gcut_data_get_type(data, "event-loop-type"));
+    gcut_take_object(G_OBJECT(loop));
+
+    milter_event_loop_deadline_init(&deadline);
+    milter_event_loop_deadline_set(loop, &deadline, 0.1,
+                                   cb_timeout, &deadline_waiting);
+    milter_event_loop_deadline_cancel(&deadline);
+    cut_assert_false(milter_event_loop_deadline_is_active(&deadline));
+
+    id = milter_event_loop_add_timeout(loop, 0.5, cb_timeout, &timeout_waiting);
+    while (timeout_waiting) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    milter_event_loop_remove(loop, id);
+    cut_assert_true(deadline_waiting);
+    cut_assert_equal_uint(1, n_timeouts);
+}
+
+void
+data_watch_io (void)
+{
+    data_deadline();
+}
+
+static gboolean
+cb_watch_io (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    GIOCondition *received_condition = data;
+
+    *received_condition = condition;
+    return FALSE;
+}
+
+void
+test_watch_io (gconstpointer data)
+{
+    MilterEventLoop *loop;
+    GIOChannel *channel;
+    GIOCondition condition = 0;
+    gint fds[2];
+    guint id;
+
+    loop = event_loop_new(gcut_data_get_type(data, "event-loop-type"));
+    gcut_take_object(G_OBJECT(loop));
+
+    cut_assert_equal_int(0, pipe(fds));
+    channel = g_io_channel_unix_new(fds[0]);
+    g_io_channel_set_close_on_unref(channel, TRUE);
+    cut_assert_equal_int(1, write(fds[1], "x", 1));
+    close(fds[1]);
+
+    id = milter_event_loop_watch_io(loop, channel, G_IO_IN,
+                                    cb_watch_io, &condition);
+    g_io_channel_unref(channel);
+    while (condition == 0) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    cut_assert_true(condition & G_IO_IN);
+    cut_assert_false(milter_event_loop_remove(loop, id));
+}
+
+void
+data_watch_io_read_level (void)
+{
+    data_deadline();
+}
+
+static gboolean
+cb_read_one_byte (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    guint *n_read = data;
+    gchar buffer[1];
+
+    if (read(g_io_channel_unix_get_fd(channel), buffer, 1) == 1)
+        (*n_read)++;
+    return TRUE;
+}
+
+void
+test_watch_io_read_level (gconstpointer data)
+{
+    MilterEventLoop *loop;
+    GIOChannel *channel;
+    gint fds[2];
+    guint n_read = 0;
+    guint id, timeout_id;
+
+    loop = event_loop_new(gcut_data_get_type(data, "event-loop-type"));
+    gcut_take_object(G_OBJECT(loop));
+
+    cut_assert_equal_int(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    channel = g_io_channel_unix_new(fds[0]);
+    g_io_channel_set_close_on_unref(channel, TRUE);
+    cut_assert_equal_int(3, write(fds[1], "xyz", 3));
+
+    id = milter_event_loop_watch_io(loop, channel, G_IO_IN,
+                                    cb_read_one_byte, &n_read);
+    g_io_channel_unref(channel);
+    timeout_id = milter_event_loop_add_timeout(loop, 1, cb_timeout,
+                                               &timeout_waiting);
+    while (n_read < 3 && timeout_waiting) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    milter_event_loop_remove(loop, id);
+    milter_event_loop_remove(loop, timeout_id);
+    close(fds[1]);
+    cut_assert_equal_uint(3, n_read);
+}
+
+void
+data_watch_io_write_level (void)
+{
+    data_deadline();
+}
+
+static gboolean
+cb_write_one_byte (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    guint *n_written = data;
+
+    if (write(g_io_channel_unix_get_fd(channel), "x", 1) == 1)
+        (*n_written)++;
+    return TRUE;
+}
+
+void
+test_watch_io_write_level (gconstpointer data)
+{
+    MilterEventLoop *loop;
+    GIOChannel *channel;
+    gint fds[2];
+    guint n_written = 0;
+    guint id, timeout_id;
+    gchar buffer[8];
+
+    loop = event_loop_new(gcut_data_get_type(data, "event-loop-type"));
+    gcut_take_object(G_OBJECT(loop));
+
+    cut_assert_equal_int(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    channel = g_io_channel_unix_new(fds[0]);
+    g_io_channel_set_close_on_unref(channel, TRUE);
+
+    id = milter_event_loop_watch_io(loop, channel, G_IO_OUT,
+                                    cb_write_one_byte, &n_written);
+    g_io_channel_unref(channel);
+    timeout_id = milter_event_loop_add_timeout(loop, 1, cb_timeout,
+                                               &timeout_waiting);
+    while (n_written < 5 && timeout_waiting) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    milter_event_loop_remove(loop, id);
+    milter_event_loop_remove(loop, timeout_id);
+    cut_assert_equal_uint(5, n_written);
+    cut_assert_equal_int(5, read(fds[1], buffer, sizeof(buffer)));
+    close(fds[1]);
+}
+
+void
+data_idle_priority (void)
+{
+#define ADD_DATUM(label, event_loop_type)                               \
+    gcut_add_datum(label,                                               \
+                   "event-loop-type", G_TYPE_GTYPE,                     \
+                   MILTER_TYPE_ ## event_loop_type ## _EVENT_LOOP,      \
+                   NULL)
+
+    ADD_DATUM("glib", GLIB);
+
+#undef ADD_DATUM
+}
+
+static gboolean
+cb_append_label (gpointer data)
+{
+    const gchar *label = data;
+
+    g_string_append(idle_labels, label);
+    return FALSE;
+}
+
+void
+test_idle_priority (gconstpointer data)
+{
+    MilterEventLoop *loop;
+
+    loop = event_loop_new(gcut_data_get_type(data, "event-loop-type"));
+    gcut_take_object(G_OBJECT(loop));
+
+    milter_event_loop_add_idle_full(loop, G_PRIORITY_LOW,
+                                    cb_append_label, "low", NULL);
+    milter_event_loop_add_idle_full(loop, G_PRIORITY_HIGH,
+                                    cb_append_label, "high", NULL);
+    milter_event_loop_add_idle_full(loop, G_PRIORITY_HIGH,
+                                    cb_append_label, "-high", NULL);
+    while (strlen(idle_labels->str) < strlen("high-highlow")) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    cut_assert_equal_string("high-highlow", idle_labels->str);
+}
@@ -32,6 +32,7 @@ void test_length (void);
 void test_get_nth_header (void);
 void test_find (void);
 void test_lookup_by_name (void);
+void test_lookup_by_name_case_sensitive (void);
 void test_index_in_same_header_name (void);
 void test_copy (void);
 void test_remove (void);
@@ -42,6 +43,7 @@ void test_insert_header (void);
 void test_change_header (void);
 void test_delete_header_with_change_header (void);
 void test_delete_header (void);
+void test_delete_header_many (void);
 
 static MilterHeaders *headers;
 static GList *expected_list;
@@ -180,6 +182,27 @@ test_lookup_by_name (void)
     cut_assert_equal_string("Third header value", actual_header->value);
 }
 
+void
+test_lookup_by_name_case_sensitive (void)
+{
+    MilterHeader *actual_header;
+
+    cut_assert_true(milter_headers_append_header(headers,
+                                                 "x-test",
+                                                 "Lower case value"));
+    cut_assert_true(milter_headers_append_header(headers,
+                                                 "X-Test",
+                                                 "Mixed case value"));
+
+    actual_header = milter_headers_lookup_by_name(headers, "X-Test");
+    cut_assert_equal_string("Mixed case value", actual_header->value);
+
+    actual_header = milter_headers_lookup_by_name(headers, "x-test");
+    cut_assert_equal_string("Lower case value", actual_header->value);
+
+    cut_assert_null(milter_headers_lookup_by_name(headers, "X-TEST"));
+}
+
 void
 test_index_in_same_header_name (void)
 {
@@ -536,6 +559,51 @@ test_delete_header (void)
 }
 
 
+void
+test_delete_header_many (void)
+{
+    MilterHeader *header;
+    guint i;
+
+    for (i = 0; i < 200; i++) {
+        gchar *value;
+
+        value = g_strdup_printf("Received value %u", i);
+        cut_assert_true(milter_headers_append_header(headers,
+                                                     "Received",
+                                                     value));
+        g_free(value);
+        cut_assert_true(milter_headers_append_header(headers,
+                                                     "X-Other",
+                                                     "Other value"));
+    }
+
+    for (i = 0; i < 100; i++) {
+        cut_assert_true(milter_headers_delete_header(headers,
+                                                     "Received",
+                                                     i + 1));
+    }
+    cut_assert_false(milter_headers_delete_header(headers, "Received", 101));
+    cut_assert_equal_uint(300, milter_headers_length(headers));
+
+    header = milter_header_new("Received", "Received value 199");
+    expected_list = g_list_append(expected_list, header);
+    cut_assert_equal_int(100,
+                         milter_headers_index_in_same_header_name(headers,
+                                                                  header));
+
+    header = milter_header_new("Received", "Received value 2");
+    expected_list = g_list_append(expected_list, header);
+    cut_assert_equal_int(-1,
+                         milter_headers_index_in_same_header_name(headers,
+                                                                  header));
+
+    header = milter_header_new("Received", "Received value 1");
+    expected_list = g_list_append(expected_list, header);
+    milter_assert_equal_header(header,
+                               milter_headers_get_nth_header(headers, 2));
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
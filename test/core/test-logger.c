@@ -50,6 +50,7 @@ void test_interesting_level (void);
 void test_path_success (void);
 void test_path_null (void);
 void test_path_nonexistent (void);
+void test_flush (void);
 
 static MilterLogger *logger;
 
@@ -404,6 +405,32 @@ test_path_nonexistent (void)
     cut_assert_equal_string(NULL, milter_logger_get_path(logger));
 }
 
+void
+test_flush (void)
+{
+    const gchar *path;
+    gchar *content = NULL;
+    GError *error = NULL;
+
+    logger = milter_logger_new();
+    milter_logger_connect_default_handler(logger);
+    milter_logger_set_target_item(logger, MILTER_LOG_ITEM_NONE);
+
+    path = cut_build_path(tmp_dir, "output.log", NULL);
+    cut_assert_true(milter_logger_set_path(logger, path, &error));
+    gcut_assert_error(error);
+
+    milter_logger_log(logger, "test", MILTER_LOG_LEVEL_STATISTICS,
+                      __FILE__, __LINE__, G_STRFUNC,
+                      "[statistics] %d", 29);
+    milter_logger_flush(logger);
+
+    g_file_get_contents(path, &content, NULL, &error);
+    gcut_assert_error(error);
+    cut_take_string(content);
+    cut_assert_equal_string("[statistics] 29\n", content);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
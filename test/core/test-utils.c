@@ -34,6 +34,8 @@ void test_inspect_flags (void);
 void test_inspect_object (void);
 void test_inspect_hash_string_string (void);
 void test_merge_hash_string_string (void);
+void test_intern_macro_name (void);
+void test_intern_macro_name_invalid (void);
 void test_inspect_list_pointer (void);
 void data_command_to_macro_stage (void);
 void test_command_to_macro_stage (gconstpointer data);
@@ -278,6 +280,38 @@ test_merge_hash_string_string (void)
     gcut_assert_equal_hash_table_string_string(expected, dest);
 }
 
+void
+test_intern_macro_name (void)
+{
+    const gchar *name;
+
+    name = milter_utils_intern_macro_name("daemon_name", -1);
+    cut_assert_equal_string("daemon_name", name);
+    cut_assert_equal_pointer(name,
+                             milter_utils_intern_macro_name("daemon_name}",
+                                                            11));
+    cut_assert_equal_string("i", milter_utils_intern_macro_name("i", -1));
+    cut_assert_equal_string("_", milter_utils_intern_macro_name("_", -1));
+    cut_assert_equal_string("{if_name}",
+                            milter_utils_intern_macro_name("{if_name}", -1));
+}
+
+void
+test_intern_macro_name_invalid (void)
+{
+    const gchar *long_name;
+    const gchar *unknown_name = "unknown macro name!";
+
+    long_name = cut_take_string(g_strnfill(64, 'x'));
+    cut_assert_null(milter_utils_intern_macro_name(long_name, -1));
+    cut_assert_equal_uint(0, g_quark_try_string(long_name));
+
+    cut_assert_null(milter_utils_intern_macro_name(unknown_name, -1));
+    cut_assert_equal_uint(0, g_quark_try_string(unknown_name));
+
+    cut_assert_null(milter_utils_intern_macro_name("", -1));
+}
+
 void
 test_inspect_list_pointer (void)
 {
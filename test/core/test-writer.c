@@ -28,10 +28,17 @@
 #include <milter/core/milter-writer.h>
 #undef shutdown
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
 
 void test_writer (void);
 void test_writer_huge_data (void);
+void test_writer_buffered_chunks (void);
+void test_writer_partial_write (void);
 void test_writer_error (void);
+void test_drain (void);
+void test_drain_timeout (void);
 void test_tag (void);
 
 static MilterEventLoop *loop;
@@ -39,6 +46,7 @@ static MilterEventLoop *loop;
 static MilterWriter *writer;
 
 static GIOChannel *channel;
+static gint peer_fd;
 
 static GError *expected_error;
 static GError *actual_error;
@@ -67,6 +75,8 @@ cut_setup (void)
     milter_writer_start(writer, loop);
     setup_error_callback();
 
+    peer_fd = -1;
+
     expected_error = NULL;
     actual_error = NULL;
 }
@@ -83,6 +93,9 @@ cut_teardown (void)
     if (loop)
         g_object_unref(loop);
 
+    if (peer_fd != -1)
+        close(peer_fd);
+
     if (expected_error)
         g_error_free(expected_error);
     if (actual_error)
@@ -174,6 +187,129 @@ test_writer_huge_data (void)
                             actual_data->str, actual_data->len);
 }
 
+void
+test_writer_buffered_chunks (void)
+{
+    GString *buffer;
+    const gchar *expected_data;
+    gsize expected_data_size;
+    GString *actual_data;
+    GError *error = NULL;
+    gint i;
+
+    buffer = g_string_new(NULL);
+    for (i = 0; i < 1024; i++) {
+        gchar *chunk;
+
+        chunk = g_strdup_printf("chunk%d\n", i);
+        g_string_append(buffer, chunk);
+        milter_writer_write(writer, chunk, strlen(chunk), &error);
+        g_free(chunk);
+        gcut_assert_error(error);
+    }
+    expected_data_size = buffer->len;
+    expected_data = cut_take_string(g_string_free(buffer, FALSE));
+
+    milter_writer_flush(writer, &error);
+    gcut_assert_error(error);
+
+    pump_all_events();
+
+    actual_data = gcut_string_io_channel_get_string(channel);
+    cut_assert_equal_memory(expected_data, expected_data_size,
+                            actual_data->str, actual_data->len);
+}
+
+static void
+string_free (GString *string)
+{
+    g_string_free(string, TRUE);
+}
+
+static void
+setup_socket_pair_writer (void)
+{
+    gint fds[2];
+    gint send_buffer_size = 4096;
+    GError *error = NULL;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        cut_error_errno();
+    peer_fd = fds[1];
+    if (fcntl(peer_fd, F_SETFL, O_NONBLOCK) == -1)
+        cut_error_errno();
+    if (setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF,
+                   &send_buffer_size, sizeof(send_buffer_size)) == -1)
+        cut_error_errno();
+
+    g_object_unref(writer);
+    g_io_channel_unref(channel);
+
+    channel = g_io_channel_unix_new(fds[0]);
+    g_io_channel_set_close_on_unref(channel, TRUE);
+    g_io_channel_set_encoding(channel, NULL, NULL);
+    g_io_channel_set_buffered(channel, FALSE);
+    g_io_channel_set_flags(channel, G_IO_FLAG_NONBLOCK, &error);
+    gcut_assert_error(error);
+
+    writer = milter_writer_io_channel_new(channel);
+    milter_writer_start(writer, loop);
+    setup_error_callback();
+}
+
+void
+test_writer_partial_write (void)
+{
+    GString *expected_data;
+    GString *actual_data;
+    gchar read_buffer[4096];
+    gboolean partially_written = FALSE;
+    GTimer *timer;
+    GError *error = NULL;
+    gint i;
+
+    cut_trace(setup_socket_pair_writer());
+
+    expected_data = g_string_new(NULL);
+    cut_take(expected_data, (CutDestroyFunction)string_free);
+    for (i = 0; i < 8192; i++) {
+        gchar *chunk;
+
+        chunk = g_strdup_printf("chunk%d\n", i);
+        g_string_append(expected_data, chunk);
+        milter_writer_write(writer, chunk, strlen(chunk), &error);
+        g_free(chunk);
+        gcut_assert_error(error);
+    }
+    milter_writer_flush(writer, &error);
+    gcut_assert_error(error);
+
+    actual_data = g_string_new(NULL);
+    cut_take(actual_data, (CutDestroyFunction)string_free);
+    timer = g_timer_new();
+    cut_take(timer, (CutDestroyFunction)g_timer_destroy);
+    while (actual_data->len < expected_data->len &&
+           g_timer_elapsed(timer, NULL) < 5.0) {
+        gsize pending_size;
+        ssize_t read_size;
+
+        milter_event_loop_iterate(loop, FALSE);
+        gcut_assert_error(actual_error);
+
+        pending_size = milter_writer_get_pending_size(writer);
+        if (0 < pending_size && pending_size < expected_data->len)
+            partially_written = TRUE;
+
+        read_size = read(peer_fd, read_buffer, sizeof(read_buffer));
+        if (read_size > 0)
+            g_string_append_len(actual_data, read_buffer, read_size);
+    }
+
+    cut_assert_true(partially_written);
+    cut_assert_equal_memory(expected_data->str, expected_data->len,
+                            actual_data->str, actual_data->len);
+}
+
 void
 test_writer_error (void)
 {
@@ -200,6 +336,66 @@ test_writer_error (void)
     gcut_assert_equal_error(expected_error, actual_error);
 }
 
+void
+test_drain (void)
+{
+    gchar *binary_data;
+    gsize data_size;
+    GString *actual_data;
+    GError *error = NULL;
+
+    data_size = 192 * 8192;
+    binary_data = g_new(gchar, data_size);
+    cut_take_memory(binary_data);
+    memset(binary_data, 'X', data_size);
+
+    milter_writer_write(writer, binary_data, data_size, &error);
+    gcut_assert_error(error);
+    cut_assert_equal_uint(data_size, milter_writer_get_pending_size(writer));
+
+    milter_writer_drain(writer, 8192, 1.0, &error);
+    gcut_assert_error(error);
+    cut_assert_operator_uint(milter_writer_get_pending_size(writer), <=, 8192);
+
+    milter_writer_flush(writer, &error);
+    gcut_assert_error(error);
+
+    pump_all_events();
+
+    actual_data = gcut_string_io_channel_get_string(channel);
+    cut_assert_equal_memory(binary_data, data_size,
+                            actual_data->str, actual_data->len);
+}
+
+void
+test_drain_timeout (void)
+{
+    gchar *binary_data;
+    gsize data_size;
+    GTimer *timer;
+    GError *error = NULL;
+
+    cut_trace(setup_socket_pair_writer());
+
+    data_size = 1024 * 1024;
+    binary_data = g_new(gchar, data_size);
+    cut_take_memory(binary_data);
+    memset(binary_data, 'X', data_size);
+
+    milter_writer_write(writer, binary_data, data_size, &error);
+    gcut_assert_error(error);
+
+    timer = g_timer_new();
+    cut_take(timer, (CutDestroyFunction)g_timer_destroy);
+    cut_assert_false(milter_writer_drain(writer, 0, 0.1, &actual_error));
+    cut_assert_operator(g_timer_elapsed(timer, NULL), <, 1.0);
+
+    expected_error = g_error_new(MILTER_WRITER_ERROR,
+                                 MILTER_WRITER_ERROR_IO_ERROR,
+                                 "timeout to wait for writable: <%g>", 0.1);
+    gcut_assert_equal_error(expected_error, actual_error);
+}
+
 void
 test_tag (void)
 {
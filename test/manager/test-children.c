@@ -76,6 +76,9 @@ void test_connection_timeout (void);
 void test_end_of_message_timeout (void);
 void test_writing_timeout (void);
 void test_end_of_message_with_protocol_version2 (void);
+void test_parallel_deferred_reply (void);
+void test_parallel_reject_while_pending (void);
+void test_parallel_temporary_failure_while_pending (void);
 
 static gchar *scenario_dir;
 static MilterManagerTestScenario *main_scenario;
@@ -85,6 +88,7 @@ static MilterEventLoop *loop;
 static MilterManagerConfiguration *config;
 static MilterManagerChildren *children;
 static MilterOption *option;
+static MilterActionFlags action;
 static MilterStepFlags step;
 static MilterManagerProcessLauncher *launcher;
 
@@ -406,6 +410,7 @@ cut_setup (void)
 
     launcher = NULL;
     option = NULL;
+    action = MILTER_ACTION_ADD_HEADERS | MILTER_ACTION_CHANGE_BODY;
     step = MILTER_STEP_NONE;
 
     actual_error = NULL;
@@ -635,6 +640,21 @@ add_child (const gchar *name, const gchar *connection_spec)
     g_object_unref(child);
 }
 
+static void
+wait_seconds (gdouble seconds)
+{
+    gboolean timeout_waiting = TRUE;
+    guint timeout_waiting_id;
+
+    timeout_waiting_id = milter_event_loop_add_timeout(loop, seconds,
+                                                       cb_timeout_waiting,
+                                                       &timeout_waiting);
+    while (timeout_waiting) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    milter_event_loop_remove(loop, timeout_waiting_id);
+}
+
 #define wait_finished()                    \
     cut_trace_with_info_expression(        \
         wait_finished_helper(),            \
@@ -1159,10 +1179,7 @@ test_scenario (gconstpointer data)
 void
 test_negotiate (void)
 {
-    option = milter_option_new(6,
-                               MILTER_ACTION_ADD_HEADERS |
-                               MILTER_ACTION_CHANGE_BODY,
-                               step);
+    option = milter_option_new(6, action, step);
 
     start_client(10026, arguments1);
     start_client(10027, arguments2);
@@ -2114,6 +2131,77 @@ test_end_of_message_with_protocol_version2 (void)
     cut_assert_equal_uint(1, collect_n_received(data));
 }
 
+static void
+setup_parallel_message_processing (void)
+{
+    milter_manager_configuration_set_parallel_message_processing(config, TRUE);
+    /* children that can't modify the message are processed in parallel. */
+    action = MILTER_ACTION_QUARANTINE;
+    arguments_append(arguments2,
+                     "--body-reply-delay", "0.3",
+                     NULL);
+}
+
+void
+test_parallel_deferred_reply (void)
+{
+    const gchar chunk[] = "message body";
+
+    setup_parallel_message_processing();
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, chunk, strlen(chunk));
+    wait_seconds(0.1);
+    cut_assert_true(milter_manager_children_is_waiting_reply(children));
+    cut_assert_equal_uint(7, n_continue_emitted);
+
+    wait_reply(8, n_continue_emitted);
+    cut_assert_false(milter_manager_children_is_waiting_reply(children));
+    cut_assert_equal_uint(2, collect_n_received(body));
+}
+
+#define stop_while_pending(stop_action, n_emitted)                      \
+    cut_trace_with_info_expression(                                     \
+        stop_while_pending_helper(stop_action, &n_emitted),             \
+        stop_while_pending(stop_action, n_emitted))
+
+static void
+stop_while_pending_helper (const gchar *stop_action, guint *n_emitted)
+{
+    const gchar chunk[] = "message body";
+
+    setup_parallel_message_processing();
+    arguments_append(arguments1,
+                     "--action", stop_action,
+                     "--body", chunk,
+                     NULL);
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, chunk, strlen(chunk));
+    wait_reply(1, *n_emitted);
+    cut_assert_equal_uint(7, n_continue_emitted);
+    cut_assert_false(milter_manager_children_is_waiting_reply(children));
+
+    /* the delayed child replies after the message is aborted. */
+    wait_seconds(0.5);
+    cut_assert_equal_uint(1, collect_n_received(abort));
+    cut_assert_equal_uint(1, *n_emitted);
+    cut_assert_equal_uint(7, n_continue_emitted);
+    cut_assert_false(milter_manager_children_is_waiting_reply(children));
+}
+
+void
+test_parallel_reject_while_pending (void)
+{
+    stop_while_pending("reject", n_reject_emitted);
+}
+
+void
+test_parallel_temporary_failure_while_pending (void)
+{
+    stop_while_pending("temporary_failure", n_temporary_failure_emitted);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -65,9 +65,15 @@ void test_syslog_facility (void);
 void test_chunk_size (void);
 void test_chunk_size_over (void);
 void test_max_pending_finished_sessions (void);
+void test_parallel_message_processing (void);
+void test_max_on_memory_body_size (void);
+void test_reuse_port (void);
 void test_egg (void);
 void test_find_egg (void);
 void test_remove_egg (void);
+void test_snapshot (void);
+void test_snapshot_reload_failure (void);
+void test_snapshot_in_threads (void);
 void test_applicable_condition (void);
 void test_find_applicable_condition (void);
 void test_remove_applicable_condition (void);
@@ -94,6 +100,9 @@ static GList *expected_applicable_conditions;
 
 static gchar *actual_xml;
 
+static MilterManagerConfigurationSnapshot *snapshot;
+static MilterManagerConfigurationSnapshot *another_snapshot;
+
 static gchar *tmp_dir;
 
 void
@@ -116,6 +125,9 @@ cut_setup (void)
 
     actual_xml = NULL;
 
+    snapshot = NULL;
+    another_snapshot = NULL;
+
     tmp_dir = g_build_filename(milter_test_get_base_dir(),
                                "tmp",
                                NULL);
@@ -156,6 +168,11 @@ cut_teardown (void)
     if (actual_xml)
         g_free(actual_xml);
 
+    if (snapshot)
+        milter_manager_configuration_snapshot_unref(snapshot);
+    if (another_snapshot)
+        milter_manager_configuration_snapshot_unref(another_snapshot);
+
     if (tmp_dir) {
         cut_remove_path(tmp_dir, NULL);
         g_free(tmp_dir);
@@ -647,6 +664,36 @@ test_max_pending_finished_sessions (void)
         milter_manager_configuration_get_max_pending_finished_sessions(config));
 }
 
+void
+test_parallel_message_processing (void)
+{
+    cut_assert_false(
+        milter_manager_configuration_is_parallel_message_processing(config));
+    milter_manager_configuration_set_parallel_message_processing(config, TRUE);
+    cut_assert_true(
+        milter_manager_configuration_is_parallel_message_processing(config));
+}
+
+void
+test_max_on_memory_body_size (void)
+{
+    cut_assert_equal_uint(
+        5242880,
+        milter_manager_configuration_get_max_on_memory_body_size(config));
+    milter_manager_configuration_set_max_on_memory_body_size(config, 1024);
+    cut_assert_equal_uint(
+        1024,
+        milter_manager_configuration_get_max_on_memory_body_size(config));
+}
+
+void
+test_reuse_port (void)
+{
+    cut_assert_false(milter_manager_configuration_is_reuse_port(config));
+    milter_manager_configuration_set_reuse_port(config, TRUE);
+    cut_assert_true(milter_manager_configuration_is_reuse_port(config));
+}
+
 static void
 milter_assert_default_configuration_helper (MilterManagerConfiguration *config)
 {
@@ -746,6 +793,15 @@ milter_assert_default_configuration_helper (MilterManagerConfiguration *config)
         0,
         milter_manager_configuration_get_max_pending_finished_sessions(config));
 
+    cut_assert_false(
+        milter_manager_configuration_is_parallel_message_processing(config));
+
+    cut_assert_equal_uint(
+        5242880,
+        milter_manager_configuration_get_max_on_memory_body_size(config));
+
+    cut_assert_false(milter_manager_configuration_is_reuse_port(config));
+
     if (expected_children)
         g_object_unref(expected_children);
     expected_children = milter_manager_children_new(config, loop);
@@ -842,6 +898,112 @@ test_remove_egg (void)
         milter_manager_test_egg_equal);
 }
 
+void
+test_snapshot (void)
+{
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_configuration_add_egg(config, egg);
+    expected_eggs = g_list_append(expected_eggs, egg);
+
+    snapshot = milter_manager_configuration_get_snapshot(config);
+    another_snapshot = milter_manager_configuration_get_snapshot(config);
+    cut_assert_equal_pointer(snapshot, another_snapshot);
+    milter_manager_configuration_snapshot_unref(another_snapshot);
+    another_snapshot = NULL;
+
+    milter_manager_configuration_clear_eggs(config);
+    gcut_assert_equal_list_object_custom(
+        expected_eggs,
+        milter_manager_configuration_snapshot_get_eggs(snapshot),
+        milter_manager_test_egg_equal);
+
+    another_snapshot = milter_manager_configuration_get_snapshot(config);
+    gcut_assert_equal_list_object_custom(
+        NULL,
+        milter_manager_configuration_snapshot_get_eggs(another_snapshot),
+        milter_manager_test_egg_equal);
+}
+
+void
+test_snapshot_reload_failure (void)
+{
+    GError *error = NULL;
+
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_configuration_add_egg(config, egg);
+    expected_eggs = g_list_append(expected_eggs, egg);
+
+    cut_assert_false(milter_manager_configuration_reload(config, &error));
+    gcut_take_error(error);
+    gcut_assert_equal_list_object_custom(
+        NULL,
+        milter_manager_configuration_get_eggs(config),
+        milter_manager_test_egg_equal);
+
+    snapshot = milter_manager_configuration_get_snapshot(config);
+    gcut_assert_equal_list_object_custom(
+        expected_eggs,
+        milter_manager_configuration_snapshot_get_eggs(snapshot),
+        milter_manager_test_egg_equal);
+}
+
+#define N_SNAPSHOT_THREADS 4
+#define N_SNAPSHOT_ITERATIONS 1000
+
+static gpointer
+get_snapshots (gpointer data)
+{
+    gint *stopped = data;
+
+    while (!g_atomic_int_get(stopped)) {
+        MilterManagerConfigurationSnapshot *current_snapshot;
+
+        current_snapshot = milter_manager_configuration_get_snapshot(config);
+        g_list_length(
+            milter_manager_configuration_snapshot_get_eggs(current_snapshot));
+        milter_manager_configuration_snapshot_unref(current_snapshot);
+    }
+
+    return NULL;
+}
+
+void
+test_snapshot_in_threads (void)
+{
+    GThread *threads[N_SNAPSHOT_THREADS];
+    gint stopped = FALSE;
+    gint i;
+
+    for (i = 0; i < N_SNAPSHOT_THREADS; i++) {
+        threads[i] = g_thread_new("snapshot", get_snapshots, &stopped);
+    }
+
+    for (i = 0; i < N_SNAPSHOT_ITERATIONS; i++) {
+        MilterManagerEgg *child_egg;
+
+        child_egg = milter_manager_egg_new("child-milter");
+        milter_manager_configuration_add_egg(config, child_egg);
+        g_object_unref(child_egg);
+        if (i % 2 == 0) {
+            milter_manager_configuration_remove_egg_by_name(config,
+                                                            "child-milter");
+        } else {
+            milter_manager_configuration_clear_eggs(config);
+        }
+    }
+
+    g_atomic_int_set(&stopped, TRUE);
+    for (i = 0; i < N_SNAPSHOT_THREADS; i++) {
+        g_thread_join(threads[i]);
+    }
+
+    snapshot = milter_manager_configuration_get_snapshot(config);
+    gcut_assert_equal_list_object_custom(
+        NULL,
+        milter_manager_configuration_snapshot_get_eggs(snapshot),
+        milter_manager_test_egg_equal);
+}
+
 void
 test_applicable_condition (void)
 {
@@ -970,6 +1132,9 @@ test_clear (void)
     test_syslog_facility();
     test_chunk_size();
     test_max_pending_finished_sessions();
+    test_parallel_message_processing();
+    test_max_on_memory_body_size();
+    test_reuse_port();
 
     handler_id = g_signal_connect(config, "connected",
                                   G_CALLBACK(cb_connected), NULL);
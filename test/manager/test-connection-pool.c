@@ -0,0 +1,193 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <milter/manager/milter-manager-connection-pool.h>
+
+#include <gcutter.h>
+
+void test_checkout_empty (void);
+void test_park (void);
+void test_checkout_different_option (void);
+void test_checkout_closed (void);
+void test_sweep (void);
+void test_sweep_closed (void);
+
+#define SPEC "inet:10025@localhost"
+
+static MilterOption *requested_option;
+static MilterOption *option;
+static MilterMacrosRequests *macros_requests;
+static MilterOption *actual_option;
+static MilterMacrosRequests *actual_macros_requests;
+static GIOChannel *channel;
+static GIOChannel *actual_channel;
+static gint peer_fd;
+
+void
+cut_setup (void)
+{
+    gint fds[2];
+
+    requested_option = milter_option_new(6,
+                                         MILTER_ACTION_ADD_HEADERS,
+                                         MILTER_STEP_NO_BODY);
+    option = milter_option_new(6,
+                               MILTER_ACTION_ADD_HEADERS,
+                               MILTER_STEP_NO_BODY |
+                               MILTER_STEP_NO_CONNECT);
+    macros_requests = milter_macros_requests_new();
+    actual_option = NULL;
+    actual_macros_requests = NULL;
+    actual_channel = NULL;
+
+    cut_assert_equal_int(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    channel = g_io_channel_unix_new(fds[0]);
+    g_io_channel_set_close_on_unref(channel, TRUE);
+    peer_fd = fds[1];
+}
+
+void
+cut_teardown (void)
+{
+    milter_manager_connection_pool_clear();
+
+    g_object_unref(requested_option);
+    g_object_unref(option);
+    g_object_unref(macros_requests);
+    if (actual_option)
+        g_object_unref(actual_option);
+    if (actual_macros_requests)
+        g_object_unref(actual_macros_requests);
+    if (channel)
+        g_io_channel_unref(channel);
+    if (actual_channel)
+        g_io_channel_unref(actual_channel);
+    if (peer_fd >= 0)
+        close(peer_fd);
+}
+
+static void
+park (void)
+{
+    milter_manager_connection_pool_park(SPEC,
+                                        requested_option,
+                                        channel,
+                                        option,
+                                        macros_requests);
+    g_io_channel_unref(channel);
+    channel = NULL;
+}
+
+void
+test_checkout_empty (void)
+{
+    cut_assert_null(
+        milter_manager_connection_pool_checkout(SPEC,
+                                                requested_option,
+                                                &actual_option,
+                                                &actual_macros_requests));
+}
+
+void
+test_park (void)
+{
+    park();
+    cut_assert_equal_uint(1,
+                          milter_manager_connection_pool_get_n_connections(SPEC));
+
+    actual_channel =
+        milter_manager_connection_pool_checkout(SPEC,
+                                                requested_option,
+                                                &actual_option,
+                                                &actual_macros_requests);
+    cut_assert_not_null(actual_channel);
+    cut_assert_true(milter_option_equal(option, actual_option));
+    cut_assert_equal_pointer(macros_requests, actual_macros_requests);
+    cut_assert_equal_uint(0,
+                          milter_manager_connection_pool_get_n_connections(SPEC));
+}
+
+void
+test_checkout_different_option (void)
+{
+    MilterOption *other_option;
+
+    park();
+
+    other_option = milter_option_copy(requested_option);
+    milter_option_add_step(other_option, MILTER_STEP_NO_HEADERS);
+    actual_channel =
+        milter_manager_connection_pool_checkout(SPEC,
+                                                other_option,
+                                                &actual_option,
+                                                &actual_macros_requests);
+    g_object_unref(other_option);
+    cut_assert_null(actual_channel);
+    cut_assert_equal_uint(1,
+                          milter_manager_connection_pool_get_n_connections(SPEC));
+}
+
+void
+test_checkout_closed (void)
+{
+    park();
+    close(peer_fd);
+    peer_fd = -1;
+
+    cut_assert_null(
+        milter_manager_connection_pool_checkout(SPEC,
+                                                requested_option,
+                                                &actual_option,
+                                                &actual_macros_requests));
+    cut_assert_equal_uint(0,
+                          milter_manager_connection_pool_get_n_connections(SPEC));
+}
+
+void
+test_sweep (void)
+{
+    park();
+
+    cut_assert_equal_uint(1, milter_manager_connection_pool_sweep());
+    cut_assert_equal_uint(1,
+                          milter_manager_connection_pool_get_n_connections(SPEC));
+}
+
+void
+test_sweep_closed (void)
+{
+    park();
+    close(peer_fd);
+    peer_fd = -1;
+
+    cut_assert_equal_uint(0, milter_manager_connection_pool_sweep());
+    cut_assert_equal_uint(0,
+                          milter_manager_connection_pool_get_n_connections(SPEC));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
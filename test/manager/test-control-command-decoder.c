@@ -36,6 +36,7 @@ void test_decode_set_configuration (void);
 void test_decode_get_configuration (void);
 void test_decode_reload (void);
 void test_decode_get_status (void);
+void test_decode_get_metrics (void);
 void test_decode_unknown (void);
 
 static MilterDecoder *decoder;
@@ -48,6 +49,7 @@ static gint n_set_configuration_received;
 static gint n_get_configuration_received;
 static gint n_reload_received;
 static gint n_get_status_received;
+static gint n_get_metrics_received;
 
 static gchar *actual_configuration;
 static gsize actual_configuration_size;
@@ -81,6 +83,12 @@ cb_get_status (MilterManagerControlCommandDecoder *decoder, gpointer user_data)
     n_get_status_received++;
 }
 
+static void
+cb_get_metrics (MilterManagerControlCommandDecoder *decoder, gpointer user_data)
+{
+    n_get_metrics_received++;
+}
+
 static void
 setup_signals (MilterDecoder *decoder)
 {
@@ -91,6 +99,7 @@ setup_signals (MilterDecoder *decoder)
     CONNECT(get_configuration);
     CONNECT(reload);
     CONNECT(get_status);
+    CONNECT(get_metrics);
 
 #undef CONNECT
 }
@@ -108,6 +117,7 @@ setup (void)
     n_get_configuration_received = 0;
     n_reload_received = 0;
     n_get_status_received = 0;
+    n_get_metrics_received = 0;
 
     buffer = g_string_new(NULL);
 
@@ -197,6 +207,16 @@ test_decode_get_status (void)
     cut_assert_equal_int(1, n_get_status_received);
 }
 
+void
+test_decode_get_metrics (void)
+{
+    g_string_append(buffer, "get-metrics");
+    g_string_append_c(buffer, '\0');
+
+    gcut_assert_error(decode());
+    cut_assert_equal_int(1, n_get_metrics_received);
+}
+
 void
 test_decode_unknown (void)
 {
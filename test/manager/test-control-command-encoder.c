@@ -30,6 +30,7 @@
 void test_encode_set_configuration (void);
 void test_encode_reload (void);
 void test_encode_get_status (void);
+void test_encode_get_metrics (void);
 
 static MilterManagerControlCommandEncoder *encoder;
 static GString *expected;
@@ -122,6 +123,23 @@ test_encode_get_status (void)
                             actual, actual_size);
 }
 
+void
+test_encode_get_metrics (void)
+{
+    const gchar *actual;
+    gsize actual_size;
+
+    g_string_append(expected, "get-metrics");
+    g_string_append_c(expected, '\0');
+
+    pack(expected);
+    milter_manager_control_command_encoder_encode_get_metrics(encoder,
+                                                              &actual,
+                                                              &actual_size);
+    cut_assert_equal_memory(expected->str, expected->len,
+                            actual, actual_size);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -32,6 +32,7 @@ void test_encode_failure (void);
 void test_encode_error (void);
 void test_encode_configuration (void);
 void test_encode_status (void);
+void test_encode_metrics (void);
 
 static MilterManagerControlReplyEncoder *encoder;
 static GString *expected;
@@ -180,6 +181,31 @@ test_encode_status (void)
                             actual, actual_size);
 }
 
+void
+test_encode_metrics (void)
+{
+    const gchar metrics[] =
+        "# TYPE milter_manager_sessions counter\n"
+        "milter_manager_sessions_total"
+        "{worker=\"0\",stage=\"quit-replied\",status=\"accept\"} 29\n"
+        "# EOF\n";
+    const gchar *actual;
+    gsize actual_size;
+
+    g_string_append(expected, "metrics");
+    g_string_append_c(expected, '\0');
+    g_string_append(expected, metrics);
+
+    pack(expected);
+    milter_manager_control_reply_encoder_encode_metrics(encoder,
+                                                        &actual, &actual_size,
+                                                        metrics,
+                                                        strlen(metrics));
+
+    cut_assert_equal_memory(expected->str, expected->len,
+                            actual, actual_size);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -29,6 +29,7 @@
 #include <milter/manager/milter-manager-control-command-encoder.h>
 #include <milter/manager/milter-manager-control-reply-encoder.h>
 #include <milter/manager/milter-manager-enum-types.h>
+#include <milter/manager/milter-manager-metrics.h>
 
 #include <milter-test-utils.h>
 #include <milter-manager-test-utils.h>
@@ -40,6 +41,9 @@
 void test_set_configuration (void);
 void test_set_configuration_failed (void);
 void test_reload (void);
+void test_get_status (void);
+void test_get_status_workers (void);
+void test_get_metrics (void);
 
 static MilterEventLoop *loop;
 
@@ -111,6 +115,8 @@ cut_setup (void)
 
     loop = milter_test_event_loop_new();
 
+    milter_manager_metrics_init(0);
+
     config = milter_manager_configuration_new(NULL);
     manager = milter_manager_new(config);
     g_object_unref(config);
@@ -173,6 +179,8 @@ cut_teardown (void)
 
     if (custom_config_path)
         g_free(custom_config_path);
+
+    milter_manager_metrics_quit();
 }
 
 static void
@@ -312,6 +320,106 @@ test_reload (void)
                             output->str, output->len);
 }
 
+void
+test_get_status (void)
+{
+    const gchar *packet;
+    gsize packet_size;
+    const gchar *status;
+    GString *output;
+
+    milter_manager_control_command_encoder_encode_get_status(command_encoder,
+                                                             &packet,
+                                                             &packet_size);
+    cut_trace(write_packet(packet, packet_size));
+    pump_all_events();
+
+    status = cut_take_printf("<status>\n"
+                             "  <process>\n"
+                             "    <pid>%d</pid>\n"
+                             "    <n-processing-sessions>0"
+                             "</n-processing-sessions>\n"
+                             "    <n-sessions>0</n-sessions>\n"
+                             "    <n-body-spills>0</n-body-spills>\n"
+                             "  </process>\n"
+                             "  <workers>\n"
+                             "  </workers>\n"
+                             "  <leaders>\n"
+                             "  </leaders>\n"
+                             "  <milters>\n"
+                             "  </milters>\n"
+                             "</status>\n",
+                             (gint)getpid());
+    milter_manager_control_reply_encoder_encode_status(reply_encoder,
+                                                       &packet, &packet_size,
+                                                       status, strlen(status));
+    output = gcut_string_io_channel_get_string(output_channel);
+    cut_assert_equal_memory(packet, packet_size,
+                            output->str, output->len);
+}
+
+void
+test_get_status_workers (void)
+{
+    const gchar *packet;
+    gsize packet_size;
+    const gchar *status;
+    GString *output;
+
+    milter_client_set_n_workers(MILTER_CLIENT(manager), 2);
+    milter_manager_control_command_encoder_encode_get_status(command_encoder,
+                                                             &packet,
+                                                             &packet_size);
+    cut_trace(write_packet(packet, packet_size));
+    pump_all_events();
+
+    status = cut_take_printf("<status>\n"
+                             "  <process>\n"
+                             "    <pid>%d</pid>\n"
+                             "    <n-processing-sessions>0"
+                             "</n-processing-sessions>\n"
+                             "    <n-sessions>0</n-sessions>\n"
+                             "    <n-body-spills>0</n-body-spills>\n"
+                             "  </process>\n"
+                             "  <workers>\n"
+                             "  </workers>\n"
+                             "  <milters>\n"
+                             "  </milters>\n"
+                             "</status>\n",
+                             (gint)getpid());
+    milter_manager_control_reply_encoder_encode_status(reply_encoder,
+                                                       &packet, &packet_size,
+                                                       status, strlen(status));
+    output = gcut_string_io_channel_get_string(output_channel);
+    cut_assert_equal_memory(packet, packet_size,
+                            output->str, output->len);
+}
+
+void
+test_get_metrics (void)
+{
+    const gchar *packet;
+    gsize packet_size;
+    const gchar *metrics;
+    GString *output;
+
+    milter_manager_metrics_record_body_spill();
+    milter_manager_control_command_encoder_encode_get_metrics(command_encoder,
+                                                              &packet,
+                                                              &packet_size);
+    cut_trace(write_packet(packet, packet_size));
+    pump_all_events();
+
+    metrics = cut_take_string(milter_manager_metrics_to_open_metrics());
+    milter_manager_control_reply_encoder_encode_metrics(reply_encoder,
+                                                        &packet, &packet_size,
+                                                        metrics,
+                                                        strlen(metrics));
+    output = gcut_string_io_channel_get_string(output_channel);
+    cut_assert_equal_memory(packet, packet_size,
+                            output->str, output->len);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
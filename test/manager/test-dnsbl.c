@@ -0,0 +1,497 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <milter/manager/milter-manager-dnsbl.h>
+
+#include <milter-test-utils.h>
+
+#include <gcutter.h>
+
+void test_listed (void);
+void test_nxdomain (void);
+void test_servfail (void);
+void test_timeout (void);
+void test_next_name_server (void);
+void test_next_name_server_refused (void);
+void test_cancel (void);
+void test_not_ipv4 (void);
+void test_no_services (void);
+void test_shared_cache (void);
+
+static MilterEventLoop *loop;
+static GIOChannel *server_channel;
+static guint server_watch_id;
+static guint server_port;
+static gint silent_server_fd;
+static GHashTable *responses;
+static GHashTable *n_queries;
+static gboolean finished;
+static gboolean timed_out;
+static MilterManagerDNSBLLookup *lookup;
+static struct sockaddr_in address;
+
+static gboolean
+cb_query (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    guint8 message[512];
+    gssize size;
+    gsize offset;
+    GString *name;
+    const gchar *response;
+    struct sockaddr_in client_address;
+    socklen_t client_address_length = sizeof(client_address);
+    gint fd;
+
+    fd = g_io_channel_unix_get_fd(channel);
+    size = recvfrom(fd, message, sizeof(message), 0,
+                    (struct sockaddr *)&client_address,
+                    &client_address_length);
+    if (size < 12)
+        return TRUE;
+
+    name = g_string_new(NULL);
+    offset = 12;
+    while (offset < (gsize)size && message[offset] > 0) {
+        if (name->len > 0)
+            g_string_append_c(name, '.');
+        g_string_append_len(name, (gchar *)message + offset + 1,
+                            message[offset]);
+        offset += 1 + message[offset];
+    }
+    offset += 1 + 4;
+
+    g_hash_table_insert(n_queries, g_strdup(name->str),
+                        GUINT_TO_POINTER(GPOINTER_TO_UINT(
+                            g_hash_table_lookup(n_queries, name->str)) + 1));
+    response = g_hash_table_lookup(responses, name->str);
+    g_string_free(name, TRUE);
+    if (!response)
+        response = "nxdomain";
+    if (g_str_equal(response, "timeout"))
+        return TRUE;
+
+    message[2] = 0x81; /* QR | RD */
+    if (g_str_equal(response, "nxdomain")) {
+        message[3] = 0x83;
+    } else if (g_str_equal(response, "servfail")) {
+        message[3] = 0x82;
+    } else {
+        guint8 answer[] = {
+            0xc0, 0x0c,             /* name */
+            0x00, 0x01, 0x00, 0x01, /* A IN */
+            0x00, 0x00, 0x01, 0x2c, /* TTL: 300 */
+            0x00, 0x04
+        };
+
+        message[3] = 0x80;
+        message[7] = 1; /* ANCOUNT */
+        memcpy(message + offset, answer, sizeof(answer));
+        offset += sizeof(answer);
+        inet_pton(AF_INET, response, message + offset);
+        offset += 4;
+    }
+
+    sendto(fd, message, offset, 0,
+           (struct sockaddr *)&client_address, client_address_length);
+    return TRUE;
+}
+
+static void
+start_name_server (void)
+{
+    struct sockaddr_in server_address;
+    socklen_t server_address_length;
+    gint fd;
+
+    memset(&server_address, 0, sizeof(server_address));
+    server_address.sin_family = AF_INET;
+    server_address.sin_addr.s_addr = g_htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    cut_assert_operator_int(fd, >=, 0);
+    cut_assert_equal_int(0, bind(fd,
+                                 (struct sockaddr *)&server_address,
+                                 sizeof(server_address)));
+    server_address_length = sizeof(server_address);
+    cut_assert_equal_int(0, getsockname(fd,
+                                        (struct sockaddr *)&server_address,
+                                        &server_address_length));
+    server_port = g_ntohs(server_address.sin_port);
+
+    server_channel = g_io_channel_unix_new(fd);
+    g_io_channel_set_close_on_unref(server_channel, TRUE);
+    server_watch_id = milter_event_loop_watch_io(loop,
+                                                 server_channel,
+                                                 G_IO_IN,
+                                                 cb_query,
+                                                 NULL);
+}
+
+static guint
+open_silent_name_server (void)
+{
+    struct sockaddr_in server_address;
+    socklen_t server_address_length;
+
+    memset(&server_address, 0, sizeof(server_address));
+    server_address.sin_family = AF_INET;
+    server_address.sin_addr.s_addr = g_htonl(INADDR_LOOPBACK);
+    silent_server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    cut_assert_operator_int(silent_server_fd, >=, 0);
+    cut_assert_equal_int(0, bind(silent_server_fd,
+                                 (struct sockaddr *)&server_address,
+                                 sizeof(server_address)));
+    server_address_length = sizeof(server_address);
+    cut_assert_equal_int(0, getsockname(silent_server_fd,
+                                        (struct sockaddr *)&server_address,
+                                        &server_address_length));
+    return g_ntohs(server_address.sin_port);
+}
+
+static void
+stop_name_server (void)
+{
+    if (server_watch_id > 0) {
+        milter_event_loop_remove(loop, server_watch_id);
+        server_watch_id = 0;
+    }
+    if (server_channel) {
+        g_io_channel_unref(server_channel);
+        server_channel = NULL;
+    }
+}
+
+void
+cut_setup (void)
+{
+    loop = milter_test_event_loop_new();
+    server_channel = NULL;
+    server_watch_id = 0;
+    silent_server_fd = -1;
+    responses = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      g_free, g_free);
+    n_queries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    finished = FALSE;
+    lookup = NULL;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.0.2.1", &(address.sin_addr));
+
+    milter_manager_dnsbl_init();
+    milter_manager_dnsbl_add_service("bl.example.com");
+    start_name_server();
+    milter_manager_dnsbl_add_name_server("127.0.0.1", server_port, NULL);
+}
+
+void
+cut_teardown (void)
+{
+    if (lookup)
+        milter_manager_dnsbl_lookup_cancel(lookup);
+    stop_name_server();
+    if (silent_server_fd != -1)
+        close(silent_server_fd);
+    milter_manager_dnsbl_quit();
+    milter_manager_dnsbl_set_timeout(5.0);
+    milter_manager_dnsbl_set_negative_cache_ttl(60);
+    if (loop)
+        g_object_unref(loop);
+    g_hash_table_unref(responses);
+    g_hash_table_unref(n_queries);
+}
+
+static void
+cb_finished (gpointer user_data)
+{
+    finished = TRUE;
+    lookup = NULL;
+}
+
+static void
+start_lookup (void)
+{
+    finished = FALSE;
+    lookup = milter_manager_dnsbl_lookup(loop,
+                                         (struct sockaddr *)&address,
+                                         sizeof(address),
+                                         cb_finished,
+                                         NULL);
+    cut_assert_not_null(lookup);
+}
+
+static void
+wait_finished (void)
+{
+    while (!finished)
+        milter_event_loop_iterate(loop, TRUE);
+}
+
+static gboolean
+cb_timeout (gpointer user_data)
+{
+    timed_out = TRUE;
+    return FALSE;
+}
+
+static guint
+get_n_queries (const gchar *query_domain)
+{
+    return GPOINTER_TO_UINT(g_hash_table_lookup(n_queries, query_domain));
+}
+
+static const GList *
+get_cached_answers (const gchar *query_domain, gboolean *cached)
+{
+    GList *answers = NULL;
+
+    *cached = milter_manager_dnsbl_get_cached_answers(query_domain, &answers);
+    return gcut_take_list(answers, g_free);
+}
+
+void
+test_listed (void)
+{
+    gboolean cached;
+
+    g_hash_table_insert(responses,
+                        g_strdup("1.2.0.192.bl.example.com"),
+                        g_strdup("127.0.0.2"));
+    cut_trace(start_lookup());
+    cut_trace(wait_finished());
+
+    gcut_assert_equal_list_string(
+        gcut_take_new_list_string("127.0.0.2", NULL),
+        get_cached_answers("1.2.0.192.bl.example.com", &cached));
+    cut_assert_true(cached);
+    cut_assert_null(milter_manager_dnsbl_lookup(loop,
+                                                (struct sockaddr *)&address,
+                                                sizeof(address),
+                                                cb_finished,
+                                                NULL));
+    cut_assert_equal_uint(1, get_n_queries("1.2.0.192.bl.example.com"));
+}
+
+void
+test_nxdomain (void)
+{
+    gboolean cached;
+
+    cut_trace(start_lookup());
+    cut_trace(wait_finished());
+
+    gcut_assert_equal_list_string(
+        NULL,
+        get_cached_answers("1.2.0.192.bl.example.com", &cached));
+    cut_assert_true(cached);
+    cut_assert_null(milter_manager_dnsbl_lookup(loop,
+                                                (struct sockaddr *)&address,
+                                                sizeof(address),
+                                                cb_finished,
+                                                NULL));
+}
+
+void
+test_servfail (void)
+{
+    gboolean cached;
+
+    g_hash_table_insert(responses,
+                        g_strdup("1.2.0.192.bl.example.com"),
+                        g_strdup("servfail"));
+    cut_trace(start_lookup());
+    cut_trace(wait_finished());
+
+    get_cached_answers("1.2.0.192.bl.example.com", &cached);
+    cut_assert_false(cached);
+
+    cut_trace(start_lookup());
+    cut_trace(wait_finished());
+    cut_assert_equal_uint(2, get_n_queries("1.2.0.192.bl.example.com"));
+}
+
+void
+test_timeout (void)
+{
+    gboolean cached;
+    GTimer *timer;
+
+    g_hash_table_insert(responses,
+                        g_strdup("1.2.0.192.bl.example.com"),
+                        g_strdup("timeout"));
+    milter_manager_dnsbl_set_timeout(0.1);
+    timer = g_timer_new();
+    cut_take(timer, (CutDestroyFunction)g_timer_destroy);
+    cut_trace(start_lookup());
+    cut_trace(wait_finished());
+
+    cut_assert_operator(g_timer_elapsed(timer, NULL), <, 1.0);
+    get_cached_answers("1.2.0.192.bl.example.com", &cached);
+    cut_assert_false(cached);
+}
+
+void
+test_next_name_server (void)
+{
+    gboolean cached;
+    guint port;
+
+    g_hash_table_insert(responses,
+                        g_strdup("1.2.0.192.bl.example.com"),
+                        g_strdup("127.0.0.2"));
+    /* The first name server doesn't answer. */
+    cut_trace(port = open_silent_name_server());
+    milter_manager_dnsbl_clear_name_servers();
+    milter_manager_dnsbl_add_name_server("127.0.0.1", port, NULL);
+    milter_manager_dnsbl_add_name_server("127.0.0.1", server_port, NULL);
+    milter_manager_dnsbl_set_timeout(0.2);
+
+    cut_trace(start_lookup());
+    cut_trace(wait_finished());
+
+    get_cached_answers("1.2.0.192.bl.example.com", &cached);
+    cut_assert_true(cached);
+}
+
+void
+test_next_name_server_refused (void)
+{
+    gboolean cached;
+    guint port;
+
+    g_hash_table_insert(responses,
+                        g_strdup("1.2.0.192.bl.example.com"),
+                        g_strdup("127.0.0.2"));
+    /* Nobody listens on the first name server. */
+    cut_trace(port = open_silent_name_server());
+    close(silent_server_fd);
+    silent_server_fd = -1;
+    milter_manager_dnsbl_clear_name_servers();
+    milter_manager_dnsbl_add_name_server("127.0.0.1", port, NULL);
+    milter_manager_dnsbl_add_name_server("127.0.0.1", server_port, NULL);
+
+    cut_trace(start_lookup());
+    cut_trace(wait_finished());
+
+    get_cached_answers("1.2.0.192.bl.example.com", &cached);
+    cut_assert_true(cached);
+}
+
+void
+test_cancel (void)
+{
+    g_hash_table_insert(responses,
+                        g_strdup("1.2.0.192.bl.example.com"),
+                        g_strdup("timeout"));
+    milter_manager_dnsbl_set_timeout(0.1);
+    cut_trace(start_lookup());
+    milter_manager_dnsbl_lookup_cancel(lookup);
+    lookup = NULL;
+
+    timed_out = FALSE;
+    milter_event_loop_add_timeout(loop, 0.2, cb_timeout, NULL);
+    while (!timed_out)
+        milter_event_loop_iterate(loop, TRUE);
+    cut_assert_false(finished);
+}
+
+void
+test_not_ipv4 (void)
+{
+    struct sockaddr_in6 address6;
+
+    memset(&address6, 0, sizeof(address6));
+    address6.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "2001:db8::1", &(address6.sin6_addr));
+    cut_assert_null(milter_manager_dnsbl_lookup(loop,
+                                                (struct sockaddr *)&address6,
+                                                sizeof(address6),
+                                                cb_finished,
+                                                NULL));
+}
+
+void
+test_no_services (void)
+{
+    milter_manager_dnsbl_clear_services();
+    cut_assert_null(milter_manager_dnsbl_lookup(loop,
+                                                (struct sockaddr *)&address,
+                                                sizeof(address),
+                                                cb_finished,
+                                                NULL));
+}
+
+void
+test_shared_cache (void)
+{
+    gboolean cached;
+    pid_t pid;
+    gint status;
+    gint64 deadline;
+
+    g_hash_table_insert(responses,
+                        g_strdup("1.2.0.192.bl.example.com"),
+                        g_strdup("127.0.0.2"));
+
+    pid = fork();
+    cut_assert_operator_int(pid, >=, 0);
+    if (pid == 0) {
+        /* A worker process looks up and the parent reads the
+         * cached answers. */
+        finished = FALSE;
+        lookup = milter_manager_dnsbl_lookup(loop,
+                                             (struct sockaddr *)&address,
+                                             sizeof(address),
+                                             cb_finished,
+                                             NULL);
+        deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+        while (lookup && !finished && g_get_monotonic_time() < deadline) {
+            guint8 message[512];
+
+            /* The parent doesn't serve the name server until
+             * the child exits. */
+            if (recv(g_io_channel_unix_get_fd(server_channel),
+                     message, sizeof(message), MSG_PEEK | MSG_DONTWAIT) > 0)
+                cb_query(server_channel, G_IO_IN, NULL);
+            milter_event_loop_iterate(loop, FALSE);
+        }
+        _exit(finished ? 0 : 1);
+    }
+
+    cut_assert_equal_int(pid, waitpid(pid, &status, 0));
+    cut_assert_true(WIFEXITED(status));
+    cut_assert_equal_int(0, WEXITSTATUS(status));
+
+    get_cached_answers("1.2.0.192.bl.example.com", &cached);
+    cut_assert_true(cached);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
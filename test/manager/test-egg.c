@@ -41,6 +41,8 @@
 
 void test_new (void);
 void test_hatch (void);
+void test_hatch_connection_spec (void);
+void test_hatch_connection_spec_host_name (void);
 void test_name (void);
 void test_description (void);
 void test_enabled (void);
@@ -55,6 +57,7 @@ void test_command (void);
 void test_command_options (void);
 void test_fallback_status (void);
 void test_evaluation_mode (void);
+void test_reuse_connection (void);
 void test_merge (void);
 void test_applicable_condition (void);
 void test_attach_applicable_conditions (void);
@@ -206,6 +209,60 @@ test_hatch (void)
         milter_manager_child_get_fallback_status(hatched_child));
 }
 
+void
+test_hatch_connection_spec (void)
+{
+    MilterManagerChild *another_child;
+    GError *error = NULL;
+
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_egg_set_connection_spec(egg, "inet:9999@127.0.0.1", &error);
+    gcut_assert_error(error);
+
+    child = milter_manager_egg_hatch(egg);
+    cut_assert_not_null(child);
+    cut_assert_equal_string(
+        "inet:9999@127.0.0.1",
+        milter_server_context_get_connection_spec(MILTER_SERVER_CONTEXT(child)));
+
+    milter_manager_egg_set_connection_spec(egg, "unix:/tmp/milter.sock", &error);
+    gcut_assert_error(error);
+
+    another_child = milter_manager_egg_hatch(egg);
+    gcut_take_object(G_OBJECT(another_child));
+    cut_assert_equal_string(
+        "unix:/tmp/milter.sock",
+        milter_server_context_get_connection_spec(
+            MILTER_SERVER_CONTEXT(another_child)));
+    cut_assert_equal_string(
+        "inet:9999@127.0.0.1",
+        milter_server_context_get_connection_spec(MILTER_SERVER_CONTEXT(child)));
+}
+
+void
+test_hatch_connection_spec_host_name (void)
+{
+    MilterManagerChild *another_child;
+    GError *error = NULL;
+
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_egg_set_connection_spec(egg, "inet:9999@localhost", &error);
+    gcut_assert_error(error);
+
+    child = milter_manager_egg_hatch(egg);
+    cut_assert_not_null(child);
+    cut_assert_equal_string(
+        "inet:9999@localhost",
+        milter_server_context_get_connection_spec(MILTER_SERVER_CONTEXT(child)));
+
+    another_child = milter_manager_egg_hatch(egg);
+    gcut_take_object(G_OBJECT(another_child));
+    cut_assert_equal_string(
+        "inet:9999@localhost",
+        milter_server_context_get_connection_spec(
+            MILTER_SERVER_CONTEXT(another_child)));
+}
+
 void
 test_name (void)
 {
@@ -396,6 +453,30 @@ test_evaluation_mode (void)
     cut_assert_true(milter_manager_child_is_evaluation_mode(child));
 }
 
+void
+test_reuse_connection (void)
+{
+    const gchar spec[] = "inet:9999@127.0.0.1";
+    GError *error = NULL;
+
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_egg_set_connection_spec(egg, spec, &error);
+    gcut_assert_error(error);
+
+    cut_assert_false(milter_manager_egg_is_reuse_connection(egg));
+    child = milter_manager_egg_hatch(egg);
+    cut_assert_not_null(child);
+    cut_assert_false(milter_manager_child_is_reuse_connection(child));
+
+    milter_manager_egg_set_reuse_connection(egg, TRUE);
+    cut_assert_true(milter_manager_egg_is_reuse_connection(egg));
+
+    g_object_unref(child);
+    child = milter_manager_egg_hatch(egg);
+    cut_assert_not_null(child);
+    cut_assert_true(milter_manager_child_is_reuse_connection(child));
+}
+
 void
 test_applicable_condition (void)
 {
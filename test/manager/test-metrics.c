@@ -0,0 +1,289 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <milter/manager/milter-manager-metrics.h>
+
+#include <gcutter.h>
+
+void test_empty (void);
+void test_session (void);
+void test_child (void);
+void test_child_stage (void);
+void test_child_stage_out_of_range (void);
+void test_worker (void);
+void test_body_spill (void);
+void test_child_duration_percentile (void);
+void test_child_duration_percentile_empty (void);
+
+static gchar *actual;
+
+#define SESSIONS_HEADER                                                 \
+    "# TYPE milter_manager_sessions counter\n"                          \
+    "# HELP milter_manager_sessions "                                   \
+    "Finished sessions by the last stage and status.\n"
+#define SESSION_DURATION_HEADER                                         \
+    "# TYPE milter_manager_session_duration_seconds histogram\n"        \
+    "# UNIT milter_manager_session_duration_seconds seconds\n"          \
+    "# HELP milter_manager_session_duration_seconds "                   \
+    "Elapsed time of finished sessions.\n"
+#define BODY_SPILLS_HEADER                                              \
+    "# TYPE milter_manager_body_spills counter\n"                       \
+    "# HELP milter_manager_body_spills "                                \
+    "Message bodies written to temporary files.\n"
+#define CHILD_RESULTS_HEADER                                            \
+    "# TYPE milter_manager_child_results counter\n"                     \
+    "# HELP milter_manager_child_results "                              \
+    "Finished child milters by the last stage and status.\n"
+#define CHILD_DURATION_HEADER                                           \
+    "# TYPE milter_manager_child_duration_seconds histogram\n"          \
+    "# UNIT milter_manager_child_duration_seconds seconds\n"            \
+    "# HELP milter_manager_child_duration_seconds "                     \
+    "Elapsed time of finished child milters.\n"
+#define CHILD_STAGE_DURATION_HEADER                                     \
+    "# TYPE milter_manager_child_stage_duration_seconds histogram\n"    \
+    "# UNIT milter_manager_child_stage_duration_seconds seconds\n"      \
+    "# HELP milter_manager_child_stage_duration_seconds "               \
+    "Elapsed time from a command to its reply "                         \
+    "by child milter and stage.\n"
+
+/* 0.02 seconds */
+#define DURATION(name, labels)                                          \
+    name "_bucket{" labels ",le=\"0.001\"} 0\n"                         \
+    name "_bucket{" labels ",le=\"0.005\"} 0\n"                         \
+    name "_bucket{" labels ",le=\"0.01\"} 0\n"                          \
+    name "_bucket{" labels ",le=\"0.025\"} 1\n"                         \
+    name "_bucket{" labels ",le=\"0.05\"} 1\n"                          \
+    name "_bucket{" labels ",le=\"0.1\"} 1\n"                           \
+    name "_bucket{" labels ",le=\"0.25\"} 1\n"                          \
+    name "_bucket{" labels ",le=\"0.5\"} 1\n"                           \
+    name "_bucket{" labels ",le=\"1\"} 1\n"                             \
+    name "_bucket{" labels ",le=\"2.5\"} 1\n"                           \
+    name "_bucket{" labels ",le=\"5\"} 1\n"                             \
+    name "_bucket{" labels ",le=\"10\"} 1\n"                            \
+    name "_bucket{" labels ",le=\"30\"} 1\n"                            \
+    name "_bucket{" labels ",le=\"60\"} 1\n"                            \
+    name "_bucket{" labels ",le=\"+Inf\"} 1\n"                          \
+    name "_count{" labels "} 1\n"                                       \
+    name "_sum{" labels "} 0.020000\n"
+
+void
+cut_setup (void)
+{
+    actual = NULL;
+    milter_manager_metrics_init(0);
+}
+
+void
+cut_teardown (void)
+{
+    milter_manager_metrics_quit();
+    if (actual)
+        g_free(actual);
+}
+
+void
+test_empty (void)
+{
+    actual = milter_manager_metrics_to_open_metrics();
+    cut_assert_equal_string(SESSIONS_HEADER
+                            SESSION_DURATION_HEADER
+                            BODY_SPILLS_HEADER
+                            CHILD_RESULTS_HEADER
+                            CHILD_DURATION_HEADER
+                            CHILD_STAGE_DURATION_HEADER
+                            "# EOF\n",
+                            actual);
+}
+
+void
+test_session (void)
+{
+    milter_manager_metrics_record_session(
+        MILTER_CLIENT_CONTEXT_STATE_QUIT_REPLIED,
+        MILTER_STATUS_ACCEPT,
+        0.02);
+    actual = milter_manager_metrics_to_open_metrics();
+    cut_assert_equal_string(
+        SESSIONS_HEADER
+        "milter_manager_sessions_total"
+        "{worker=\"0\",stage=\"quit-replied\",status=\"accept\"} 1\n"
+        SESSION_DURATION_HEADER
+        DURATION("milter_manager_session_duration_seconds", "worker=\"0\"")
+        BODY_SPILLS_HEADER
+        CHILD_RESULTS_HEADER
+        CHILD_DURATION_HEADER
+        CHILD_STAGE_DURATION_HEADER
+        "# EOF\n",
+        actual);
+}
+
+void
+test_child (void)
+{
+    milter_manager_metrics_record_child("milter@10029",
+                                        MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE,
+                                        MILTER_STATUS_REJECT,
+                                        0.02);
+    actual = milter_manager_metrics_to_open_metrics();
+    cut_assert_equal_string(
+        SESSIONS_HEADER
+        SESSION_DURATION_HEADER
+        BODY_SPILLS_HEADER
+        CHILD_RESULTS_HEADER
+        "milter_manager_child_results_total"
+        "{worker=\"0\",child=\"milter@10029\","
+        "stage=\"end-of-message\",status=\"reject\"} 1\n"
+        CHILD_DURATION_HEADER
+        DURATION("milter_manager_child_duration_seconds",
+                 "worker=\"0\",child=\"milter@10029\"")
+        CHILD_STAGE_DURATION_HEADER
+        "# EOF\n",
+        actual);
+}
+
+void
+test_child_stage (void)
+{
+    milter_manager_metrics_record_child_stage(
+        "milter@10029",
+        MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM,
+        0.02);
+    actual = milter_manager_metrics_to_open_metrics();
+    cut_assert_equal_string(
+        SESSIONS_HEADER
+        SESSION_DURATION_HEADER
+        BODY_SPILLS_HEADER
+        CHILD_RESULTS_HEADER
+        CHILD_DURATION_HEADER
+        CHILD_STAGE_DURATION_HEADER
+        DURATION("milter_manager_child_stage_duration_seconds",
+                 "worker=\"0\",child=\"milter@10029\","
+                 "stage=\"envelope-from\"")
+        "# EOF\n",
+        actual);
+}
+
+void
+test_child_stage_out_of_range (void)
+{
+    milter_manager_metrics_record_child_stage(
+        "milter@10029",
+        MILTER_SERVER_CONTEXT_STATE_QUIT,
+        0.02);
+    actual = milter_manager_metrics_to_open_metrics();
+    cut_assert_equal_string(
+        SESSIONS_HEADER
+        SESSION_DURATION_HEADER
+        BODY_SPILLS_HEADER
+        CHILD_RESULTS_HEADER
+        CHILD_DURATION_HEADER
+        CHILD_STAGE_DURATION_HEADER
+        "# EOF\n",
+        actual);
+}
+
+void
+test_worker (void)
+{
+    milter_manager_metrics_quit();
+    milter_manager_metrics_init(2);
+    milter_manager_metrics_set_worker_id(2);
+    milter_manager_metrics_record_session(
+        MILTER_CLIENT_CONTEXT_STATE_QUIT_REPLIED,
+        MILTER_STATUS_ACCEPT,
+        0.02);
+    actual = milter_manager_metrics_to_open_metrics();
+    cut_assert_equal_string(
+        SESSIONS_HEADER
+        "milter_manager_sessions_total"
+        "{worker=\"2\",stage=\"quit-replied\",status=\"accept\"} 1\n"
+        SESSION_DURATION_HEADER
+        DURATION("milter_manager_session_duration_seconds", "worker=\"2\"")
+        BODY_SPILLS_HEADER
+        CHILD_RESULTS_HEADER
+        CHILD_DURATION_HEADER
+        CHILD_STAGE_DURATION_HEADER
+        "# EOF\n",
+        actual);
+}
+
+void
+test_body_spill (void)
+{
+    milter_manager_metrics_record_body_spill();
+    milter_manager_metrics_record_body_spill();
+    cut_assert_equal_uint(2, milter_manager_metrics_get_n_body_spills(0));
+
+    actual = milter_manager_metrics_to_open_metrics();
+    cut_assert_equal_string(
+        SESSIONS_HEADER
+        SESSION_DURATION_HEADER
+        BODY_SPILLS_HEADER
+        "milter_manager_body_spills_total{worker=\"0\"} 2\n"
+        CHILD_RESULTS_HEADER
+        CHILD_DURATION_HEADER
+        CHILD_STAGE_DURATION_HEADER
+        "# EOF\n",
+        actual);
+}
+
+void
+test_child_duration_percentile (void)
+{
+    gint i;
+
+    for (i = 0; i < 4; i++) {
+        milter_manager_metrics_record_child("milter@10029",
+                                            MILTER_SERVER_CONTEXT_STATE_QUIT,
+                                            MILTER_STATUS_ACCEPT,
+                                            0.02);
+    }
+    for (i = 0; i < 4; i++) {
+        milter_manager_metrics_record_child("milter@10029",
+                                            MILTER_SERVER_CONTEXT_STATE_QUIT,
+                                            MILTER_STATUS_ACCEPT,
+                                            0.7);
+    }
+
+    cut_assert_equal_double(
+        0.025, 0.0001,
+        milter_manager_metrics_get_child_duration_percentile("milter@10029",
+                                                             0.5));
+    cut_assert_equal_double(
+        0.875, 0.0001,
+        milter_manager_metrics_get_child_duration_percentile("milter@10029",
+                                                             0.875));
+}
+
+void
+test_child_duration_percentile_empty (void)
+{
+    cut_assert_equal_double(
+        -1.0, 0.0001,
+        milter_manager_metrics_get_child_duration_percentile("milter@10029",
+                                                             0.5));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
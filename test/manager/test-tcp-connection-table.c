@@ -0,0 +1,161 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <milter/manager/milter-manager-tcp-connection-table.h>
+
+#include <gcutter.h>
+
+void test_lookup (void);
+void test_lookup_close_wait (void);
+void test_lookup_unknown (void);
+
+static gint server_fd;
+static gint client_fd;
+static gint accepted_fd;
+static struct sockaddr_in server_address;
+static struct sockaddr_in client_address;
+
+void
+cut_setup (void)
+{
+    socklen_t address_length;
+
+    server_fd = -1;
+    client_fd = -1;
+    accepted_fd = -1;
+
+    if (!milter_manager_tcp_connection_table_is_available())
+        cut_omit("TCP connection table isn't available on this platform");
+
+    milter_manager_tcp_connection_table_set_lifetime(0.0);
+
+    memset(&server_address, 0, sizeof(server_address));
+    server_address.sin_family = AF_INET;
+    server_address.sin_addr.s_addr = g_htonl(INADDR_LOOPBACK);
+    server_address.sin_port = 0;
+
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    cut_assert_operator_int(server_fd, >=, 0);
+    cut_assert_equal_int(0, bind(server_fd,
+                                 (struct sockaddr *)&server_address,
+                                 sizeof(server_address)));
+    cut_assert_equal_int(0, listen(server_fd, 1));
+    address_length = sizeof(server_address);
+    cut_assert_equal_int(0, getsockname(server_fd,
+                                        (struct sockaddr *)&server_address,
+                                        &address_length));
+
+    client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    cut_assert_operator_int(client_fd, >=, 0);
+    cut_assert_equal_int(0, connect(client_fd,
+                                    (struct sockaddr *)&server_address,
+                                    sizeof(server_address)));
+    address_length = sizeof(client_address);
+    cut_assert_equal_int(0, getsockname(client_fd,
+                                        (struct sockaddr *)&client_address,
+                                        &address_length));
+
+    accepted_fd = accept(server_fd, NULL, NULL);
+    cut_assert_operator_int(accepted_fd, >=, 0);
+}
+
+void
+cut_teardown (void)
+{
+    if (accepted_fd >= 0)
+        close(accepted_fd);
+    if (client_fd >= 0)
+        close(client_fd);
+    if (server_fd >= 0)
+        close(server_fd);
+
+    milter_manager_tcp_connection_table_clear();
+}
+
+void
+test_lookup (void)
+{
+    MilterManagerTCPState state;
+    MilterGenericSocketAddress local_address;
+
+    cut_assert_true(
+        milter_manager_tcp_connection_table_lookup(
+            (struct sockaddr *)&client_address,
+            sizeof(client_address),
+            FALSE,
+            &state,
+            &local_address));
+    gcut_assert_equal_enum(MILTER_TYPE_MANAGER_TCP_STATE,
+                           MILTER_MANAGER_TCP_STATE_ESTABLISHED,
+                           state);
+    cut_assert_equal_int(AF_INET, local_address.address.base.sa_family);
+    cut_assert_equal_uint(g_ntohs(server_address.sin_port),
+                          g_ntohs(local_address.address.inet.sin_port));
+}
+
+void
+test_lookup_close_wait (void)
+{
+    MilterManagerTCPState state;
+
+    close(client_fd);
+    client_fd = -1;
+    g_usleep(G_USEC_PER_SEC / 10);
+
+    cut_assert_true(
+        milter_manager_tcp_connection_table_lookup(
+            (struct sockaddr *)&client_address,
+            sizeof(client_address),
+            FALSE,
+            &state,
+            NULL));
+    gcut_assert_equal_enum(MILTER_TYPE_MANAGER_TCP_STATE,
+                           MILTER_MANAGER_TCP_STATE_CLOSE_WAIT,
+                           state);
+}
+
+void
+test_lookup_unknown (void)
+{
+    struct sockaddr_in unknown_address;
+
+    unknown_address = client_address;
+    unknown_address.sin_addr.s_addr = g_htonl(0xc0000201); /* 192.0.2.1 */
+
+    cut_assert_false(
+        milter_manager_tcp_connection_table_lookup(
+            (struct sockaddr *)&unknown_address,
+            sizeof(unknown_address),
+            TRUE,
+            NULL,
+            NULL));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
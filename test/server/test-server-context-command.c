@@ -44,8 +44,10 @@ void test_data (void);
 void test_data_with_protocol_version2 (void);
 void test_unknown (void);
 void test_header (void);
+void test_header_with_packet (void);
 void test_end_of_header (void);
 void test_body (void);
+void test_body_with_packet (void);
 void test_end_of_message (void);
 void test_end_of_message_without_chunk (void);
 void test_quit (void);
@@ -677,6 +679,35 @@ test_header (void)
     cut_assert_equal_uint(0, n_message_processed);
 }
 
+void
+test_header_with_packet (void)
+{
+    const gchar name[] = "X-HEADER-NAME";
+    const gchar value[] = "MilterServerContext test";
+    const gchar *packet;
+    gsize packet_size;
+    const gchar *shared_packet;
+
+    test_data();
+    channel_free();
+
+    reply_continue();
+
+    milter_command_encoder_encode_header(encoder,
+                                         &packet, &packet_size,
+                                         name, "shared value");
+    shared_packet = cut_take_memory(g_memdup(packet, packet_size));
+    cut_assert_true(milter_server_context_header_with_packet(context,
+                                                             name, value,
+                                                             shared_packet,
+                                                             packet_size));
+    pump_all_events();
+    milter_test_assert_state(HEADER);
+    milter_test_assert_status(NOT_CHANGE);
+
+    milter_test_assert_packet(channel, shared_packet, packet_size);
+}
+
 void
 test_end_of_header (void)
 {
@@ -725,6 +756,36 @@ test_body (void)
     cut_assert_equal_uint(0, n_message_processed);
 }
 
+void
+test_body_with_packet (void)
+{
+    const gchar chunk[] = "This is a body text.";
+    const gchar *packet;
+    gsize packet_size;
+    const gchar *shared_packet;
+
+    test_end_of_header();
+    channel_free();
+
+    reply_continue();
+
+    milter_command_encoder_encode_body(encoder, &packet, &packet_size,
+                                       "This is a shared body.",
+                                       strlen("This is a shared body."),
+                                       NULL);
+    shared_packet = cut_take_memory(g_memdup(packet, packet_size));
+    cut_assert_true(milter_server_context_body_with_packet(context,
+                                                           chunk,
+                                                           strlen(chunk),
+                                                           shared_packet,
+                                                           packet_size));
+    pump_all_events();
+    milter_test_assert_state(BODY);
+    milter_test_assert_status(NOT_CHANGE);
+
+    milter_test_assert_packet(channel, shared_packet, packet_size);
+}
+
 void
 test_end_of_message (void)
 {
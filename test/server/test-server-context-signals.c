@@ -68,6 +68,7 @@ void test_connection_failure (void);
 void test_shutdown (void);
 void test_skip (void);
 void test_skip_on_invalid_state (void);
+void test_stage_replied (void);
 void test_reading_timeout (void);
 void test_writing_timeout (void);
 void test_invalid_state_error (void);
@@ -113,6 +114,7 @@ static gint n_quarantines;
 static gint n_connection_failures;
 static gint n_shutdowns;
 static gint n_skips;
+static gint n_stage_replieds;
 static gint n_errors;
 
 static guint actual_reply_code;
@@ -129,6 +131,8 @@ static gchar *actual_recipient_parameters;
 static gchar *actual_quarantine_reason;
 static MilterOption *actual_option;
 static MilterMacrosRequests *actual_requests;
+static MilterServerContextState actual_stage;
+static gdouble actual_stage_elapsed;
 
 static gboolean timed_out_before;
 static gboolean timed_out_after;
@@ -364,6 +368,18 @@ cb_skip (MilterServerContext *context, gpointer user_data)
     return MILTER_STATUS_CONTINUE;
 }
 
+static void
+cb_stage_replied (MilterServerContext *context,
+                  MilterServerContextState state,
+                  gdouble elapsed,
+                  gpointer user_data)
+{
+    n_stage_replieds++;
+
+    actual_stage = state;
+    actual_stage_elapsed = elapsed;
+}
+
 static void
 cb_error (MilterErrorEmittable *emittable, GError *error)
 {
@@ -405,6 +421,7 @@ setup_signals (MilterServerContext *context)
     CONNECT(connection_failure);
     CONNECT(shutdown);
     CONNECT(skip);
+    CONNECT(stage_replied);
     CONNECT(error);
 
 #undef CONNECT
@@ -483,6 +500,7 @@ cut_setup (void)
     n_connection_failures = 0;
     n_shutdowns = 0;
     n_skips = 0;
+    n_stage_replieds = 0;
     n_errors = 0;
 
     actual_header_index = -1;
@@ -499,6 +517,8 @@ cut_setup (void)
     actual_quarantine_reason = NULL;
     actual_option = NULL;
     actual_requests = NULL;
+    actual_stage = MILTER_SERVER_CONTEXT_STATE_INVALID;
+    actual_stage_elapsed = -1.0;
 
     timed_out_before = FALSE;
     timed_out_after = FALSE;
@@ -1300,6 +1320,29 @@ cb_io_timeout_detect (gpointer data)
     return FALSE;
 }
 
+void
+test_stage_replied (void)
+{
+    const gchar *packet;
+    gsize packet_size;
+
+    milter_server_context_helo(context, "delian");
+    pump_all_events();
+    cut_assert_equal_int(0, n_stage_replieds);
+
+    milter_reply_encoder_encode_continue(encoder, &packet, &packet_size);
+    write_data(packet, packet_size);
+    cut_assert_equal_int(1, n_stage_replieds);
+    gcut_assert_equal_enum(MILTER_TYPE_SERVER_CONTEXT_STATE,
+                           MILTER_SERVER_CONTEXT_STATE_HELO,
+                           actual_stage);
+    cut_assert_operator(actual_stage_elapsed, >=, 0.0);
+
+    milter_reply_encoder_encode_continue(encoder, &packet, &packet_size);
+    write_data(packet, packet_size);
+    cut_assert_equal_int(1, n_stage_replieds);
+}
+
 void
 test_reading_timeout (void)
 {
@@ -53,6 +53,7 @@ void test_state (void);
 void test_last_state (void);
 void test_macro (void);
 void test_macros_hash_table (void);
+void test_share_macros_hash_table (void);
 void data_has_accepted_recipient (void);
 void test_has_accepted_recipient (gconstpointer data);
 
@@ -802,6 +803,39 @@ test_macros_hash_table (void)
         milter_protocol_agent_get_available_macros(agent));
 }
 
+void
+test_share_macros_hash_table (void)
+{
+    MilterProtocolAgent *agent;
+    GHashTable *macros;
+
+    agent = MILTER_PROTOCOL_AGENT(context);
+    milter_protocol_agent_set_macro_context(agent, MILTER_COMMAND_HELO);
+
+    macros = gcut_take_new_hash_table_string_string("if_name", "localhost",
+                                                    NULL);
+    milter_protocol_agent_share_macros_hash_table(agent,
+                                                  MILTER_COMMAND_CONNECT,
+                                                  macros);
+    milter_protocol_agent_set_macro(agent, MILTER_COMMAND_HELO,
+                                    "if_name", "mail.example.com");
+    cut_assert_equal_string("mail.example.com",
+                            milter_protocol_agent_get_macro(agent,
+                                                            "{if_name}"));
+
+    milter_protocol_agent_set_macro(agent, MILTER_COMMAND_CONNECT,
+                                    "if_addr", "IPv6:::1");
+    gcut_assert_equal_hash_table_string_string(
+        gcut_take_new_hash_table_string_string("if_name", "mail.example.com",
+                                               "if_addr", "IPv6:::1",
+                                               NULL),
+        milter_protocol_agent_get_available_macros(agent));
+    gcut_assert_equal_hash_table_string_string(
+        gcut_take_new_hash_table_string_string("if_name", "localhost",
+                                               NULL),
+        macros);
+}
+
 void
 data_has_accepted_recipient (void)
 {
@@ -55,6 +55,8 @@ void test_macro (gconstpointer data);
 void data_invalid_spec (void);
 void test_invalid_spec (gconstpointer data);
 
+void test_benchmark (void);
+
 static MilterEventLoop *loop;
 
 static MilterTestClient *client;
@@ -2617,6 +2619,28 @@ test_invalid_spec (gconstpointer data)
     cut_assert_equal_string(test_data->expected_message, output_string->str);
 }
 
+void
+test_benchmark (void)
+{
+    GError *error = NULL;
+
+    setup_test_client("inet:9999@localhost", NULL);
+    setup_server("inet:9999@localhost",
+                 "--benchmark --benchmark-sessions 2");
+
+    gcut_process_run(server, &error);
+    gcut_assert_error(error);
+
+    wait_for_reaping(FALSE);
+    cut_assert_equal_int(EXIT_SUCCESS, exit_status);
+
+    cut_assert_equal_int(2, n_end_of_messages);
+    cut_assert_match("\"sessions\": 2,", output_string->str);
+    cut_assert_match("\"errors\": 0,", output_string->str);
+    cut_assert_match("\"end-of-message\": \\{\"count\": 2,",
+                     output_string->str);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -0,0 +1,839 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2026  Sutou Kouhei <kou@clear-code.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <glib/gi18n.h>
+
+#ifdef HAVE_LOCALE_H
+#  include <locale.h>
+#endif
+
+#include <milter/client.h>
+
+#define DEFAULT_GROUP_NAME "default"
+#define FAKE_HEADER_NAME "X-Milter-Fake-Client"
+#define REPLACED_BODY "This body is replaced by milter-fake-client.\r\n"
+
+#define MILTER_FAKE_CLIENT_ERROR                                \
+    (g_quark_from_static_string("milter-fake-client-error-quark"))
+
+typedef enum
+{
+    MILTER_FAKE_CLIENT_ERROR_INVALID_VALUE
+} MilterFakeClientError;
+
+typedef enum
+{
+    FAKE_STAGE_CONNECT,
+    FAKE_STAGE_HELO,
+    FAKE_STAGE_ENVELOPE_FROM,
+    FAKE_STAGE_ENVELOPE_RECIPIENT,
+    FAKE_STAGE_DATA,
+    FAKE_STAGE_UNKNOWN,
+    FAKE_STAGE_HEADER,
+    FAKE_STAGE_END_OF_HEADER,
+    FAKE_STAGE_BODY,
+    FAKE_STAGE_END_OF_MESSAGE,
+    N_FAKE_STAGES
+} FakeStage;
+
+static const gchar *fake_stage_names[N_FAKE_STAGES] = {
+    "connect",
+    "helo",
+    "envelope-from",
+    "envelope-recipient",
+    "data",
+    "unknown",
+    "header",
+    "end-of-header",
+    "body",
+    "end-of-message"
+};
+
+static const gchar *fake_stage_response_signal_names[N_FAKE_STAGES] = {
+    "connect-response",
+    "helo-response",
+    "envelope-from-response",
+    "envelope-recipient-response",
+    "data-response",
+    "unknown-response",
+    "header-response",
+    "end-of-header-response",
+    "body-response",
+    "end-of-message-response"
+};
+
+typedef enum
+{
+    LATENCY_DISTRIBUTION_CONSTANT,
+    LATENCY_DISTRIBUTION_UNIFORM,
+    LATENCY_DISTRIBUTION_EXPONENTIAL
+} LatencyDistribution;
+
+typedef enum
+{
+    FAKE_ACTION_NONE,
+    FAKE_ACTION_ADD_HEADER,
+    FAKE_ACTION_CHANGE_HEADER,
+    FAKE_ACTION_DELETE_HEADER,
+    FAKE_ACTION_REPLACE_BODY,
+    FAKE_ACTION_QUARANTINE
+} FakeAction;
+
+static const gchar *fake_action_names[] = {
+    "none",
+    "add-header",
+    "change-header",
+    "delete-header",
+    "replace-body",
+    "quarantine"
+};
+
+typedef struct _WeightedChoice
+{
+    gint value;
+    guint weight;
+} WeightedChoice;
+
+typedef struct _StageBehavior
+{
+    LatencyDistribution distribution;
+    gdouble latency;
+    gdouble jitter;
+    gdouble stall_rate;
+    gdouble stall_time;
+    GArray *replies;
+    GArray *actions;
+} StageBehavior;
+
+typedef struct _FakeSession
+{
+    MilterClientContext *context;
+    GRand *rand;
+    FakeStage stage;
+    MilterStatus status;
+    guint reply_id;
+} FakeSession;
+
+static gchar *configuration_path = NULL;
+static gint seed = 0;
+static volatile gint n_sessions = 0;
+static StageBehavior behaviors[N_FAKE_STAGES];
+static MilterClient *client = NULL;
+
+static gboolean
+print_version (const gchar *option_name,
+               const gchar *value,
+               gpointer data,
+               GError **error)
+{
+    g_print("%s\n", VERSION);
+    exit(EXIT_SUCCESS);
+    return TRUE;
+}
+
+static const GOptionEntry option_entries[] =
+{
+    {"configuration", 'c', 0, G_OPTION_ARG_FILENAME, &configuration_path,
+     N_("Read behavior of each protocol stage from PATH"), "PATH"},
+    {"seed", 0, 0, G_OPTION_ARG_INT, &seed,
+     N_("Use SEED as random seed. 0 means a random seed. (0)"), "SEED"},
+    {"version", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, print_version,
+     N_("Show version"), NULL},
+    {NULL}
+};
+
+static void
+init_behaviors (void)
+{
+    gint i;
+
+    for (i = 0; i < N_FAKE_STAGES; i++) {
+        StageBehavior *behavior = &behaviors[i];
+
+        behavior->distribution = LATENCY_DISTRIBUTION_CONSTANT;
+        behavior->latency = 0.0;
+        behavior->jitter = 0.0;
+        behavior->stall_rate = 0.0;
+        behavior->stall_time = 0.0;
+        behavior->replies = g_array_new(FALSE, FALSE, sizeof(WeightedChoice));
+        behavior->actions = g_array_new(FALSE, FALSE, sizeof(WeightedChoice));
+    }
+}
+
+static void
+clear_behaviors (void)
+{
+    gint i;
+
+    for (i = 0; i < N_FAKE_STAGES; i++) {
+        g_array_free(behaviors[i].replies, TRUE);
+        g_array_free(behaviors[i].actions, TRUE);
+    }
+}
+
+static gboolean
+parse_distribution (const gchar *name, LatencyDistribution *distribution,
+                    GError **error)
+{
+    if (g_str_equal(name, "constant")) {
+        *distribution = LATENCY_DISTRIBUTION_CONSTANT;
+    } else if (g_str_equal(name, "uniform")) {
+        *distribution = LATENCY_DISTRIBUTION_UNIFORM;
+    } else if (g_str_equal(name, "exponential")) {
+        *distribution = LATENCY_DISTRIBUTION_EXPONENTIAL;
+    } else {
+        g_set_error(error,
+                    MILTER_FAKE_CLIENT_ERROR,
+                    MILTER_FAKE_CLIENT_ERROR_INVALID_VALUE,
+                    "unknown latency distribution: <%s>: "
+                    "available values: [constant|uniform|exponential]",
+                    name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+parse_reply (const gchar *name, gint *value, GError **error)
+{
+    GError *enum_error = NULL;
+
+    *value = milter_utils_enum_from_string(MILTER_TYPE_STATUS, name,
+                                           &enum_error);
+    if (enum_error) {
+        g_set_error(error,
+                    MILTER_FAKE_CLIENT_ERROR,
+                    MILTER_FAKE_CLIENT_ERROR_INVALID_VALUE,
+                    "unknown reply: <%s>: %s", name, enum_error->message);
+        g_error_free(enum_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+parse_action (const gchar *name, gint *value, GError **error)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(fake_action_names); i++) {
+        if (g_str_equal(name, fake_action_names[i])) {
+            *value = i;
+            return TRUE;
+        }
+    }
+
+    g_set_error(error,
+                MILTER_FAKE_CLIENT_ERROR,
+                MILTER_FAKE_CLIENT_ERROR_INVALID_VALUE,
+                "unknown action: <%s>: available values: "
+                "[none|add-header|change-header|delete-header|"
+                "replace-body|quarantine]",
+                name);
+    return FALSE;
+}
+
+/* Parses "NAME1:WEIGHT1;NAME2:WEIGHT2;...". ":WEIGHT" can be
+ * omitted. It means ":1". */
+static gboolean
+parse_weighted_choices (GKeyFile *key_file,
+                        const gchar *group,
+                        const gchar *key,
+                        gboolean (*parse_value) (const gchar  *name,
+                                                 gint         *value,
+                                                 GError      **error),
+                        GArray *choices,
+                        GError **error)
+{
+    gchar **items;
+    gsize i, n_items;
+
+    items = g_key_file_get_string_list(key_file, group, key, &n_items, NULL);
+    if (!items)
+        return TRUE;
+
+    g_array_set_size(choices, 0);
+    for (i = 0; i < n_items; i++) {
+        WeightedChoice choice;
+        gchar **name_and_weight;
+        gboolean success = TRUE;
+
+        name_and_weight = g_strsplit(g_strstrip(items[i]), ":", 2);
+        choice.weight = 1;
+        if (name_and_weight[1]) {
+            gchar *end;
+
+            choice.weight = strtoul(name_and_weight[1], &end, 10);
+            if (end == name_and_weight[1] || end[0] != '\0') {
+                g_set_error(error,
+                            MILTER_FAKE_CLIENT_ERROR,
+                            MILTER_FAKE_CLIENT_ERROR_INVALID_VALUE,
+                            "[%s] %s: invalid weight: <%s>",
+                            group, key, items[i]);
+                success = FALSE;
+            }
+        }
+        if (success)
+            success = parse_value(name_and_weight[0], &(choice.value), error);
+        g_strfreev(name_and_weight);
+        if (!success) {
+            g_strfreev(items);
+            return FALSE;
+        }
+
+        if (choice.weight > 0)
+            g_array_append_val(choices, choice);
+    }
+    g_strfreev(items);
+
+    return TRUE;
+}
+
+static gboolean
+load_double (GKeyFile *key_file, const gchar *group, const gchar *key,
+             gdouble *value, GError **error)
+{
+    GError *key_file_error = NULL;
+    gdouble loaded_value;
+
+    if (!g_key_file_has_key(key_file, group, key, NULL))
+        return TRUE;
+
+    loaded_value = g_key_file_get_double(key_file, group, key,
+                                         &key_file_error);
+    if (key_file_error) {
+        g_propagate_error(error, key_file_error);
+        return FALSE;
+    }
+    if (loaded_value < 0.0) {
+        g_set_error(error,
+                    MILTER_FAKE_CLIENT_ERROR,
+                    MILTER_FAKE_CLIENT_ERROR_INVALID_VALUE,
+                    "[%s] %s: must not be negative: <%g>",
+                    group, key, loaded_value);
+        return FALSE;
+    }
+
+    *value = loaded_value;
+    return TRUE;
+}
+
+static gboolean
+load_behavior (GKeyFile *key_file, const gchar *group,
+               StageBehavior *behavior, GError **error)
+{
+    gchar *distribution;
+
+    if (!g_key_file_has_group(key_file, group))
+        return TRUE;
+
+    distribution = g_key_file_get_string(key_file, group, "distribution",
+                                         NULL);
+    if (distribution) {
+        gboolean success;
+
+        success = parse_distribution(g_strstrip(distribution),
+                                     &(behavior->distribution),
+                                     error);
+        g_free(distribution);
+        if (!success)
+            return FALSE;
+    }
+
+    if (!load_double(key_file, group, "latency", &(behavior->latency), error))
+        return FALSE;
+    if (!load_double(key_file, group, "jitter", &(behavior->jitter), error))
+        return FALSE;
+    if (!load_double(key_file, group, "stall-rate",
+                     &(behavior->stall_rate), error))
+        return FALSE;
+    if (!load_double(key_file, group, "stall-time",
+                     &(behavior->stall_time), error))
+        return FALSE;
+
+    if (!parse_weighted_choices(key_file, group, "replies", parse_reply,
+                                behavior->replies, error))
+        return FALSE;
+    if (!parse_weighted_choices(key_file, group, "actions", parse_action,
+                                behavior->actions, error))
+        return FALSE;
+
+    return TRUE;
+}
+
+/* Each stage uses values in [default] group unless its own
+ * group such as [end-of-message] overrides them. */
+static gboolean
+load_configuration (const gchar *path, GError **error)
+{
+    GKeyFile *key_file;
+    gint i;
+    gboolean success = TRUE;
+
+    key_file = g_key_file_new();
+    g_key_file_set_list_separator(key_file, ';');
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, error)) {
+        g_key_file_free(key_file);
+        return FALSE;
+    }
+
+    for (i = 0; i < N_FAKE_STAGES && success; i++) {
+        success = load_behavior(key_file, DEFAULT_GROUP_NAME,
+                                &behaviors[i], error);
+        if (success)
+            success = load_behavior(key_file, fake_stage_names[i],
+                                    &behaviors[i], error);
+    }
+    g_key_file_free(key_file);
+
+    return success;
+}
+
+static gint
+choose (GRand *rand, GArray *choices, gint default_value)
+{
+    guint i, total_weight = 0, weight;
+
+    for (i = 0; i < choices->len; i++)
+        total_weight += g_array_index(choices, WeightedChoice, i).weight;
+    if (total_weight == 0)
+        return default_value;
+
+    weight = g_rand_int_range(rand, 0, total_weight);
+    for (i = 0; i < choices->len; i++) {
+        WeightedChoice *choice = &g_array_index(choices, WeightedChoice, i);
+
+        if (weight < choice->weight)
+            return choice->value;
+        weight -= choice->weight;
+    }
+
+    return default_value;
+}
+
+/* Returns a negative value for a stall that never replies. */
+static gdouble
+compute_latency (GRand *rand, StageBehavior *behavior)
+{
+    gdouble latency = behavior->latency;
+
+    if (behavior->stall_rate > 0.0 &&
+        g_rand_double(rand) < behavior->stall_rate) {
+        if (behavior->stall_time > 0.0)
+            return behavior->stall_time;
+        else
+            return -1.0;
+    }
+
+    switch (behavior->distribution) {
+    case LATENCY_DISTRIBUTION_UNIFORM:
+        latency = g_rand_double_range(rand, 0.0, behavior->latency * 2);
+        break;
+    case LATENCY_DISTRIBUTION_EXPONENTIAL:
+        latency = -behavior->latency * log(1.0 - g_rand_double(rand));
+        break;
+    case LATENCY_DISTRIBUTION_CONSTANT:
+    default:
+        break;
+    }
+
+    if (behavior->jitter > 0.0) {
+        latency += g_rand_double_range(rand,
+                                       -behavior->jitter,
+                                       behavior->jitter);
+        if (latency < 0.0)
+            latency = 0.0;
+    }
+
+    return latency;
+}
+
+static void
+apply_action (FakeSession *session)
+{
+    MilterClientContext *context = session->context;
+    GError *error = NULL;
+    FakeAction action;
+
+    action = choose(session->rand,
+                    behaviors[FAKE_STAGE_END_OF_MESSAGE].actions,
+                    FAKE_ACTION_NONE);
+    switch (action) {
+    case FAKE_ACTION_ADD_HEADER:
+        milter_client_context_add_header(context,
+                                         FAKE_HEADER_NAME, "added",
+                                         &error);
+        break;
+    case FAKE_ACTION_CHANGE_HEADER:
+        milter_client_context_change_header(context,
+                                            "Subject", 1, "changed",
+                                            &error);
+        break;
+    case FAKE_ACTION_DELETE_HEADER:
+        milter_client_context_delete_header(context,
+                                            "Subject", 1,
+                                            &error);
+        break;
+    case FAKE_ACTION_REPLACE_BODY:
+        milter_client_context_replace_body(context,
+                                           REPLACED_BODY,
+                                           strlen(REPLACED_BODY),
+                                           &error);
+        break;
+    case FAKE_ACTION_QUARANTINE:
+        milter_client_context_quarantine(context, "milter-fake-client");
+        break;
+    case FAKE_ACTION_NONE:
+    default:
+        break;
+    }
+
+    if (error) {
+        milter_error("[fake-client][error][%s] %s",
+                     fake_action_names[action], error->message);
+        g_error_free(error);
+    }
+}
+
+static gboolean
+cb_reply (gpointer user_data)
+{
+    FakeSession *session = user_data;
+
+    session->reply_id = 0;
+    if (session->stage == FAKE_STAGE_END_OF_MESSAGE)
+        apply_action(session);
+    g_signal_emit_by_name(session->context,
+                          fake_stage_response_signal_names[session->stage],
+                          session->status);
+
+    return FALSE;
+}
+
+static void
+cancel_reply (FakeSession *session)
+{
+    MilterEventLoop *loop;
+
+    if (session->reply_id == 0)
+        return;
+
+    loop = milter_agent_get_event_loop(MILTER_AGENT(session->context));
+    milter_event_loop_remove(loop, session->reply_id);
+    session->reply_id = 0;
+}
+
+static MilterStatus
+reply (MilterClientContext *context, FakeStage stage)
+{
+    FakeSession *session;
+    StageBehavior *behavior = &behaviors[stage];
+    gdouble latency;
+
+    session = milter_client_context_get_private_data(context);
+    session->stage = stage;
+    session->status = choose(session->rand, behavior->replies,
+                             MILTER_STATUS_CONTINUE);
+
+    latency = compute_latency(session->rand, behavior);
+    if (latency < 0.0)
+        return MILTER_STATUS_PROGRESS;
+
+    if (latency == 0.0) {
+        if (stage == FAKE_STAGE_END_OF_MESSAGE)
+            apply_action(session);
+        return session->status;
+    }
+
+    session->reply_id =
+        milter_event_loop_add_timeout(
+            milter_agent_get_event_loop(MILTER_AGENT(context)),
+            latency,
+            cb_reply,
+            session);
+    return MILTER_STATUS_PROGRESS;
+}
+
+static MilterStatus
+cb_negotiate (MilterClientContext *context, MilterOption *option,
+              gpointer user_data)
+{
+    milter_option_remove_step(option,
+                              MILTER_STEP_ENVELOPE_RECIPIENT_REJECTED |
+                              MILTER_STEP_HEADER_VALUE_WITH_LEADING_SPACE |
+                              MILTER_STEP_NO_MASK);
+
+    return MILTER_STATUS_CONTINUE;
+}
+
+static MilterStatus
+cb_connect (MilterClientContext *context, const gchar *host_name,
+            const struct sockaddr *address, socklen_t address_length,
+            gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_CONNECT);
+}
+
+static MilterStatus
+cb_helo (MilterClientContext *context, const gchar *fqdn, gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_HELO);
+}
+
+static MilterStatus
+cb_envelope_from (MilterClientContext *context, const gchar *from,
+                  gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_ENVELOPE_FROM);
+}
+
+static MilterStatus
+cb_envelope_recipient (MilterClientContext *context, const gchar *to,
+                       gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_ENVELOPE_RECIPIENT);
+}
+
+static MilterStatus
+cb_data (MilterClientContext *context, gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_DATA);
+}
+
+static MilterStatus
+cb_unknown (MilterClientContext *context, const gchar *command,
+            gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_UNKNOWN);
+}
+
+static MilterStatus
+cb_header (MilterClientContext *context, const gchar *name, const gchar *value,
+           gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_HEADER);
+}
+
+static MilterStatus
+cb_end_of_header (MilterClientContext *context, gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_END_OF_HEADER);
+}
+
+static MilterStatus
+cb_body (MilterClientContext *context, const gchar *chunk, gsize length,
+         gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_BODY);
+}
+
+static MilterStatus
+cb_end_of_message (MilterClientContext *context,
+                   const gchar *chunk, gsize length,
+                   gpointer user_data)
+{
+    return reply(context, FAKE_STAGE_END_OF_MESSAGE);
+}
+
+static MilterStatus
+cb_abort (MilterClientContext *context, MilterClientContextState state,
+          gpointer user_data)
+{
+    cancel_reply(milter_client_context_get_private_data(context));
+
+    return MILTER_STATUS_CONTINUE;
+}
+
+static void
+cb_finished (MilterFinishedEmittable *emittable, gpointer user_data)
+{
+    MilterClientContext *context = MILTER_CLIENT_CONTEXT(emittable);
+
+    cancel_reply(milter_client_context_get_private_data(context));
+}
+
+static void
+fake_session_free (FakeSession *session)
+{
+    g_rand_free(session->rand);
+    g_free(session);
+}
+
+static FakeSession *
+fake_session_new (MilterClientContext *context)
+{
+    FakeSession *session;
+    gint n;
+
+    n = g_atomic_int_add(&n_sessions, 1);
+
+    session = g_new0(FakeSession, 1);
+    session->context = context;
+    if (seed == 0)
+        session->rand = g_rand_new();
+    else
+        session->rand = g_rand_new_with_seed(seed + n);
+    session->stage = FAKE_STAGE_CONNECT;
+    session->status = MILTER_STATUS_CONTINUE;
+    session->reply_id = 0;
+
+    return session;
+}
+
+static void
+setup_context_signals (MilterClientContext *context)
+{
+#define CONNECT(name)                                                   \
+    g_signal_connect(context, #name, G_CALLBACK(cb_ ## name), NULL)
+
+    CONNECT(negotiate);
+    CONNECT(connect);
+    CONNECT(helo);
+    CONNECT(envelope_from);
+    CONNECT(envelope_recipient);
+    CONNECT(data);
+    CONNECT(header);
+    CONNECT(end_of_header);
+    CONNECT(body);
+    CONNECT(end_of_message);
+    CONNECT(abort);
+    CONNECT(unknown);
+
+    CONNECT(finished);
+
+#undef CONNECT
+}
+
+static void
+cb_connection_established (MilterClient *client, MilterClientContext *context,
+                           gpointer user_data)
+{
+    milter_client_context_set_private_data(context,
+                                           fake_session_new(context),
+                                           (GDestroyNotify)fake_session_free);
+    setup_context_signals(context);
+}
+
+static void
+cb_error (MilterErrorEmittable *emittable, GError *error,
+          gpointer user_data)
+{
+    g_print("ERROR: %s\n", error->message);
+}
+
+static void
+setup_client_signals (MilterClient *client)
+{
+#define CONNECT(name)                                                   \
+    g_signal_connect(client, #name, G_CALLBACK(cb_ ## name), NULL)
+
+    CONNECT(connection_established);
+    CONNECT(error);
+
+#undef CONNECT
+}
+
+static void
+cb_signal_shutdown_client (int signum)
+{
+    if (client)
+        milter_client_shutdown(client);
+
+    signal(signum, SIG_DFL);
+}
+
+int
+main (int argc, char *argv[])
+{
+    gboolean success = TRUE;
+    GError *error = NULL;
+    GOptionContext *option_context;
+    GOptionGroup *milter_group;
+
+#ifdef HAVE_LOCALE_H
+    setlocale(LC_ALL, "");
+#endif
+
+    milter_init();
+    milter_client_init();
+
+    option_context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(option_context, option_entries, NULL);
+
+    client = milter_client_new();
+    milter_group = milter_client_get_option_group(client);
+    g_option_context_add_group(option_context, milter_group);
+
+    if (!g_option_context_parse(option_context, &argc, &argv, &error)) {
+        g_print("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(option_context);
+        g_object_unref(client);
+        exit(EXIT_FAILURE);
+    }
+
+    init_behaviors();
+    if (configuration_path)
+        success = load_configuration(configuration_path, &error);
+    if (success)
+        success = milter_client_listen(client, &error);
+    if (success)
+        success = milter_client_drop_privilege(client, &error);
+    if (success) {
+        void (*sigint_handler) (int signum);
+        void (*sigterm_handler) (int signum);
+
+        setup_client_signals(client);
+        sigint_handler = signal(SIGINT, cb_signal_shutdown_client);
+        sigterm_handler = signal(SIGTERM, cb_signal_shutdown_client);
+        success = milter_client_run(client, &error);
+        if (!success) {
+            g_print("%s\n", error->message);
+            g_error_free(error);
+        }
+        signal(SIGTERM, sigterm_handler);
+        signal(SIGINT, sigint_handler);
+    } else {
+        g_print("%s\n", error->message);
+        g_error_free(error);
+    }
+    g_object_unref(client);
+    clear_behaviors();
+
+    g_option_context_free(option_context);
+
+    milter_client_quit();
+    milter_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+vi:nowrap:ai:expandtab:sw=4
+*/
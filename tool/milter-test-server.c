@@ -42,6 +42,7 @@
 #include <milter/core.h>
 
 #define DEFAULT_NEGOTIATE_VERSION 6
+#define DEFAULT_BENCHMARK_DURATION 10.0
 #define MILTER_TEST_SERVER_ALL_TIMEOUTS_UNSPECIFIED -1.0
 
 static const gchar *program_name = NULL;
@@ -75,6 +76,14 @@ static gdouble writing_timeout = MILTER_SERVER_CONTEXT_DEFAULT_WRITING_TIMEOUT;
 static gdouble reading_timeout = MILTER_SERVER_CONTEXT_DEFAULT_READING_TIMEOUT;
 static gdouble end_of_message_timeout = MILTER_SERVER_CONTEXT_DEFAULT_END_OF_MESSAGE_TIMEOUT;
 static gdouble all_timeouts = MILTER_TEST_SERVER_ALL_TIMEOUTS_UNSPECIFIED;
+static gboolean benchmark = FALSE;
+static gdouble benchmark_duration = 0.0;
+static gint benchmark_n_sessions = 0;
+static gchar *benchmark_mail_directory = NULL;
+static gchar *benchmark_mbox = NULL;
+static GPtrArray *benchmark_samples = NULL;
+static gint64 benchmark_deadline = 0;
+static volatile gint benchmark_n_started_sessions = 0;
 
 #define MILTER_TEST_SERVER_ERROR                                \
     (g_quark_from_static_string("milter-test-server-error-quark"))
@@ -86,6 +95,55 @@ typedef enum
     MILTER_TEST_SERVER_ERROR_TIMEOUT
 } MilterTestServerError;
 
+typedef enum
+{
+    BENCHMARK_STAGE_NEGOTIATE,
+    BENCHMARK_STAGE_CONNECT,
+    BENCHMARK_STAGE_HELO,
+    BENCHMARK_STAGE_ENVELOPE_FROM,
+    BENCHMARK_STAGE_ENVELOPE_RECIPIENT,
+    BENCHMARK_STAGE_UNKNOWN,
+    BENCHMARK_STAGE_DATA,
+    BENCHMARK_STAGE_HEADER,
+    BENCHMARK_STAGE_END_OF_HEADER,
+    BENCHMARK_STAGE_BODY,
+    BENCHMARK_STAGE_END_OF_MESSAGE,
+    BENCHMARK_STAGE_SESSION,
+    N_BENCHMARK_STAGES,
+    BENCHMARK_STAGE_NONE = N_BENCHMARK_STAGES
+} BenchmarkStage;
+
+static const gchar *benchmark_stage_names[N_BENCHMARK_STAGES] = {
+    "negotiate",
+    "connect",
+    "helo",
+    "envelope-from",
+    "envelope-recipient",
+    "unknown",
+    "data",
+    "header",
+    "end-of-header",
+    "body",
+    "end-of-message",
+    "session"
+};
+
+/* Latencies are in seconds. */
+typedef struct _BenchmarkStatistics
+{
+    guint n_sessions;
+    guint n_errors;
+    GArray *latencies[N_BENCHMARK_STAGES];
+} BenchmarkStatistics;
+
+typedef struct _MailSample
+{
+    gchar *envelope_from;
+    gchar **recipients;
+    MilterHeaders *headers;
+    gchar **body_chunks;
+} MailSample;
+
 typedef struct _Message
 {
     gchar *envelope_from;
@@ -109,12 +167,17 @@ typedef struct _ProcessData
     gchar *reply_message;
     gchar *quarantine_reason;
     MilterOption *option;
+    const gchar *envelope_from;
+    gchar **recipients;
     MilterHeaders *option_headers;
     gint current_recipient;
     gchar **body_chunks;
     gint current_body_chunk;
     Message *message;
     GError *error;
+    BenchmarkStatistics *statistics;
+    BenchmarkStage current_stage;
+    gint64 stage_start_time;
 } ProcessData;
 
 #define RED_COLOR "\033[01;31m"
@@ -130,6 +193,65 @@ typedef struct _ProcessData
 #define NORMAL_COLOR "\033[00m"
 #define NO_COLOR ""
 
+static void
+benchmark_statistics_init (BenchmarkStatistics *statistics)
+{
+    gint i;
+
+    statistics->n_sessions = 0;
+    statistics->n_errors = 0;
+    for (i = 0; i < N_BENCHMARK_STAGES; i++)
+        statistics->latencies[i] = g_array_new(FALSE, FALSE, sizeof(gdouble));
+}
+
+static void
+benchmark_statistics_clear (BenchmarkStatistics *statistics)
+{
+    gint i;
+
+    for (i = 0; i < N_BENCHMARK_STAGES; i++)
+        g_array_free(statistics->latencies[i], TRUE);
+}
+
+static void
+benchmark_statistics_add_latency (BenchmarkStatistics *statistics,
+                                  BenchmarkStage stage,
+                                  gdouble latency)
+{
+    g_array_append_val(statistics->latencies[stage], latency);
+}
+
+/* A stage starts when its command is sent and finishes when
+ * the milter replies to it. Commands that the milter doesn't
+ * reply to (MILTER_STEP_NO_REPLY_*) aren't measured because
+ * the next command overwrites the started stage. */
+static void
+start_stage (ProcessData *data, BenchmarkStage stage)
+{
+    if (!data->statistics)
+        return;
+
+    data->current_stage = stage;
+    data->stage_start_time = g_get_monotonic_time();
+}
+
+static void
+finish_stage (ProcessData *data)
+{
+    gint64 elapsed_time;
+
+    if (!data->statistics)
+        return;
+    if (data->current_stage == BENCHMARK_STAGE_NONE)
+        return;
+
+    elapsed_time = g_get_monotonic_time() - data->stage_start_time;
+    benchmark_statistics_add_latency(data->statistics,
+                                     data->current_stage,
+                                     elapsed_time / (gdouble)G_USEC_PER_SEC);
+    data->current_stage = BENCHMARK_STAGE_NONE;
+}
+
 static void
 remove_recipient (GList **recipients, const gchar *recipient)
 {
@@ -260,6 +382,7 @@ send_connect (MilterServerContext *context, ProcessData *data)
     else
         host_name = "mx.example.net";
 
+    start_stage(data, BENCHMARK_STAGE_CONNECT);
     if (connect_address) {
         milter_server_context_connect(context,
                                       host_name,
@@ -289,6 +412,7 @@ send_helo (MilterServerContext *context, ProcessData *data)
     if (milter_option_get_step(data->option) & MILTER_STEP_NO_HELO)
         return FALSE;
 
+    start_stage(data, BENCHMARK_STAGE_HELO);
     milter_server_context_helo(context, helo_host);
     return TRUE;
 }
@@ -301,7 +425,8 @@ send_envelope_from (MilterServerContext *context, ProcessData *data)
     if (milter_option_get_step(data->option) & MILTER_STEP_NO_ENVELOPE_FROM)
         return FALSE;
 
-    milter_server_context_envelope_from(context, envelope_from);
+    start_stage(data, BENCHMARK_STAGE_ENVELOPE_FROM);
+    milter_server_context_envelope_from(context, data->envelope_from);
     return TRUE;
 }
 
@@ -310,7 +435,7 @@ send_envelope_recipient (MilterServerContext *context, ProcessData *data)
 {
     gchar *recipient;
 
-    recipient = recipients[data->current_recipient];
+    recipient = data->recipients[data->current_recipient];
     if (!recipient)
         return FALSE;
 
@@ -319,6 +444,7 @@ send_envelope_recipient (MilterServerContext *context, ProcessData *data)
     if (milter_option_get_step(data->option) & MILTER_STEP_NO_ENVELOPE_RECIPIENT)
         return FALSE;
 
+    start_stage(data, BENCHMARK_STAGE_ENVELOPE_RECIPIENT);
     milter_server_context_envelope_recipient(context, recipient);
     data->current_recipient++;
     return TRUE;
@@ -335,6 +461,7 @@ send_unknown (MilterServerContext *context, ProcessData *data)
         return FALSE;
 
     set_macros_for_unknown(MILTER_PROTOCOL_AGENT(context));
+    start_stage(data, BENCHMARK_STAGE_UNKNOWN);
     milter_server_context_unknown(context, unknown_command);
     return TRUE;
 }
@@ -349,6 +476,7 @@ send_data (MilterServerContext *context, ProcessData *data)
     if (milter_option_get_version(data->option) < 4)
         return FALSE;
 
+    start_stage(data, BENCHMARK_STAGE_DATA);
     milter_server_context_data(context);
     return TRUE;
 }
@@ -365,6 +493,7 @@ send_header (MilterServerContext *context, ProcessData *data)
         return FALSE;
 
     header = milter_headers_get_nth_header(data->option_headers, 1);
+    start_stage(data, BENCHMARK_STAGE_HEADER);
     milter_server_context_header(context, header->name, header->value);
     milter_headers_remove(data->option_headers, header);
     return TRUE;
@@ -377,6 +506,7 @@ send_end_of_header (MilterServerContext *context, ProcessData *data)
     if (milter_option_get_step(data->option) & MILTER_STEP_NO_END_OF_HEADER)
         return FALSE;
 
+    start_stage(data, BENCHMARK_STAGE_END_OF_HEADER);
     milter_server_context_end_of_header(context);
     return TRUE;
 }
@@ -394,6 +524,7 @@ send_body (MilterServerContext *context, ProcessData *data)
     if (!body_chunk)
         return FALSE;
 
+    start_stage(data, BENCHMARK_STAGE_BODY);
     milter_server_context_body(context, body_chunk, strlen(body_chunk));
     data->current_body_chunk++;
     return TRUE;
@@ -403,6 +534,7 @@ static gboolean
 send_end_of_message (MilterServerContext *context, ProcessData *data)
 {
     set_macros_for_end_of_message(MILTER_PROTOCOL_AGENT(context));
+    start_stage(data, BENCHMARK_STAGE_END_OF_MESSAGE);
     milter_server_context_end_of_message(context, NULL, 0);
     return TRUE;
 }
@@ -412,6 +544,8 @@ cb_continue (MilterServerContext *context, gpointer user_data)
 {
     ProcessData *data = user_data;
 
+    finish_stage(data);
+
     switch (milter_server_context_get_state(context)) {
     case MILTER_SERVER_CONTEXT_STATE_NEGOTIATE:
         if (send_connect(context, data))
@@ -465,6 +599,7 @@ cb_negotiate_reply (MilterServerContext *context, MilterOption *option,
 {
     ProcessData *data = user_data;
 
+    finish_stage(data);
     if (data->option) {
         milter_error("duplicated negotiate");
         send_abort(context, data);
@@ -484,12 +619,13 @@ cb_temporary_failure (MilterServerContext *context, gpointer user_data)
     ProcessData *data = user_data;
     MilterServerContextState state;
 
+    finish_stage(data);
     state = milter_server_context_get_state(context);
 
     switch (state) {
     case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT:
         remove_recipient(&(data->message->recipients),
-                         *(recipients + data->current_recipient - 1));
+                         *(data->recipients + data->current_recipient - 1));
         if (data->message->recipients) {
             cb_continue(context, user_data);
             break;
@@ -507,12 +643,13 @@ cb_reject (MilterServerContext *context, gpointer user_data)
     ProcessData *data = user_data;
     MilterServerContextState state;
 
+    finish_stage(data);
     state = milter_server_context_get_state(context);
 
     switch (state) {
     case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT:
         remove_recipient(&(data->message->recipients),
-                         *(recipients + data->current_recipient - 1));
+                         *(data->recipients + data->current_recipient - 1));
         if (data->message->recipients) {
             cb_continue(context, user_data);
             break;
@@ -533,6 +670,7 @@ cb_reply_code (MilterServerContext *context,
 {
     ProcessData *data = user_data;
 
+    finish_stage(data);
     data->reply_code = code;
     if (data->reply_extended_code)
         g_free(data->reply_extended_code);
@@ -552,6 +690,7 @@ cb_accept (MilterServerContext *context, gpointer user_data)
 {
     ProcessData *data = user_data;
 
+    finish_stage(data);
     send_abort(context, data);
     data->success = TRUE;
 }
@@ -561,6 +700,7 @@ cb_discard (MilterServerContext *context, gpointer user_data)
 {
     ProcessData *data = user_data;
 
+    finish_stage(data);
     send_abort(context, data);
     data->success = FALSE;
 }
@@ -696,6 +836,8 @@ static void
 cb_skip (MilterServerContext *context, gpointer user_data)
 {
     ProcessData *data = user_data;
+
+    finish_stage(data);
     while (data->body_chunks[data->current_body_chunk])
         data->current_body_chunk++;
 
@@ -923,6 +1065,7 @@ cb_ready (MilterServerContext *context, gpointer user_data)
     data->succeeded_to_connect = TRUE;
     setup(context, data);
     g_timer_start(data->timer);
+    start_stage(data, BENCHMARK_STAGE_NEGOTIATE);
     negotiate(context);
 }
 
@@ -1133,16 +1276,6 @@ parse_end_of_message_macro_arg (const gchar *option_name,
                            data, error);
 }
 
-static gboolean
-set_envelope_from (const gchar *from)
-{
-    if (envelope_from)
-        g_free(envelope_from);
-    envelope_from = g_strdup(from);
-
-    return TRUE;
-}
-
 static gchar *
 extract_path_from_mail_address (const gchar *mail_address, GError **error)
 {
@@ -1182,16 +1315,17 @@ extract_path_from_mail_address (const gchar *mail_address, GError **error)
 
 static gboolean
 parse_header (const gchar *name, const gchar *value,
-              GList **recipient_list, GError **error)
+              gchar **reverse_path, GList **recipient_list, GError **error)
 {
     if (strcmp(name, "From") == 0) {
-        gchar *reverse_path;
+        gchar *path;
 
-        reverse_path = extract_path_from_mail_address(value, error);
-        if (!reverse_path)
+        path = extract_path_from_mail_address(value, error);
+        if (!path)
             return FALSE;
-        set_envelope_from(reverse_path);
-        g_free(reverse_path);
+        if (*reverse_path)
+            g_free(*reverse_path);
+        *reverse_path = path;
     } else if (strcmp(name, "To") == 0) {
         gchar *forward_path;
 
@@ -1294,6 +1428,8 @@ parse_mail_contents_header_part_collect_headers (gchar ***lines_,
 
 static gboolean
 parse_mail_contents_header_part_parse_headers (MilterHeaders *headers,
+                                               gchar **reverse_path,
+                                               gchar ***forward_paths,
                                                GError **error)
 {
     const GList *header_list;
@@ -1303,7 +1439,7 @@ parse_mail_contents_header_part_parse_headers (MilterHeaders *headers,
     for (; header_list; header_list = g_list_next(header_list)) {
         MilterHeader *header = header_list->data;
         if (!parse_header(header->name, header->value,
-                          &recipient_list, error)) {
+                          reverse_path, &recipient_list, error)) {
             return FALSE;
         }
     }
@@ -1312,12 +1448,14 @@ parse_mail_contents_header_part_parse_headers (MilterHeaders *headers,
         gint i, length;
         GList *node;
 
+        if (*forward_paths)
+            g_strfreev(*forward_paths);
         length = g_list_length(recipient_list);
-        recipients = g_new0(gchar *, length + 1);
+        *forward_paths = g_new0(gchar *, length + 1);
         for (i = 0, node = recipient_list; node; i++, node = g_list_next(node)) {
-            recipients[i] = node->data;
+            (*forward_paths)[i] = node->data;
         }
-        recipients[length] = NULL;
+        (*forward_paths)[length] = NULL;
         g_list_free(recipient_list);
     }
 
@@ -1325,7 +1463,11 @@ parse_mail_contents_header_part_parse_headers (MilterHeaders *headers,
 }
 
 static gboolean
-parse_mail_contents_header_part (gchar ***lines_, GError **error)
+parse_mail_contents_header_part (gchar ***lines_,
+                                 MilterHeaders *mail_headers,
+                                 gchar **reverse_path,
+                                 gchar ***forward_paths,
+                                 GError **error)
 {
     MilterHeaders *headers;
     const GList *header_list;
@@ -1338,7 +1480,10 @@ parse_mail_contents_header_part (gchar ***lines_, GError **error)
         return FALSE;
     }
 
-    if (!parse_mail_contents_header_part_parse_headers(headers, error)) {
+    if (!parse_mail_contents_header_part_parse_headers(headers,
+                                                       reverse_path,
+                                                       forward_paths,
+                                                       error)) {
         g_object_unref(headers);
         return FALSE;
     }
@@ -1346,7 +1491,7 @@ parse_mail_contents_header_part (gchar ***lines_, GError **error)
     header_list = milter_headers_get_list(headers);
     for (; header_list; header_list = g_list_next(header_list)) {
         MilterHeader *header = header_list->data;
-        milter_headers_append_header(option_headers,
+        milter_headers_append_header(mail_headers,
                                      header->name, header->value);
     }
 
@@ -1356,7 +1501,8 @@ parse_mail_contents_header_part (gchar ***lines_, GError **error)
 }
 
 static gboolean
-parse_mail_contents_body_part (gchar ***lines_, GError **error)
+parse_mail_contents_body_part (gchar ***lines_, gchar ***chunks_,
+                               GError **error)
 {
     gchar **lines = *lines_;
     GString *body_string;
@@ -1393,13 +1539,20 @@ parse_mail_contents_body_part (gchar ***lines_, GError **error)
     }
     g_string_free(body_string, TRUE);
     g_ptr_array_add(chunks, NULL);
-    body_chunks = (gchar **)g_ptr_array_free(chunks, FALSE);
+    if (*chunks_)
+        g_strfreev(*chunks_);
+    *chunks_ = (gchar **)g_ptr_array_free(chunks, FALSE);
 
     return TRUE;
 }
 
 static gboolean
-parse_mail_contents (const gchar *contents, GError **error)
+parse_mail_contents (const gchar *contents,
+                     MilterHeaders *mail_headers,
+                     gchar **reverse_path,
+                     gchar ***forward_paths,
+                     gchar ***chunks,
+                     GError **error)
 {
     gchar **lines, **first_lines;
 
@@ -1410,12 +1563,16 @@ parse_mail_contents (const gchar *contents, GError **error)
     if (*lines && g_str_has_prefix(*lines, "From "))
         lines++;
 
-    if (!parse_mail_contents_header_part(&lines, error)) {
+    if (!parse_mail_contents_header_part(&lines,
+                                         mail_headers,
+                                         reverse_path,
+                                         forward_paths,
+                                         error)) {
         g_strfreev(first_lines);
         return FALSE;
     }
 
-    if (!parse_mail_contents_body_part(&lines, error)) {
+    if (!parse_mail_contents_body_part(&lines, chunks, error)) {
         g_strfreev(first_lines);
         return FALSE;
     }
@@ -1471,7 +1628,12 @@ parse_mail_file_arg (const gchar *option_name,
     }
     g_io_channel_unref(io_channel);
 
-    if (!parse_mail_contents(contents, &internal_error)) {
+    if (!parse_mail_contents(contents,
+                             option_headers,
+                             &envelope_from,
+                             &recipients,
+                             &body_chunks,
+                             &internal_error)) {
         g_set_error(error,
                     G_OPTION_ERROR,
                     G_OPTION_ERROR_FAILED,
@@ -1484,6 +1646,193 @@ parse_mail_file_arg (const gchar *option_name,
     return TRUE;
 }
 
+static void
+mail_sample_free (MailSample *sample)
+{
+    if (sample->envelope_from)
+        g_free(sample->envelope_from);
+    if (sample->recipients)
+        g_strfreev(sample->recipients);
+    if (sample->headers)
+        g_object_unref(sample->headers);
+    if (sample->body_chunks)
+        g_strfreev(sample->body_chunks);
+    g_free(sample);
+}
+
+/* Envelope addresses fall back to the ones specified by
+ * command line options. So this must be called after they
+ * are normalized. */
+static gboolean
+add_benchmark_sample (const gchar *contents, GError **error)
+{
+    MailSample *sample;
+
+    sample = g_new0(MailSample, 1);
+    sample->headers = milter_headers_new();
+    if (!parse_mail_contents(contents,
+                             sample->headers,
+                             &(sample->envelope_from),
+                             &(sample->recipients),
+                             &(sample->body_chunks),
+                             error)) {
+        mail_sample_free(sample);
+        return FALSE;
+    }
+
+    if (!sample->envelope_from)
+        sample->envelope_from = g_strdup(envelope_from);
+    if (!sample->recipients)
+        sample->recipients = g_strdupv(recipients);
+
+    g_ptr_array_add(benchmark_samples, sample);
+
+    return TRUE;
+}
+
+static gboolean
+load_benchmark_sample (const gchar *path, GError **error)
+{
+    gchar *contents = NULL;
+    GError *internal_error = NULL;
+
+    if (!g_file_get_contents(path, &contents, NULL, &internal_error) ||
+        !add_benchmark_sample(contents, &internal_error)) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_FAILED,
+                    _("Loading from %s failed.: %s"),
+                    path, internal_error->message);
+        g_error_free(internal_error);
+        g_free(contents);
+        return FALSE;
+    }
+    g_free(contents);
+
+    return TRUE;
+}
+
+static gint
+compare_file_name (gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+static gboolean
+load_benchmark_mail_directory (const gchar *directory, GError **error)
+{
+    GDir *dir;
+    const gchar *name;
+    GPtrArray *paths;
+    GError *internal_error = NULL;
+    gboolean success = TRUE;
+    guint i;
+
+    dir = g_dir_open(directory, 0, &internal_error);
+    if (!dir) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_FAILED,
+                    _("Loading from %s failed.: %s"),
+                    directory, internal_error->message);
+        g_error_free(internal_error);
+        return FALSE;
+    }
+
+    paths = g_ptr_array_new_with_free_func(g_free);
+    while ((name = g_dir_read_name(dir))) {
+        gchar *path;
+
+        if (name[0] == '.')
+            continue;
+        path = g_build_filename(directory, name, NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_REGULAR))
+            g_ptr_array_add(paths, path);
+        else
+            g_free(path);
+    }
+    g_dir_close(dir);
+
+    /* Samples are used in the same order on every run. */
+    g_ptr_array_sort(paths, compare_file_name);
+    for (i = 0; i < paths->len && success; i++) {
+        success = load_benchmark_sample(g_ptr_array_index(paths, i), error);
+    }
+
+    if (success && paths->len == 0) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_BAD_VALUE,
+                    _("%s has no mail."), directory);
+        success = FALSE;
+    }
+    g_ptr_array_unref(paths);
+
+    return success;
+}
+
+static gboolean
+load_benchmark_mbox (const gchar *path, GError **error)
+{
+    gchar *contents = NULL;
+    const gchar *mail;
+    GError *internal_error = NULL;
+    guint n_mails = 0;
+
+    if (!g_file_get_contents(path, &contents, NULL, &internal_error)) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_FAILED,
+                    _("Loading from %s failed.: %s"),
+                    path, internal_error->message);
+        g_error_free(internal_error);
+        return FALSE;
+    }
+
+    /* Each mail starts with a 'From ' line. The line itself is
+     * ignored by parse_mail_contents(). */
+    mail = contents;
+    while (mail[0]) {
+        const gchar *next_mail;
+        gchar *mail_contents;
+        gboolean success;
+
+        next_mail = strstr(mail, "\nFrom ");
+        if (next_mail) {
+            next_mail++;
+            mail_contents = g_strndup(mail, next_mail - mail);
+        } else {
+            next_mail = mail + strlen(mail);
+            mail_contents = g_strdup(mail);
+        }
+        success = add_benchmark_sample(mail_contents, &internal_error);
+        g_free(mail_contents);
+        if (!success) {
+            g_set_error(error,
+                        G_OPTION_ERROR,
+                        G_OPTION_ERROR_FAILED,
+                        _("Loading from %s failed.: %s"),
+                        path, internal_error->message);
+            g_error_free(internal_error);
+            g_free(contents);
+            return FALSE;
+        }
+        n_mails++;
+        mail = next_mail;
+    }
+    g_free(contents);
+
+    if (n_mails == 0) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_BAD_VALUE,
+                    _("%s has no mail."), path);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 static gboolean
 parse_color_arg (const gchar *option_name, const gchar *value,
                  gpointer data, GError **error)
@@ -1613,6 +1962,24 @@ static const GOptionEntry option_entries[] =
      "SECONDS"},
     {"threads", 't', 0, G_OPTION_ARG_INT, &n_threads,
      N_("Create N threads."), "N"},
+    {"benchmark", 0, 0, G_OPTION_ARG_NONE, &benchmark,
+     N_("Run sessions repeatedly and report throughput and latencies "
+        "as JSON. Sessions are run concurrently by --threads threads."),
+     NULL},
+    {"benchmark-duration", 0, 0, G_OPTION_ARG_DOUBLE, &benchmark_duration,
+     N_("Stop starting new benchmark sessions after SECONDS seconds. "
+        "(" G_STRINGIFY(DEFAULT_BENCHMARK_DURATION) " "
+        "unless --benchmark-sessions is specified)"),
+     "SECONDS"},
+    {"benchmark-sessions", 0, 0, G_OPTION_ARG_INT, &benchmark_n_sessions,
+     N_("Run N benchmark sessions in total."), "N"},
+    {"benchmark-mail-directory", 0, 0, G_OPTION_ARG_FILENAME,
+     &benchmark_mail_directory,
+     N_("Use mails placed in DIRECTORY as benchmark mail samples."),
+     "DIRECTORY"},
+    {"benchmark-mbox", 0, 0, G_OPTION_ARG_FILENAME, &benchmark_mbox,
+     N_("Use mails in mbox placed at PATH as benchmark mail samples."),
+     "PATH"},
     {"verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose,
      N_("Be verbose"), NULL},
     {"version", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, print_version,
@@ -1621,28 +1988,29 @@ static const GOptionEntry option_entries[] =
 };
 
 static Message *
-message_new (void)
+message_new (const gchar *reverse_path, gchar **forward_paths,
+             MilterHeaders *headers, gchar **chunks)
 {
     Message *message;
     gint i;
 
     message = g_new0(Message, 1);
-    message->envelope_from = g_strdup(envelope_from);
-    message->original_envelope_from = g_strdup(envelope_from);
+    message->envelope_from = g_strdup(reverse_path);
+    message->original_envelope_from = g_strdup(reverse_path);
     message->recipients = NULL;
     message->original_recipients = NULL;
-    for (i = 0; i < g_strv_length(recipients); i++) {
+    for (i = 0; i < g_strv_length(forward_paths); i++) {
         message->recipients = \
-            g_list_append(message->recipients, g_strdup(recipients[i]));
+            g_list_append(message->recipients, g_strdup(forward_paths[i]));
         message->original_recipients = \
-            g_list_append(message->original_recipients, g_strdup(recipients[i]));
+            g_list_append(message->original_recipients, g_strdup(forward_paths[i]));
     }
-    message->headers = milter_headers_copy(option_headers);
-    message->original_headers = milter_headers_copy(option_headers);
+    message->headers = milter_headers_copy(headers);
+    message->original_headers = milter_headers_copy(headers);
 
     message->body_string = g_string_new(NULL);
-    for (i = 0; i < g_strv_length(body_chunks); i++)
-        g_string_append(message->body_string, g_strdup(body_chunks[i]));
+    for (i = 0; i < g_strv_length(chunks); i++)
+        g_string_append(message->body_string, chunks[i]);
     message->replaced_body_string = g_string_new(NULL);
 
     return message;
@@ -1669,28 +2037,50 @@ free_message (Message *message)
         g_object_unref(message->original_headers);
     if (message->body_string)
         g_string_free(message->body_string, TRUE);
+    if (message->replaced_body_string)
+        g_string_free(message->replaced_body_string, TRUE);
 
     g_free(message);
 }
 
+/* Uses the mail specified by command line options when
+ * sample is NULL. */
 static void
-init_process_data (ProcessData *data)
+init_process_data (ProcessData *data, const MailSample *sample)
 {
+    MilterHeaders *headers = option_headers;
+    gchar **chunks = body_chunks;
+
+    data->envelope_from = envelope_from;
+    data->recipients = recipients;
+    if (sample) {
+        data->envelope_from = sample->envelope_from;
+        data->recipients = sample->recipients;
+        headers = sample->headers;
+        chunks = sample->body_chunks;
+    }
+
     data->loop = milter_glib_event_loop_new(NULL);
     data->timer = g_timer_new();
     data->succeeded_to_connect = TRUE;
     data->success = TRUE;
     data->quarantine_reason = NULL;
     data->option = NULL;
-    data->option_headers = milter_headers_copy(option_headers);
-    data->body_chunks = g_strdupv(body_chunks);
+    data->option_headers = milter_headers_copy(headers);
+    data->body_chunks = g_strdupv(chunks);
     data->current_body_chunk = 0;
     data->current_recipient = 0;
     data->reply_code = 0;
     data->reply_extended_code = NULL;
     data->reply_message = NULL;
-    data->message = message_new();
+    data->message = message_new(data->envelope_from,
+                                data->recipients,
+                                headers,
+                                chunks);
     data->error = NULL;
+    data->statistics = NULL;
+    data->current_stage = BENCHMARK_STAGE_NONE;
+    data->stage_start_time = 0;
 }
 
 static void
@@ -1949,6 +2339,29 @@ post_option_parse (GOptionContext *option_context,
 
     post_apply_options_to_macros();
 
+    if (!benchmark &&
+        (benchmark_duration > 0.0 ||
+         benchmark_n_sessions > 0 ||
+         benchmark_mail_directory ||
+         benchmark_mbox)) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_BAD_VALUE,
+                    _("--benchmark-* options require --benchmark"));
+        return FALSE;
+    }
+    if (benchmark) {
+        if (benchmark_duration <= 0.0 && benchmark_n_sessions <= 0)
+            benchmark_duration = DEFAULT_BENCHMARK_DURATION;
+        benchmark_samples =
+            g_ptr_array_new_with_free_func((GDestroyNotify)mail_sample_free);
+        if (benchmark_mail_directory &&
+            !load_benchmark_mail_directory(benchmark_mail_directory, error))
+            return FALSE;
+        if (benchmark_mbox && !load_benchmark_mbox(benchmark_mbox, error))
+            return FALSE;
+    }
+
     return TRUE;
 }
 
@@ -1972,6 +2385,9 @@ free_option_values (void)
         g_hash_table_unref(end_of_header_macros);
     if (end_of_message_macros)
         g_hash_table_unref(end_of_message_macros);
+
+    if (benchmark_samples)
+        g_ptr_array_unref(benchmark_samples);
 }
 
 static void
@@ -2329,24 +2745,31 @@ setup_context (MilterServerContext *context, ProcessData *process_data)
     g_signal_connect(context, "error", G_CALLBACK(cb_connection_error), process_data);
 }
 
+static gboolean
+run_process (MilterServerContext *context, ProcessData *process_data,
+             GError **error)
+{
+    if (!milter_server_context_set_connection_spec(context, spec, error))
+        return FALSE;
+    if (!milter_server_context_establish_connection(context, error))
+        return FALSE;
+
+    milter_event_loop_run(process_data->loop);
+
+    return TRUE;
+}
+
 static gboolean
 start_process (MilterServerContext *context, ProcessData *process_data)
 {
-    gboolean success;
     GError *error = NULL;
 
-    success = milter_server_context_set_connection_spec(context, spec, &error);
-    if (success)
-        success = milter_server_context_establish_connection(context, &error);
-
-    if (!success) {
+    if (!run_process(context, process_data, &error)) {
         g_print("%s\n", error->message);
         g_error_free(error);
         return FALSE;
     }
 
-    milter_event_loop_run(process_data->loop);
-
     print_result(context, process_data);
 
     return process_data->succeeded_to_connect;
@@ -2369,6 +2792,270 @@ test_server_thread (gpointer data)
     return GINT_TO_POINTER(success);
 }
 
+static gboolean
+benchmark_next_session (const MailSample **sample)
+{
+    gint n_started_sessions;
+
+    if (benchmark_deadline > 0 && g_get_monotonic_time() >= benchmark_deadline)
+        return FALSE;
+
+    n_started_sessions = g_atomic_int_add(&benchmark_n_started_sessions, 1);
+    if (benchmark_n_sessions > 0 && n_started_sessions >= benchmark_n_sessions)
+        return FALSE;
+
+    if (benchmark_samples->len == 0)
+        *sample = NULL;
+    else
+        *sample = g_ptr_array_index(benchmark_samples,
+                                    n_started_sessions %
+                                    benchmark_samples->len);
+    return TRUE;
+}
+
+static gpointer
+benchmark_thread (gpointer data)
+{
+    BenchmarkStatistics *statistics = data;
+    const MailSample *sample;
+
+    while (benchmark_next_session(&sample)) {
+        ProcessData process_data;
+        MilterServerContext *context;
+        GError *error = NULL;
+
+        init_process_data(&process_data, sample);
+        process_data.statistics = statistics;
+
+        context = milter_server_context_new();
+        setup_context(context, &process_data);
+        if (!run_process(context, &process_data, &error)) {
+            milter_error("[benchmark][error] %s", error->message);
+            g_error_free(error);
+            process_data.succeeded_to_connect = FALSE;
+        }
+        g_object_unref(context);
+
+        statistics->n_sessions++;
+        if (!process_data.succeeded_to_connect || process_data.error) {
+            if (process_data.error)
+                milter_error("[benchmark][error] %s",
+                             process_data.error->message);
+            statistics->n_errors++;
+        } else {
+            benchmark_statistics_add_latency(
+                statistics,
+                BENCHMARK_STAGE_SESSION,
+                g_timer_elapsed(process_data.timer, NULL));
+        }
+
+        free_process_data(&process_data);
+    }
+
+    return NULL;
+}
+
+static gint
+compare_latency (gconstpointer a, gconstpointer b)
+{
+    gdouble latency1 = *(const gdouble *)a;
+    gdouble latency2 = *(const gdouble *)b;
+
+    if (latency1 < latency2)
+        return -1;
+    else if (latency1 > latency2)
+        return 1;
+    else
+        return 0;
+}
+
+/* Uses the nearest-rank method. latencies must be sorted. */
+static gdouble
+latency_percentile (GArray *latencies, gdouble percentile)
+{
+    gdouble exact_rank;
+    guint rank;
+
+    exact_rank = percentile * latencies->len;
+    rank = (guint)exact_rank;
+    if (rank < exact_rank || rank < 1)
+        rank++;
+    if (rank > latencies->len)
+        rank = latencies->len;
+    return g_array_index(latencies, gdouble, rank - 1);
+}
+
+static void
+append_json_double (GString *json, gdouble value)
+{
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_ascii_formatd(buffer, sizeof(buffer), "%.6f", value);
+    g_string_append(json, buffer);
+}
+
+static void
+append_json_string (GString *json, const gchar *string)
+{
+    const gchar *character;
+
+    g_string_append_c(json, '"');
+    for (character = string; *character; character++) {
+        switch (*character) {
+        case '"':
+            g_string_append(json, "\\\"");
+            break;
+        case '\\':
+            g_string_append(json, "\\\\");
+            break;
+        default:
+            if ((guchar)*character < 0x20)
+                g_string_append_printf(json, "\\u%04x", *character);
+            else
+                g_string_append_c(json, *character);
+            break;
+        }
+    }
+    g_string_append_c(json, '"');
+}
+
+static void
+append_stage_latencies (GString *json, GArray *latencies)
+{
+    const gdouble percentiles[] = {0.5, 0.95, 0.99, 0.999};
+    const gchar *percentile_names[] = {"p50", "p95", "p99", "p999"};
+    gdouble sum = 0.0;
+    guint i;
+
+    g_array_sort(latencies, compare_latency);
+    for (i = 0; i < latencies->len; i++)
+        sum += g_array_index(latencies, gdouble, i);
+
+    g_string_append_printf(json, "{\"count\": %u, \"min\": ", latencies->len);
+    append_json_double(json, g_array_index(latencies, gdouble, 0));
+    g_string_append(json, ", \"mean\": ");
+    append_json_double(json, sum / latencies->len);
+    for (i = 0; i < G_N_ELEMENTS(percentiles); i++) {
+        g_string_append_printf(json, ", \"%s\": ", percentile_names[i]);
+        append_json_double(json, latency_percentile(latencies, percentiles[i]));
+    }
+    g_string_append(json, ", \"max\": ");
+    append_json_double(json,
+                       g_array_index(latencies, gdouble, latencies->len - 1));
+    g_string_append(json, "}");
+}
+
+static void
+print_benchmark_report (BenchmarkStatistics *statistics,
+                        guint concurrency,
+                        gdouble elapsed_time)
+{
+    GString *json;
+    gboolean first_stage = TRUE;
+    gint i;
+
+    json = g_string_new("{\n");
+    g_string_append(json, "  \"spec\": ");
+    append_json_string(json, spec);
+    g_string_append_printf(json, ",\n  \"concurrency\": %u,\n", concurrency);
+    g_string_append_printf(json, "  \"samples\": %u,\n",
+                           benchmark_samples->len);
+    g_string_append(json, "  \"elapsed_time\": ");
+    append_json_double(json, elapsed_time);
+    g_string_append_printf(json, ",\n  \"sessions\": %u,\n",
+                           statistics->n_sessions);
+    g_string_append_printf(json, "  \"errors\": %u,\n",
+                           statistics->n_errors);
+    g_string_append(json, "  \"throughput\": ");
+    append_json_double(json,
+                       elapsed_time > 0.0 ?
+                       (statistics->n_sessions - statistics->n_errors) /
+                       elapsed_time :
+                       0.0);
+    g_string_append(json, ",\n  \"latencies\": {");
+    for (i = 0; i < N_BENCHMARK_STAGES; i++) {
+        GArray *latencies = statistics->latencies[i];
+
+        if (latencies->len == 0)
+            continue;
+        g_string_append(json, first_stage ? "\n" : ",\n");
+        first_stage = FALSE;
+        g_string_append(json, "    ");
+        append_json_string(json, benchmark_stage_names[i]);
+        g_string_append(json, ": ");
+        append_stage_latencies(json, latencies);
+    }
+    g_string_append(json, first_stage ? "}\n" : "\n  }\n");
+    g_string_append(json, "}\n");
+
+    g_print("%s", json->str);
+    g_string_free(json, TRUE);
+}
+
+static gboolean
+run_benchmark (void)
+{
+    BenchmarkStatistics *worker_statistics;
+    BenchmarkStatistics statistics;
+    GThread **threads = NULL;
+    GTimer *timer;
+    guint concurrency;
+    gboolean success;
+    guint i;
+    gint j;
+
+    concurrency = MAX(n_threads, 1);
+    worker_statistics = g_new0(BenchmarkStatistics, concurrency);
+    for (i = 0; i < concurrency; i++)
+        benchmark_statistics_init(&worker_statistics[i]);
+
+    timer = g_timer_new();
+    if (benchmark_duration > 0.0)
+        benchmark_deadline =
+            g_get_monotonic_time() + benchmark_duration * G_USEC_PER_SEC;
+    if (n_threads > 0) {
+        threads = g_new0(GThread *, concurrency);
+        for (i = 0; i < concurrency; i++) {
+            threads[i] = g_thread_try_new("benchmark_thread",
+                                          benchmark_thread,
+                                          &worker_statistics[i],
+                                          NULL);
+        }
+        for (i = 0; i < concurrency; i++) {
+            if (threads[i])
+                g_thread_join(threads[i]);
+        }
+        g_free(threads);
+    } else {
+        benchmark_thread(&worker_statistics[0]);
+    }
+    g_timer_stop(timer);
+
+    benchmark_statistics_init(&statistics);
+    for (i = 0; i < concurrency; i++) {
+        BenchmarkStatistics *worker = &worker_statistics[i];
+
+        statistics.n_sessions += worker->n_sessions;
+        statistics.n_errors += worker->n_errors;
+        for (j = 0; j < N_BENCHMARK_STAGES; j++) {
+            g_array_append_vals(statistics.latencies[j],
+                                worker->latencies[j]->data,
+                                worker->latencies[j]->len);
+        }
+        benchmark_statistics_clear(worker);
+    }
+    g_free(worker_statistics);
+
+    print_benchmark_report(&statistics, concurrency,
+                           g_timer_elapsed(timer, NULL));
+    success = statistics.n_sessions > 0 && statistics.n_errors == 0;
+
+    benchmark_statistics_clear(&statistics);
+    g_timer_destroy(timer);
+
+    return success;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -2402,7 +3089,9 @@ main (int argc, char *argv[])
     if (verbose)
         g_setenv("MILTER_LOG_LEVEL", "all", FALSE);
 
-    if (n_threads > 0) {
+    if (benchmark) {
+        success = run_benchmark();
+    } else if (n_threads > 0) {
         GThread **threads;
         ProcessData *process_data;
         gint i;
@@ -2410,7 +3099,7 @@ main (int argc, char *argv[])
         threads = g_new0(GThread *, n_threads);
         process_data = g_new0(ProcessData, n_threads);
         for (i = 0; i < n_threads; i++) {
-            init_process_data(&process_data[i]);
+            init_process_data(&process_data[i], NULL);
             threads[i] = g_thread_try_new("test_server_thread",
                                           test_server_thread,
                                           &process_data[i],
@@ -2426,7 +3115,7 @@ main (int argc, char *argv[])
         g_free(threads);
     } else {
         ProcessData process_data;
-        init_process_data(&process_data);
+        init_process_data(&process_data, NULL);
         success = GPOINTER_TO_INT(test_server_thread(&process_data));
         free_process_data(&process_data);
     }